@@ -0,0 +1,1064 @@
+/************************************************************************************//**
+* \file         bench\xcpbench.c
+* \brief        End-to-end firmware update benchmark against the simulated XCP slave.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <stdio.h>                                    /* standard I/O library          */
+#include <stdlib.h>                                   /* standard library              */
+#include <string.h>                                   /* string library                */
+#include <unistd.h>                                   /* UNIX standard functions       */
+#include <signal.h>                                   /* signal handling               */
+#include <fcntl.h>                                    /* file control options          */
+#include <sys/wait.h>                                 /* waiting for child processes   */
+#include "xcpmaster.h"                                /* XCP master protocol module    */
+#include "srecord.h"                                  /* S-record file handling        */
+#include "timeutil.h"                                 /* time utility module           */
+#include "filemap.h"                                  /* read-only file mapping        */
+#include "hexdecode.h"                                /* hexadecimal decoding          */
+#include "parallel.h"                                 /* parallel execution of jobs    */
+#include "imagecache.h"                               /* parsed firmware image cache   */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Program return code if all went ok. */
+#define PROG_RESULT_OK    (0)
+
+/** \brief Program return code if an error occurred. */
+#define PROG_RESULT_ERROR (1)
+
+/** \brief Number of data bytes on each generated S-record line. */
+#define BENCH_BYTES_PER_RECORD         (32)
+
+/** \brief Size of the flash memory of the simulated slave. */
+#define BENCH_FLASH_SIZE               (1024 * 1024)
+
+/** \brief Time in microseconds that the simulated slave takes to erase a sector. */
+#define BENCH_ERASE_TIME_US            (2000)
+
+/** \brief Time in microseconds that the simulated slave takes to erase a sector for the
+ *         images that are erased on demand. Erasing a chunk then takes longer than the
+ *         lower bound of a timeout.
+ */
+#define BENCH_SLOW_ERASE_TIME_US       (20000)
+
+/** \brief Size of an erasable sector of the simulated slave. */
+#define BENCH_SECTOR_SIZE              (4096)
+
+/** \brief Number of bytes that are programmed after erasing on demand, the same as a
+ *         chunk of openblt-tcp-boot --stream.
+ */
+#define BENCH_STREAM_CHUNK_SIZE        (64 * 1024)
+
+/** \brief Time in nanoseconds that the simulated slave takes to program a byte. */
+#define BENCH_PROGRAM_TIME_NS          (20)
+
+/** \brief Time in milliseconds that the simulated slave is given to start listening. */
+#define BENCH_SIM_START_TIMEOUT_MS     (2000)
+
+/** \brief Maximum number of characters in a file name. */
+#define BENCH_PATH_MAX_LEN             (256)
+
+/** \brief Number of characters of a generated S3 line, including the line feed. */
+#define BENCH_S3_LINE_LEN              (4 + (2 * (4 + BENCH_BYTES_PER_RECORD + 1)) + 1)
+
+/** \brief Number of times the parse benchmark parses the file with each decoder. The
+ *         fastest run counts.
+ */
+#define BENCH_PARSE_RUNS               (3)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enumeration for the phases of a firmware update that are timed separately. */
+typedef enum
+{
+  BENCH_PHASE_PARSE,                             /**< parsing the S-record file        */
+  BENCH_PHASE_CONNECT,                           /**< TCP and XCP connect              */
+  BENCH_PHASE_PROGRAM_START,                     /**< starting the programming session */
+  BENCH_PHASE_ERASE,                             /**< erasing memory                   */
+  BENCH_PHASE_PROGRAM,                           /**< programming data                 */
+  BENCH_PHASE_FINISH,                            /**< stopping the session and reset   */
+  BENCH_PHASE_CNT                                /**< number of phases                 */
+} tBenchPhase;
+
+/** \brief Enumeration for the ways the memory of the simulated slave is erased. */
+typedef enum
+{
+  BENCH_ERASE_SPAN,                              /**< lowest to highest address        */
+  BENCH_ERASE_SECTORS,                           /**< runs of sectors with data, -k    */
+  BENCH_ERASE_ON_DEMAND                          /**< before each chunk, --stream      */
+} tBenchErase;
+
+/** \brief Structure type for a synthetic firmware image. The image consists of blocks
+ *         of the same size, placed at a fixed distance from each other. Only the first
+ *         block can be of a different size, such as a bootloader in front of the
+ *         application.
+ */
+typedef struct
+{
+  const sb_char *name;                            /**< name of the image               */
+  const sb_char *layout;                          /**< dense or sparse                 */
+  sb_uint8 recordType;                            /**< 1, 2 or 3 for S1, S2 or S3      */
+  tBenchErase erase;                              /**< how the memory is erased        */
+  sb_uint32 base;                                 /**< address of the first block      */
+  sb_uint32 firstBlockSize;                       /**< number of bytes in first block  */
+  sb_uint32 blockSize;                            /**< number of bytes in a block      */
+  sb_uint32 blockStride;                          /**< distance between the blocks     */
+  sb_uint32 blockCnt;                             /**< number of blocks                */
+} tBenchImage;
+
+/** \brief Structure type for the results of one benchmark run. */
+typedef struct
+{
+  sb_uint8 result;                                /**< SB_TRUE if the update succeeded */
+  sb_uint32 dataBytes;                            /**< number of programmed bytes      */
+  sb_uint32 commands;                             /**< number of transmitted commands  */
+  sb_uint64 phaseNs[BENCH_PHASE_CNT];             /**< duration of each phase          */
+  sb_uint64 wallNs;                               /**< duration of the complete update */
+} tBenchResult;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void     DisplayProgramInfo(void);
+static void     DisplayProgramUsage(void);
+static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[]);
+static sb_uint8 BenchWriteImage(const tBenchImage *image, const sb_char *fileName);
+static void     BenchWriteRecord(sb_file hFile, sb_uint8 recordType, sb_uint32 address,
+                                 const sb_uint8 *data, sb_uint8 len);
+static pid_t    BenchStartSim(sb_uint32 flashBase, sb_uint32 eraseTimeUs,
+                              sb_uint32 oneWayDelayUs);
+static void     BenchStopSim(pid_t pid);
+static sb_uint8 BenchRun(const sb_char *fileName, tBenchErase erase,
+                         tBenchResult *result);
+static sb_uint8 BenchEraseSectors(tXcpMasterSession *session, const tSrecordImage *image);
+static sb_uint8 BenchProgramOnDemand(tXcpMasterSession *session, const tSrecordImage *image);
+static void     BenchWriteJsonResult(sb_file hJson, const tBenchImage *image,
+                                     sb_uint32 rttUs, const tBenchResult *result,
+                                     sb_uint8 first);
+static sb_int32 BenchParse(void);
+static sb_uint64 BenchParseRuns(const tFileMap *srecordFile, sb_uint8 *ok);
+static sb_uint64 BenchParseCacheRuns(const tFileMap *srecordFile, sb_uint8 *ok);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Synthetic firmware images that are benchmarked. The boot and application
+ *         image erases a single sector before a long run of sectors, which must not
+ *         time out on the round trip time of the short erase.
+ */
+static const tBenchImage benchImages[] =
+{
+  { "s3-dense-32k",    "dense",  3, BENCH_ERASE_SPAN,    0x08000000, 32768,  32768,  32768,  1  },
+  { "s3-dense-128k",   "dense",  3, BENCH_ERASE_SPAN,    0x08000000, 131072, 131072, 131072, 1  },
+  { "s3-sparse-16x512","sparse", 3, BENCH_ERASE_SPAN,    0x08000000, 512,    512,    4096,   16 },
+  { "s3-boot-app-512k","sparse", 3, BENCH_ERASE_SECTORS, 0x08000000, 64,     524288, 65536,  2  },
+  { "s3-boot-app-128k","sparse", 3, BENCH_ERASE_ON_DEMAND,0x08000000, 64,     131072, 65536,  2  },
+  { "s2-dense-32k",    "dense",  2, BENCH_ERASE_SPAN,    0x00010000, 32768,  32768,  32768,  1  },
+  { "s1-dense-16k",    "dense",  1, BENCH_ERASE_SPAN,    0x00001000, 16384,  16384,  16384,  1  }
+};
+
+/** \brief Names of the ways to erase in the JSON output, indexed by tBenchErase. */
+static const sb_char *benchEraseNames[] =
+{
+  "span", "sectors", "onDemand"
+};
+
+/** \brief Round trip times in microseconds that the network of the simulated slave
+ *         injects. 0 measures the plain loopback interface.
+ */
+static const sb_uint32 benchRttsUs[] = { 0, 200, 1000 };
+
+/** \brief Names of the phases in the JSON output, indexed by tBenchPhase. */
+static const sb_char *benchPhaseNames[BENCH_PHASE_CNT] =
+{
+  "parse", "connect", "programStart", "erase", "program", "finish"
+};
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Path of the simulated slave executable. */
+static sb_char simPath[BENCH_PATH_MAX_LEN];
+
+/** \brief Name of the JSON file that the results are written to. */
+static sb_char jsonFileName[BENCH_PATH_MAX_LEN] = "bench.json";
+
+/** \brief Directory where the generated S-record files are stored. */
+static sb_char workDir[BENCH_PATH_MAX_LEN] = "/tmp";
+
+/** \brief TCP port of the simulated slave. */
+static sb_uint32 simPort = 5800;
+
+/** \brief Number of program commands in flight. */
+static sb_uint32 programWindow = 1;
+
+/** \brief Size in MiB of the S-record file of the parse benchmark, 0 to benchmark the
+ *         firmware update instead.
+ */
+static sb_uint32 parseSizeMiB = 0;
+
+
+/************************************************************************************//**
+** \brief     Program entry point. Generates the synthetic images and updates the
+**            simulated slave with each of them at each of the round trip times.
+** \param     argc Number of program parameters.
+** \param     argv array to program parameter strings.
+** \return    0 on success, > 0 on error.
+**
+****************************************************************************************/
+sb_int32 main(sb_int32 argc, sb_char *argv[])
+{
+  sb_char fileName[BENCH_PATH_MAX_LEN + 32];
+  sb_file hJson;
+  tBenchResult result;
+  sb_uint32 imageIdx;
+  sb_uint32 rttIdx;
+  sb_uint8 first = SB_TRUE;
+  sb_uint8 allOk = SB_TRUE;
+  pid_t simPid;
+
+  setbuf(stdout, SB_NULL);
+  DisplayProgramInfo();
+
+  if (ParseCommandLine(argc, argv) == SB_FALSE)
+  {
+    DisplayProgramUsage();
+    return PROG_RESULT_ERROR;
+  }
+  if (parseSizeMiB > 0)
+  {
+    return BenchParse();
+  }
+
+  hJson = fopen(jsonFileName, "w");
+  if (hJson == SB_NULL)
+  {
+    printf("Could not create \"%s\"\n", jsonFileName);
+    return PROG_RESULT_ERROR;
+  }
+  fprintf(hJson, "{\n  \"benchmark\": \"openblt-xcp-bench\",\n  \"programWindow\": %u,\n"
+          "  \"eraseTimeUs\": %u,\n  \"programTimeNs\": %u,\n  \"runs\": [",
+          programWindow, BENCH_ERASE_TIME_US, BENCH_PROGRAM_TIME_NS);
+
+  printf("%-18s %7s %8s %10s %8s %10s\n", "Image", "RTT[us]", "Bytes", "Bytes/s",
+         "RT/KiB", "Wall[ms]");
+  for (imageIdx=0; imageIdx<sizeof(benchImages)/sizeof(benchImages[0]); imageIdx++)
+  {
+    /* -------------------- generate the image --------------------------------------- */
+    snprintf(fileName, sizeof(fileName), "%s/%s.srec", workDir, benchImages[imageIdx].name);
+    if (BenchWriteImage(&benchImages[imageIdx], fileName) == SB_FALSE)
+    {
+      printf("Could not create \"%s\"\n", fileName);
+      fclose(hJson);
+      return PROG_RESULT_ERROR;
+    }
+    for (rttIdx=0; rttIdx<sizeof(benchRttsUs)/sizeof(benchRttsUs[0]); rttIdx++)
+    {
+      /* -------------------- flash it to a fresh simulated slave -------------------- */
+      simPid = BenchStartSim(benchImages[imageIdx].base & 0xffff0000,
+                             (benchImages[imageIdx].erase == BENCH_ERASE_ON_DEMAND) ?
+                             BENCH_SLOW_ERASE_TIME_US : BENCH_ERASE_TIME_US,
+                             benchRttsUs[rttIdx] / 2);
+      if (simPid < 0)
+      {
+        printf("Could not start \"%s\"\n", simPath);
+        fclose(hJson);
+        return PROG_RESULT_ERROR;
+      }
+      BenchRun(fileName, benchImages[imageIdx].erase, &result);
+      BenchStopSim(simPid);
+      if (result.result == SB_FALSE)
+      {
+        allOk = SB_FALSE;
+      }
+
+      /* -------------------- report the results ------------------------------------- */
+      printf("%-18s %7u %8u %10.0f %8.2f %10.1f %s\n", benchImages[imageIdx].name,
+             benchRttsUs[rttIdx], result.dataBytes,
+             (result.wallNs > 0) ? (result.dataBytes * 1e9 / result.wallNs) : 0.0,
+             (result.dataBytes > 0) ? (result.commands * 1024.0 / result.dataBytes) : 0.0,
+             result.wallNs / 1e6, (result.result == SB_TRUE) ? "OK" : "ERROR");
+      BenchWriteJsonResult(hJson, &benchImages[imageIdx], benchRttsUs[rttIdx], &result,
+                           first);
+      first = SB_FALSE;
+    }
+  }
+
+  fprintf(hJson, "\n  ]\n}\n");
+  fclose(hJson);
+  printf("Results written to \"%s\"\n", jsonFileName);
+  return (allOk == SB_TRUE) ? PROG_RESULT_OK : PROG_RESULT_ERROR;
+} /*** end of main ***/
+
+
+/************************************************************************************//**
+** \brief     Outputs information to the user about this program.
+** \return    none.
+**
+****************************************************************************************/
+static void DisplayProgramInfo(void)
+{
+  printf("-------------------------------------------------------------------------\n");
+  printf("openblt-xcp-bench version 1.00. Measures the firmware update performance\n");
+  printf("of openblt-tcp-boot against the simulated XCP slave.\n\n");
+  printf("Copyright (c) by Feaser  http://www.feaser.com\n");
+  printf("-------------------------------------------------------------------------\n");
+} /*** end of DisplayProgramInfo ***/
+
+
+/************************************************************************************//**
+** \brief     Outputs information to the user about how to use this program.
+** \return    none.
+**
+****************************************************************************************/
+static void DisplayProgramUsage(void)
+{
+  printf("Usage:    openblt-xcp-bench -s[simulator] [-o[json file]] [-d[directory]]\n");
+  printf("                            [-p[port]] [-w[window]]\n");
+  printf("          openblt-xcp-bench -m[size] [-o[json file]] [-d[directory]]\n\n");
+  printf("Example:  openblt-xcp-bench -s./openblt-xcp-sim -obench.json -w8\n");
+  printf("          -> Writes the results to bench.json, with up to 8 program\n");
+  printf("             commands in flight.\n");
+  printf("Options:  -o[json file] file for the results (default bench.json).\n");
+  printf("          -d[directory] directory for the generated S-record files\n");
+  printf("                        (default /tmp).\n");
+  printf("          -p[port] TCP port for the simulated slave (default 5800).\n");
+  printf("          -w[window] program commands in flight (1..%d, default 1).\n",
+         XCP_MASTER_PROGRAM_WINDOW_MAX);
+  printf("          -m[size] measures the parse throughput of an S-record file of\n");
+  printf("                   [size] MiB with each hexadecimal decoder, instead of\n");
+  printf("                   the firmware update.\n");
+  printf("-------------------------------------------------------------------------\n");
+} /*** end of DisplayProgramUsage ***/
+
+
+/************************************************************************************//**
+** \brief     Parses the command line arguments.
+** \param     argc Number of program parameters.
+** \param     argv array to program parameter strings.
+** \return    SB_TRUE on success, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[])
+{
+  sb_int32 paramIdx;
+  sb_char *value;
+
+  for (paramIdx=1; paramIdx<argc; paramIdx++)
+  {
+    if ( (argv[paramIdx][0] != '-') || (argv[paramIdx][1] == '\0') )
+    {
+      return SB_FALSE;
+    }
+    value = &argv[paramIdx][2];
+    switch (argv[paramIdx][1])
+    {
+      case 's':
+      case 'o':
+      case 'd':
+        if ( (strlen(value) == 0) || (strlen(value) >= BENCH_PATH_MAX_LEN) )
+        {
+          return SB_FALSE;
+        }
+        strcpy((argv[paramIdx][1] == 's') ? simPath :
+               ((argv[paramIdx][1] == 'o') ? jsonFileName : workDir), value);
+        break;
+      case 'p':
+        sscanf(value, "%u", &simPort);
+        break;
+      case 'w':
+        sscanf(value, "%u", &programWindow);
+        break;
+      case 'm':
+        sscanf(value, "%u", &parseSizeMiB);
+        break;
+      default:
+        return SB_FALSE;
+    }
+  }
+
+  /* verify the parameters */
+  if ( ((simPath[0] == '\0') && (parseSizeMiB == 0)) || (programWindow < 1) ||
+       (programWindow > XCP_MASTER_PROGRAM_WINDOW_MAX) )
+  {
+    return SB_FALSE;
+  }
+  return SB_TRUE;
+} /*** end of ParseCommandLine ***/
+
+
+/************************************************************************************//**
+** \brief     Writes a synthetic firmware image as an S-record file. The data follows a
+**            pseudo random pattern, such that it cannot be mistaken for erased flash.
+** \param     image The image to write.
+** \param     fileName Name of the S-record file.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 BenchWriteImage(const tBenchImage *image, const sb_char *fileName)
+{
+  sb_file hFile;
+  sb_uint8 data[BENCH_BYTES_PER_RECORD];
+  sb_uint32 seed = 0x12345678;
+  sb_uint32 blockIdx;
+  sb_uint32 blockSize;
+  sb_uint32 offset;
+  sb_uint32 len;
+  sb_uint32 idx;
+  static const sb_uint8 header[] = { 'b', 'e', 'n', 'c', 'h' };
+
+  hFile = fopen(fileName, "w");
+  if (hFile == SB_NULL)
+  {
+    return SB_FALSE;
+  }
+  BenchWriteRecord(hFile, 0, 0, header, sizeof(header));
+  for (blockIdx=0; blockIdx<image->blockCnt; blockIdx++)
+  {
+    blockSize = (blockIdx == 0) ? image->firstBlockSize : image->blockSize;
+    for (offset=0; offset<blockSize; offset+=len)
+    {
+      len = blockSize - offset;
+      if (len > BENCH_BYTES_PER_RECORD)
+      {
+        len = BENCH_BYTES_PER_RECORD;
+      }
+      for (idx=0; idx<len; idx++)
+      {
+        seed = seed * 1103515245 + 12345;
+        data[idx] = (sb_uint8)(seed >> 16);
+      }
+      BenchWriteRecord(hFile, image->recordType,
+                       image->base + (blockIdx * image->blockStride) + offset, data,
+                       (sb_uint8)len);
+    }
+  }
+  /* the termination record has the record type 10 - the data record type */
+  BenchWriteRecord(hFile, 10 - image->recordType, image->base, SB_NULL, 0);
+  fclose(hFile);
+  return SB_TRUE;
+} /*** end of BenchWriteImage ***/
+
+
+/************************************************************************************//**
+** \brief     Writes one S-record line.
+** \param     hFile File to write to.
+** \param     recordType S-record type digit. Determines the size of the address.
+** \param     address Address field of the record.
+** \param     data Data bytes of the record.
+** \param     len Number of data bytes.
+** \return    none.
+**
+****************************************************************************************/
+static void BenchWriteRecord(sb_file hFile, sb_uint8 recordType, sb_uint32 address,
+                             const sb_uint8 *data, sb_uint8 len)
+{
+  static const sb_char hexDigits[] = "0123456789ABCDEF";
+  sb_char line[4 + (2 * 256) + 2];
+  sb_uint32 lineLen = 0;
+  sb_uint8 addressBytes;
+  sb_uint8 checksum;
+  sb_uint8 value;
+  sb_uint8 idx;
+
+  /* S0, S1 and S9 have a 16-bit address, S2 and S8 a 24-bit and S3 and S7 a 32-bit */
+  addressBytes = 2;
+  if ( (recordType == 2) || (recordType == 8) )
+  {
+    addressBytes = 3;
+  }
+  else if ( (recordType == 3) || (recordType == 7) )
+  {
+    addressBytes = 4;
+  }
+  /* the line is formatted by hand, because the parse benchmark writes hundreds of MB */
+  checksum = addressBytes + len + 1;
+  line[lineLen++] = 'S';
+  line[lineLen++] = '0' + recordType;
+  line[lineLen++] = hexDigits[checksum >> 4];
+  line[lineLen++] = hexDigits[checksum & 0x0f];
+  for (idx=addressBytes; idx>0; idx--)
+  {
+    value = (sb_uint8)(address >> ((idx - 1) * 8));
+    line[lineLen++] = hexDigits[value >> 4];
+    line[lineLen++] = hexDigits[value & 0x0f];
+    checksum += value;
+  }
+  for (idx=0; idx<len; idx++)
+  {
+    line[lineLen++] = hexDigits[data[idx] >> 4];
+    line[lineLen++] = hexDigits[data[idx] & 0x0f];
+    checksum += data[idx];
+  }
+  checksum = ~checksum;
+  line[lineLen++] = hexDigits[checksum >> 4];
+  line[lineLen++] = hexDigits[checksum & 0x0f];
+  line[lineLen++] = '\n';
+  fwrite(line, 1, lineLen, hFile);
+} /*** end of BenchWriteRecord ***/
+
+
+/************************************************************************************//**
+** \brief     Starts the simulated slave in a child process and waits until it accepts
+**            connections.
+** \param     flashBase Start address of the flash memory of the simulated slave.
+** \param     eraseTimeUs Time that the simulated slave takes to erase a sector.
+** \param     oneWayDelayUs Network delay that the simulated slave adds in each direction.
+** \return    Process ID of the simulated slave, or -1 on error.
+**
+****************************************************************************************/
+static pid_t BenchStartSim(sb_uint32 flashBase, sb_uint32 eraseTimeUs,
+                           sb_uint32 oneWayDelayUs)
+{
+  sb_char args[7][32];
+  pid_t pid;
+  sb_int32 devNull;
+  sb_uint64 startNs;
+  tXcpTransport transport;
+
+  snprintf(args[0], sizeof(args[0]), "-p%u", simPort);
+  snprintf(args[1], sizeof(args[1]), "-a0x%08x", flashBase);
+  snprintf(args[2], sizeof(args[2]), "-s%u", BENCH_FLASH_SIZE);
+  snprintf(args[3], sizeof(args[3]), "-e%u", eraseTimeUs);
+  snprintf(args[4], sizeof(args[4]), "-w%u", BENCH_PROGRAM_TIME_NS);
+  snprintf(args[5], sizeof(args[5]), "-n%u", oneWayDelayUs);
+  snprintf(args[6], sizeof(args[6]), "-k%u", BENCH_SECTOR_SIZE);
+
+  pid = fork();
+  if (pid < 0)
+  {
+    return -1;
+  }
+  if (pid == 0)
+  {
+    /* the simulated slave should not clutter the output of the benchmark */
+    devNull = open("/dev/null", O_WRONLY);
+    if (devNull >= 0)
+    {
+      dup2(devNull, STDOUT_FILENO);
+      close(devNull);
+    }
+    execl(simPath, simPath, args[0], args[1], args[2], args[3], args[4], args[5],
+          args[6], (sb_char *)SB_NULL);
+    _exit(PROG_RESULT_ERROR);
+  }
+
+  /* wait until the simulated slave listens. the connection that probes for this is
+   * served by its own process, which ends when the connection is closed.
+   */
+  startNs = TimeUtilGetTimeNs();
+  while (XcpTransportInit(&transport, "127.0.0.1", simPort, XCP_TRANSPORT_PROFILE_DEFAULT,
+                          BENCH_SIM_START_TIMEOUT_MS) == SB_FALSE)
+  {
+    if ( (TimeUtilGetTimeNs() - startNs) > (BENCH_SIM_START_TIMEOUT_MS * 1000000ull) )
+    {
+      BenchStopSim(pid);
+      return -1;
+    }
+    TimeUtilDelayMs(10);
+  }
+  XcpTransportClose(&transport);
+  return pid;
+} /*** end of BenchStartSim ***/
+
+
+/************************************************************************************//**
+** \brief     Stops the simulated slave.
+** \param     pid Process ID of the simulated slave.
+** \return    none.
+**
+****************************************************************************************/
+static void BenchStopSim(pid_t pid)
+{
+  kill(pid, SIGTERM);
+  waitpid(pid, SB_NULL, 0);
+} /*** end of BenchStopSim ***/
+
+
+/************************************************************************************//**
+** \brief     Updates the firmware of the simulated slave in the same way as
+**            openblt-tcp-boot does, and measures the duration of each phase.
+** \param     fileName Name of the S-record file.
+** \param     erase How the memory is erased.
+** \param     result Pointer to where the results are stored.
+** \return    SB_TRUE if the firmware update succeeded, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 BenchRun(const sb_char *fileName, tBenchErase erase,
+                         tBenchResult *result)
+{
+  tXcpMasterSession session;
+  tSrecordParseResults fileParseResults;
+  tSrecordImage image;
+  tSrecordError parseError;
+  tFileMap srecordFile;
+  sb_uint32 idx;
+  sb_uint64 startNs;
+  sb_uint64 phaseStartNs;
+  sb_uint8 ok;
+
+  memset(result, 0, sizeof(*result));
+  startNs = TimeUtilGetTimeNs();
+
+  /* -------------------- parsing the S-record file ---------------------------------- */
+  if (FileMapOpen(fileName, &srecordFile) == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+  ok = SrecordParseImage(srecordFile.data, srecordFile.size, &image, &fileParseResults,
+                         &parseError);
+  FileMapClose(&srecordFile);
+  if (ok == SB_FALSE)
+  {
+    SrecordFreeImage(&image);
+    return SB_FALSE;
+  }
+  result->dataBytes = fileParseResults.data_bytes_total;
+  phaseStartNs = TimeUtilGetTimeNs();
+  result->phaseNs[BENCH_PHASE_PARSE] = phaseStartNs - startNs;
+
+  /* -------------------- connecting ------------------------------------------------- */
+  if (XcpMasterInit(&session, "127.0.0.1", simPort, XCP_TRANSPORT_PROFILE_DEFAULT,
+                    XCP_TRANSPORT_CONNECT_TIMEOUT_MS) == SB_FALSE)
+  {
+    SrecordFreeImage(&image);
+    return SB_FALSE;
+  }
+  XcpMasterSetProgramWindow(&session, (sb_uint8)programWindow);
+  ok = XcpMasterConnect(&session);
+  result->phaseNs[BENCH_PHASE_CONNECT] = TimeUtilGetTimeNs() - phaseStartNs;
+
+  /* -------------------- starting the programming session --------------------------- */
+  if (ok == SB_TRUE)
+  {
+    phaseStartNs = TimeUtilGetTimeNs();
+    ok = XcpMasterStartProgrammingSession(&session);
+    result->phaseNs[BENCH_PHASE_PROGRAM_START] = TimeUtilGetTimeNs() - phaseStartNs;
+  }
+
+  /* -------------------- erasing ---------------------------------------------------- */
+  if ( (ok == SB_TRUE) && (erase != BENCH_ERASE_ON_DEMAND) )
+  {
+    phaseStartNs = TimeUtilGetTimeNs();
+    if (erase == BENCH_ERASE_SECTORS)
+    {
+      ok = BenchEraseSectors(&session, &image);
+    }
+    else
+    {
+      ok = XcpMasterClearMemory(&session, fileParseResults.address_low,
+                                fileParseResults.address_high - fileParseResults.address_low + 1);
+    }
+    result->phaseNs[BENCH_PHASE_ERASE] = TimeUtilGetTimeNs() - phaseStartNs;
+  }
+
+  /* -------------------- programming ------------------------------------------------ */
+  if (ok == SB_TRUE)
+  {
+    phaseStartNs = TimeUtilGetTimeNs();
+    if (erase == BENCH_ERASE_ON_DEMAND)
+    {
+      ok = BenchProgramOnDemand(&session, &image);
+    }
+    else
+    {
+      for (idx=0; (idx<image.segmentCnt) && (ok == SB_TRUE); idx++)
+      {
+        ok = XcpMasterProgramData(&session, image.segments[idx].address,
+                                  image.segments[idx].length, image.segments[idx].data);
+      }
+    }
+    result->phaseNs[BENCH_PHASE_PROGRAM] = TimeUtilGetTimeNs() - phaseStartNs;
+  }
+
+  /* -------------------- finishing -------------------------------------------------- */
+  if (ok == SB_TRUE)
+  {
+    /* the simulated slave closes the connection after the reset, so this ends the
+     * update. unlike openblt-tcp-boot, no second reset command is sent.
+     */
+    phaseStartNs = TimeUtilGetTimeNs();
+    ok = XcpMasterStopProgrammingSession(&session);
+    result->phaseNs[BENCH_PHASE_FINISH] = TimeUtilGetTimeNs() - phaseStartNs;
+  }
+
+  result->wallNs = TimeUtilGetTimeNs() - startNs;
+  result->commands = XcpTransportGetStats(&session.transport)->packets;
+  result->result = ok;
+  XcpMasterDeinit(&session);
+  SrecordFreeImage(&image);
+  return ok;
+} /*** end of BenchRun ***/
+
+
+/************************************************************************************//**
+** \brief     Erases the runs of sectors that the image has data in, one erase command
+**            for each run, the same way as openblt-tcp-boot does with -k.
+** \param     session XCP master session.
+** \param     image The firmware image.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 BenchEraseSectors(tXcpMasterSession *session, const tSrecordImage *image)
+{
+  tSrecordRange range;
+  sb_uint32 segmentIdx = 0;
+
+  while (SrecordImageNextEraseRange(image, BENCH_SECTOR_SIZE, &segmentIdx, &range) == SB_TRUE)
+  {
+    if (XcpMasterClearMemory(session, range.address, range.length) == SB_FALSE)
+    {
+      return SB_FALSE;
+    }
+  }
+  return SB_TRUE;
+} /*** end of BenchEraseSectors ***/
+
+
+/************************************************************************************//**
+** \brief     Programs the image in chunks, erasing the sectors of each chunk that were
+**            not erased yet right before programming it, the same way as
+**            openblt-tcp-boot does with --stream.
+** \param     session XCP master session.
+** \param     image The firmware image.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 BenchProgramOnDemand(tXcpMasterSession *session, const tSrecordImage *image)
+{
+  const tSrecordSegment *segment;
+  sb_uint32 segmentIdx;
+  sb_uint32 offset;
+  sb_uint32 length;
+  sb_uint32 address;
+  sb_uint32 sector;
+  sb_uint32 lastSector;
+  sb_uint32 erasedSectors = 0;
+
+  for (segmentIdx=0; segmentIdx<image->segmentCnt; segmentIdx++)
+  {
+    segment = &image->segments[segmentIdx];
+    for (offset=0; offset<segment->length; offset+=length)
+    {
+      length = segment->length - offset;
+      if (length > BENCH_STREAM_CHUNK_SIZE)
+      {
+        length = BENCH_STREAM_CHUNK_SIZE;
+      }
+      address = segment->address + offset;
+      /* the segments are sorted, so the sectors before the last erased one are done */
+      sector = address / BENCH_SECTOR_SIZE;
+      if (sector < erasedSectors)
+      {
+        sector = erasedSectors;
+      }
+      lastSector = (address + length - 1) / BENCH_SECTOR_SIZE;
+      if ( (sector <= lastSector) &&
+           (XcpMasterClearMemory(session, sector * BENCH_SECTOR_SIZE,
+                                 (lastSector - sector + 1) * BENCH_SECTOR_SIZE) == SB_FALSE) )
+      {
+        return SB_FALSE;
+      }
+      erasedSectors = lastSector + 1;
+      if (XcpMasterProgramData(session, address, length, &segment->data[offset]) == SB_FALSE)
+      {
+        return SB_FALSE;
+      }
+    }
+  }
+  return SB_TRUE;
+} /*** end of BenchProgramOnDemand ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the results of one benchmark run as an element of the JSON array.
+** \param     hJson JSON file.
+** \param     image The benchmarked image.
+** \param     rttUs Injected round trip time.
+** \param     result Results of the run.
+** \param     first SB_TRUE for the first element of the array.
+** \return    none.
+**
+****************************************************************************************/
+static void BenchWriteJsonResult(sb_file hJson, const tBenchImage *image,
+                                 sb_uint32 rttUs, const tBenchResult *result,
+                                 sb_uint8 first)
+{
+  tBenchPhase phase;
+
+  fprintf(hJson, "%s\n    {\"image\": \"%s\", \"format\": \"S%u\", \"layout\": \"%s\", "
+          "\"erase\": \"%s\", \"eraseTimeUs\": %u, \"rttUs\": %u, \"result\": \"%s\", "
+          "\"bytes\": %u, \"commands\": %u,\n",
+          (first == SB_TRUE) ? "" : ",", image->name, image->recordType, image->layout,
+          benchEraseNames[image->erase],
+          (image->erase == BENCH_ERASE_ON_DEMAND) ? BENCH_SLOW_ERASE_TIME_US : BENCH_ERASE_TIME_US,
+          rttUs,
+          (result->result == SB_TRUE) ? "ok" : "error", result->dataBytes, result->commands);
+  fprintf(hJson, "     \"bytesPerSec\": %.0f, \"roundTripsPerKiB\": %.3f, \"wallMs\": %.3f,\n",
+          (result->wallNs > 0) ? (result->dataBytes * 1e9 / result->wallNs) : 0.0,
+          (result->dataBytes > 0) ? (result->commands * 1024.0 / result->dataBytes) : 0.0,
+          result->wallNs / 1e6);
+  fprintf(hJson, "     \"phasesMs\": {");
+  for (phase=BENCH_PHASE_PARSE; phase<BENCH_PHASE_CNT; phase++)
+  {
+    fprintf(hJson, "%s\"%s\": %.3f", (phase == BENCH_PHASE_PARSE) ? "" : ", ",
+            benchPhaseNames[phase], result->phaseNs[phase] / 1e6);
+  }
+  fprintf(hJson, "}}");
+} /*** end of BenchWriteJsonResult ***/
+
+
+/************************************************************************************//**
+** \brief     Measures the throughput of parsing a large S-record file with each of the
+**            hexadecimal decoders that the processor supports, on a single thread.
+**            With the last decoder, the throughput is then measured with a growing
+**            number of threads, up to one for each processor. Finally the time to load
+**            the image from the image cache is measured. The file is generated first,
+**            with S3 records as produced for external flash images, and removed
+**            afterwards. The throughput is that of the S-record text.
+** \return    0 on success, > 0 on error.
+**
+****************************************************************************************/
+static sb_int32 BenchParse(void)
+{
+  sb_char fileName[BENCH_PATH_MAX_LEN + 32];
+  tBenchImage image = { "parse", "dense", 3, BENCH_ERASE_SPAN, 0, 0, 0, 0, 1 };
+  tFileMap srecordFile;
+  tHexDecodeImpl impl;
+  sb_file hJson;
+  sb_uint64 bestNs;
+  sb_uint64 singleNs = 0;
+  sb_uint64 cachedNs;
+  sb_uint32 cpuCnt;
+  sb_uint32 threadCnt;
+  sb_uint8 first = SB_TRUE;
+  sb_uint8 ok = SB_TRUE;
+
+  /* -------------------- generate the file ------------------------------------------ */
+  image.blockSize = (sb_uint32)(((sb_uint64)parseSizeMiB * 1024 * 1024) / BENCH_S3_LINE_LEN) *
+                    BENCH_BYTES_PER_RECORD;
+  image.firstBlockSize = image.blockSize;
+  image.blockStride = image.blockSize;
+  snprintf(fileName, sizeof(fileName), "%s/parse-%umib.srec", workDir, parseSizeMiB);
+  printf("Generating %u MiB S-record file \"%s\"...", parseSizeMiB, fileName);
+  if (BenchWriteImage(&image, fileName) == SB_FALSE)
+  {
+    printf("ERROR\n");
+    return PROG_RESULT_ERROR;
+  }
+  printf("OK\n");
+  if (FileMapOpen(fileName, &srecordFile) == SB_FALSE)
+  {
+    printf("Could not open \"%s\"\n", fileName);
+    unlink(fileName);
+    return PROG_RESULT_ERROR;
+  }
+  hJson = fopen(jsonFileName, "w");
+  if (hJson == SB_NULL)
+  {
+    printf("Could not create \"%s\"\n", jsonFileName);
+    FileMapClose(&srecordFile);
+    unlink(fileName);
+    return PROG_RESULT_ERROR;
+  }
+  fprintf(hJson, "{\n  \"benchmark\": \"openblt-xcp-bench parse\",\n  \"fileBytes\": %u,\n"
+          "  \"dataBytes\": %u,\n  \"bytesPerRecord\": %u,\n  \"runs\": [",
+          srecordFile.size, image.blockSize, BENCH_BYTES_PER_RECORD);
+
+  /* -------------------- parse it with each decoder --------------------------------- */
+  SrecordSetParseThreads(1);
+  printf("%-8s %10s %10s\n", "Decoder", "MB/s", "Time[ms]");
+  for (impl=HEX_DECODE_IMPL_TABLE; impl<HEX_DECODE_IMPL_CNT; impl++)
+  {
+    if (HexDecodeSelect(impl) == SB_FALSE)
+    {
+      printf("%-8s %10s\n", HexDecodeGetImplName(impl), "n/a");
+      continue;
+    }
+    bestNs = BenchParseRuns(&srecordFile, &ok);
+    printf("%-8s %10.1f %10.1f\n", HexDecodeGetImplName(impl),
+           srecordFile.size * 1e3 / bestNs, bestNs / 1e6);
+    fprintf(hJson, "%s\n    {\"decoder\": \"%s\", \"mbPerSec\": %.1f, \"parseMs\": %.1f}",
+            (first == SB_TRUE) ? "" : ",", HexDecodeGetImplName(impl),
+            srecordFile.size * 1e3 / bestNs, bestNs / 1e6);
+    first = SB_FALSE;
+  }
+
+  /* -------------------- parse it with a growing number of threads ------------------ */
+  fprintf(hJson, "\n  ],\n  \"decoder\": \"%s\",\n  \"threads\": [",
+          HexDecodeGetImplName(HexDecodeGetImpl()));
+  printf("\n%-8s %10s %10s %8s\n", "Threads", "MB/s", "Time[ms]", "Speedup");
+  cpuCnt = ParallelGetCpuCount();
+  if (cpuCnt > PARALLEL_JOBS_MAX)
+  {
+    cpuCnt = PARALLEL_JOBS_MAX;
+  }
+  first = SB_TRUE;
+  /* double the number of threads, ending with one per processor */
+  for (threadCnt=1; threadCnt<=cpuCnt;
+       threadCnt=((threadCnt < cpuCnt) && ((threadCnt * 2) > cpuCnt)) ? cpuCnt : (threadCnt * 2))
+  {
+    SrecordSetParseThreads(threadCnt);
+    bestNs = BenchParseRuns(&srecordFile, &ok);
+    if (threadCnt == 1)
+    {
+      singleNs = bestNs;
+    }
+    printf("%-8u %10.1f %10.1f %7.2fx\n", threadCnt, srecordFile.size * 1e3 / bestNs,
+           bestNs / 1e6, (double)singleNs / bestNs);
+    fprintf(hJson, "%s\n    {\"threads\": %u, \"mbPerSec\": %.1f, \"parseMs\": %.1f, "
+            "\"speedup\": %.2f}", (first == SB_TRUE) ? "" : ",", threadCnt,
+            srecordFile.size * 1e3 / bestNs, bestNs / 1e6, (double)singleNs / bestNs);
+    first = SB_FALSE;
+  }
+  SrecordSetParseThreads(0);
+
+  /* -------------------- load it from the image cache ------------------------------- */
+  cachedNs = BenchParseCacheRuns(&srecordFile, &ok);
+  printf("\n%-8s %10.1f %10.1f %7.2fx\n", "Cached", srecordFile.size * 1e3 / cachedNs,
+         cachedNs / 1e6, (double)singleNs / cachedNs);
+  fprintf(hJson, "\n  ],\n  \"cached\": {\"mbPerSec\": %.1f, \"loadMs\": %.1f, "
+          "\"speedup\": %.2f}\n}\n", srecordFile.size * 1e3 / cachedNs, cachedNs / 1e6,
+          (double)singleNs / cachedNs);
+  fclose(hJson);
+  FileMapClose(&srecordFile);
+  unlink(fileName);
+  if (ok == SB_FALSE)
+  {
+    printf("Parsing failed\n");
+    return PROG_RESULT_ERROR;
+  }
+  printf("Results written to \"%s\"\n", jsonFileName);
+  return PROG_RESULT_OK;
+} /*** end of BenchParse ***/
+
+
+/************************************************************************************//**
+** \brief     Parses an S-record file several times and measures the fastest run.
+** \param     srecordFile The mapped S-record file.
+** \param     ok Set to SB_FALSE when the parsing fails.
+** \return    Time of the fastest run in nanoseconds.
+**
+****************************************************************************************/
+static sb_uint64 BenchParseRuns(const tFileMap *srecordFile, sb_uint8 *ok)
+{
+  tSrecordParseResults parseResults;
+  tSrecordImage parsedImage;
+  tSrecordError parseError;
+  sb_uint64 startNs;
+  sb_uint64 runNs;
+  sb_uint64 bestNs = 0;
+  sb_uint32 run;
+
+  for (run=0; run<BENCH_PARSE_RUNS; run++)
+  {
+    startNs = TimeUtilGetTimeNs();
+    if (SrecordParseImage(srecordFile->data, srecordFile->size, &parsedImage,
+                          &parseResults, &parseError) == SB_FALSE)
+    {
+      *ok = SB_FALSE;
+    }
+    runNs = TimeUtilGetTimeNs() - startNs;
+    if ( (bestNs == 0) || (runNs < bestNs) )
+    {
+      bestNs = runNs;
+    }
+    SrecordFreeImage(&parsedImage);
+  }
+  return bestNs;
+} /*** end of BenchParseRuns ***/
+
+
+/************************************************************************************//**
+** \brief     Stores the image of an S-record file in the image cache, in the working
+**            directory, and measures the fastest of several runs of loading it back.
+**            A run includes determining the key of the file.
+** \param     srecordFile The mapped S-record file.
+** \param     ok Set to SB_FALSE when the parsing or the cache fails.
+** \return    Time of the fastest run in nanoseconds.
+**
+****************************************************************************************/
+static sb_uint64 BenchParseCacheRuns(const tFileMap *srecordFile, sb_uint8 *ok)
+{
+  tSrecordParseResults parseResults;
+  tSrecordImage parsedImage;
+  tSrecordError parseError;
+  sb_uint64 key;
+  sb_uint64 startNs;
+  sb_uint64 runNs;
+  sb_uint64 bestNs = 1;
+  sb_uint32 run;
+
+  key = ImageCacheKey(srecordFile->data, srecordFile->size, FIRMWARE_FORMAT_SRECORD, 0);
+  if ( (SrecordParseImage(srecordFile->data, srecordFile->size, &parsedImage,
+                          &parseResults, &parseError) == SB_FALSE) ||
+       (ImageCacheStore(workDir, key, &parsedImage) == SB_FALSE) )
+  {
+    *ok = SB_FALSE;
+    SrecordFreeImage(&parsedImage);
+    return bestNs;
+  }
+  SrecordFreeImage(&parsedImage);
+
+  for (run=0; run<BENCH_PARSE_RUNS; run++)
+  {
+    startNs = TimeUtilGetTimeNs();
+    key = ImageCacheKey(srecordFile->data, srecordFile->size, FIRMWARE_FORMAT_SRECORD, 0);
+    if (ImageCacheLoad(workDir, key, &parsedImage, &parseResults) == SB_FALSE)
+    {
+      *ok = SB_FALSE;
+    }
+    runNs = TimeUtilGetTimeNs() - startNs;
+    if ( (run == 0) || (runNs < bestNs) )
+    {
+      bestNs = runNs;
+    }
+    SrecordFreeImage(&parsedImage);
+  }
+  ImageCacheRemove(workDir, key);
+  return bestNs;
+} /*** end of BenchParseCacheRuns ***/
+
+
+/*********************************** end of xcpbench.c **********************************/
@@ -0,0 +1,277 @@
+/************************************************************************************//**
+* \file         elffile.c
+* \brief        ELF file library source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* for strcpy etc.               */
+#include "elffile.h"                                  /* ELF file library              */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Size of the identification at the start of an ELF file. */
+#define ELFFILE_IDENT_SIZE                (16)
+/** \brief Index of the class, 32 or 64 bits, in the identification. */
+#define ELFFILE_IDENT_CLASS               (4)
+/** \brief Index of the byte order in the identification. */
+#define ELFFILE_IDENT_DATA                (5)
+/** \brief Class of a 32-bit ELF file. */
+#define ELFFILE_CLASS_32                  (1)
+/** \brief Class of a 64-bit ELF file. */
+#define ELFFILE_CLASS_64                  (2)
+/** \brief Byte order of a little endian ELF file. */
+#define ELFFILE_DATA_LSB                  (1)
+/** \brief Byte order of a big endian ELF file. */
+#define ELFFILE_DATA_MSB                  (2)
+/** \brief Type of a loadable program segment. */
+#define ELFFILE_PT_LOAD                   (1)
+/** \brief Number of program headers that means the real number is stored elsewhere. */
+#define ELFFILE_PN_XNUM                   (0xffff)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for the layout of an ELF file, which differs between the 32
+ *         and 64-bit classes. The values are offsets of the fields in the file header
+ *         and in a program header.
+ */
+typedef struct
+{
+  sb_uint8 headerSize;                            /**< size of the file header         */
+  sb_uint8 phoff;                                 /**< offset of the program headers   */
+  sb_uint8 phentsize;                             /**< size of a program header        */
+  sb_uint8 phnum;                                 /**< number of program headers       */
+  sb_uint8 phSize;                                /**< used size of a program header   */
+  sb_uint8 pOffset;                               /**< offset of the segment in file   */
+  sb_uint8 pPaddr;                                /**< physical address of the segment */
+  sb_uint8 pFilesz;                               /**< size of the segment in the file */
+  sb_uint8 addrSize;                              /**< size of an address or offset    */
+} tElfFileLayout;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static sb_uint64 ElfFileRead(const sb_uint8 *field, sb_uint8 size, sb_uint8 bigEndian);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Layout of a 32-bit ELF file. */
+static const tElfFileLayout elfFileLayout32 = { 52, 28, 42, 44, 32, 4, 12, 16, 4 };
+
+/** \brief Layout of a 64-bit ELF file. */
+static const tElfFileLayout elfFileLayout64 = { 64, 32, 54, 56, 56, 8, 24, 32, 8 };
+
+/** \brief Magic number at the start of an ELF file. */
+static const sb_uint8 elfFileMagic[4] = { 0x7f, 'E', 'L', 'F' };
+
+
+/************************************************************************************//**
+** \brief     Determines whether a file is an ELF file, from its magic number.
+** \param     buffer Contents of the file.
+** \param     size Number of bytes in the buffer.
+** \return    SB_TRUE if the file is an ELF file, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 ElfFileIsElf(const sb_char *buffer, sb_uint32 size)
+{
+  if ( (size >= sizeof(elfFileMagic)) &&
+       (memcmp(buffer, elfFileMagic, sizeof(elfFileMagic)) == 0) )
+  {
+    return SB_TRUE;
+  }
+  return SB_FALSE;
+} /*** end of ElfFileIsElf ***/
+
+
+/************************************************************************************//**
+** \brief     Loads the program segments of an ELF file into an in-memory firmware
+**            image. The data of each loadable segment is copied straight from the file
+**            to its physical address, which is where it is stored in non-volatile
+**            memory. The part of a segment that is not in the file, such as the .bss
+**            section, is not programmed. Both 32 and 64-bit ELF files in either byte
+**            order are supported, as long as the addresses fit in 32 bits.
+** \param     buffer Contents of the ELF file.
+** \param     size Number of bytes in the buffer.
+** \param     image Pointer to where the firmware image should be stored. Must be
+**            released with SrecordFreeImage(), also when this function fails.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored when the loading fails.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 ElfFileParseImage(const sb_char *buffer, sb_uint32 size, tSrecordImage *image,
+                           tSrecordParseResults *parseResults, tSrecordError *error)
+{
+  const sb_uint8 *file = (const sb_uint8 *)buffer;
+  const tElfFileLayout *layout;
+  const sb_uint8 *header;
+  tSrecordSegment *segment;
+  sb_uint8 bigEndian;
+  sb_uint8 sorted = SB_TRUE;
+  sb_uint64 phoff;
+  sb_uint32 phentsize;
+  sb_uint32 phnum;
+  sb_uint64 offset;
+  sb_uint64 address;
+  sb_uint64 length;
+  sb_uint32 idx;
+
+  /* init data structures */
+  memset(image, 0, sizeof(*image));
+  parseResults->address_high = 0;
+  parseResults->address_low = 0xffffffff;
+  parseResults->data_bytes_total = 0;
+  parseResults->segment_count = 0;
+  error->line = 0;
+  error->reason = SB_NULL;
+
+  /* check the identification and select the layout of the headers */
+  if ( (size < ELFFILE_IDENT_SIZE) || (ElfFileIsElf(buffer, size) == SB_FALSE) )
+  {
+    error->reason = "not an ELF file";
+    return SB_FALSE;
+  }
+  if ( ((file[ELFFILE_IDENT_CLASS] != ELFFILE_CLASS_32) &&
+        (file[ELFFILE_IDENT_CLASS] != ELFFILE_CLASS_64)) ||
+       ((file[ELFFILE_IDENT_DATA] != ELFFILE_DATA_LSB) &&
+        (file[ELFFILE_IDENT_DATA] != ELFFILE_DATA_MSB)) )
+  {
+    error->reason = "unsupported ELF class or byte order";
+    return SB_FALSE;
+  }
+  layout = (file[ELFFILE_IDENT_CLASS] == ELFFILE_CLASS_32) ? &elfFileLayout32 :
+                                                              &elfFileLayout64;
+  bigEndian = (file[ELFFILE_IDENT_DATA] == ELFFILE_DATA_MSB) ? SB_TRUE : SB_FALSE;
+  if (size < layout->headerSize)
+  {
+    error->reason = "truncated ELF header";
+    return SB_FALSE;
+  }
+
+  /* locate the program headers */
+  phoff = ElfFileRead(&file[layout->phoff], layout->addrSize, bigEndian);
+  phentsize = (sb_uint32)ElfFileRead(&file[layout->phentsize], 2, bigEndian);
+  phnum = (sb_uint32)ElfFileRead(&file[layout->phnum], 2, bigEndian);
+  if (phnum == ELFFILE_PN_XNUM)
+  {
+    error->reason = "too many program headers";
+    return SB_FALSE;
+  }
+  if ( (phnum > 0) && ((phentsize < layout->phSize) || (phoff > size) ||
+                       (((sb_uint64)phnum * phentsize) > (size - phoff))) )
+  {
+    error->reason = "program headers exceed the file";
+    return SB_FALSE;
+  }
+
+  /* add the data of each loadable segment to the image */
+  for (idx=0; idx<phnum; idx++)
+  {
+    header = &file[phoff + ((sb_uint64)idx * phentsize)];
+    length = ElfFileRead(&header[layout->pFilesz], layout->addrSize, bigEndian);
+    if ( (ElfFileRead(header, 4, bigEndian) != ELFFILE_PT_LOAD) || (length == 0) )
+    {
+      continue;
+    }
+    offset = ElfFileRead(&header[layout->pOffset], layout->addrSize, bigEndian);
+    address = ElfFileRead(&header[layout->pPaddr], layout->addrSize, bigEndian);
+    if ( (offset > size) || (length > (size - offset)) )
+    {
+      error->reason = "program segment exceeds the file";
+      return SB_FALSE;
+    }
+    if ( (address > 0xffffffffull) || ((address + length - 1) > 0xffffffffull) )
+    {
+      error->reason = "program segment exceeds the 32-bit address range";
+      return SB_FALSE;
+    }
+    /* keep track of whether the segments are in order of their addresses */
+    if (image->segmentCnt > 0)
+    {
+      segment = &image->segments[image->segmentCnt - 1];
+      if (address < (segment->address + segment->length))
+      {
+        sorted = SB_FALSE;
+      }
+    }
+    if (SrecordImageAppend(image, (sb_uint32)address, &file[offset],
+                           (sb_uint32)length, 0) == SB_FALSE)
+    {
+      error->reason = "out of memory";
+      return SB_FALSE;
+    }
+  }
+
+  /* a file without data cannot be programmed */
+  if (image->segmentCnt == 0)
+  {
+    error->reason = "no loadable program segments with data";
+    return SB_FALSE;
+  }
+  return SrecordImageFinish(image, sorted, parseResults, error);
+} /*** end of ElfFileParseImage ***/
+
+
+/************************************************************************************//**
+** \brief     Reads an unsigned field of an ELF file in the byte order of the file.
+** \param     field The field.
+** \param     size Number of bytes of the field, at most 8.
+** \param     bigEndian SB_TRUE if the most significant byte comes first.
+** \return    The value of the field.
+**
+****************************************************************************************/
+static sb_uint64 ElfFileRead(const sb_uint8 *field, sb_uint8 size, sb_uint8 bigEndian)
+{
+  sb_uint64 value = 0;
+  sb_uint8 idx;
+
+  assert(size <= 8);
+
+  for (idx=0; idx<size; idx++)
+  {
+    value = (value << 8) | field[(bigEndian == SB_TRUE) ? idx : (size - 1 - idx)];
+  }
+  return value;
+} /*** end of ElfFileRead ***/
+
+
+/*********************************** end of elffile.c **********************************/
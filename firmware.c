@@ -0,0 +1,249 @@
+/************************************************************************************//**
+* \file         firmware.c
+* \brief        Firmware file loading source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* for strcpy etc.               */
+#include "firmware.h"                                 /* firmware file loading         */
+#include "srecord.h"                                  /* S-record file handling        */
+#include "ihex.h"                                     /* Intel HEX file handling       */
+#include "elffile.h"                                  /* ELF file handling             */
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static sb_uint8 FirmwareParseBinary(const sb_char *buffer, sb_uint32 size,
+                                    sb_uint32 baseAddress, tSrecordImage *image,
+                                    tSrecordParseResults *parseResults,
+                                    tSrecordError *error);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Names of the formats, indexed by tFirmwareFormat. */
+static const sb_char *firmwareFormatNames[FIRMWARE_FORMAT_CNT] =
+{
+  "S-record", "Intel HEX", "ELF", "binary"
+};
+
+/** \brief Names of the compression formats, indexed by tFirmwareCompression. */
+static const sb_char *firmwareCompressionNames[FIRMWARE_COMPRESSION_CNT] =
+{
+  "uncompressed", "gzip", "xz", "zstd"
+};
+
+/** \brief Magic number at the start of a gzip file. */
+static const sb_uint8 firmwareGzipMagic[] = { 0x1f, 0x8b };
+
+/** \brief Magic number at the start of an xz file. */
+static const sb_uint8 firmwareXzMagic[] = { 0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00 };
+
+/** \brief Magic number at the start of a Zstandard frame. */
+static const sb_uint8 firmwareZstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+
+/************************************************************************************//**
+** \brief     Detects the format of a firmware file. An ELF file is recognized by its
+**            magic number. Otherwise the first record tells the format: an Intel HEX
+**            record starts with a colon. Everything else is treated as an S-record
+**            file, such that the S-record parser reports what is wrong with it. A raw
+**            binary file cannot be detected.
+** \param     buffer Contents of the firmware file.
+** \param     size Number of bytes in the buffer.
+** \return    The format.
+**
+****************************************************************************************/
+tFirmwareFormat FirmwareDetectFormat(const sb_char *buffer, sb_uint32 size)
+{
+  sb_uint32 idx;
+
+  if (ElfFileIsElf(buffer, size) == SB_TRUE)
+  {
+    return FIRMWARE_FORMAT_ELF;
+  }
+  /* skip the empty lines before the first record */
+  for (idx=0; idx<size; idx++)
+  {
+    if ( (buffer[idx] != '\r') && (buffer[idx] != '\n') && (buffer[idx] != ' ') &&
+         (buffer[idx] != '\t') )
+    {
+      return (buffer[idx] == ':') ? FIRMWARE_FORMAT_IHEX : FIRMWARE_FORMAT_SRECORD;
+    }
+  }
+  return FIRMWARE_FORMAT_SRECORD;
+} /*** end of FirmwareDetectFormat ***/
+
+
+/************************************************************************************//**
+** \brief     Parses the contents of a firmware file into an in-memory firmware image.
+** \param     format Format of the firmware file.
+** \param     buffer Contents of the firmware file.
+** \param     size Number of bytes in the buffer.
+** \param     baseAddress Memory address of a raw binary file. Not used for the other
+**            formats, which contain the addresses themselves.
+** \param     image Pointer to where the firmware image should be stored. Must be
+**            released with SrecordFreeImage(), also when this function fails.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored when the parsing fails.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 FirmwareParseImage(tFirmwareFormat format, const sb_char *buffer,
+                            sb_uint32 size, sb_uint32 baseAddress, tSrecordImage *image,
+                            tSrecordParseResults *parseResults, tSrecordError *error)
+{
+  assert(format < FIRMWARE_FORMAT_CNT);
+
+  switch (format)
+  {
+    case FIRMWARE_FORMAT_IHEX:
+      return IhexParseImage(buffer, size, image, parseResults, error);
+
+    case FIRMWARE_FORMAT_ELF:
+      return ElfFileParseImage(buffer, size, image, parseResults, error);
+
+    case FIRMWARE_FORMAT_BINARY:
+      return FirmwareParseBinary(buffer, size, baseAddress, image, parseResults, error);
+
+    default:
+      return SrecordParseImage(buffer, size, image, parseResults, error);
+  }
+} /*** end of FirmwareParseImage ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the name of a format of a firmware file.
+** \param     format The format.
+** \return    The name.
+**
+****************************************************************************************/
+const sb_char *FirmwareGetFormatName(tFirmwareFormat format)
+{
+  assert(format < FIRMWARE_FORMAT_CNT);
+
+  return firmwareFormatNames[format];
+} /*** end of FirmwareGetFormatName ***/
+
+
+/************************************************************************************//**
+** \brief     Detects whether a firmware file is compressed, from the magic number at
+**            its start. This is done before detecting the format of its contents, so a
+**            raw binary file that happens to start with such a magic number is taken
+**            for a compressed file as well.
+** \param     buffer The start of the firmware file.
+** \param     size Number of bytes in the buffer. FIRMWARE_COMPRESSION_MAGIC_SIZE bytes
+**            suffice, unless the file is shorter.
+** \return    The compression format.
+**
+****************************************************************************************/
+tFirmwareCompression FirmwareDetectCompression(const sb_char *buffer, sb_uint32 size)
+{
+  if ( (size >= sizeof(firmwareGzipMagic)) &&
+       (memcmp(buffer, firmwareGzipMagic, sizeof(firmwareGzipMagic)) == 0) )
+  {
+    return FIRMWARE_COMPRESSION_GZIP;
+  }
+  if ( (size >= sizeof(firmwareXzMagic)) &&
+       (memcmp(buffer, firmwareXzMagic, sizeof(firmwareXzMagic)) == 0) )
+  {
+    return FIRMWARE_COMPRESSION_XZ;
+  }
+  if ( (size >= sizeof(firmwareZstdMagic)) &&
+       (memcmp(buffer, firmwareZstdMagic, sizeof(firmwareZstdMagic)) == 0) )
+  {
+    return FIRMWARE_COMPRESSION_ZSTD;
+  }
+  return FIRMWARE_COMPRESSION_NONE;
+} /*** end of FirmwareDetectCompression ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the name of a compression format of a firmware file.
+** \param     compression The compression format.
+** \return    The name.
+**
+****************************************************************************************/
+const sb_char *FirmwareGetCompressionName(tFirmwareCompression compression)
+{
+  assert(compression < FIRMWARE_COMPRESSION_CNT);
+
+  return firmwareCompressionNames[compression];
+} /*** end of FirmwareGetCompressionName ***/
+
+
+/************************************************************************************//**
+** \brief     Loads a raw binary file into an in-memory firmware image. The contents of
+**            the file are a single segment at the base address.
+** \param     buffer Contents of the binary file.
+** \param     size Number of bytes in the buffer.
+** \param     baseAddress Memory address of the first byte of the file.
+** \param     image Pointer to where the firmware image should be stored.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored when the loading fails.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 FirmwareParseBinary(const sb_char *buffer, sb_uint32 size,
+                                    sb_uint32 baseAddress, tSrecordImage *image,
+                                    tSrecordParseResults *parseResults,
+                                    tSrecordError *error)
+{
+  memset(image, 0, sizeof(*image));
+  error->line = 0;
+  error->reason = SB_NULL;
+  if (size == 0)
+  {
+    error->reason = "the file is empty";
+    return SB_FALSE;
+  }
+  if ((baseAddress + size - 1) < baseAddress)
+  {
+    error->reason = "data exceeds the 32-bit address range";
+    return SB_FALSE;
+  }
+  if (SrecordImageAppend(image, baseAddress, (const sb_uint8 *)buffer, size, 0) == SB_FALSE)
+  {
+    error->reason = "out of memory";
+    return SB_FALSE;
+  }
+  return SrecordImageFinish(image, SB_TRUE, parseResults, error);
+} /*** end of FirmwareParseBinary ***/
+
+
+/*********************************** end of firmware.c *********************************/
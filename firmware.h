@@ -0,0 +1,88 @@
+/************************************************************************************//**
+* \file         firmware.h
+* \brief        Firmware file loading header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+#ifndef FIRMWARE_H
+#define FIRMWARE_H
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "srecord.h"                                  /* S-record file handling        */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of bytes at the start of a file that tell its compression format. */
+#define FIRMWARE_COMPRESSION_MAGIC_SIZE (6)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enumeration for the supported formats of a firmware file. */
+typedef enum
+{
+  FIRMWARE_FORMAT_SRECORD,                       /**< Motorola S-record                */
+  FIRMWARE_FORMAT_IHEX,                          /**< Intel HEX                        */
+  FIRMWARE_FORMAT_ELF,                           /**< ELF executable                   */
+  FIRMWARE_FORMAT_BINARY,                        /**< raw binary at a base address     */
+  FIRMWARE_FORMAT_CNT                            /**< number of formats                */
+} tFirmwareFormat;
+
+/** \brief Enumeration for the compression formats of a firmware file. */
+typedef enum
+{
+  FIRMWARE_COMPRESSION_NONE,                     /**< not compressed                   */
+  FIRMWARE_COMPRESSION_GZIP,                     /**< gzip                             */
+  FIRMWARE_COMPRESSION_XZ,                       /**< xz                               */
+  FIRMWARE_COMPRESSION_ZSTD,                     /**< Zstandard                        */
+  FIRMWARE_COMPRESSION_CNT                       /**< number of compression formats    */
+} tFirmwareCompression;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+tFirmwareFormat FirmwareDetectFormat(const sb_char *buffer, sb_uint32 size);
+sb_uint8        FirmwareParseImage(tFirmwareFormat format, const sb_char *buffer,
+                                   sb_uint32 size, sb_uint32 baseAddress,
+                                   tSrecordImage *image,
+                                   tSrecordParseResults *parseResults,
+                                   tSrecordError *error);
+const sb_char  *FirmwareGetFormatName(tFirmwareFormat format);
+tFirmwareCompression FirmwareDetectCompression(const sb_char *buffer, sb_uint32 size);
+const sb_char  *FirmwareGetCompressionName(tFirmwareCompression compression);
+
+
+#endif /* FIRMWARE_H */
+/*********************************** end of firmware.h *********************************/
@@ -0,0 +1,407 @@
+/************************************************************************************//**
+* \file         hexdecode.c
+* \brief        Hexadecimal decoding source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include "hexdecode.h"                                /* hexadecimal decoding          */
+
+/* the SIMD implementations need the SSE2 instruction set as a baseline. AVX2 is only
+ * used when the processor supports it, which is detected at runtime.
+ */
+#if (HEX_DECODE_SIMD_ENABLE > 0) && defined(__SSE2__) && defined(__GNUC__)
+#define HEX_DECODE_HAVE_SSE2           (1)
+#include <immintrin.h>                                /* x86 SIMD intrinsics           */
+#else
+#define HEX_DECODE_HAVE_SSE2           (0)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type of an implementation of the decoder. */
+typedef sb_uint8 (*tHexDecodeFunc)(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                                   sb_uint8 *checksum);
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void     HexDecodeSelectFastest(void);
+static sb_uint8 HexDecodeTable(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                               sb_uint8 *checksum);
+#if (HEX_DECODE_HAVE_SSE2 > 0)
+static sb_uint8 HexDecodeSse2(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                              sb_uint8 *checksum);
+static sb_uint8 HexDecodeAvx2(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                              sb_uint8 *checksum);
+#endif
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Value of each hexadecimal digit character, with bit 4 set to mark it as valid.
+ *         All other characters are 0.
+ */
+static const sb_uint8 hexDecodeTable[256] =
+{
+  ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+  ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+  ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d, ['E'] = 0x1e, ['F'] = 0x1f,
+  ['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f
+};
+
+/** \brief Names of the implementations, indexed by tHexDecodeImpl. */
+static const sb_char *hexDecodeImplNames[HEX_DECODE_IMPL_CNT] =
+{
+  "table", "sse2", "avx2"
+};
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Implementation that is used, SB_NULL until the first call. */
+static tHexDecodeFunc hexDecodeFunc = SB_NULL;
+
+/** \brief Implementation that is used. */
+static tHexDecodeImpl hexDecodeImpl = HEX_DECODE_IMPL_TABLE;
+
+
+/************************************************************************************//**
+** \brief     Decodes a string of hexadecimal digits into bytes, validates the digits
+**            and adds the bytes to a checksum, all in a single pass. Both upper and
+**            lower case digits are accepted. The fastest implementation that the
+**            processor supports is used, unless another one was selected with
+**            HexDecodeSelect().
+** \param     hex The hexadecimal digits, two for each byte.
+** \param     bytes Pointer to where the decoded bytes are stored.
+** \param     len Number of bytes to decode.
+** \param     checksum Checksum that the bytes are added to, modulo 256.
+** \return    SB_TRUE if all characters are hexadecimal digits, SB_FALSE otherwise. The
+**            decoded bytes and the checksum are undefined in that case.
+**
+****************************************************************************************/
+sb_uint8 HexDecode(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                   sb_uint8 *checksum)
+{
+  /* select the fastest implementation on the first call. concurrent first calls all
+   * select the same one.
+   */
+  if (hexDecodeFunc == SB_NULL)
+  {
+    HexDecodeSelectFastest();
+  }
+  return hexDecodeFunc(hex, bytes, len, checksum);
+} /*** end of HexDecode ***/
+
+
+/************************************************************************************//**
+** \brief     Selects the implementation of the decoder, for comparing their
+**            performance.
+** \param     impl The implementation.
+** \return    SB_TRUE if successful, SB_FALSE if the implementation is not available on
+**            this processor or in this build.
+**
+****************************************************************************************/
+sb_uint8 HexDecodeSelect(tHexDecodeImpl impl)
+{
+  switch (impl)
+  {
+    case HEX_DECODE_IMPL_TABLE:
+      hexDecodeFunc = HexDecodeTable;
+      break;
+
+#if (HEX_DECODE_HAVE_SSE2 > 0)
+    case HEX_DECODE_IMPL_SSE2:
+      hexDecodeFunc = HexDecodeSse2;
+      break;
+
+    case HEX_DECODE_IMPL_AVX2:
+      if (__builtin_cpu_supports("avx2") == 0)
+      {
+        return SB_FALSE;
+      }
+      hexDecodeFunc = HexDecodeAvx2;
+      break;
+#endif
+
+    default:
+      return SB_FALSE;
+  }
+  hexDecodeImpl = impl;
+  return SB_TRUE;
+} /*** end of HexDecodeSelect ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the implementation of the decoder that is used. When none was
+**            selected yet, the fastest one is selected first. Calling this function
+**            before decoding on several threads avoids that they all select it.
+** \return    The implementation.
+**
+****************************************************************************************/
+tHexDecodeImpl HexDecodeGetImpl(void)
+{
+  if (hexDecodeFunc == SB_NULL)
+  {
+    HexDecodeSelectFastest();
+  }
+  return hexDecodeImpl;
+} /*** end of HexDecodeGetImpl ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the name of an implementation of the decoder.
+** \param     impl The implementation.
+** \return    The name.
+**
+****************************************************************************************/
+const sb_char *HexDecodeGetImplName(tHexDecodeImpl impl)
+{
+  assert(impl < HEX_DECODE_IMPL_CNT);
+
+  return hexDecodeImplNames[impl];
+} /*** end of HexDecodeGetImplName ***/
+
+
+/************************************************************************************//**
+** \brief     Selects the fastest implementation of the decoder that the processor
+**            supports.
+** \return    none.
+**
+****************************************************************************************/
+static void HexDecodeSelectFastest(void)
+{
+  if (HexDecodeSelect(HEX_DECODE_IMPL_AVX2) == SB_FALSE)
+  {
+    if (HexDecodeSelect(HEX_DECODE_IMPL_SSE2) == SB_FALSE)
+    {
+      HexDecodeSelect(HEX_DECODE_IMPL_TABLE);
+    }
+  }
+} /*** end of HexDecodeSelectFastest ***/
+
+
+/************************************************************************************//**
+** \brief     Table driven implementation of HexDecode(). Invalid characters are
+**            detected without a branch per byte, by combining the valid bits of all
+**            table entries.
+** \param     hex The hexadecimal digits, two for each byte.
+** \param     bytes Pointer to where the decoded bytes are stored.
+** \param     len Number of bytes to decode.
+** \param     checksum Checksum that the bytes are added to, modulo 256.
+** \return    SB_TRUE if all characters are hexadecimal digits, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 HexDecodeTable(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                               sb_uint8 *checksum)
+{
+  sb_uint8 valid = 0x10;
+  sb_uint8 high;
+  sb_uint8 low;
+  sb_uint8 sum = *checksum;
+  sb_uint32 idx;
+
+  for (idx=0; idx<len; idx++)
+  {
+    high = hexDecodeTable[(sb_uint8)hex[2 * idx]];
+    low = hexDecodeTable[(sb_uint8)hex[(2 * idx) + 1]];
+    valid &= high & low;
+    bytes[idx] = (sb_uint8)((high << 4) | (low & 0x0f));
+    sum += bytes[idx];
+  }
+  *checksum = sum;
+  return (valid != 0) ? SB_TRUE : SB_FALSE;
+} /*** end of HexDecodeTable ***/
+
+
+#if (HEX_DECODE_HAVE_SSE2 > 0)
+/************************************************************************************//**
+** \brief     Converts 16 hexadecimal digit characters to their 4-bit values with SSE2.
+**            Digits are '0'..'9' and, after folding to lower case, 'a'..'f'. The value
+**            is the lower nibble of the character, plus 9 for a letter.
+** \param     chars The characters.
+** \param     invalid Mask that the invalid characters are added to.
+** \return    The values.
+**
+****************************************************************************************/
+static inline __m128i HexDecodeSse2Nibbles(__m128i chars, __m128i *invalid)
+{
+  __m128i lower;
+  __m128i digit;
+  __m128i alpha;
+
+  /* characters of 0x80 and up are negative, so the signed compares reject them */
+  lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+  digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                        _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+  alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+  *invalid = _mm_or_si128(*invalid, _mm_andnot_si128(_mm_or_si128(digit, alpha),
+                                                     _mm_set1_epi8(-1)));
+  return _mm_add_epi8(_mm_and_si128(chars, _mm_set1_epi8(0x0f)),
+                      _mm_and_si128(alpha, _mm_set1_epi8(9)));
+} /*** end of HexDecodeSse2Nibbles ***/
+
+
+/************************************************************************************//**
+** \brief     SSE2 implementation of HexDecode(). Decodes 16 bytes at a time and leaves
+**            the remainder to the table driven implementation.
+** \param     hex The hexadecimal digits, two for each byte.
+** \param     bytes Pointer to where the decoded bytes are stored.
+** \param     len Number of bytes to decode.
+** \param     checksum Checksum that the bytes are added to, modulo 256.
+** \return    SB_TRUE if all characters are hexadecimal digits, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 HexDecodeSse2(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                              sb_uint8 *checksum)
+{
+  __m128i invalid = _mm_setzero_si128();
+  __m128i sum = _mm_setzero_si128();
+  __m128i first;
+  __m128i second;
+  __m128i decoded;
+
+  while (len >= 16)
+  {
+    first = HexDecodeSse2Nibbles(_mm_loadu_si128((const __m128i *)hex), &invalid);
+    second = HexDecodeSse2Nibbles(_mm_loadu_si128((const __m128i *)(hex + 16)), &invalid);
+    /* each 16-bit lane holds the high nibble in its low byte and the low nibble in its
+     * high byte. combine them into a byte in the low byte of the lane.
+     */
+    first = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(first, _mm_set1_epi16(0x00ff)), 4),
+                         _mm_srli_epi16(first, 8));
+    second = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(second, _mm_set1_epi16(0x00ff)), 4),
+                          _mm_srli_epi16(second, 8));
+    decoded = _mm_packus_epi16(first, second);
+    _mm_storeu_si128((__m128i *)bytes, decoded);
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(decoded, _mm_setzero_si128()));
+    hex += 32;
+    bytes += 16;
+    len -= 16;
+  }
+  if (_mm_movemask_epi8(invalid) != 0)
+  {
+    return SB_FALSE;
+  }
+  *checksum += (sb_uint8)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+  return HexDecodeTable(hex, bytes, len, checksum);
+} /*** end of HexDecodeSse2 ***/
+
+
+/************************************************************************************//**
+** \brief     Converts 32 hexadecimal digit characters to their 4-bit values with AVX2.
+**            Works the same as HexDecodeSse2Nibbles().
+** \param     chars The characters.
+** \param     invalid Mask that the invalid characters are added to.
+** \return    The values.
+**
+****************************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256i HexDecodeAvx2Nibbles(__m256i chars, __m256i *invalid)
+{
+  __m256i lower;
+  __m256i digit;
+  __m256i alpha;
+
+  lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+  digit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)),
+                           _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+  alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                           _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+  *invalid = _mm256_or_si256(*invalid, _mm256_andnot_si256(_mm256_or_si256(digit, alpha),
+                                                           _mm256_set1_epi8(-1)));
+  return _mm256_add_epi8(_mm256_and_si256(chars, _mm256_set1_epi8(0x0f)),
+                         _mm256_and_si256(alpha, _mm256_set1_epi8(9)));
+} /*** end of HexDecodeAvx2Nibbles ***/
+
+
+/************************************************************************************//**
+** \brief     AVX2 implementation of HexDecode(). Decodes 32 bytes at a time and leaves
+**            the remainder to the SSE2 implementation.
+** \param     hex The hexadecimal digits, two for each byte.
+** \param     bytes Pointer to where the decoded bytes are stored.
+** \param     len Number of bytes to decode.
+** \param     checksum Checksum that the bytes are added to, modulo 256.
+** \return    SB_TRUE if all characters are hexadecimal digits, SB_FALSE otherwise.
+**
+****************************************************************************************/
+__attribute__((target("avx2")))
+static sb_uint8 HexDecodeAvx2(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                              sb_uint8 *checksum)
+{
+  __m256i invalid = _mm256_setzero_si256();
+  __m256i sum = _mm256_setzero_si256();
+  __m256i first;
+  __m256i second;
+  __m256i decoded;
+  __m128i sum128;
+
+  while (len >= 32)
+  {
+    first = HexDecodeAvx2Nibbles(_mm256_loadu_si256((const __m256i *)hex), &invalid);
+    second = HexDecodeAvx2Nibbles(_mm256_loadu_si256((const __m256i *)(hex + 32)), &invalid);
+    first = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(first, _mm256_set1_epi16(0x00ff)), 4),
+                            _mm256_srli_epi16(first, 8));
+    second = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(second, _mm256_set1_epi16(0x00ff)), 4),
+                             _mm256_srli_epi16(second, 8));
+    /* packing works within each 128-bit half, which interleaves the 8-byte groups of
+     * both inputs. restore their order.
+     */
+    decoded = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second),
+                                       _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *)bytes, decoded);
+    sum = _mm256_add_epi64(sum, _mm256_sad_epu8(decoded, _mm256_setzero_si256()));
+    hex += 64;
+    bytes += 32;
+    len -= 32;
+  }
+  if (_mm256_movemask_epi8(invalid) != 0)
+  {
+    return SB_FALSE;
+  }
+  sum128 = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  *checksum += (sb_uint8)(_mm_cvtsi128_si32(sum128) + _mm_cvtsi128_si32(_mm_srli_si128(sum128, 8)));
+  return HexDecodeSse2(hex, bytes, len, checksum);
+} /*** end of HexDecodeAvx2 ***/
+#endif
+
+
+/*********************************** end of hexdecode.c *********************************/
@@ -0,0 +1,71 @@
+/************************************************************************************//**
+* \file         hexdecode.h
+* \brief        Hexadecimal decoding header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+#ifndef HEXDECODE_H
+#define HEXDECODE_H
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Enable the SSE2 and AVX2 implementations of the decoder, on processors that
+ *         support them. Set to 0 to always use the table driven implementation.
+ */
+#ifndef HEX_DECODE_SIMD_ENABLE
+#define HEX_DECODE_SIMD_ENABLE         (1)
+#endif
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enumeration for the implementations of the decoder. */
+typedef enum
+{
+  HEX_DECODE_IMPL_TABLE,                         /**< lookup table, one byte at a time */
+  HEX_DECODE_IMPL_SSE2,                          /**< SSE2, 16 bytes at a time         */
+  HEX_DECODE_IMPL_AVX2,                          /**< AVX2, 32 bytes at a time         */
+  HEX_DECODE_IMPL_CNT                            /**< number of implementations        */
+} tHexDecodeImpl;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint8 HexDecode(const sb_char *hex, sb_uint8 *bytes, sb_uint32 len,
+                   sb_uint8 *checksum);
+sb_uint8 HexDecodeSelect(tHexDecodeImpl impl);
+tHexDecodeImpl HexDecodeGetImpl(void);
+const sb_char *HexDecodeGetImplName(tHexDecodeImpl impl);
+
+
+#endif /* HEXDECODE_H */
+/*********************************** end of hexdecode.h *********************************/
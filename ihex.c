@@ -0,0 +1,309 @@
+/************************************************************************************//**
+* \file         ihex.c
+* \brief        Intel HEX library source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* for strcpy etc.               */
+#include "ihex.h"                                     /* Intel HEX library             */
+#include "hexdecode.h"                                /* hexadecimal decoding          */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Number of bytes of a record besides its data: the byte count, the address,
+ *         the record type and the checksum.
+ */
+#define IHEX_RECORD_OVERHEAD              (5)
+
+/** \brief Data record. */
+#define IHEX_TYPE_DATA                    (0x00)
+/** \brief End of file record. */
+#define IHEX_TYPE_END_OF_FILE             (0x01)
+/** \brief Extended segment address record, bits 4..19 of the address. */
+#define IHEX_TYPE_EXT_SEGMENT_ADDRESS     (0x02)
+/** \brief Start segment address record, the CS:IP of the entry point. */
+#define IHEX_TYPE_START_SEGMENT_ADDRESS   (0x03)
+/** \brief Extended linear address record, bits 16..31 of the address. */
+#define IHEX_TYPE_EXT_LINEAR_ADDRESS      (0x04)
+/** \brief Start linear address record, the entry point. */
+#define IHEX_TYPE_START_LINEAR_ADDRESS    (0x05)
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static const sb_char *IhexAddData(tIhexParser *parser, sb_uint32 address,
+                                  const sb_uint8 *data, sb_uint32 length);
+
+
+/************************************************************************************//**
+** \brief     Parses the contents of an Intel HEX file into an in-memory firmware image,
+**            in a single pass. Each record is fully validated: the start code, the hex
+**            digits, the byte count and the checksum. The first invalid line stops the
+**            parsing and is reported with its line number. Both extended segment and
+**            extended linear addresses are supported. Lines after the end of file
+**            record are ignored. The image is built the same way as that of an
+**            S-record file.
+** \param     buffer Contents of the Intel HEX file.
+** \param     size Number of bytes in the buffer.
+** \param     image Pointer to where the firmware image should be stored. Must be
+**            released with SrecordFreeImage(), also when this function fails.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored when the parsing fails.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 IhexParseImage(const sb_char *buffer, sb_uint32 size, tSrecordImage *image,
+                        tSrecordParseResults *parseResults, tSrecordError *error)
+{
+  tIhexParser parser;
+  const sb_char *line = buffer;
+  const sb_char *end = buffer + size;
+  const sb_char *lineEnd;
+  sb_uint32 lineLen;
+  sb_uint32 lineNumber = 0;
+
+  /* init data structures */
+  memset(image, 0, sizeof(*image));
+  parseResults->address_high = 0;
+  parseResults->address_low = 0xffffffff;
+  parseResults->data_bytes_total = 0;
+  parseResults->segment_count = 0;
+  error->line = 0;
+  error->reason = SB_NULL;
+  IhexParserInit(&parser, image);
+
+  /* loop through all lines of the file. the extended address carries over from one
+   * record to the next, so the lines are parsed in order.
+   */
+  while ( (line < end) && (parser.endOfFile == SB_FALSE) )
+  {
+    lineNumber++;
+    lineEnd = memchr(line, '\n', end - line);
+    if (lineEnd == SB_NULL)
+    {
+      lineEnd = end;
+    }
+    /* strip the line termination and trailing white space */
+    lineLen = lineEnd - line;
+    while ( (lineLen > 0) && ((line[lineLen - 1] == '\r') || (line[lineLen - 1] == ' ') ||
+                              (line[lineLen - 1] == '\t')) )
+    {
+      lineLen--;
+    }
+    /* empty lines are allowed */
+    if (lineLen > 0)
+    {
+      error->reason = IhexParseLine(&parser, line, lineLen, lineNumber);
+      if (error->reason != SB_NULL)
+      {
+        error->line = lineNumber;
+        return SB_FALSE;
+      }
+    }
+    line = lineEnd + 1;
+  }
+
+  /* a file without data cannot be programmed */
+  if (image->segmentCnt == 0)
+  {
+    error->reason = "no data records";
+    return SB_FALSE;
+  }
+  return SrecordImageFinish(image, parser.sorted, parseResults, error);
+} /*** end of IhexParseImage ***/
+
+
+/************************************************************************************//**
+** \brief     Initializes the state of a parser that builds a firmware image one record
+**            at a time, with IhexParseLine().
+** \param     parser The state of the parser.
+** \param     image The firmware image that the data is added to.
+** \return    none.
+**
+****************************************************************************************/
+void IhexParserInit(tIhexParser *parser, tSrecordImage *image)
+{
+  parser->image = image;
+  parser->base = 0;
+  parser->line = 0;
+  parser->segmented = SB_FALSE;
+  parser->sorted = SB_TRUE;
+  parser->endOfFile = SB_FALSE;
+} /*** end of IhexParserInit ***/
+
+
+/************************************************************************************//**
+** \brief     Validates and parses a record of an Intel HEX file. The data of a data
+**            record is added to the firmware image. The records must be parsed in the
+**            order of the file, because of the extended addresses.
+** \param     parser The state of the parser.
+** \param     line The line, without its line termination.
+** \param     lineLen Number of characters on the line.
+** \param     lineNumber Number of the line in the file.
+** \return    SB_NULL if the line is valid, otherwise a description of the error.
+**
+****************************************************************************************/
+const sb_char *IhexParseLine(tIhexParser *parser, const sb_char *line, sb_uint32 lineLen,
+                             sb_uint32 lineNumber)
+{
+  sb_uint8 bytes[255 + IHEX_RECORD_OVERHEAD - 1];
+  sb_uint8 byteCount;
+  sb_uint8 checksum = 0;
+  sb_uint32 offset;
+  sb_uint32 value;
+  sb_uint32 length;
+  const sb_char *reason;
+
+  parser->line = lineNumber;
+  if ( (lineLen < (1 + (2 * IHEX_RECORD_OVERHEAD))) || (line[0] != ':') )
+  {
+    return "not an Intel HEX record";
+  }
+  if (HexDecode(&line[1], &byteCount, 1, &checksum) == SB_FALSE)
+  {
+    return "invalid hex digit";
+  }
+  if (lineLen != (1 + (2 * ((sb_uint32)byteCount + IHEX_RECORD_OVERHEAD))))
+  {
+    return "byte count does not match the length of the record";
+  }
+  /* decode the address, record type, data and checksum bytes and add them to the
+   * checksum, in one pass over the characters
+   */
+  if (HexDecode(&line[3], bytes, byteCount + IHEX_RECORD_OVERHEAD - 1, &checksum) == SB_FALSE)
+  {
+    return "invalid hex digit";
+  }
+  /* the sum includes the checksum itself, which makes it 0 when correct */
+  if (checksum != 0)
+  {
+    return "checksum mismatch";
+  }
+  offset = ((sb_uint32)bytes[0] << 8) | bytes[1];
+  switch (bytes[2])
+  {
+    case IHEX_TYPE_DATA:
+      if (byteCount == 0)
+      {
+        return SB_NULL;
+      }
+      /* with a segment address the offset wraps around within the 64 KiB segment */
+      length = byteCount;
+      if ( (parser->segmented == SB_TRUE) && ((offset + length) > 0x10000) )
+      {
+        length = 0x10000 - offset;
+      }
+      reason = IhexAddData(parser, parser->base + offset, &bytes[3], length);
+      if ( (reason == SB_NULL) && (length < byteCount) )
+      {
+        reason = IhexAddData(parser, parser->base, &bytes[3 + length], byteCount - length);
+      }
+      return reason;
+
+    case IHEX_TYPE_END_OF_FILE:
+      if (byteCount != 0)
+      {
+        return "byte count does not match the record type";
+      }
+      parser->endOfFile = SB_TRUE;
+      return SB_NULL;
+
+    case IHEX_TYPE_EXT_SEGMENT_ADDRESS:
+    case IHEX_TYPE_EXT_LINEAR_ADDRESS:
+      if (byteCount != 2)
+      {
+        return "byte count does not match the record type";
+      }
+      value = ((sb_uint32)bytes[3] << 8) | bytes[4];
+      parser->segmented = (bytes[2] == IHEX_TYPE_EXT_SEGMENT_ADDRESS) ? SB_TRUE : SB_FALSE;
+      parser->base = (parser->segmented == SB_TRUE) ? (value << 4) : (value << 16);
+      return SB_NULL;
+
+    case IHEX_TYPE_START_SEGMENT_ADDRESS:
+    case IHEX_TYPE_START_LINEAR_ADDRESS:
+      /* the entry point is not needed for programming */
+      if (byteCount != 4)
+      {
+        return "byte count does not match the record type";
+      }
+      return SB_NULL;
+
+    default:
+      return "unsupported record type";
+  }
+} /*** end of IhexParseLine ***/
+
+
+/************************************************************************************//**
+** \brief     Adds the data of a data record to the firmware image.
+** \param     parser The state of the parser.
+** \param     address Memory address of the data.
+** \param     data The data bytes.
+** \param     length Number of data bytes, at least 1.
+** \return    SB_NULL if successful, otherwise a description of the error.
+**
+****************************************************************************************/
+static const sb_char *IhexAddData(tIhexParser *parser, sb_uint32 address,
+                                  const sb_uint8 *data, sb_uint32 length)
+{
+  tSrecordImage *image = parser->image;
+  tSrecordSegment *segment;
+
+  if ((address + length - 1) < address)
+  {
+    return "data exceeds the 32-bit address range";
+  }
+  /* keep track of whether the records are in order of their addresses */
+  if (image->segmentCnt > 0)
+  {
+    segment = &image->segments[image->segmentCnt - 1];
+    if (address < (segment->address + segment->length))
+    {
+      parser->sorted = SB_FALSE;
+    }
+  }
+  if (SrecordImageAppend(image, address, data, length, parser->line) == SB_FALSE)
+  {
+    return "out of memory";
+  }
+  return SB_NULL;
+} /*** end of IhexAddData ***/
+
+
+/*********************************** end of ihex.c *************************************/
@@ -0,0 +1,70 @@
+/************************************************************************************//**
+* \file         ihex.h
+* \brief        Intel HEX library header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+#ifndef IHEX_H
+#define IHEX_H
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "srecord.h"                                  /* S-record file handling        */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for the state of the parser, which carries the extended
+ *         address from one record to the next.
+ */
+typedef struct
+{
+  tSrecordImage *image;                           /**< image that the data is added to */
+  sb_uint32 base;                                 /**< extended address                */
+  sb_uint32 line;                                 /**< line of the record being parsed */
+  sb_uint8 segmented;                             /**< SB_TRUE for a segment address   */
+  sb_uint8 sorted;                                /**< SB_TRUE if in order of address  */
+  sb_uint8 endOfFile;                             /**< SB_TRUE after the last record   */
+} tIhexParser;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint8 IhexParseImage(const sb_char *buffer, sb_uint32 size, tSrecordImage *image,
+                        tSrecordParseResults *parseResults, tSrecordError *error);
+void     IhexParserInit(tIhexParser *parser, tSrecordImage *image);
+const sb_char *IhexParseLine(tIhexParser *parser, const sb_char *line, sb_uint32 lineLen,
+                             sb_uint32 lineNumber);
+
+
+#endif /* IHEX_H */
+/*********************************** end of ihex.h *************************************/
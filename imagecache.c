@@ -0,0 +1,627 @@
+/************************************************************************************//**
+* \file         imagecache.c
+* \brief        Parsed firmware image cache source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* for strcpy etc.               */
+#include <stdio.h>                                    /* standard I/O library          */
+#include <stdlib.h>                                   /* for malloc etc.               */
+#include "imagecache.h"                               /* parsed firmware image cache   */
+#include "filemap.h"                                  /* read-only file mapping        */
+#include "parallel.h"                                 /* parallel execution of jobs    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Version of the layout of a cache file. */
+#define IMAGE_CACHE_VERSION            (2)
+
+/** \brief Value that reads back differently on a machine with another byte order. */
+#define IMAGE_CACHE_BYTE_ORDER         (0x01020304)
+
+/** \brief Maximum number of characters in the name of a cache file. */
+#define IMAGE_CACHE_PATH_MAX_LEN       (512)
+
+/** \brief Size of the blocks of a firmware file that are hashed on separate threads.
+ *         It is fixed, such that the key does not depend on the number of processors.
+ */
+#define IMAGE_CACHE_KEY_BLOCK_SIZE     (8u * 1024 * 1024)
+
+/** \brief Maximum number of blocks of a firmware file. */
+#define IMAGE_CACHE_KEY_BLOCKS_MAX     ((0xFFFFFFFFu / IMAGE_CACHE_KEY_BLOCK_SIZE) + 1)
+
+/** \brief Alignment of the data in a cache file. */
+#define IMAGE_CACHE_DATA_ALIGN         (8)
+
+/* primes of the XXH64 hash algorithm */
+#define IMAGE_CACHE_PRIME64_1          (0x9E3779B185EBCA87ull)
+#define IMAGE_CACHE_PRIME64_2          (0xC2B2AE3D27D4EB4Full)
+#define IMAGE_CACHE_PRIME64_3          (0x165667B19E3779F9ull)
+#define IMAGE_CACHE_PRIME64_4          (0x85EBCA77C2B2AE63ull)
+#define IMAGE_CACHE_PRIME64_5          (0x27D4EB2F165667C5ull)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for the header at the start of a cache file. It is followed
+ *         by the segments and the data, at the offsets in the header.
+ */
+typedef struct
+{
+  sb_char magic[8];                               /**< identifies a cache file         */
+  sb_uint32 version;                              /**< IMAGE_CACHE_VERSION             */
+  sb_uint32 byteOrder;                            /**< IMAGE_CACHE_BYTE_ORDER          */
+  sb_uint64 key;                                  /**< key of the firmware file        */
+  sb_uint64 contentsHash;                         /**< hash of the file, with this 0   */
+  sb_uint32 segmentCnt;                           /**< number of segments              */
+  sb_uint32 dataSize;                             /**< number of data bytes            */
+  sb_uint32 segmentsOffset;                       /**< offset of the segments          */
+  sb_uint32 dataOffset;                           /**< offset of the data              */
+  sb_uint32 fileSize;                             /**< size of the cache file          */
+} tImageCacheHeader;
+
+/** \brief Structure type for the blocks of a firmware file that a thread hashes. */
+typedef struct
+{
+  const sb_uint8 *data;                           /**< contents of the firmware file   */
+  sb_uint32 size;                                 /**< size of the firmware file       */
+  sb_uint64 seed;                                 /**< seed of the hash of each block  */
+  sb_uint32 firstBlock;                           /**< index of the first block        */
+  sb_uint32 blockCnt;                             /**< number of blocks                */
+  sb_uint64 *blockHashes;                         /**< hashes of all blocks            */
+} tImageCacheKeyJob;
+
+/** \brief Structure type for a segment in a cache file. */
+typedef struct
+{
+  sb_uint32 address;                              /**< start address of the segment    */
+  sb_uint32 length;                               /**< number of data bytes            */
+  sb_uint32 offset;                               /**< offset of the data              */
+} tImageCacheSegment;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static sb_uint8  ImageCacheMapImage(const tImageCacheHeader *header,
+                                    const tFileMap *cacheFile, tSrecordImage *image,
+                                    tSrecordParseResults *parseResults);
+static sb_uint64 ImageCacheHashTables(const tImageCacheHeader *header,
+                                      const sb_uint8 *cacheData);
+static void      ImageCacheHashBlocks(void *context);
+static sb_uint64 ImageCacheHash(const sb_uint8 *data, sb_uint32 len, sb_uint64 seed);
+static sb_uint64 ImageCacheHashRound(sb_uint64 acc, sb_uint64 input);
+static sb_uint64 ImageCacheRead64(const sb_uint8 *data);
+static sb_uint32 ImageCacheRead32(const sb_uint8 *data);
+static void      ImageCacheGetPath(const sb_char *cacheDir, sb_uint64 key, sb_char *path);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Magic number at the start of a cache file. */
+static const sb_char imageCacheMagic[8] = { 'O', 'B', 'L', 'T', 'I', 'M', 'G', '\0' };
+
+
+/************************************************************************************//**
+** \brief     Determines the key of a firmware file in the cache. It is a 64-bit XXH64
+**            hash of the contents of the file, which takes a fraction of the time of
+**            parsing it. A large file is hashed in blocks on one thread per processor,
+**            after which the hashes of the blocks are hashed. The format and base
+**            address that the file is loaded with are part of the key, as they change
+**            the firmware image.
+** \param     buffer Contents of the firmware file.
+** \param     size Number of bytes in the buffer.
+** \param     format Format that the file is loaded with.
+** \param     baseAddress Base address of a raw binary file.
+** \return    The key.
+**
+****************************************************************************************/
+sb_uint64 ImageCacheKey(const sb_char *buffer, sb_uint32 size, tFirmwareFormat format,
+                        sb_uint32 baseAddress)
+{
+  sb_uint64 blockHashes[IMAGE_CACHE_KEY_BLOCKS_MAX];
+  tImageCacheKeyJob jobs[PARALLEL_JOBS_MAX];
+  sb_uint64 seed;
+  sb_uint32 blockCnt;
+  sb_uint32 jobCnt;
+  sb_uint32 idx;
+
+  seed = ((sb_uint64)format << 32) | ((format == FIRMWARE_FORMAT_BINARY) ? baseAddress : 0);
+  if (size <= IMAGE_CACHE_KEY_BLOCK_SIZE)
+  {
+    return ImageCacheHash((const sb_uint8 *)buffer, size, seed);
+  }
+
+  /* divide the blocks over the threads */
+  blockCnt = (sb_uint32)(((sb_uint64)size + IMAGE_CACHE_KEY_BLOCK_SIZE - 1) /
+                         IMAGE_CACHE_KEY_BLOCK_SIZE);
+  jobCnt = ParallelGetCpuCount();
+  if (jobCnt > PARALLEL_JOBS_MAX)
+  {
+    jobCnt = PARALLEL_JOBS_MAX;
+  }
+  if (jobCnt > blockCnt)
+  {
+    jobCnt = blockCnt;
+  }
+  for (idx=0; idx<jobCnt; idx++)
+  {
+    jobs[idx].data = (const sb_uint8 *)buffer;
+    jobs[idx].size = size;
+    jobs[idx].seed = seed;
+    jobs[idx].firstBlock = (blockCnt * idx) / jobCnt;
+    jobs[idx].blockCnt = ((blockCnt * (idx + 1)) / jobCnt) - jobs[idx].firstBlock;
+    jobs[idx].blockHashes = blockHashes;
+  }
+  ParallelRun(ImageCacheHashBlocks, jobs, sizeof(tImageCacheKeyJob), jobCnt);
+  return ImageCacheHash((const sb_uint8 *)blockHashes, blockCnt * sizeof(sb_uint64), seed);
+} /*** end of ImageCacheKey ***/
+
+
+/************************************************************************************//**
+** \brief     Loads the firmware image of a firmware file from the cache. The cache file
+**            is mapped into memory and the image refers to the data in the mapping,
+**            without any parsing or copying. The mapping is released together with the
+**            image by SrecordFreeImage(). The contents of the cache file are checked
+**            against the hash in its header first, such that a damaged cache file is
+**            never used.
+** \param     cacheDir Directory of the cache files.
+** \param     key Key of the firmware file, from ImageCacheKey().
+** \param     image Pointer to where the firmware image should be stored. It is
+**            released again when the loading fails.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \return    SB_TRUE if the image was loaded, SB_FALSE if it is not in the cache.
+**
+****************************************************************************************/
+sb_uint8 ImageCacheLoad(const sb_char *cacheDir, sb_uint64 key, tSrecordImage *image,
+                        tSrecordParseResults *parseResults)
+{
+  sb_char path[IMAGE_CACHE_PATH_MAX_LEN];
+  tImageCacheHeader header;
+  tFileMap cacheFile;
+  sb_uint8 result;
+
+  memset(image, 0, sizeof(*image));
+  ImageCacheGetPath(cacheDir, key, path);
+  if (FileMapOpen(path, &cacheFile) == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+  /* -------------------- check the header ------------------------------------------- */
+  if (cacheFile.size < sizeof(header))
+  {
+    FileMapClose(&cacheFile);
+    return SB_FALSE;
+  }
+  memcpy(&header, cacheFile.data, sizeof(header));
+  if ( (memcmp(header.magic, imageCacheMagic, sizeof(imageCacheMagic)) != 0) ||
+       (header.version != IMAGE_CACHE_VERSION) ||
+       (header.byteOrder != IMAGE_CACHE_BYTE_ORDER) || (header.key != key) ||
+       (header.fileSize != cacheFile.size) || (header.segmentCnt == 0) ||
+       (header.segmentsOffset < sizeof(header)) ||
+       (header.dataOffset < header.segmentsOffset) ||
+       ((header.segmentsOffset % sizeof(sb_uint32)) != 0) ||
+       ((header.segmentsOffset +
+         ((sb_uint64)header.segmentCnt * sizeof(tImageCacheSegment))) > cacheFile.size) ||
+       (((sb_uint64)header.dataOffset + header.dataSize) > cacheFile.size) )
+  {
+    FileMapClose(&cacheFile);
+    return SB_FALSE;
+  }
+
+  /* the image takes over the mapping, also when it turns out to be invalid */
+  result = ImageCacheMapImage(&header, &cacheFile, image, parseResults);
+  if (result == SB_FALSE)
+  {
+    SrecordFreeImage(image);
+  }
+  return result;
+} /*** end of ImageCacheLoad ***/
+
+
+/************************************************************************************//**
+** \brief     Stores the firmware image of a firmware file in the cache. The cache file
+**            is written under a temporary name first and then renamed, such that other
+**            processes never see a partially written file.
+** \param     cacheDir Directory of the cache files. It must exist.
+** \param     key Key of the firmware file, from ImageCacheKey().
+** \param     image The firmware image, as completed by SrecordImageFinish().
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 ImageCacheStore(const sb_char *cacheDir, sb_uint64 key,
+                         const tSrecordImage *image)
+{
+  sb_char path[IMAGE_CACHE_PATH_MAX_LEN];
+  sb_char tempPath[IMAGE_CACHE_PATH_MAX_LEN + 4];
+  static const sb_uint8 padding[IMAGE_CACHE_DATA_ALIGN];
+  tImageCacheHeader header;
+  tImageCacheSegment cacheSegment;
+  tFileMap tempFile;
+  sb_uint64 hash;
+  sb_file hFile;
+  sb_uint8 result = SB_TRUE;
+  sb_uint32 offset = 0;
+  sb_uint32 padLen;
+  sb_uint32 idx;
+
+  /* -------------------- fill in the header ----------------------------------------- */
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, imageCacheMagic, sizeof(imageCacheMagic));
+  header.version = IMAGE_CACHE_VERSION;
+  header.byteOrder = IMAGE_CACHE_BYTE_ORDER;
+  header.key = key;
+  header.segmentCnt = image->segmentCnt;
+  for (idx=0; idx<image->segmentCnt; idx++)
+  {
+    header.dataSize += image->segments[idx].length;
+  }
+  header.segmentsOffset = sizeof(header);
+  header.dataOffset = header.segmentsOffset +
+                      (header.segmentCnt * sizeof(tImageCacheSegment));
+  header.dataOffset = (header.dataOffset + IMAGE_CACHE_DATA_ALIGN - 1) &
+                      ~(IMAGE_CACHE_DATA_ALIGN - 1);
+  header.fileSize = header.dataOffset + header.dataSize;
+
+  /* -------------------- write the cache file --------------------------------------- */
+  ImageCacheGetPath(cacheDir, key, path);
+  snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+  hFile = fopen(tempPath, "w+b");
+  if (hFile == SB_NULL)
+  {
+    return SB_FALSE;
+  }
+  if (fwrite(&header, sizeof(header), 1, hFile) != 1)
+  {
+    result = SB_FALSE;
+  }
+  for (idx=0; idx<image->segmentCnt; idx++)
+  {
+    cacheSegment.address = image->segments[idx].address;
+    cacheSegment.length = image->segments[idx].length;
+    cacheSegment.offset = offset;
+    offset += cacheSegment.length;
+    if (fwrite(&cacheSegment, sizeof(cacheSegment), 1, hFile) != 1)
+    {
+      result = SB_FALSE;
+    }
+  }
+  padLen = header.dataOffset - header.segmentsOffset -
+           (header.segmentCnt * sizeof(tImageCacheSegment));
+  if (fwrite(padding, 1, padLen, hFile) != padLen)
+  {
+    result = SB_FALSE;
+  }
+  for (idx=0; idx<image->segmentCnt; idx++)
+  {
+    if (fwrite(image->segments[idx].data, 1, image->segments[idx].length, hFile) !=
+        image->segments[idx].length)
+    {
+      result = SB_FALSE;
+    }
+  }
+
+  /* the header is written again with the hash of the contents that were written */
+  if ( (result == SB_TRUE) && (fflush(hFile) == 0) &&
+       (FileMapOpen(tempPath, &tempFile) == SB_TRUE) )
+  {
+    hash = ImageCacheHashTables(&header, (const sb_uint8 *)tempFile.data);
+    header.contentsHash = ImageCacheHash((const sb_uint8 *)&tempFile.data[header.dataOffset],
+                                         header.dataSize, hash);
+    FileMapClose(&tempFile);
+    if ( (fseek(hFile, 0, SEEK_SET) != 0) ||
+         (fwrite(&header, sizeof(header), 1, hFile) != 1) )
+    {
+      result = SB_FALSE;
+    }
+  }
+  else
+  {
+    result = SB_FALSE;
+  }
+  if (fclose(hFile) != 0)
+  {
+    result = SB_FALSE;
+  }
+  if ( (result == SB_FALSE) || (rename(tempPath, path) != 0) )
+  {
+    remove(tempPath);
+    return SB_FALSE;
+  }
+  return SB_TRUE;
+} /*** end of ImageCacheStore ***/
+
+
+/************************************************************************************//**
+** \brief     Removes the cached firmware image of a firmware file, if there is one.
+** \param     cacheDir Directory of the cache files.
+** \param     key Key of the firmware file, from ImageCacheKey().
+** \return    none.
+**
+****************************************************************************************/
+void ImageCacheRemove(const sb_char *cacheDir, sb_uint64 key)
+{
+  sb_char path[IMAGE_CACHE_PATH_MAX_LEN];
+
+  ImageCacheGetPath(cacheDir, key, path);
+  remove(path);
+} /*** end of ImageCacheRemove ***/
+
+
+/************************************************************************************//**
+** \brief     Builds a firmware image whose arena is the data of a mapped cache file,
+**            after checking the cache file against the hash in its header. The
+**            segments are copied, as they are small. The image takes over the mapping.
+** \param     header Header of the cache file, with offsets that were checked against
+**            the size of the file.
+** \param     cacheFile The mapped cache file.
+** \param     image Pointer to where the firmware image should be stored.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \return    SB_TRUE if successful, SB_FALSE if the cache file is not valid.
+**
+****************************************************************************************/
+static sb_uint8 ImageCacheMapImage(const tImageCacheHeader *header,
+                                   const tFileMap *cacheFile, tSrecordImage *image,
+                                   tSrecordParseResults *parseResults)
+{
+  const tImageCacheSegment *cacheSegments;
+  tSrecordSegment *segment;
+  tSrecordError error;
+  sb_uint64 hash;
+  sb_uint32 idx;
+
+  /* the data is used where it is, so it is read-only and nothing of it is allocated */
+  image->arenaMap = *cacheFile;
+  image->arena = (sb_uint8 *)&cacheFile->data[header->dataOffset];
+  image->arenaAlloc = 0;
+  image->arenaSize = header->dataSize;
+  cacheSegments = (const tImageCacheSegment *)&cacheFile->data[header->segmentsOffset];
+  image->segments = malloc(header->segmentCnt * sizeof(tSrecordSegment));
+  if (image->segments == SB_NULL)
+  {
+    return SB_FALSE;
+  }
+  image->segmentAlloc = header->segmentCnt;
+  for (idx=0; idx<header->segmentCnt; idx++)
+  {
+    /* the segments must be sorted and lie within the data */
+    if ( (cacheSegments[idx].length == 0) ||
+         (((sb_uint64)cacheSegments[idx].offset + cacheSegments[idx].length) >
+          header->dataSize) ||
+         ((idx > 0) && (cacheSegments[idx].address <= cacheSegments[idx - 1].address)) )
+    {
+      return SB_FALSE;
+    }
+    segment = &image->segments[idx];
+    segment->address = cacheSegments[idx].address;
+    segment->length = cacheSegments[idx].length;
+    segment->offset = cacheSegments[idx].offset;
+    segment->line = 0;
+    segment->data = SB_NULL;
+    image->segmentCnt++;
+  }
+  /* the header and the tables are hashed first, which seeds the hash of the data */
+  hash = ImageCacheHashTables(header, (const sb_uint8 *)cacheFile->data);
+  hash = ImageCacheHash(image->arena, header->dataSize, hash);
+  if (hash != header->contentsHash)
+  {
+    return SB_FALSE;
+  }
+  return SrecordImageFinish(image, SB_TRUE, parseResults, &error);
+} /*** end of ImageCacheMapImage ***/
+
+
+/************************************************************************************//**
+** \brief     Hashes the header of a cache file, without its hash, and the tables that
+**            follow it up to the data.
+** \param     header Header of the cache file.
+** \param     cacheData Contents of the cache file.
+** \return    The hash, which is the seed of the hash of the data.
+**
+****************************************************************************************/
+static sb_uint64 ImageCacheHashTables(const tImageCacheHeader *header,
+                                      const sb_uint8 *cacheData)
+{
+  tImageCacheHeader hashedHeader;
+  sb_uint64 hash;
+
+  hashedHeader = *header;
+  hashedHeader.contentsHash = 0;
+  hash = ImageCacheHash((const sb_uint8 *)&hashedHeader, sizeof(hashedHeader), header->key);
+  return ImageCacheHash(&cacheData[sizeof(hashedHeader)],
+                        header->dataOffset - sizeof(hashedHeader), hash);
+} /*** end of ImageCacheHashTables ***/
+
+
+/************************************************************************************//**
+** \brief     Hashes blocks of a firmware file for its key. Runs on a thread of its own.
+** \param     context The blocks, of type tImageCacheKeyJob.
+** \return    none.
+**
+****************************************************************************************/
+static void ImageCacheHashBlocks(void *context)
+{
+  tImageCacheKeyJob *job = (tImageCacheKeyJob *)context;
+  sb_uint32 offset;
+  sb_uint32 len;
+  sb_uint32 idx;
+
+  for (idx=job->firstBlock; idx<(job->firstBlock + job->blockCnt); idx++)
+  {
+    offset = idx * IMAGE_CACHE_KEY_BLOCK_SIZE;
+    len = job->size - offset;
+    if (len > IMAGE_CACHE_KEY_BLOCK_SIZE)
+    {
+      len = IMAGE_CACHE_KEY_BLOCK_SIZE;
+    }
+    job->blockHashes[idx] = ImageCacheHash(&job->data[offset], len, job->seed);
+  }
+} /*** end of ImageCacheHashBlocks ***/
+
+
+/************************************************************************************//**
+** \brief     Calculates the XXH64 hash of data.
+** \param     data The data.
+** \param     len Number of data bytes.
+** \param     seed Seed of the hash.
+** \return    The hash.
+**
+****************************************************************************************/
+static sb_uint64 ImageCacheHash(const sb_uint8 *data, sb_uint32 len, sb_uint64 seed)
+{
+  const sb_uint8 *end = data + len;
+  sb_uint64 acc[4];
+  sb_uint64 hash;
+  sb_uint8 idx;
+
+  if (len >= 32)
+  {
+    /* four independent lanes of 8 bytes each */
+    acc[0] = seed + IMAGE_CACHE_PRIME64_1 + IMAGE_CACHE_PRIME64_2;
+    acc[1] = seed + IMAGE_CACHE_PRIME64_2;
+    acc[2] = seed;
+    acc[3] = seed - IMAGE_CACHE_PRIME64_1;
+    while ((end - data) >= 32)
+    {
+      for (idx=0; idx<4; idx++)
+      {
+        acc[idx] = ImageCacheHashRound(acc[idx], ImageCacheRead64(data + (8 * idx)));
+      }
+      data += 32;
+    }
+    hash = ((acc[0] << 1) | (acc[0] >> 63)) + ((acc[1] << 7) | (acc[1] >> 57)) +
+           ((acc[2] << 12) | (acc[2] >> 52)) + ((acc[3] << 18) | (acc[3] >> 46));
+    for (idx=0; idx<4; idx++)
+    {
+      hash ^= ImageCacheHashRound(0, acc[idx]);
+      hash = (hash * IMAGE_CACHE_PRIME64_1) + IMAGE_CACHE_PRIME64_4;
+    }
+  }
+  else
+  {
+    hash = seed + IMAGE_CACHE_PRIME64_5;
+  }
+  hash += len;
+
+  /* the remaining bytes */
+  while ((end - data) >= 8)
+  {
+    hash ^= ImageCacheHashRound(0, ImageCacheRead64(data));
+    hash = (((hash << 27) | (hash >> 37)) * IMAGE_CACHE_PRIME64_1) + IMAGE_CACHE_PRIME64_4;
+    data += 8;
+  }
+  if ((end - data) >= 4)
+  {
+    hash ^= (sb_uint64)ImageCacheRead32(data) * IMAGE_CACHE_PRIME64_1;
+    hash = (((hash << 23) | (hash >> 41)) * IMAGE_CACHE_PRIME64_2) + IMAGE_CACHE_PRIME64_3;
+    data += 4;
+  }
+  while (data < end)
+  {
+    hash ^= *data * IMAGE_CACHE_PRIME64_5;
+    hash = ((hash << 11) | (hash >> 53)) * IMAGE_CACHE_PRIME64_1;
+    data++;
+  }
+
+  /* mix the bits */
+  hash ^= hash >> 33;
+  hash *= IMAGE_CACHE_PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= IMAGE_CACHE_PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+} /*** end of ImageCacheHash ***/
+
+
+/************************************************************************************//**
+** \brief     Processes 8 bytes of input in a lane of the XXH64 hash.
+** \param     acc Accumulator of the lane.
+** \param     input The input.
+** \return    New value of the accumulator.
+**
+****************************************************************************************/
+static sb_uint64 ImageCacheHashRound(sb_uint64 acc, sb_uint64 input)
+{
+  acc += input * IMAGE_CACHE_PRIME64_2;
+  acc = (acc << 31) | (acc >> 33);
+  return acc * IMAGE_CACHE_PRIME64_1;
+} /*** end of ImageCacheHashRound ***/
+
+
+/************************************************************************************//**
+** \brief     Reads a 64-bit little endian value from unaligned memory.
+** \param     data The memory.
+** \return    The value.
+**
+****************************************************************************************/
+static sb_uint64 ImageCacheRead64(const sb_uint8 *data)
+{
+  return (sb_uint64)ImageCacheRead32(data) | ((sb_uint64)ImageCacheRead32(data + 4) << 32);
+} /*** end of ImageCacheRead64 ***/
+
+
+/************************************************************************************//**
+** \brief     Reads a 32-bit little endian value from unaligned memory.
+** \param     data The memory.
+** \return    The value.
+**
+****************************************************************************************/
+static sb_uint32 ImageCacheRead32(const sb_uint8 *data)
+{
+  return (sb_uint32)data[0] | ((sb_uint32)data[1] << 8) | ((sb_uint32)data[2] << 16) |
+         ((sb_uint32)data[3] << 24);
+} /*** end of ImageCacheRead32 ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the name of the cache file of a firmware file.
+** \param     cacheDir Directory of the cache files.
+** \param     key Key of the firmware file.
+** \param     path Buffer of IMAGE_CACHE_PATH_MAX_LEN characters for the name.
+** \return    none.
+**
+****************************************************************************************/
+static void ImageCacheGetPath(const sb_char *cacheDir, sb_uint64 key, sb_char *path)
+{
+  snprintf(path, IMAGE_CACHE_PATH_MAX_LEN, "%s/%016llx.imgcache", cacheDir, key);
+} /*** end of ImageCacheGetPath ***/
+
+
+/*********************************** end of imagecache.c *******************************/
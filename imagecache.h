@@ -0,0 +1,56 @@
+/************************************************************************************//**
+* \file         imagecache.h
+* \brief        Parsed firmware image cache header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "srecord.h"                                  /* S-record file handling        */
+#include "firmware.h"                                 /* firmware file loading         */
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint64 ImageCacheKey(const sb_char *buffer, sb_uint32 size, tFirmwareFormat format,
+                        sb_uint32 baseAddress);
+sb_uint8  ImageCacheLoad(const sb_char *cacheDir, sb_uint64 key, tSrecordImage *image,
+                         tSrecordParseResults *parseResults);
+sb_uint8  ImageCacheStore(const sb_char *cacheDir, sb_uint64 key,
+                          const tSrecordImage *image);
+void      ImageCacheRemove(const sb_char *cacheDir, sb_uint64 key);
+
+
+#endif /* IMAGECACHE_H */
+/*********************************** end of imagecache.h *******************************/
@@ -39,9 +39,17 @@
 #include <assert.h>                                   /* assertion module              */
 #include <sb_types.h>                                 /* C types                       */
 #include <stdio.h>                                    /* standard I/O library          */
+#include <stdlib.h>                                   /* standard library              */
 #include <string.h>                                   /* string library                */
 #include "xcpmaster.h"                                /* XCP master protocol module    */
 #include "srecord.h"                                  /* S-record file handling        */
+#include "firmware.h"                                 /* firmware file loading         */
+#include "imagecache.h"                               /* parsed firmware image cache   */
+#include "xcpengine.h"                                /* concurrent update engine      */
+#include "xcptrace.h"                                 /* timeline export               */
+#include "report.h"                                   /* progress and result reporting */
+#include "filemap.h"                                  /* read-only file mapping        */
+#include "firmwarestream.h"                           /* streaming firmware parser     */
 #include "timeutil.h"                                 /* time utility module           */
 
 
@@ -51,6 +59,12 @@
 static void     DisplayProgramInfo(void);
 static void     DisplayProgramUsage(void);
 static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[]);
+static sb_int32 UpdateFromFile(void);
+static sb_int32 UpdateFromStream(void);
+static sb_int32 UpdateDevice(tSrecordImage *image, tSrecordParseResults *fileParseResults);
+static sb_uint8 ProgramImage(tSrecordImage *image, tSrecordParseResults *fileParseResults);
+static sb_uint8 ProgramStream(void);
+static sb_int32 UpdateTargets(tSrecordImage *image, tSrecordParseResults *fileParseResults);
 
 
 /****************************************************************************************
@@ -62,18 +76,88 @@ static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[]);
 /** \brief Program return code if an error occurred. */
 #define PROG_RESULT_ERROR (1)
 
+/** \brief Maximum number of devices that can be updated in one run. */
+#define MAX_TARGETS       (1024)
+
+/** \brief Default number of devices that are updated at the same time. */
+#define DEFAULT_CONCURRENCY (32)
+
+/** \brief Number of bytes of a segment that are programmed before the progress is
+ *         reported. Each part costs one SET MTA command.
+ */
+#define PROGRAM_PROGRESS_CHUNK (64*1024)
+
+/** \brief Smallest sector size that can be specified with -k. */
+#define SECTOR_SIZE_MIN   (256)
+
 
 /****************************************************************************************
 * Local data declarations
 ****************************************************************************************/
-/** \brief IP address of the device, such as 192.168.1.100 */
-static sb_char deviceAddress[32];
+/** \brief Host name or IP address of the device, such as 192.168.1.100 */
+static sb_char deviceAddress[XCP_ENGINE_ADDRESS_MAX_LEN];
 
 /** \brief IP port of the device, such as 2101 */
 static sb_uint32 devicePort;
 
-/** \brief Name of the S-record file. */
-static sb_char srecordFileName[128]; 
+/** \brief Name of the firmware file. */
+static sb_char firmwareFileName[128]; 
+
+/** \brief Memory address of a raw binary firmware file, when specified with -b. */
+static sb_uint32 baseAddress;
+
+/** \brief Whether the firmware file is a raw binary file, which is the case when its
+ *         base address is specified with -b.
+ */
+static sb_uint8 firmwareIsBinary = SB_FALSE;
+
+/** \brief Whether the firmware file is streamed to the device while it is parsed, which
+ *         is the case with --stream or when the firmware file is read from the standard
+ *         input.
+ */
+static sb_uint8 firmwareStream = SB_FALSE;
+
+/** \brief Size of the sectors that the device erases, when specified with -k. Only the
+ *         sectors with data are erased, on demand when the firmware file is streamed.
+ */
+static sb_uint32 sectorSize = 0;
+
+/** \brief Number of program commands kept in flight, 1 for stop-and-wait. */
+static sb_uint32 programWindow = 1;
+
+/** \brief XCP master session with the device. */
+static tXcpMasterSession session;
+
+/** \brief Socket profile of the TCP connection. */
+static tXcpTransportProfile socketProfile = XCP_TRANSPORT_PROFILE_DEFAULT;
+
+/** \brief Devices that are updated concurrently, when specified with -t. */
+static tXcpEngineTarget targets[MAX_TARGETS];
+
+/** \brief Number of devices that are updated concurrently. */
+static sb_uint32 targetCnt = 0;
+
+/** \brief Maximum number of devices that are updated at the same time. */
+static sb_uint32 maxConcurrent = DEFAULT_CONCURRENCY;
+
+/** \brief Time in milliseconds that establishing a TCP connection is allowed to take. */
+static sb_uint32 connectTimeoutMs = XCP_TRANSPORT_CONNECT_TIMEOUT_MS;
+
+/** \brief Name of the trace file, when specified with --trace. */
+static sb_char traceFileName[128];
+
+/** \brief Directory of the parsed firmware image cache, when specified with --cache. */
+static sb_char cacheDirName[128];
+
+/** \brief The way progress and results are output, JSON events when --json is given. */
+static tReportMode reportMode = REPORT_MODE_HUMAN;
+
+#if (XCP_STATS_ENABLE > 0)
+/** \brief Name of the file that the command statistics are written to, when specified
+ *         with -s.
+ */
+static sb_char statsFileName[128];
+#endif
 
 
 /************************************************************************************//**
@@ -85,155 +169,517 @@ static sb_char srecordFileName[128];
 ****************************************************************************************/
 sb_int32 main(sb_int32 argc, sb_char *argv[])
 {
-  sb_file hSrecord;
-  tSrecordParseResults fileParseResults;
-  tSrecordLineParseResults lineParseResults;
-
-  /* disable buffering for the standard output to make sure printf does not wait until
-   * a newline character is detected before outputting text on the console.
-   */
-  setbuf(stdout, SB_NULL);
-
-  /* inform user about the program */
-  DisplayProgramInfo();
+  sb_int32 result;
 
   /* start out by making sure program was started with the correct parameters */
   if (ParseCommandLine(argc, argv) == SB_FALSE)
   {
-    /* parameters invalid. inform user about how this program works */
+    /* parameters invalid. inform user about the program and how it works */
+    DisplayProgramInfo();
     DisplayProgramUsage();
     return PROG_RESULT_ERROR;
   }
 
+  /* all output from here on goes through the report module, which buffers the standard
+   * output and writes it once per event.
+   */
+  ReportInit(reportMode);
+  if (reportMode == REPORT_MODE_HUMAN)
+  {
+    /* inform user about the program */
+    DisplayProgramInfo();
+  }
+
+  /* -------------------- start recording the trace ---------------------------------- */
+  if ( (traceFileName[0] != '\0') && (XcpTraceOpen(traceFileName) == SB_FALSE) )
+  {
+    ReportMessage("Could not create trace file \"%s\"\n", traceFileName);
+    ReportResult(SB_FALSE);
+    return PROG_RESULT_ERROR;
+  }
+
   /* -------------------- start the firmware update procedure ------------------------ */
-  printf("Starting firmware update for \"%s\" using %s:%d\n", srecordFileName, deviceAddress, devicePort);
+  ReportStart(firmwareFileName, deviceAddress, devicePort, targetCnt);
+
+  /* -------------------- update the device(s) --------------------------------------- */
+  if (firmwareStream == SB_TRUE)
+  {
+    result = UpdateFromStream();
+  }
+  else
+  {
+    result = UpdateFromFile();
+  }
+
+#if (XCP_STATS_ENABLE > 0)
+  /* -------------------- output the command statistics ------------------------------ */
+  if (statsFileName[0] != '\0')
+  {
+    if (XcpStatsWriteJson(XcpStatsGetTotals(), statsFileName) == SB_TRUE)
+    {
+      ReportMessage("Command statistics written to \"%s\"\n", statsFileName);
+    }
+    else
+    {
+      ReportMessage("Could not write command statistics to \"%s\"\n", statsFileName);
+    }
+  }
+#endif
+  ReportResult((result == PROG_RESULT_OK) ? SB_TRUE : SB_FALSE);
+  XcpTraceClose();
+  return result;
+} /*** end of main ***/
+
 
-  /* -------------------- validating the S-record file ------------------------------- */
-  printf("Checking formatting of S-record file \"%s\"...", srecordFileName);
-  if (SrecordIsValid(srecordFileName) == SB_FALSE)
+/************************************************************************************//**
+** \brief     Loads the complete firmware file and performs the firmware update of the
+**            device(s) with it.
+** \return    0 if the device(s) were updated, > 0 on error.
+**
+****************************************************************************************/
+static sb_int32 UpdateFromFile(void)
+{
+  tFileMap firmwareFile;
+  tFirmwareFormat format;
+  tFirmwareCompression compression;
+  tSrecordParseResults fileParseResults;
+  tSrecordImage image;
+  tSrecordError parseError;
+  sb_uint64 cacheKey = 0;
+  sb_int32 result;
+  sb_uint8 parsed;
+  sb_uint8 useCache = SB_FALSE;
+  sb_uint8 cached = SB_FALSE;
+
+  /* -------------------- opening the firmware file --------------------------------- */
+  ReportPhaseStart(REPORT_PHASE_OPEN, "Opening firmware file \"%s\"...", firmwareFileName);
+  if (FileMapOpen(firmwareFileName, &firmwareFile) == SB_FALSE)
   {
-    printf("ERROR\n");
+    ReportPhaseEnd(SB_FALSE);
     return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
+  ReportPhaseEnd(SB_TRUE);
 
-  /* -------------------- opening the S-record file ---------------------------------- */
-  printf("Opening S-record file \"%s\"...", srecordFileName);
-  if ((hSrecord = SrecordOpen(srecordFileName)) == SB_NULL)
+  /* -------------------- parsing the firmware file --------------------------------- */
+  /* the file is parsed and validated completely before a device is touched. its format
+   * follows from its contents, except for a raw binary file. a compressed file is
+   * decompressed while it is parsed, so only the image is kept in memory.
+   */
+  compression = FirmwareDetectCompression(firmwareFile.data, firmwareFile.size);
+  if (compression != FIRMWARE_COMPRESSION_NONE)
   {
-    printf("ERROR\n");
+    FileMapClose(&firmwareFile);
+    ReportPhaseStart(REPORT_PHASE_PARSE, "Parsing %s compressed file \"%s\"...",
+                     FirmwareGetCompressionName(compression), firmwareFileName);
+    parsed = FirmwareStreamLoadImage(firmwareFileName, firmwareIsBinary, baseAddress,
+                                     &image, &fileParseResults, &parseError);
+    format = FirmwareStreamGetFormat();
+  }
+  else
+  {
+    if (firmwareIsBinary == SB_TRUE)
+    {
+      format = FIRMWARE_FORMAT_BINARY;
+    }
+    else
+    {
+      format = FirmwareDetectFormat(firmwareFile.data, firmwareFile.size);
+    }
+    ReportPhaseStart(REPORT_PHASE_PARSE, "Parsing %s file \"%s\"...",
+                     FirmwareGetFormatName(format), firmwareFileName);
+
+    /* a text file that was parsed before is loaded from the cache, which only takes
+     * hashing its contents. an ELF or raw binary file is already loaded as fast as
+     * that.
+     */
+    if ( (cacheDirName[0] != '\0') &&
+         ((format == FIRMWARE_FORMAT_SRECORD) || (format == FIRMWARE_FORMAT_IHEX)) )
+    {
+      useCache = SB_TRUE;
+      cacheKey = ImageCacheKey(firmwareFile.data, firmwareFile.size, format, baseAddress);
+      cached = ImageCacheLoad(cacheDirName, cacheKey, &image, &fileParseResults);
+    }
+    parsed = cached;
+    if (cached == SB_FALSE)
+    {
+      parsed = FirmwareParseImage(format, firmwareFile.data, firmwareFile.size,
+                                  baseAddress, &image, &fileParseResults, &parseError);
+    }
+    FileMapClose(&firmwareFile);
+  }
+  ReportPhaseEnd(parsed);
+  if (parsed == SB_FALSE)
+  {
+    ReportParseError(parseError.line, parseError.reason);
+    SrecordFreeImage(&image);
     return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
+  if (cached == SB_TRUE)
+  {
+    ReportMessage("Loaded the firmware image from the cache\n");
+  }
+  else if ( (useCache == SB_TRUE) &&
+            (ImageCacheStore(cacheDirName, cacheKey, &image) == SB_FALSE) )
+  {
+    ReportMessage("Could not write the firmware image to the cache in \"%s\"\n",
+                  cacheDirName);
+  }
+  ReportImage(FirmwareGetFormatName(format), &fileParseResults);
+
+  /* -------------------- update the device(s) --------------------------------------- */
+  if (targetCnt > 0)
+  {
+    result = UpdateTargets(&image, &fileParseResults);
+  }
+  else
+  {
+    result = UpdateDevice(&image, &fileParseResults);
+  }
+  SrecordFreeImage(&image);
+  return result;
+} /*** end of UpdateFromFile ***/
 
-  /* -------------------- parsing the S-record file ---------------------------------- */
-  printf("Parsing S-record file \"%s\"...", srecordFileName);
-  SrecordParse(hSrecord, &fileParseResults);
-  printf("OK\n");
-  printf("-> Lowest memory address:  0x%08x\n", fileParseResults.address_low);
-  printf("-> Highest memory address: 0x%08x\n", fileParseResults.address_high);
-  printf("-> Total data bytes: %u\n", fileParseResults.data_bytes_total);
+
+/************************************************************************************//**
+** \brief     Performs the firmware update of the device while the firmware file is
+**            read and parsed. Programming starts as soon as the first data was parsed,
+**            instead of after validating the whole file, so an error further on in the
+**            file is only found after part of it was programmed. The programming
+**            session is then not finished, which leaves the device in the bootloader.
+** \return    0 if the device was updated, > 0 on error.
+**
+****************************************************************************************/
+static sb_int32 UpdateFromStream(void)
+{
+  tSrecordParseResults fileParseResults;
+  tSrecordError parseError;
+  sb_int32 result;
+
+  /* -------------------- opening the firmware file --------------------------------- */
+  ReportPhaseStart(REPORT_PHASE_OPEN, "Opening firmware file \"%s\"...", firmwareFileName);
+  if (FirmwareStreamOpen(firmwareFileName, firmwareIsBinary, baseAddress,
+                         &parseError) == SB_FALSE)
+  {
+    if (parseError.reason == SB_NULL)
+    {
+      ReportPhaseEnd(SB_FALSE);
+    }
+    else
+    {
+      ReportPhaseFailedParsing(parseError.line, parseError.reason);
+    }
+    return PROG_RESULT_ERROR;
+  }
+  ReportPhaseEnd(SB_TRUE);
+
+  /* -------------------- update the device ------------------------------------------ */
+  /* the file is parsed on another thread while the connection is established */
+  result = UpdateDevice(SB_NULL, SB_NULL);
+  FirmwareStreamClose(&fileParseResults, &parseError);
+  return result;
+} /*** end of UpdateFromStream ***/
+
+
+/************************************************************************************//**
+** \brief     Performs the firmware update of the device that was specified with -d and
+**            -p.
+** \param     image Firmware image of the firmware file, or SB_NULL to program the
+**            firmware file that is streamed.
+** \param     fileParseResults Parsing results of the firmware file, or SB_NULL when it
+**            is streamed.
+** \return    0 if the device was updated, > 0 on error.
+**
+****************************************************************************************/
+static sb_int32 UpdateDevice(tSrecordImage *image, tSrecordParseResults *fileParseResults)
+{
+  sb_uint8 result;
 
   /* -------------------- Open the serial port --------------------------------------- */
-  printf("Connecting to %s...", deviceAddress);
-  if (XcpMasterInit(deviceAddress, devicePort) == SB_FALSE)
+  ReportPhaseStart(REPORT_PHASE_TCP_CONNECT, "Connecting to %s...", deviceAddress);
+  result = XcpMasterInit(&session, deviceAddress, devicePort, socketProfile, connectTimeoutMs);
+  ReportPhaseEnd(result);
+  if (result == SB_FALSE)
   {
-    printf("ERROR\n");
-    SrecordClose(hSrecord);
     return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
+  XcpMasterSetProgramWindow(&session, programWindow);
 
   /* -------------------- Connect to XCP slave --------------------------------------- */
-  printf("Connecting to bootloader...");
-  if (XcpMasterConnect() == SB_FALSE)
+  ReportPhaseStart(REPORT_PHASE_CONNECT, "Connecting to bootloader...");
+  if (XcpMasterConnect(&session) == SB_FALSE)
   {
     /* no response. prompt the user to reset the system */
-    printf("TIMEOUT\nReset your microcontroller...");
+    ReportMessage("TIMEOUT\nReset your microcontroller...");
   }
   /* now keep retrying until we get a response */
-  while (XcpMasterConnect() == SB_FALSE)
+  while (XcpMasterConnect(&session) == SB_FALSE)
   {
     /* delay a bit to not pump up the CPU load */
     TimeUtilDelayMs(20);
   }
-  printf("OK\n");
+  ReportPhaseEnd(SB_TRUE);
  
   /* -------------------- Prepare the programming session ---------------------------- */
-  printf("Initializing programming session...");
-  if (XcpMasterStartProgrammingSession() == SB_FALSE)
+  ReportPhaseStart(REPORT_PHASE_PROGRAM_START, "Initializing programming session...");
+  result = XcpMasterStartProgrammingSession(&session);
+  ReportPhaseEnd(result);
+  if (result == SB_FALSE)
   {
-    printf("ERROR\n");
-    XcpMasterDisconnect();
-    XcpMasterDeinit();
-    SrecordClose(hSrecord);
+    XcpMasterDisconnect(&session);
+    XcpMasterDeinit(&session);
     return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
 
-  /* -------------------- Erase memory ----------------------------------------------- */
-  printf("Erasing %u bytes starting at 0x%08x...", fileParseResults.data_bytes_total, fileParseResults.address_low);
-  if (XcpMasterClearMemory(fileParseResults.address_low, (fileParseResults.address_high - fileParseResults.address_low)) == SB_FALSE)
+  /* -------------------- Erase memory and program data ----------------------------- */
+  if (image == SB_NULL)
   {
-    printf("ERROR\n");
-    XcpMasterDisconnect();
-    XcpMasterDeinit();
-    SrecordClose(hSrecord);
-    return PROG_RESULT_ERROR;
+    result = ProgramStream();
   }
-  printf("OK\n");
-
-  /* -------------------- Program data ----------------------------------------------- */
-  printf("Programming data. Please wait...");
-  /* loop through all S-records with program data */
-  while (SrecordParseNextDataLine(hSrecord, &lineParseResults) == SB_TRUE)
+  else
   {
-    if (XcpMasterProgramData(lineParseResults.address, lineParseResults.length, lineParseResults.data) == SB_FALSE)
-    {
-      printf("ERROR\n");
-      XcpMasterDisconnect();
-      XcpMasterDeinit();
-      SrecordClose(hSrecord);
-      return PROG_RESULT_ERROR;
-    }
+    result = ProgramImage(image, fileParseResults);
+  }
+  if (result == SB_FALSE)
+  {
+    /* the programming session is not finished, so the device stays in the bootloader */
+    XcpMasterDisconnect(&session);
+    XcpMasterDeinit(&session);
+    return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
 
   /* -------------------- Stop the programming session ------------------------------- */
-  printf("Finishing programming session...");
-  if (XcpMasterStopProgrammingSession() == SB_FALSE)
+  ReportPhaseStart(REPORT_PHASE_PROGRAM_STOP, "Finishing programming session...");
+  result = XcpMasterStopProgrammingSession(&session);
+  ReportPhaseEnd(result);
+  if (result == SB_FALSE)
   {
-    printf("ERROR\n");
-    XcpMasterDisconnect();
-    XcpMasterDeinit();
-    SrecordClose(hSrecord);
+    XcpMasterDisconnect(&session);
+    XcpMasterDeinit(&session);
     return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
 
   /* -------------------- Disconnect from XCP slave and perform software reset ------- */
-  printf("Performing software reset...");
-  if (XcpMasterDisconnect() == SB_FALSE)
+  ReportPhaseStart(REPORT_PHASE_RESET, "Performing software reset...");
+  result = XcpMasterDisconnect(&session);
+  ReportPhaseEnd(result);
+  if (result == SB_FALSE)
   {
-    printf("ERROR\n");
-    XcpMasterDeinit();
-    SrecordClose(hSrecord);
+    XcpMasterDeinit(&session);
     return PROG_RESULT_ERROR;
   }
-  printf("OK\n");
 
   /* -------------------- close the serial port -------------------------------------- */
-  XcpMasterDeinit();
-  printf("Closing connection to %s\n", deviceAddress);
-
-  /* -------------------- close the S-record file ------------------------------------ */
-  SrecordClose(hSrecord);
-  printf("Closed S-record file \"%s\"\n", srecordFileName);
+  XcpMasterDeinit(&session);
+  ReportMessage("Closing connection to %s\n", deviceAddress);
+  ReportSessionStats(&session);
 
   /* all done */
-  printf("Firmware successfully updated!\n");
   return PROG_RESULT_OK;
-} /*** end of main ***/
+} /*** end of UpdateDevice ***/
+
+
+/************************************************************************************//**
+** \brief     Erases the memory of the device that the firmware image has data in and
+**            programs the data. When the sector size is known, only the sectors that
+**            the image has data in are erased, otherwise the memory from the lowest
+**            to the highest address.
+** \param     image Firmware image of the firmware file.
+** \param     fileParseResults Parsing results of the firmware file.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 ProgramImage(tSrecordImage *image, tSrecordParseResults *fileParseResults)
+{
+  tSrecordSegment *segment;
+  tSrecordRange range;
+  sb_uint32 segmentIdx;
+  sb_uint32 segmentOffset;
+  sb_uint32 chunkLen;
+  sb_uint32 bytesDone;
+  sb_uint8 result;
+
+  /* -------------------- Erase memory ----------------------------------------------- */
+  ReportPhaseStart(REPORT_PHASE_ERASE, "Erasing %u bytes starting at 0x%08x...", fileParseResults->data_bytes_total, fileParseResults->address_low);
+  if (sectorSize == 0)
+  {
+    result = XcpMasterClearMemory(&session, fileParseResults->address_low, (fileParseResults->address_high - fileParseResults->address_low));
+  }
+  else
+  {
+    /* one erase command for each run of adjacent sectors with data */
+    result = SB_TRUE;
+    segmentIdx = 0;
+    while (SrecordImageNextEraseRange(image, sectorSize, &segmentIdx, &range) == SB_TRUE)
+    {
+      if (XcpMasterClearMemory(&session, range.address, range.length) == SB_FALSE)
+      {
+        ReportPhaseFailedAt(range.address);
+        return SB_FALSE;
+      }
+    }
+  }
+  ReportPhaseEnd(result);
+  if (result == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+
+  /* -------------------- Program data ----------------------------------------------- */
+  ReportPhaseStart(REPORT_PHASE_PROGRAM, "Programming data. Please wait...");
+  bytesDone = 0;
+  /* loop through all contiguous segments of the firmware image */
+  for (segmentIdx=0; segmentIdx<image->segmentCnt; segmentIdx++)
+  {
+    segment = &image->segments[segmentIdx];
+    for (segmentOffset=0; segmentOffset<segment->length; segmentOffset+=chunkLen)
+    {
+      chunkLen = segment->length - segmentOffset;
+      if (chunkLen > PROGRAM_PROGRESS_CHUNK)
+      {
+        chunkLen = PROGRAM_PROGRESS_CHUNK;
+      }
+      if (XcpMasterProgramData(&session, segment->address + segmentOffset, chunkLen, &segment->data[segmentOffset]) == SB_FALSE)
+      {
+        ReportPhaseFailedAt(XcpMasterGetErrorAddress(&session));
+        return SB_FALSE;
+      }
+      bytesDone += chunkLen;
+      ReportProgress(bytesDone, fileParseResults->data_bytes_total);
+    }
+  }
+  ReportPhaseEnd(SB_TRUE);
+  return SB_TRUE;
+} /*** end of ProgramImage ***/
+
+
+/************************************************************************************//**
+** \brief     Programs the data of the firmware file that is streamed, one chunk at a
+**            time as it is parsed. The sectors that a chunk has data in are erased
+**            right before the chunk is programmed, unless they were erased for an
+**            earlier chunk already.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 ProgramStream(void)
+{
+  const tFirmwareStreamChunk *chunk;
+  tSrecordParseResults fileParseResults;
+  tSrecordError parseError;
+  sb_uint8 *erased;
+  sb_uint32 sector;
+  sb_uint32 lastSector;
+  sb_uint32 firstSector;
+  sb_uint32 bytesDone = 0;
+  sb_uint8 result = SB_TRUE;
+
+  ReportPhaseStart(REPORT_PHASE_PROGRAM, "Streaming data. Please wait...");
+  /* one bit for each sector of the 32-bit address space, set once it was erased */
+  erased = calloc((0xffffffffu / sectorSize) / 8 + 1, 1);
+  if (erased == SB_NULL)
+  {
+    ReportPhaseEnd(SB_FALSE);
+    return SB_FALSE;
+  }
+  while ( (result == SB_TRUE) && ((chunk = FirmwareStreamGet()) != SB_NULL) )
+  {
+    /* erase each run of sectors of the chunk that were not erased yet */
+    sector = chunk->address / sectorSize;
+    lastSector = (chunk->address + chunk->length - 1) / sectorSize;
+    while ( (result == SB_TRUE) && (sector <= lastSector) )
+    {
+      firstSector = sector;
+      while ( (sector <= lastSector) && ((erased[sector / 8] & (1 << (sector % 8))) == 0) )
+      {
+        erased[sector / 8] |= (sb_uint8)(1 << (sector % 8));
+        sector++;
+      }
+      if (sector > firstSector)
+      {
+        result = XcpMasterClearMemory(&session, firstSector * sectorSize,
+                                      (sector - firstSector) * sectorSize);
+        if (result == SB_FALSE)
+        {
+          ReportPhaseFailedAt(firstSector * sectorSize);
+        }
+      }
+      else
+      {
+        sector++;
+      }
+    }
+    /* program the data of the chunk */
+    if ( (result == SB_TRUE) &&
+         (XcpMasterProgramData(&session, chunk->address, chunk->length,
+                               (sb_uint8 *)chunk->data) == SB_FALSE) )
+    {
+      ReportPhaseFailedAt(XcpMasterGetErrorAddress(&session));
+      result = SB_FALSE;
+    }
+    if (result == SB_TRUE)
+    {
+      bytesDone += chunk->length;
+      ReportProgress(bytesDone, 0);
+      FirmwareStreamRelease();
+    }
+  }
+  free(erased);
+  if (result == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+
+  /* the end of the chunks is either the end of the file, or an error in it */
+  if (FirmwareStreamClose(&fileParseResults, &parseError) == SB_FALSE)
+  {
+    ReportPhaseFailedParsing(parseError.line, parseError.reason);
+    return SB_FALSE;
+  }
+  ReportPhaseEnd(SB_TRUE);
+  ReportImage(FirmwareGetFormatName(FirmwareStreamGetFormat()), &fileParseResults);
+  return SB_TRUE;
+} /*** end of ProgramStream ***/
+
+
+/************************************************************************************//**
+** \brief     Performs the firmware update of all devices that were specified with -t
+**            and outputs the result of each one.
+** \param     image Firmware image of the firmware file.
+** \param     fileParseResults Parsing results of the firmware file.
+** \return    0 if all devices were updated, > 0 on error.
+**
+****************************************************************************************/
+static sb_int32 UpdateTargets(tSrecordImage *image, tSrecordParseResults *fileParseResults)
+{
+  sb_uint32 idx;
+  sb_uint32 failedCnt = 0;
+  sb_uint32 startTime;
+
+  ReportPhaseStart(REPORT_PHASE_UPDATE_DEVICES, "Updating %u devices, %u at a time. Please wait...", targetCnt, maxConcurrent);
+  startTime = TimeUtilGetSystemTimeMs();
+  XcpEngineRun(targets, targetCnt, maxConcurrent, image, fileParseResults,
+               socketProfile, programWindow, connectTimeoutMs);
+  for (idx=0; idx<targetCnt; idx++)
+  {
+    if (targets[idx].result == SB_FALSE)
+    {
+      failedCnt++;
+    }
+  }
+  ReportPhaseEnd((failedCnt == 0) ? SB_TRUE : SB_FALSE);
+
+  /* -------------------- output the result of each device --------------------------- */
+  for (idx=0; idx<targetCnt; idx++)
+  {
+    ReportTarget(&targets[idx], (idx == 0) ? SB_TRUE : SB_FALSE);
+  }
+  ReportTargetsSummary(targetCnt - failedCnt, targetCnt, TimeUtilGetSystemTimeMs() - startTime);
+
+  if (failedCnt > 0)
+  {
+    return PROG_RESULT_ERROR;
+  }
+  return PROG_RESULT_OK;
+} /*** end of UpdateTargets ***/
 
 
 /************************************************************************************//**
@@ -258,19 +704,62 @@ static void DisplayProgramInfo(void)
 ****************************************************************************************/
 static void DisplayProgramUsage(void)
 {
-  printf("Usage:    openblt-tcp-boot -d[address] -p[port] [s-record file]\n\n");
+  printf("Usage:    openblt-tcp-boot -d[address] -p[port] [-w[window]] [-l] [-o[timeout]]\n");
+  printf("                           [-b[address]] [firmware file]\n");
+  printf("          openblt-tcp-boot -d[address] -p[port] -k[size] --stream [-w[window]]\n");
+  printf("                           [-l] [-o[timeout]] [-b[address]] [firmware file]\n");
+  printf("          openblt-tcp-boot -t[address:port] [-t...] [-c[count]] [-w[window]] [-l]\n");
+  printf("                           [-o[timeout]] [-b[address]] [firmware file]\n\n");
   printf("Example:  openblt-tcp-boot -d192.168.1.100 -p2101 myfirmware.srec\n");
   printf("          -> Connects to 192.168.1.100, port 2101, and programs the\n");
   printf("             myfirmware.srec file in non-volatile memory of the\n");
   printf("             microcontroller using OpenBLT.\n");
+  printf("          The firmware file is a Motorola S-record, Intel HEX or ELF file,\n");
+  printf("          which is detected from its contents, or a raw binary file. It\n");
+  printf("          can be compressed with gzip, xz or zstd.\n");
+  printf("Options:  -w[window] keeps up to [window] program commands in flight\n");
+  printf("             (1..%d). Default is 1, which waits for each response.\n", XCP_MASTER_PROGRAM_WINDOW_MAX);
+  printf("          -l uses the low latency socket profile for the TCP connection.\n");
+  printf("          -o[timeout] gives up connecting after [timeout] milliseconds.\n");
+  printf("             Default is %d.\n", XCP_TRANSPORT_CONNECT_TIMEOUT_MS);
+  printf("          -t[address:port] adds a device to update. Can be repeated to update\n");
+  printf("             up to %d devices concurrently. IPv6 addresses are written\n", MAX_TARGETS);
+  printf("             in brackets, such as -t[fd00::1]:2101.\n");
+  printf("          -c[count] updates at most [count] of the -t devices at the same\n");
+  printf("             time. Default is %d.\n", DEFAULT_CONCURRENCY);
+  printf("          -b[address] programs the firmware file as raw binary data, starting\n");
+  printf("             at the hexadecimal [address], such as -b08000000.\n");
+  printf("          --stream programs the data while the firmware file is parsed,\n");
+  printf("             erasing the sectors on demand. The file is not validated\n");
+  printf("             before programming starts. Implied when the firmware file\n");
+  printf("             is - to read it from the standard input. Not with -t.\n");
+  printf("          -k[size] is the size in bytes of the largest sector of the device,\n");
+  printf("             a power of two of at least %d. Only the sectors with data\n", SECTOR_SIZE_MIN);
+  printf("             are erased. Required with --stream.\n");
+  printf("          --trace [file] records a timeline of the phases and commands in\n");
+  printf("             Chrome trace event format, for viewing in Perfetto.\n");
+  printf("          --cache [dir] keeps the parsed firmware image in the existing\n");
+  printf("             directory [dir], to skip parsing the same file next time.\n");
+  printf("          --json outputs the progress and the result as newline delimited\n");
+  printf("             JSON events.\n");
+#if (XCP_STATS_ENABLE > 0)
+  printf("          -s[file] writes statistics of each type of command to [file]\n");
+  printf("             in JSON format.\n");
+#endif
   printf("-------------------------------------------------------------------------\n");
 } /*** end of DisplayProgramUsage ***/
 
 
 /************************************************************************************//**
-** \brief     Parses the command line arguments. A fixed amount of arguments is expected.
-**            The program should be called as: 
-**              openblt-tcp-boot -d[address] -p[port] [s-record file]
+** \brief     Parses the command line arguments. The program should be called as:
+**              openblt-tcp-boot -d[address] -p[port] [-w[window]] [-l] [-o[timeout]]
+**                               [-b[address]] [firmware file]
+**            or, to program the firmware file while it is parsed, as:
+**              openblt-tcp-boot -d[address] -p[port] -k[size] --stream [-w[window]]
+**                               [-l] [-o[timeout]] [-b[address]] [firmware file]
+**            or, to update several devices concurrently, as:
+**              openblt-tcp-boot -t[address:port] [-t...] [-c[count]] [-w[window]] [-l]
+**                               [-o[timeout]] [-b[address]] [firmware file]
 ** \param     argc Number of program parameters.
 ** \param     argv array to program parameter strings.
 ** \return    SB_TRUE on success, SB_FALSE otherwise.
@@ -278,13 +767,29 @@ static void DisplayProgramUsage(void)
 ****************************************************************************************/
 static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[])
 {
-  sb_uint8 paramIdx;
+  sb_int32 paramIdx;
   sb_uint8 paramDfound = SB_FALSE;
   sb_uint8 paramPfound = SB_FALSE;
-  sb_uint8 srecordfound = SB_FALSE;
+  sb_uint8 paramWfound = SB_FALSE;
+  sb_uint8 paramLfound = SB_FALSE;
+  sb_uint8 paramCfound = SB_FALSE;
+  sb_uint8 paramOfound = SB_FALSE;
+  sb_uint8 paramBfound = SB_FALSE;
+  sb_uint8 paramTraceFound = SB_FALSE;
+  sb_uint8 paramCacheFound = SB_FALSE;
+  sb_uint8 paramJsonFound = SB_FALSE;
+  sb_uint8 paramStreamFound = SB_FALSE;
+  sb_uint8 paramKfound = SB_FALSE;
+#if (XCP_STATS_ENABLE > 0)
+  sb_uint8 paramSfound = SB_FALSE;
+#endif
+  sb_uint8 firmwarefound = SB_FALSE;
+  sb_char *addressPtr;
+  sb_char *portPtr;
+  sb_uint32 addressLen;
 
   /* make sure the right amount of arguments are given */
-  if (argc != 4)
+  if (argc < 3)
   {
     return SB_FALSE;
   }
@@ -294,10 +799,52 @@ static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[])
    */
   for (paramIdx=1; paramIdx<argc; paramIdx++)
   {
+    /* is this the trace file? it has a separate value, like the cache directory */
+    if ( (strcmp(argv[paramIdx], "--trace") == 0) && (paramTraceFound == SB_FALSE) )
+    {
+      /* copy the file name and set flag that this parameter was found */
+      paramIdx++;
+      if ( (paramIdx >= argc) || (strlen(argv[paramIdx]) >= sizeof(traceFileName)) )
+      {
+        return SB_FALSE;
+      }
+      strcpy(traceFileName, argv[paramIdx]);
+      paramTraceFound = SB_TRUE;
+    }
+    /* is this the cache directory? */
+    else if ( (strcmp(argv[paramIdx], "--cache") == 0) && (paramCacheFound == SB_FALSE) )
+    {
+      /* copy the directory name and set flag that this parameter was found */
+      paramIdx++;
+      if ( (paramIdx >= argc) || (strlen(argv[paramIdx]) >= sizeof(cacheDirName)) )
+      {
+        return SB_FALSE;
+      }
+      strcpy(cacheDirName, argv[paramIdx]);
+      paramCacheFound = SB_TRUE;
+    }
+    /* is this the JSON output? */
+    else if ( (strcmp(argv[paramIdx], "--json") == 0) && (paramJsonFound == SB_FALSE) )
+    {
+      /* select the JSON events and set flag that this parameter was found */
+      reportMode = REPORT_MODE_JSON;
+      paramJsonFound = SB_TRUE;
+    }
+    /* is this the streaming of the firmware file? */
+    else if ( (strcmp(argv[paramIdx], "--stream") == 0) && (paramStreamFound == SB_FALSE) )
+    {
+      /* select the streaming and set flag that this parameter was found */
+      firmwareStream = SB_TRUE;
+      paramStreamFound = SB_TRUE;
+    }
     /* is this the device address? */
-    if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'd') && (paramDfound == SB_FALSE) )
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'd') && (paramDfound == SB_FALSE) )
     {
       /* copy the device name and set flag that this parameter was found */
+      if (strlen(&argv[paramIdx][2]) >= sizeof(deviceAddress))
+      {
+        return SB_FALSE;
+      }
       strcpy(deviceAddress, &argv[paramIdx][2]);
       paramDfound = SB_TRUE;
     }
@@ -308,17 +855,140 @@ static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[])
       sscanf(&argv[paramIdx][2], "%u", &devicePort);
       paramPfound = SB_TRUE;
     }
+    /* is this the program window? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'w') && (paramWfound == SB_FALSE) )
+    {
+      /* extract the window size and set flag that this parameter was found */
+      sscanf(&argv[paramIdx][2], "%u", &programWindow);
+      if ( (programWindow < 1) || (programWindow > XCP_MASTER_PROGRAM_WINDOW_MAX) )
+      {
+        return SB_FALSE;
+      }
+      paramWfound = SB_TRUE;
+    }
+    /* is this the low latency socket profile? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'l') && (paramLfound == SB_FALSE) )
+    {
+      /* select the profile and set flag that this parameter was found */
+      socketProfile = XCP_TRANSPORT_PROFILE_LOW_LATENCY;
+      paramLfound = SB_TRUE;
+    }
+    /* is this a device to update concurrently? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 't') )
+    {
+      /* split the address and the port and add the device */
+      addressPtr = &argv[paramIdx][2];
+      portPtr = strrchr(addressPtr, ':');
+      if ( (targetCnt >= MAX_TARGETS) || (portPtr == SB_NULL) )
+      {
+        return SB_FALSE;
+      }
+      addressLen = portPtr - addressPtr;
+      /* strip the brackets around an IPv6 address */
+      if ( (addressLen >= 2) && (addressPtr[0] == '[') && (addressPtr[addressLen - 1] == ']') )
+      {
+        addressPtr++;
+        addressLen -= 2;
+      }
+      if ( (addressLen == 0) || (addressLen >= XCP_ENGINE_ADDRESS_MAX_LEN) )
+      {
+        return SB_FALSE;
+      }
+      memcpy(targets[targetCnt].address, addressPtr, addressLen);
+      targets[targetCnt].address[addressLen] = '\0';
+      if (sscanf(portPtr + 1, "%u", &targets[targetCnt].port) != 1)
+      {
+        return SB_FALSE;
+      }
+      targetCnt++;
+    }
+    /* is this the concurrency? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'c') && (paramCfound == SB_FALSE) )
+    {
+      /* extract the concurrency and set flag that this parameter was found */
+      sscanf(&argv[paramIdx][2], "%u", &maxConcurrent);
+      if (maxConcurrent < 1)
+      {
+        return SB_FALSE;
+      }
+      paramCfound = SB_TRUE;
+    }
+    /* is this the connect timeout? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'o') && (paramOfound == SB_FALSE) )
+    {
+      /* extract the timeout and set flag that this parameter was found */
+      sscanf(&argv[paramIdx][2], "%u", &connectTimeoutMs);
+      if (connectTimeoutMs < 1)
+      {
+        return SB_FALSE;
+      }
+      paramOfound = SB_TRUE;
+    }
+    /* is this the base address of a raw binary file? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'b') && (paramBfound == SB_FALSE) )
+    {
+      /* extract the address and set flag that this parameter was found */
+      if (sscanf(&argv[paramIdx][2], "%x", &baseAddress) != 1)
+      {
+        return SB_FALSE;
+      }
+      firmwareIsBinary = SB_TRUE;
+      paramBfound = SB_TRUE;
+    }
+    /* is this the sector size? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 'k') && (paramKfound == SB_FALSE) )
+    {
+      /* extract the sector size and set flag that this parameter was found */
+      if ( (sscanf(&argv[paramIdx][2], "%u", &sectorSize) != 1) ||
+           (sectorSize < SECTOR_SIZE_MIN) || ((sectorSize & (sectorSize - 1)) != 0) )
+      {
+        return SB_FALSE;
+      }
+      paramKfound = SB_TRUE;
+    }
+#if (XCP_STATS_ENABLE > 0)
+    /* is this the command statistics file? */
+    else if ( (argv[paramIdx][0] == '-') && (argv[paramIdx][1] == 's') && (paramSfound == SB_FALSE) )
+    {
+      /* copy the file name and set flag that this parameter was found */
+      if ( (strlen(&argv[paramIdx][2]) == 0) || (strlen(&argv[paramIdx][2]) >= sizeof(statsFileName)) )
+      {
+        return SB_FALSE;
+      }
+      strcpy(statsFileName, &argv[paramIdx][2]);
+      paramSfound = SB_TRUE;
+    }
+#endif
     /* still here so it must be the filename */
-    else if (srecordfound == SB_FALSE)
+    else if (firmwarefound == SB_FALSE)
     {
       /* copy the file name and set flag that this parameter was found */
-      strcpy(srecordFileName, &argv[paramIdx][0]);
-      srecordfound = SB_TRUE;
+      if (strlen(argv[paramIdx]) >= sizeof(firmwareFileName))
+      {
+        return SB_FALSE;
+      }
+      strcpy(firmwareFileName, &argv[paramIdx][0]);
+      firmwarefound = SB_TRUE;
     }
   }
   
-  /* verify if all parameters were found */
-  if ( (paramDfound == SB_FALSE) || (paramPfound == SB_FALSE) || (srecordfound == SB_FALSE) )
+  /* verify if all parameters were found. the device is either specified with -d and
+   * -p, or with one or more -t parameters.
+   */
+  if ( (firmwarefound == SB_FALSE) ||
+       ((targetCnt == 0) && ((paramDfound == SB_FALSE) || (paramPfound == SB_FALSE))) )
+  {
+    return SB_FALSE;
+  }
+
+  /* the standard input can only be streamed. streaming programs a single device and
+   * needs to know the sectors to erase them on demand.
+   */
+  if (strcmp(firmwareFileName, "-") == 0)
+  {
+    firmwareStream = SB_TRUE;
+  }
+  if ( (firmwareStream == SB_TRUE) && ((targetCnt > 0) || (paramKfound == SB_FALSE)) )
   {
     return SB_FALSE;
   }
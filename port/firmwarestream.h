@@ -0,0 +1,111 @@
+/************************************************************************************//**
+* \file         port\firmwarestream.h
+* \brief        Streaming firmware file parser header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+#ifndef FIRMWARESTREAM_H
+#define FIRMWARESTREAM_H
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "srecord.h"                                  /* S-record file handling        */
+#include "firmware.h"                                 /* firmware file loading         */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Decompress gzip files with zlib. Enabled by the build when zlib is found. */
+#ifndef FIRMWARE_STREAM_GZIP_ENABLE
+#define FIRMWARE_STREAM_GZIP_ENABLE    (0)
+#endif
+
+/** \brief Decompress xz files with liblzma. Enabled by the build when liblzma is found. */
+#ifndef FIRMWARE_STREAM_XZ_ENABLE
+#define FIRMWARE_STREAM_XZ_ENABLE      (0)
+#endif
+
+/** \brief Decompress Zstandard files with libzstd. Enabled by the build when libzstd is
+ *         found.
+ */
+#ifndef FIRMWARE_STREAM_ZSTD_ENABLE
+#define FIRMWARE_STREAM_ZSTD_ENABLE    (0)
+#endif
+
+/** \brief Maximum number of data bytes in a chunk. */
+#define FIRMWARE_STREAM_CHUNK_SIZE     (64*1024)
+
+/** \brief Number of chunks that the queue holds. Together with the read buffer, this
+ *         bounds the memory that streaming a file takes, whatever its size.
+ */
+#define FIRMWARE_STREAM_QUEUE_LEN      (8)
+
+/** \brief Number of bytes that are read from the file at a time. Also the maximum
+ *         length of a line.
+ */
+#define FIRMWARE_STREAM_READ_SIZE      (64*1024)
+
+/** \brief Maximum memory in bytes that the xz decoder may use. Enough for files that
+ *         were compressed with the highest preset, xz -9.
+ */
+#define FIRMWARE_STREAM_XZ_MEMLIMIT    (128*1024*1024)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for a chunk of contiguous data that is ready to be programmed. */
+typedef struct
+{
+  sb_uint32 address;                              /**< memory address of the data      */
+  sb_uint32 length;                               /**< number of data bytes            */
+  sb_uint32 line;                                 /**< line of its first record, or 0  */
+  sb_uint8 data[FIRMWARE_STREAM_CHUNK_SIZE];      /**< the data bytes                  */
+} tFirmwareStreamChunk;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint8 FirmwareStreamOpen(const sb_char *fileName, sb_uint8 isBinary,
+                            sb_uint32 baseAddress, tSrecordError *error);
+tFirmwareFormat FirmwareStreamGetFormat(void);
+const tFirmwareStreamChunk *FirmwareStreamGet(void);
+void     FirmwareStreamRelease(void);
+sb_uint8 FirmwareStreamClose(tSrecordParseResults *parseResults, tSrecordError *error);
+sb_uint8 FirmwareStreamLoadImage(const sb_char *fileName, sb_uint8 isBinary,
+                                 sb_uint32 baseAddress, tSrecordImage *image,
+                                 tSrecordParseResults *parseResults,
+                                 tSrecordError *error);
+
+
+#endif /* FIRMWARESTREAM_H */
+/*********************************** end of firmwarestream.h ***************************/
@@ -0,0 +1,111 @@
+/************************************************************************************//**
+* \file         port\linux\filemap.c
+* \brief        Read-only file mapping source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <unistd.h>                                   /* UNIX standard functions       */
+#include <fcntl.h>                                    /* file control definitions      */
+#include <sys/mman.h>                                 /* memory mapping                */
+#include <sys/stat.h>                                 /* file status                   */
+#include "filemap.h"                                  /* read-only file mapping        */
+
+
+/************************************************************************************//**
+** \brief     Maps the contents of a file into memory for reading. The file is read by
+**            the kernel on demand, without copying it into a buffer first. The
+**            mapping is advised for sequential access.
+** \param     fileName Name of the file.
+** \param     fileMap Pointer to where the mapping is stored.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 FileMapOpen(const sb_char *fileName, tFileMap *fileMap)
+{
+  struct stat fileStat;
+  void *data;
+  sb_int32 fd;
+
+  fileMap->data = SB_NULL;
+  fileMap->size = 0;
+  fd = open((const char *)fileName, O_RDONLY);
+  if (fd < 0)
+  {
+    return SB_FALSE;
+  }
+  /* only regular files can be mapped. the size is limited to 32 bits */
+  if ( (fstat(fd, &fileStat) < 0) || (S_ISREG(fileStat.st_mode) == 0) ||
+       (fileStat.st_size > 0xffffffffll) )
+  {
+    close(fd);
+    return SB_FALSE;
+  }
+  /* an empty file cannot be mapped, but it is a valid file */
+  if (fileStat.st_size > 0)
+  {
+    data = mmap(SB_NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      close(fd);
+      return SB_FALSE;
+    }
+    madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+    fileMap->data = data;
+    fileMap->size = (sb_uint32)fileStat.st_size;
+  }
+  /* the mapping stays valid after the file is closed */
+  close(fd);
+  return SB_TRUE;
+} /*** end of FileMapOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Unmaps a file that was mapped with FileMapOpen().
+** \param     fileMap The mapping.
+** \return    none.
+**
+****************************************************************************************/
+void FileMapClose(tFileMap *fileMap)
+{
+  if (fileMap->data != SB_NULL)
+  {
+    munmap((void *)fileMap->data, fileMap->size);
+  }
+  fileMap->data = SB_NULL;
+  fileMap->size = 0;
+} /*** end of FileMapClose ***/
+
+
+/*********************************** end of filemap.c **********************************/
@@ -0,0 +1,1130 @@
+/************************************************************************************//**
+* \file         port\linux\firmwarestream.c
+* \brief        Streaming firmware file parser source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* string library                */
+#include <errno.h>                                    /* error numbers                 */
+#include <fcntl.h>                                    /* file control options          */
+#include <unistd.h>                                   /* UNIX standard functions       */
+#include <poll.h>                                     /* waiting for file descriptors  */
+#include <pthread.h>                                  /* POSIX threads                 */
+#include "firmwarestream.h"                           /* streaming firmware parser     */
+#include "ihex.h"                                     /* Intel HEX library             */
+#include "hexdecode.h"                                /* hexadecimal decoding          */
+#if (FIRMWARE_STREAM_GZIP_ENABLE > 0)
+#include <zlib.h>                                     /* gzip decompression            */
+#endif
+#if (FIRMWARE_STREAM_XZ_ENABLE > 0)
+#include <lzma.h>                                     /* xz decompression              */
+#endif
+#if (FIRMWARE_STREAM_ZSTD_ENABLE > 0)
+#include <zstd.h>                                     /* Zstandard decompression       */
+#endif
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of data bytes on a line of an S-record or Intel HEX file. The
+ *         parsed data is moved to the queue before the next line could overflow a
+ *         chunk.
+ */
+#define FIRMWARE_STREAM_LINE_DATA_MAX  (256)
+
+/** \brief Number of bytes that are read at least to detect the format of the file. */
+#define FIRMWARE_STREAM_DETECT_SIZE    (4)
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void    *FirmwareStreamThreadMain(void *arg);
+static const sb_char *FirmwareStreamParseLines(sb_uint8 endOfFile);
+static const sb_char *FirmwareStreamAddBinary(void);
+static const sb_char *FirmwareStreamFlush(void);
+static const sb_char *FirmwareStreamPut(sb_uint32 address, const sb_uint8 *data,
+                                        sb_uint32 length, sb_uint32 line);
+static sb_int32 FirmwareStreamRead(sb_char *buffer, sb_uint32 size);
+static sb_int32 FirmwareStreamReadFile(sb_char *buffer, sb_uint32 size);
+static const sb_char *FirmwareStreamDecoderInit(void);
+static sb_int32 FirmwareStreamDecode(sb_char *buffer, sb_uint32 size);
+static void     FirmwareStreamCloseFile(void);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief SB_TRUE while a file is streamed, from FirmwareStreamOpen() until
+ *         FirmwareStreamClose().
+ */
+static sb_uint8 streamOpen = SB_FALSE;
+
+/** \brief File descriptor of the file, or of the standard input. */
+static int streamFd = -1;
+
+/** \brief Pipe that wakes up the thread when it waits for more of the file. Closing its
+ *         write end stops the reading, such as of a pipe that no data comes from.
+ */
+static int streamWakePipe[2] = { -1, -1 };
+
+/** \brief Format of the file. */
+static tFirmwareFormat streamFormat;
+
+/** \brief Compression format of the file. */
+static tFirmwareCompression streamCompression;
+
+/** \brief Bytes that were read from a compressed file, but not decompressed yet. Of an
+ *         uncompressed file, only the bytes that were read to detect the compression.
+ */
+static sb_char streamInput[FIRMWARE_STREAM_READ_SIZE];
+
+/** \brief Number of bytes in the input buffer. */
+static sb_uint32 streamInputLen;
+
+/** \brief Index of the first byte in the input buffer that was not used yet. */
+static sb_uint32 streamInputPos;
+
+/** \brief SB_TRUE when the end of the file was read into the input buffer. */
+static sb_uint8 streamInputEof;
+
+/** \brief SB_TRUE when the decoder reached the end of the compressed data. More
+ *         compressed data can follow, as gzip, xz and Zstandard files may be
+ *         concatenated.
+ */
+static sb_uint8 streamDecoderEnd;
+
+/** \brief Reason that reading the file failed, if it did. */
+static const sb_char *streamReadReason;
+
+#if (FIRMWARE_STREAM_GZIP_ENABLE > 0)
+/** \brief State of the gzip decoder. */
+static z_stream streamZlib;
+#endif
+
+#if (FIRMWARE_STREAM_XZ_ENABLE > 0)
+/** \brief State of the xz decoder. */
+static lzma_stream streamLzma = LZMA_STREAM_INIT;
+#endif
+
+#if (FIRMWARE_STREAM_ZSTD_ENABLE > 0)
+/** \brief State of the Zstandard decoder. */
+static ZSTD_DStream *streamZstd;
+#endif
+
+/** \brief Memory address of the data that is read next from a raw binary file. */
+static sb_uint32 streamBinaryAddress;
+
+/** \brief Thread that reads and parses the file. */
+static pthread_t streamThread;
+
+/** \brief Protects the queue and the state that the threads share. */
+static pthread_mutex_t streamMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief Signaled when a chunk was added to the queue or the parsing ended. */
+static pthread_cond_t streamNotEmpty = PTHREAD_COND_INITIALIZER;
+
+/** \brief Signaled when a chunk was released or the streaming is stopped. */
+static pthread_cond_t streamNotFull = PTHREAD_COND_INITIALIZER;
+
+/** \brief Queue of chunks that are ready to be programmed. The chunk at the head stays
+ *         in the queue until it is released, so it is never overwritten while in use.
+ */
+static tFirmwareStreamChunk streamQueue[FIRMWARE_STREAM_QUEUE_LEN];
+
+/** \brief Index of the oldest chunk in the queue. */
+static sb_uint32 streamHead;
+
+/** \brief Number of chunks in the queue. */
+static sb_uint32 streamCount;
+
+/** \brief SB_TRUE when the parsing ended, after which no chunks are added anymore. */
+static sb_uint8 streamDone;
+
+/** \brief SB_TRUE when the streaming is stopped before the end of the file. */
+static sb_uint8 streamAbort;
+
+/** \brief Characters that were read from the file but not parsed yet. They start at
+ *         the beginning of a line.
+ */
+static sb_char streamBuffer[FIRMWARE_STREAM_READ_SIZE];
+
+/** \brief Number of characters in the buffer. */
+static sb_uint32 streamBufferLen;
+
+/** \brief SB_TRUE when the end of the file was read. */
+static sb_uint8 streamEndOfFile;
+
+/** \brief Number of the last line that was parsed. */
+static sb_uint32 streamLineNumber;
+
+/** \brief Data of the lines that were parsed, but not added to the queue yet. */
+static tSrecordImage streamImage;
+
+/** \brief Memory ranges of the data that was added to the queue, which detects data
+ *         that overlaps data of earlier lines before it is programmed.
+ */
+static tSrecordImage streamIndex;
+
+/** \brief State of the Intel HEX parser, which carries over from one line to the next. */
+static tIhexParser streamIhexParser;
+
+/** \brief Parse results of the data that was added to the queue. */
+static tSrecordParseResults streamResults;
+
+/** \brief Reason that the parsing failed, if it did. */
+static tSrecordError streamError;
+
+
+/************************************************************************************//**
+** \brief     Opens a firmware file and starts parsing it on a thread of its own. The
+**            data is handed out in chunks with FirmwareStreamGet() while the file is
+**            still being read and parsed, so the programming can start right away.
+**            The file can be a pipe, which is read until its end. A gzip, xz or
+**            Zstandard compressed file is decompressed while it is read, without
+**            storing the decompressed contents. Only one file can be streamed at a
+**            time.
+** \param     fileName Name of the file, or "-" for the standard input.
+** \param     isBinary SB_TRUE to stream the file as raw binary data, otherwise its
+**            format is detected from its contents. An ELF file cannot be streamed.
+** \param     baseAddress Memory address of a raw binary file.
+** \param     error Pointer to where the reason is stored when the file is not
+**            accepted. The reason is SB_NULL when the file could not be opened.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 FirmwareStreamOpen(const sb_char *fileName, sb_uint8 isBinary,
+                            sb_uint32 baseAddress, tSrecordError *error)
+{
+  sb_int32 readLen;
+  sb_uint32 idx;
+  sb_uint8 detected = SB_FALSE;
+
+  assert(streamOpen == SB_FALSE);
+
+  error->line = 0;
+  error->reason = SB_NULL;
+  streamCompression = FIRMWARE_COMPRESSION_NONE;
+  streamFd = (strcmp(fileName, "-") == 0) ? STDIN_FILENO : open(fileName, O_RDONLY);
+  if (streamFd < 0)
+  {
+    return SB_FALSE;
+  }
+  if (pipe(streamWakePipe) != 0)
+  {
+    error->reason = "could not create a pipe";
+    FirmwareStreamCloseFile();
+    return SB_FALSE;
+  }
+
+  /* read the start of the file, which tells whether it is compressed */
+  streamInputLen = 0;
+  streamInputPos = 0;
+  streamInputEof = SB_FALSE;
+  while ( (streamInputEof == SB_FALSE) &&
+          (streamInputLen < FIRMWARE_COMPRESSION_MAGIC_SIZE) )
+  {
+    readLen = FirmwareStreamReadFile(&streamInput[streamInputLen],
+                                     sizeof(streamInput) - streamInputLen);
+    if (readLen < 0)
+    {
+      error->reason = "could not read the file";
+      FirmwareStreamCloseFile();
+      return SB_FALSE;
+    }
+    streamInputEof = (readLen == 0) ? SB_TRUE : SB_FALSE;
+    streamInputLen += readLen;
+  }
+  streamCompression = FirmwareDetectCompression(streamInput, streamInputLen);
+  error->reason = FirmwareStreamDecoderInit();
+  if (error->reason != SB_NULL)
+  {
+    FirmwareStreamCloseFile();
+    return SB_FALSE;
+  }
+
+  /* read the start of the file, up to the first character that is not white space,
+   * which is enough to detect the format.
+   */
+  streamBufferLen = 0;
+  streamEndOfFile = SB_FALSE;
+  while ( (detected == SB_FALSE) && (streamEndOfFile == SB_FALSE) &&
+          (streamBufferLen < sizeof(streamBuffer)) )
+  {
+    readLen = FirmwareStreamRead(&streamBuffer[streamBufferLen],
+                                 sizeof(streamBuffer) - streamBufferLen);
+    if (readLen < 0)
+    {
+      error->reason = streamReadReason;
+      break;
+    }
+    streamEndOfFile = (readLen == 0) ? SB_TRUE : SB_FALSE;
+    streamBufferLen += readLen;
+    for (idx=0; (idx<streamBufferLen) && (streamBufferLen >= FIRMWARE_STREAM_DETECT_SIZE); idx++)
+    {
+      if ( (streamBuffer[idx] != ' ') && (streamBuffer[idx] != '\t') &&
+           (streamBuffer[idx] != '\r') && (streamBuffer[idx] != '\n') )
+      {
+        detected = SB_TRUE;
+        break;
+      }
+    }
+  }
+  if ( (error->reason == SB_NULL) && (streamBufferLen == 0) )
+  {
+    error->reason = "the file is empty";
+  }
+  streamFormat = (isBinary == SB_TRUE) ? FIRMWARE_FORMAT_BINARY :
+                 FirmwareDetectFormat(streamBuffer, streamBufferLen);
+  if ( (error->reason == SB_NULL) && (streamFormat == FIRMWARE_FORMAT_ELF) )
+  {
+    error->reason = "an ELF file cannot be streamed or compressed";
+  }
+  if (error->reason != SB_NULL)
+  {
+    FirmwareStreamCloseFile();
+    return SB_FALSE;
+  }
+
+  /* start parsing on a thread of its own */
+  memset(&streamImage, 0, sizeof(streamImage));
+  memset(&streamIndex, 0, sizeof(streamIndex));
+  IhexParserInit(&streamIhexParser, &streamImage);
+  streamBinaryAddress = baseAddress;
+  streamLineNumber = 0;
+  streamResults.address_high = 0;
+  streamResults.address_low = 0xffffffff;
+  streamResults.data_bytes_total = 0;
+  streamResults.segment_count = 0;
+  streamError.line = 0;
+  streamError.reason = SB_NULL;
+  streamHead = 0;
+  streamCount = 0;
+  streamDone = SB_FALSE;
+  streamAbort = SB_FALSE;
+  /* select the hexadecimal decoder before the thread uses it */
+  HexDecodeGetImpl();
+  if (pthread_create(&streamThread, SB_NULL, FirmwareStreamThreadMain, SB_NULL) != 0)
+  {
+    error->reason = "could not start the parser thread";
+    FirmwareStreamCloseFile();
+    return SB_FALSE;
+  }
+  streamOpen = SB_TRUE;
+  return SB_TRUE;
+} /*** end of FirmwareStreamOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the format of the file that is streamed.
+** \return    The format.
+**
+****************************************************************************************/
+tFirmwareFormat FirmwareStreamGetFormat(void)
+{
+  return streamFormat;
+} /*** end of FirmwareStreamGetFormat ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the next chunk of data, in the order of the file. Waits until the
+**            chunk was parsed. The chunk must be released with FirmwareStreamRelease()
+**            before the next one is obtained.
+** \return    The chunk, or SB_NULL at the end of the file or when the parsing failed.
+**            FirmwareStreamClose() tells which of the two it is.
+**
+****************************************************************************************/
+const tFirmwareStreamChunk *FirmwareStreamGet(void)
+{
+  const tFirmwareStreamChunk *chunk = SB_NULL;
+
+  assert(streamOpen == SB_TRUE);
+
+  pthread_mutex_lock(&streamMutex);
+  while ( (streamCount == 0) && (streamDone == SB_FALSE) )
+  {
+    pthread_cond_wait(&streamNotEmpty, &streamMutex);
+  }
+  /* once the file turned out to be invalid, there is no point in programming more */
+  if ( (streamCount > 0) && (streamError.reason == SB_NULL) )
+  {
+    chunk = &streamQueue[streamHead];
+  }
+  pthread_mutex_unlock(&streamMutex);
+  return chunk;
+} /*** end of FirmwareStreamGet ***/
+
+
+/************************************************************************************//**
+** \brief     Releases the chunk that was obtained with FirmwareStreamGet(), which makes
+**            room in the queue for the parser.
+** \return    none.
+**
+****************************************************************************************/
+void FirmwareStreamRelease(void)
+{
+  pthread_mutex_lock(&streamMutex);
+  assert(streamCount > 0);
+  streamHead = (streamHead + 1) % FIRMWARE_STREAM_QUEUE_LEN;
+  streamCount--;
+  pthread_cond_signal(&streamNotFull);
+  pthread_mutex_unlock(&streamMutex);
+} /*** end of FirmwareStreamRelease ***/
+
+
+/************************************************************************************//**
+** \brief     Stops streaming the file, also when not all chunks were obtained yet, and
+**            waits for the parser thread to end. Can be called more than once.
+** \param     parseResults Pointer to where the parse results of the data that was
+**            parsed are stored.
+** \param     error Pointer to where the reason is stored when the parsing failed.
+** \return    SB_TRUE if the whole file was parsed without errors, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 FirmwareStreamClose(tSrecordParseResults *parseResults, tSrecordError *error)
+{
+  if (streamOpen == SB_TRUE)
+  {
+    pthread_mutex_lock(&streamMutex);
+    streamAbort = SB_TRUE;
+    pthread_cond_signal(&streamNotFull);
+    pthread_mutex_unlock(&streamMutex);
+    /* the thread could also wait for more of the file, such as from the standard input */
+    close(streamWakePipe[1]);
+    streamWakePipe[1] = -1;
+    pthread_join(streamThread, SB_NULL);
+    FirmwareStreamCloseFile();
+    SrecordFreeImage(&streamImage);
+    SrecordFreeImage(&streamIndex);
+    streamOpen = SB_FALSE;
+  }
+  *parseResults = streamResults;
+  *error = streamError;
+  return (streamError.reason == SB_NULL) ? SB_TRUE : SB_FALSE;
+} /*** end of FirmwareStreamClose ***/
+
+
+/************************************************************************************//**
+** \brief     Loads a firmware file into an in-memory firmware image by streaming it.
+**            Only the image is kept in memory, not the contents of the file, which is
+**            how a compressed file is loaded. The image is validated the same way as
+**            when the file is parsed at once.
+** \param     fileName Name of the file, or "-" for the standard input.
+** \param     isBinary SB_TRUE to load the file as raw binary data, otherwise its
+**            format is detected from its contents. An ELF file cannot be loaded.
+** \param     baseAddress Memory address of a raw binary file.
+** \param     image Pointer to where the firmware image should be stored. Must be
+**            released with SrecordFreeImage(), also when this function fails.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored when the loading fails.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 FirmwareStreamLoadImage(const sb_char *fileName, sb_uint8 isBinary,
+                                 sb_uint32 baseAddress, tSrecordImage *image,
+                                 tSrecordParseResults *parseResults,
+                                 tSrecordError *error)
+{
+  const tFirmwareStreamChunk *chunk;
+  sb_uint32 nextAddress = 0;
+  sb_uint8 sorted = SB_TRUE;
+  sb_uint8 appended = SB_TRUE;
+
+  memset(image, 0, sizeof(*image));
+  if (FirmwareStreamOpen(fileName, isBinary, baseAddress, error) == SB_FALSE)
+  {
+    if (error->reason == SB_NULL)
+    {
+      error->reason = "could not open the file";
+    }
+    return SB_FALSE;
+  }
+  while ( (appended == SB_TRUE) && ((chunk = FirmwareStreamGet()) != SB_NULL) )
+  {
+    /* the image only needs to be sorted when the file is not in order of address */
+    if (chunk->address < nextAddress)
+    {
+      sorted = SB_FALSE;
+    }
+    nextAddress = chunk->address + chunk->length;
+    appended = SrecordImageAppend(image, chunk->address, chunk->data, chunk->length,
+                                  chunk->line);
+    FirmwareStreamRelease();
+  }
+  if (FirmwareStreamClose(parseResults, error) == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+  if (appended == SB_FALSE)
+  {
+    error->line = 0;
+    error->reason = "out of memory";
+    return SB_FALSE;
+  }
+  return SrecordImageFinish(image, sorted, parseResults, error);
+} /*** end of FirmwareStreamLoadImage ***/
+
+
+/************************************************************************************//**
+** \brief     Entry point of the thread that reads and parses the file. It fills the
+**            queue with chunks until the end of the file, an error, or until the
+**            streaming is stopped.
+** \param     arg Not used.
+** \return    SB_NULL.
+**
+****************************************************************************************/
+static void *FirmwareStreamThreadMain(void *arg)
+{
+  const sb_char *reason = SB_NULL;
+  sb_int32 readLen;
+
+  (void)arg;
+  for (;;)
+  {
+    /* parse what was read so far */
+    if (streamFormat == FIRMWARE_FORMAT_BINARY)
+    {
+      reason = FirmwareStreamAddBinary();
+    }
+    else
+    {
+      reason = FirmwareStreamParseLines(streamEndOfFile);
+    }
+    if ( (reason != SB_NULL) || (streamEndOfFile == SB_TRUE) ||
+         (streamIhexParser.endOfFile == SB_TRUE) )
+    {
+      break;
+    }
+    /* read the next part of the file */
+    readLen = FirmwareStreamRead(&streamBuffer[streamBufferLen],
+                                 sizeof(streamBuffer) - streamBufferLen);
+    if (readLen < 0)
+    {
+      streamLineNumber = 0;
+      reason = streamReadReason;
+      break;
+    }
+    streamEndOfFile = (readLen == 0) ? SB_TRUE : SB_FALSE;
+    streamBufferLen += readLen;
+  }
+
+  /* hand out the data of the last lines */
+  if (reason == SB_NULL)
+  {
+    reason = FirmwareStreamFlush();
+  }
+  if ( (reason == SB_NULL) && (streamResults.data_bytes_total == 0) )
+  {
+    /* a file without data cannot be programmed */
+    streamLineNumber = 0;
+    reason = (streamFormat == FIRMWARE_FORMAT_SRECORD) ? "no S1, S2 or S3 records with data" :
+             (streamFormat == FIRMWARE_FORMAT_IHEX) ? "no data records" : "the file is empty";
+  }
+
+  pthread_mutex_lock(&streamMutex);
+  /* an error after the streaming was stopped no longer matters */
+  if ( (reason != SB_NULL) && (streamAbort == SB_FALSE) )
+  {
+    streamError.line = streamLineNumber;
+    streamError.reason = reason;
+  }
+  streamDone = SB_TRUE;
+  pthread_cond_signal(&streamNotEmpty);
+  pthread_mutex_unlock(&streamMutex);
+  return SB_NULL;
+} /*** end of FirmwareStreamThreadMain ***/
+
+
+/************************************************************************************//**
+** \brief     Parses the complete lines in the buffer. A line that is not complete yet
+**            is moved to the start of the buffer, to be completed by the next read.
+** \param     endOfFile SB_TRUE when the rest of the buffer is the last line of the file.
+** \return    SB_NULL if successful, otherwise a description of the error.
+**
+****************************************************************************************/
+static const sb_char *FirmwareStreamParseLines(sb_uint8 endOfFile)
+{
+  const sb_char *line = streamBuffer;
+  const sb_char *end = streamBuffer + streamBufferLen;
+  const sb_char *lineEnd;
+  const sb_char *reason = SB_NULL;
+  sb_uint32 lineLen;
+
+  while ( (line < end) && (streamIhexParser.endOfFile == SB_FALSE) )
+  {
+    lineEnd = memchr(line, '\n', end - line);
+    if (lineEnd == SB_NULL)
+    {
+      if (endOfFile == SB_FALSE)
+      {
+        break;
+      }
+      lineEnd = end;
+    }
+    streamLineNumber++;
+    /* strip the line termination and trailing white space */
+    lineLen = lineEnd - line;
+    while ( (lineLen > 0) && ((line[lineLen - 1] == '\r') || (line[lineLen - 1] == ' ') ||
+                              (line[lineLen - 1] == '\t')) )
+    {
+      lineLen--;
+    }
+    /* empty lines are allowed */
+    if (lineLen > 0)
+    {
+      if (streamFormat == FIRMWARE_FORMAT_SRECORD)
+      {
+        reason = SrecordParseRecord(line, lineLen, streamLineNumber, &streamImage);
+      }
+      else
+      {
+        reason = IhexParseLine(&streamIhexParser, line, lineLen, streamLineNumber);
+      }
+      if (reason != SB_NULL)
+      {
+        return reason;
+      }
+    }
+    line = lineEnd + 1;
+    /* hand out the data before the next line could overflow a chunk */
+    if ( ((streamImage.arenaSize + FIRMWARE_STREAM_LINE_DATA_MAX) > FIRMWARE_STREAM_CHUNK_SIZE) ||
+         (streamImage.segmentCnt >= SRECORD_IMAGE_SEGMENTS) )
+    {
+      reason = FirmwareStreamFlush();
+      if (reason != SB_NULL)
+      {
+        return reason;
+      }
+    }
+  }
+
+  /* keep the line that is not complete yet */
+  if (line >= end)
+  {
+    streamBufferLen = 0;
+  }
+  else if (line > streamBuffer)
+  {
+    streamBufferLen = end - line;
+    memmove(streamBuffer, line, streamBufferLen);
+  }
+  else if (streamBufferLen == sizeof(streamBuffer))
+  {
+    streamLineNumber++;
+    return "line too long";
+  }
+  return SB_NULL;
+} /*** end of FirmwareStreamParseLines ***/
+
+
+/************************************************************************************//**
+** \brief     Adds the contents of the buffer to the data of a raw binary file.
+** \return    SB_NULL if successful, otherwise a description of the error.
+**
+****************************************************************************************/
+static const sb_char *FirmwareStreamAddBinary(void)
+{
+  sb_uint32 offset = 0;
+  sb_uint32 length;
+  const sb_char *reason;
+
+  while (offset < streamBufferLen)
+  {
+    /* fill up the chunk */
+    length = FIRMWARE_STREAM_CHUNK_SIZE - streamImage.arenaSize;
+    if (length > (streamBufferLen - offset))
+    {
+      length = streamBufferLen - offset;
+    }
+    if ((streamBinaryAddress + length - 1) < streamBinaryAddress)
+    {
+      return "data exceeds the 32-bit address range";
+    }
+    if (SrecordImageAppend(&streamImage, streamBinaryAddress,
+                           (const sb_uint8 *)&streamBuffer[offset], length,
+                           0) == SB_FALSE)
+    {
+      return "out of memory";
+    }
+    streamBinaryAddress += length;
+    offset += length;
+    if (streamImage.arenaSize == FIRMWARE_STREAM_CHUNK_SIZE)
+    {
+      reason = FirmwareStreamFlush();
+      if (reason != SB_NULL)
+      {
+        return reason;
+      }
+    }
+  }
+  streamBufferLen = 0;
+  return SB_NULL;
+} /*** end of FirmwareStreamAddBinary ***/
+
+
+/************************************************************************************//**
+** \brief     Adds the data that was parsed to the queue, one chunk for each segment,
+**            and empties the image that held it.
+** \return    SB_NULL if successful, otherwise a description of the error.
+**
+****************************************************************************************/
+static const sb_char *FirmwareStreamFlush(void)
+{
+  tSrecordSegment *segment;
+  const sb_char *reason;
+  sb_uint32 idx;
+
+  for (idx=0; idx<streamImage.segmentCnt; idx++)
+  {
+    segment = &streamImage.segments[idx];
+    reason = FirmwareStreamPut(segment->address, &streamImage.arena[segment->offset],
+                               segment->length, segment->line);
+    if (reason != SB_NULL)
+    {
+      return reason;
+    }
+  }
+  /* keep the memory for the next lines */
+  streamImage.segmentCnt = 0;
+  streamImage.arenaSize = 0;
+  return SB_NULL;
+} /*** end of FirmwareStreamFlush ***/
+
+
+/************************************************************************************//**
+** \brief     Adds a chunk to the queue. Waits until there is room for it.
+** \param     address Memory address of the data.
+** \param     data The data bytes.
+** \param     length Number of data bytes, at most FIRMWARE_STREAM_CHUNK_SIZE.
+** \param     line Line of the first record of the data, or 0 for a raw binary file.
+** \return    SB_NULL if successful, otherwise a description of the error.
+**
+****************************************************************************************/
+static const sb_char *FirmwareStreamPut(sb_uint32 address, const sb_uint8 *data,
+                                        sb_uint32 length, sb_uint32 line)
+{
+  tFirmwareStreamChunk *chunk;
+  tSrecordError overlap;
+
+  assert(length <= FIRMWARE_STREAM_CHUNK_SIZE);
+
+  /* data that overlaps earlier data must not be programmed */
+  if (SrecordImageInsertRange(&streamIndex, address, length, line, &overlap) == SB_FALSE)
+  {
+    streamLineNumber = overlap.line;
+    return overlap.reason;
+  }
+  streamResults.segment_count = streamIndex.segmentCnt;
+
+  pthread_mutex_lock(&streamMutex);
+  while ( (streamCount == FIRMWARE_STREAM_QUEUE_LEN) && (streamAbort == SB_FALSE) )
+  {
+    pthread_cond_wait(&streamNotFull, &streamMutex);
+  }
+  if (streamAbort == SB_TRUE)
+  {
+    pthread_mutex_unlock(&streamMutex);
+    return "streaming stopped";
+  }
+  chunk = &streamQueue[(streamHead + streamCount) % FIRMWARE_STREAM_QUEUE_LEN];
+  pthread_mutex_unlock(&streamMutex);
+
+  /* the chunk is not part of the queue yet, so it is filled without holding the lock */
+  chunk->address = address;
+  chunk->length = length;
+  chunk->line = line;
+  memcpy(chunk->data, data, length);
+  if (address < streamResults.address_low)
+  {
+    streamResults.address_low = address;
+  }
+  if ((address + length - 1) > streamResults.address_high)
+  {
+    streamResults.address_high = address + length - 1;
+  }
+  streamResults.data_bytes_total += length;
+
+  pthread_mutex_lock(&streamMutex);
+  streamCount++;
+  pthread_cond_signal(&streamNotEmpty);
+  pthread_mutex_unlock(&streamMutex);
+  return SB_NULL;
+} /*** end of FirmwareStreamPut ***/
+
+
+/************************************************************************************//**
+** \brief     Reads the contents of the file, decompressing them if the file is
+**            compressed.
+** \param     buffer Buffer for the contents.
+** \param     size Size of the buffer.
+** \return    Number of bytes read, 0 at the end of the file, or -1 on error, of which
+**            the reason is stored in streamReadReason.
+**
+****************************************************************************************/
+static sb_int32 FirmwareStreamRead(sb_char *buffer, sb_uint32 size)
+{
+  sb_int32 readLen;
+
+  for (;;)
+  {
+    if (streamCompression == FIRMWARE_COMPRESSION_NONE)
+    {
+      /* the bytes that were read to detect the compression come first */
+      if (streamInputPos < streamInputLen)
+      {
+        readLen = streamInputLen - streamInputPos;
+        if ((sb_uint32)readLen > size)
+        {
+          readLen = size;
+        }
+        memcpy(buffer, &streamInput[streamInputPos], readLen);
+        streamInputPos += readLen;
+        return readLen;
+      }
+      readLen = FirmwareStreamReadFile(buffer, size);
+      if (readLen < 0)
+      {
+        streamReadReason = "could not read the file";
+      }
+      return readLen;
+    }
+    /* read more of a compressed file once the decoder used all of it */
+    if ( (streamInputPos == streamInputLen) && (streamInputEof == SB_FALSE) )
+    {
+      readLen = FirmwareStreamReadFile(streamInput, sizeof(streamInput));
+      if (readLen < 0)
+      {
+        streamReadReason = "could not read the file";
+        return -1;
+      }
+      streamInputPos = 0;
+      streamInputLen = readLen;
+      streamInputEof = (readLen == 0) ? SB_TRUE : SB_FALSE;
+    }
+    if ( (streamInputPos == streamInputLen) && (streamInputEof == SB_TRUE) &&
+         (streamDecoderEnd == SB_TRUE) )
+    {
+      return 0;
+    }
+    /* the decoder can use input without producing output, then read more. it can also
+     * still have output when all input was used.
+     */
+    readLen = FirmwareStreamDecode(buffer, size);
+    if (readLen != 0)
+    {
+      return readLen;
+    }
+    if ( (streamInputPos == streamInputLen) && (streamInputEof == SB_TRUE) )
+    {
+      if (streamDecoderEnd == SB_FALSE)
+      {
+        streamReadReason = "the compressed data is truncated";
+        return -1;
+      }
+      return 0;
+    }
+  }
+} /*** end of FirmwareStreamRead ***/
+
+
+/************************************************************************************//**
+** \brief     Reads from the file, retrying when interrupted by a signal. Waits in poll()
+**            until data is available, such that the wait ends when the streaming is
+**            stopped.
+** \param     buffer Buffer for the data.
+** \param     size Size of the buffer.
+** \return    Number of bytes read, 0 at the end of the file, or -1 on error or when
+**            the streaming was stopped.
+**
+****************************************************************************************/
+static sb_int32 FirmwareStreamReadFile(sb_char *buffer, sb_uint32 size)
+{
+  struct pollfd pfds[2];
+  ssize_t readLen;
+
+  pfds[0].fd = streamFd;
+  pfds[0].events = POLLIN;
+  pfds[1].fd = streamWakePipe[0];
+  pfds[1].events = POLLIN;
+  for (;;)
+  {
+    if (poll(pfds, 2, -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    /* the write end of the pipe is closed to stop the streaming */
+    if (pfds[1].revents != 0)
+    {
+      return -1;
+    }
+    readLen = read(streamFd, buffer, size);
+    if ( (readLen >= 0) || (errno != EINTR) )
+    {
+      return (sb_int32)readLen;
+    }
+  }
+} /*** end of FirmwareStreamReadFile ***/
+
+
+/************************************************************************************//**
+** \brief     Initializes the decoder for the compression format of the file.
+** \return    SB_NULL if successful, otherwise a description of the error.
+**
+****************************************************************************************/
+static const sb_char *FirmwareStreamDecoderInit(void)
+{
+  streamDecoderEnd = SB_FALSE;
+  switch (streamCompression)
+  {
+    case FIRMWARE_COMPRESSION_GZIP:
+#if (FIRMWARE_STREAM_GZIP_ENABLE > 0)
+      memset(&streamZlib, 0, sizeof(streamZlib));
+      /* a window of 32 KiB with a gzip header */
+      if (inflateInit2(&streamZlib, 15 + 16) != Z_OK)
+      {
+        return "out of memory";
+      }
+      return SB_NULL;
+#else
+      return "this build cannot decompress gzip files";
+#endif
+
+    case FIRMWARE_COMPRESSION_XZ:
+#if (FIRMWARE_STREAM_XZ_ENABLE > 0)
+      if (lzma_stream_decoder(&streamLzma, FIRMWARE_STREAM_XZ_MEMLIMIT,
+                              LZMA_CONCATENATED) != LZMA_OK)
+      {
+        return "out of memory";
+      }
+      return SB_NULL;
+#else
+      return "this build cannot decompress xz files";
+#endif
+
+    case FIRMWARE_COMPRESSION_ZSTD:
+#if (FIRMWARE_STREAM_ZSTD_ENABLE > 0)
+      streamZstd = ZSTD_createDStream();
+      if ( (streamZstd == SB_NULL) || (ZSTD_isError(ZSTD_initDStream(streamZstd))) )
+      {
+        ZSTD_freeDStream(streamZstd);
+        streamZstd = SB_NULL;
+        return "out of memory";
+      }
+      return SB_NULL;
+#else
+      return "this build cannot decompress zstd files";
+#endif
+
+    default:
+      streamDecoderEnd = SB_TRUE;
+      return SB_NULL;
+  }
+} /*** end of FirmwareStreamDecoderInit ***/
+
+
+/************************************************************************************//**
+** \brief     Decompresses the bytes in the input buffer, as far as they fit in the
+**            output buffer.
+** \param     buffer Buffer for the decompressed bytes.
+** \param     size Size of the buffer.
+** \return    Number of decompressed bytes, or -1 on error, of which the reason is
+**            stored in streamReadReason.
+**
+****************************************************************************************/
+static sb_int32 FirmwareStreamDecode(sb_char *buffer, sb_uint32 size)
+{
+#if (FIRMWARE_STREAM_GZIP_ENABLE > 0)
+  int zlibResult;
+#endif
+#if (FIRMWARE_STREAM_XZ_ENABLE > 0)
+  lzma_ret lzmaResult;
+#endif
+#if (FIRMWARE_STREAM_ZSTD_ENABLE > 0)
+  ZSTD_inBuffer zstdIn;
+  ZSTD_outBuffer zstdOut;
+  size_t zstdResult;
+#endif
+  sb_int32 decodedLen = 0;
+
+  streamReadReason = "the compressed data is corrupt";
+  switch (streamCompression)
+  {
+#if (FIRMWARE_STREAM_GZIP_ENABLE > 0)
+    case FIRMWARE_COMPRESSION_GZIP:
+      /* the next member of a file with concatenated members starts a new stream */
+      if (streamDecoderEnd == SB_TRUE)
+      {
+        inflateReset(&streamZlib);
+        streamDecoderEnd = SB_FALSE;
+      }
+      streamZlib.next_in = (Bytef *)&streamInput[streamInputPos];
+      streamZlib.avail_in = streamInputLen - streamInputPos;
+      streamZlib.next_out = (Bytef *)buffer;
+      streamZlib.avail_out = size;
+      zlibResult = inflate(&streamZlib, Z_NO_FLUSH);
+      streamInputPos = streamInputLen - streamZlib.avail_in;
+      decodedLen = size - streamZlib.avail_out;
+      if (zlibResult == Z_STREAM_END)
+      {
+        streamDecoderEnd = SB_TRUE;
+      }
+      else if (zlibResult == Z_MEM_ERROR)
+      {
+        streamReadReason = "out of memory";
+        decodedLen = -1;
+      }
+      else if ( (zlibResult != Z_OK) && (zlibResult != Z_BUF_ERROR) )
+      {
+        decodedLen = -1;
+      }
+      break;
+#endif
+
+#if (FIRMWARE_STREAM_XZ_ENABLE > 0)
+    case FIRMWARE_COMPRESSION_XZ:
+      streamLzma.next_in = (const uint8_t *)&streamInput[streamInputPos];
+      streamLzma.avail_in = streamInputLen - streamInputPos;
+      streamLzma.next_out = (uint8_t *)buffer;
+      streamLzma.avail_out = size;
+      /* with concatenated streams, the end is only known at the end of the file */
+      lzmaResult = lzma_code(&streamLzma, (streamInputEof == SB_TRUE) ? LZMA_FINISH :
+                                                                       LZMA_RUN);
+      streamInputPos = streamInputLen - streamLzma.avail_in;
+      decodedLen = size - streamLzma.avail_out;
+      if (lzmaResult == LZMA_STREAM_END)
+      {
+        streamDecoderEnd = SB_TRUE;
+      }
+      else if (lzmaResult == LZMA_MEM_ERROR)
+      {
+        streamReadReason = "out of memory";
+        decodedLen = -1;
+      }
+      else if (lzmaResult == LZMA_MEMLIMIT_ERROR)
+      {
+        streamReadReason = "the compressed data needs too much memory";
+        decodedLen = -1;
+      }
+      else if ( (lzmaResult != LZMA_OK) && (lzmaResult != LZMA_BUF_ERROR) )
+      {
+        decodedLen = -1;
+      }
+      break;
+#endif
+
+#if (FIRMWARE_STREAM_ZSTD_ENABLE > 0)
+    case FIRMWARE_COMPRESSION_ZSTD:
+      zstdIn.src = &streamInput[streamInputPos];
+      zstdIn.size = streamInputLen - streamInputPos;
+      zstdIn.pos = 0;
+      zstdOut.dst = buffer;
+      zstdOut.size = size;
+      zstdOut.pos = 0;
+      zstdResult = ZSTD_decompressStream(streamZstd, &zstdOut, &zstdIn);
+      streamInputPos += zstdIn.pos;
+      decodedLen = zstdOut.pos;
+      /* a result of 0 means that a frame is complete, another one can follow */
+      streamDecoderEnd = (zstdResult == 0) ? SB_TRUE : SB_FALSE;
+      if (ZSTD_isError(zstdResult))
+      {
+        decodedLen = -1;
+      }
+      break;
+#endif
+
+    default:
+      decodedLen = -1;
+      break;
+  }
+  return decodedLen;
+} /*** end of FirmwareStreamDecode ***/
+
+
+/************************************************************************************//**
+** \brief     Closes the file and releases the decoder of a compressed file.
+** \return    none.
+**
+****************************************************************************************/
+static void FirmwareStreamCloseFile(void)
+{
+  sb_uint32 idx;
+
+  switch (streamCompression)
+  {
+#if (FIRMWARE_STREAM_GZIP_ENABLE > 0)
+    case FIRMWARE_COMPRESSION_GZIP:
+      inflateEnd(&streamZlib);
+      break;
+#endif
+
+#if (FIRMWARE_STREAM_XZ_ENABLE > 0)
+    case FIRMWARE_COMPRESSION_XZ:
+      lzma_end(&streamLzma);
+      break;
+#endif
+
+#if (FIRMWARE_STREAM_ZSTD_ENABLE > 0)
+    case FIRMWARE_COMPRESSION_ZSTD:
+      ZSTD_freeDStream(streamZstd);
+      streamZstd = SB_NULL;
+      break;
+#endif
+
+    default:
+      break;
+  }
+  streamCompression = FIRMWARE_COMPRESSION_NONE;
+  if (streamFd != STDIN_FILENO)
+  {
+    close(streamFd);
+  }
+  for (idx=0; idx<2; idx++)
+  {
+    if (streamWakePipe[idx] >= 0)
+    {
+      close(streamWakePipe[idx]);
+      streamWakePipe[idx] = -1;
+    }
+  }
+} /*** end of FirmwareStreamCloseFile ***/
+
+
+/*********************************** end of firmwarestream.c ***************************/
@@ -0,0 +1,140 @@
+/************************************************************************************//**
+* \file         port\linux\parallel.c
+* \brief        Parallel execution of jobs source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <unistd.h>                                   /* UNIX standard functions       */
+#include <pthread.h>                                  /* POSIX threads                 */
+#include "parallel.h"                                 /* parallel execution of jobs    */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for a job that runs on a thread of its own. */
+typedef struct
+{
+  pthread_t thread;                               /**< thread that runs the job        */
+  tParallelJob job;                               /**< function of the job             */
+  void *context;                                  /**< context of the job              */
+  sb_uint8 started;                               /**< SB_TRUE if the thread started   */
+} tParallelThread;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void *ParallelThreadMain(void *arg);
+
+
+/************************************************************************************//**
+** \brief     Obtains the number of processors that are online, which is the number of
+**            jobs that can make progress at the same time.
+** \return    Number of processors, at least 1.
+**
+****************************************************************************************/
+sb_uint32 ParallelGetCpuCount(void)
+{
+  long cpuCnt;
+
+  cpuCnt = sysconf(_SC_NPROCESSORS_ONLN);
+  return (cpuCnt > 0) ? (sb_uint32)cpuCnt : 1;
+} /*** end of ParallelGetCpuCount ***/
+
+
+/************************************************************************************//**
+** \brief     Runs jobs in parallel and waits for all of them to complete. The first job
+**            runs on the calling thread and each of the others on a thread of its own.
+**            A job whose thread cannot be created runs on the calling thread instead,
+**            so all jobs always complete.
+** \param     job Function of the jobs.
+** \param     contexts Array with the context of each job.
+** \param     contextSize Size of each element of the contexts array in bytes.
+** \param     jobCnt Number of jobs, at most PARALLEL_JOBS_MAX.
+** \return    none.
+**
+****************************************************************************************/
+void ParallelRun(tParallelJob job, void *contexts, sb_uint32 contextSize,
+                 sb_uint32 jobCnt)
+{
+  tParallelThread threads[PARALLEL_JOBS_MAX];
+  sb_uint32 idx;
+
+  assert(jobCnt <= PARALLEL_JOBS_MAX);
+
+  for (idx=1; idx<jobCnt; idx++)
+  {
+    threads[idx].job = job;
+    threads[idx].context = (sb_uint8 *)contexts + (idx * contextSize);
+    threads[idx].started = (pthread_create(&threads[idx].thread, SB_NULL,
+                                           ParallelThreadMain, &threads[idx]) == 0) ?
+                           SB_TRUE : SB_FALSE;
+  }
+  if (jobCnt > 0)
+  {
+    job(contexts);
+  }
+  for (idx=1; idx<jobCnt; idx++)
+  {
+    if (threads[idx].started == SB_TRUE)
+    {
+      pthread_join(threads[idx].thread, SB_NULL);
+    }
+    else
+    {
+      job(threads[idx].context);
+    }
+  }
+} /*** end of ParallelRun ***/
+
+
+/************************************************************************************//**
+** \brief     Entry point of the threads that run a job.
+** \param     arg The thread, of type tParallelThread.
+** \return    SB_NULL.
+**
+****************************************************************************************/
+static void *ParallelThreadMain(void *arg)
+{
+  tParallelThread *thread = arg;
+
+  thread->job(thread->context);
+  return SB_NULL;
+} /*** end of ParallelThreadMain ***/
+
+
+/*********************************** end of parallel.c *********************************/
@@ -38,26 +38,54 @@
 #include <sb_types.h>                                 /* C types                       */
 #include <unistd.h>                                   /* UNIX standard functions       */
 #include <fcntl.h>                                    /* file control definitions      */
+#include <errno.h>                                    /* error number definitions      */
 #include <time.h>                                     /* time definitions              */
-#include <sys/time.h>
+#include "timeutil.h"                                 /* time utility module           */
 
 
 /************************************************************************************//**
-** \brief     Get the system time in milliseconds.
+** \brief     Get the system time in milliseconds. The time is obtained from the
+**            monotonic clock, so it does not jump when the wall clock is adjusted. It
+**            is only meaningful for measuring time differences.
 ** \return    Time in milliseconds.
 **
 ****************************************************************************************/
 sb_uint32 TimeUtilGetSystemTimeMs(void)
 {
- struct timeval tv;
+  return (sb_uint32)(TimeUtilGetTimeNs() / 1000000ull);
+} /*** end of TimeUtilGetSystemTimeMs ***/
 
- if (gettimeofday(&tv, SB_NULL) != 0)
- {
-   return 0;
- }
 
- return (sb_uint32)((tv.tv_sec * 1000ul) + (tv.tv_usec / 1000ul));
-} /*** end of XcpTransportClose ***/
+/************************************************************************************//**
+** \brief     Get the time of the monotonic clock in nanoseconds. The clock starts at an
+**            unspecified point, does not jump when the wall clock is adjusted and does
+**            not wrap during the lifetime of the program.
+** \return    Time in nanoseconds.
+**
+****************************************************************************************/
+sb_uint64 TimeUtilGetTimeNs(void)
+{
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+  {
+    return 0;
+  }
+
+  return ((sb_uint64)ts.tv_sec * 1000000000ull) + (sb_uint64)ts.tv_nsec;
+} /*** end of TimeUtilGetTimeNs ***/
+
+
+/************************************************************************************//**
+** \brief     Get the time in microseconds that elapsed since the specified time.
+** \param     startNs Start time, as obtained with TimeUtilGetTimeNs().
+** \return    Elapsed time in microseconds.
+**
+****************************************************************************************/
+sb_uint64 TimeUtilGetElapsedUs(sb_uint64 startNs)
+{
+  return (TimeUtilGetTimeNs() - startNs) / 1000ull;
+} /*** end of TimeUtilGetElapsedUs ***/
 
 
 /************************************************************************************//**
@@ -68,8 +96,31 @@ sb_uint32 TimeUtilGetSystemTimeMs(void)
 ****************************************************************************************/
 void TimeUtilDelayMs(sb_uint16 delay)
 {
-  usleep(1000 * delay);
+  TimeUtilDelayUs(1000ul * delay);
 } /*** end of TimeUtilDelayMs **/
 
 
+/************************************************************************************//**
+** \brief     Performs a delay of the specified amount of microseconds. The delay is
+**            not cut short when a signal is caught.
+** \param     delay Delay time in microseconds.
+** \return    none.
+**
+****************************************************************************************/
+void TimeUtilDelayUs(sb_uint32 delay)
+{
+  struct timespec ts;
+  sb_uint64 wakeupNs;
+
+  /* sleep until an absolute time, so that interruptions do not extend the delay */
+  wakeupNs = TimeUtilGetTimeNs() + (1000ull * delay);
+  ts.tv_sec = wakeupNs / 1000000000ull;
+  ts.tv_nsec = wakeupNs % 1000000000ull;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, SB_NULL) == EINTR)
+  {
+    ;
+  }
+} /*** end of TimeUtilDelayUs ***/
+
+
 /*********************************** end of xcptransport.c *****************************/
@@ -0,0 +1,757 @@
+/************************************************************************************//**
+* \file         port\linux\xcpengine.c
+* \brief        Engine for concurrent firmware updates of several devices source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <stdlib.h>                                   /* standard library              */
+#include <string.h>                                   /* string function definitions   */
+#include <unistd.h>                                   /* UNIX standard functions       */
+#include <errno.h>                                    /* error number definitions      */
+#include <sys/epoll.h>                                /* I/O event notification        */
+#include "xcpengine.h"                                /* concurrent update engine      */
+#include "timeutil.h"                                 /* time utility module           */
+#include "parallel.h"                                 /* parallel execution of jobs    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Time in milliseconds that the XCP CONNECT command is retransmitted before
+ *         giving up. This gives the user some time to reset a device that is not in
+ *         bootloader mode.
+ */
+#define XCP_ENGINE_CONNECT_TIMEOUT_MS      (5000)
+
+/** \brief Maximum number of events that are processed per wait operation. */
+#define XCP_ENGINE_MAX_EVENTS              (64)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for a command that is in flight while programming data. */
+typedef struct
+{
+  sb_uint32 address;                              /**< memory address of the command   */
+  sb_uint32 len;                                  /**< number of bytes programmed      */
+} tXcpEngineInFlight;
+
+/** \brief Structure type for a slot in which the firmware update of one device runs. */
+typedef struct
+{
+  tXcpMasterSession session;                      /**< XCP master session              */
+  tXcpEngineTarget *target;                       /**< device that is being updated    */
+  sb_uint8 active;                                /**< slot is in use                  */
+  sb_uint32 segmentIdx;                           /**< segment being programmed        */
+  sb_uint32 segmentOffset;                        /**< bytes of the segment transmitted*/
+  sb_uint8 endOfImage;                            /**< all segments were transmitted   */
+  sb_uint32 mtaAddress;                           /**< address that the MTA points to  */
+  sb_uint8 mtaValid;                              /**< MTA address is known            */
+  tXcpEngineInFlight inFlight[XCP_MASTER_PENDING_MAX]; /**< commands in flight         */
+  sb_uint8 inFlightHead;                          /**< oldest command in flight        */
+  sb_uint64 connectEndNs;                         /**< time to stop the CONNECT retries*/
+  sb_uint64 deadlineNs;                           /**< time that a response is due     */
+  sb_uint64 startTimeNs;                          /**< start time of the update        */
+} tXcpEngineDevice;
+
+/** \brief Structure type for the devices whose host names a thread resolves. */
+typedef struct
+{
+  tXcpEngineTarget *targets;                      /**< all devices                     */
+  tXcpTransportHost **hosts;                      /**< addresses of all devices        */
+  sb_uint32 firstTarget;                          /**< index of the first device       */
+  sb_uint32 targetCnt;                            /**< number of devices               */
+} tXcpEngineResolveJob;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void     XcpEngineResolveHosts(tXcpEngineTarget targets[],
+                                      tXcpTransportHost *hosts[], sb_uint32 targetCnt);
+static void     XcpEngineResolveJob(void *context);
+static void     XcpEngineStartDevice(tXcpEngineDevice *device, tXcpEngineTarget *target,
+                                     const tXcpTransportHost *host,
+                                     tXcpTransportProfile profile, sb_uint8 programWindow);
+static void     XcpEngineFinishDevice(tXcpEngineDevice *device, sb_uint8 result);
+static void     XcpEngineProcessEvent(tXcpEngineDevice *device);
+static void     XcpEngineProcessTimeout(tXcpEngineDevice *device);
+static sb_uint8 XcpEngineProcessResponse(tXcpEngineDevice *device);
+static sb_uint8 XcpEngineFillProgramWindow(tXcpEngineDevice *device);
+static void     XcpEngineUpdateDeadline(tXcpEngineDevice *device);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Epoll instance that monitors the connections of all active devices. */
+static sb_int32 epollFd;
+
+/** \brief Lowest and highest memory address of the firmware, for erasing memory. */
+static tSrecordParseResults *firmwareInfo;
+
+/** \brief Firmware image that is programmed into all devices. */
+static const tSrecordImage *firmwareImage;
+
+/** \brief Time in milliseconds that establishing the TCP connection is allowed to take. */
+static sb_uint32 tcpConnectTimeoutMs;
+
+
+/************************************************************************************//**
+** \brief     Performs the firmware update of all specified devices. The updates run
+**            concurrently, each one in its own slot, and are driven from a single
+**            thread by one epoll loop. The number of updates that run at the same time
+**            is limited to maxConcurrent. The host names of all devices are resolved
+**            before the loop starts, such that a slow name lookup cannot stall the
+**            updates that are running. The outcome of each update is stored in its
+**            target.
+** \param     targets Devices to update.
+** \param     targetCnt Number of devices to update.
+** \param     maxConcurrent Maximum number of updates that run at the same time.
+** \param     image Firmware image that is programmed into all devices.
+** \param     parseResults Parsing results of the S-record file.
+** \param     profile Socket profile of the connections.
+** \param     programWindow Number of program commands in flight per device.
+** \param     connectTimeoutMs Time that establishing a TCP connection may take.
+** \return    SB_TRUE if all updates were successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpEngineRun(tXcpEngineTarget targets[], sb_uint32 targetCnt,
+                      sb_uint32 maxConcurrent, const tSrecordImage *image,
+                      tSrecordParseResults *parseResults, tXcpTransportProfile profile,
+                      sb_uint8 programWindow, sb_uint32 connectTimeoutMs)
+{
+  tXcpEngineDevice *devices;
+  tXcpTransportHost **hosts;
+  struct epoll_event events[XCP_ENGINE_MAX_EVENTS];
+  sb_uint32 nextTarget = 0;
+  sb_uint32 activeCnt;
+  sb_uint32 idx;
+  sb_int32 eventCnt;
+  sb_int32 waitMs;
+  sb_int32 remainingMs;
+  sb_uint64 now;
+  sb_uint8 result = SB_TRUE;
+
+  /* there is no point in having more slots than devices */
+  if (maxConcurrent > targetCnt)
+  {
+    maxConcurrent = targetCnt;
+  }
+  if (maxConcurrent == 0)
+  {
+    return SB_TRUE;
+  }
+  devices = calloc(maxConcurrent, sizeof(tXcpEngineDevice));
+  hosts = calloc(targetCnt, sizeof(tXcpTransportHost *));
+  if ( (devices == SB_NULL) || (hosts == SB_NULL) )
+  {
+    free(devices);
+    free(hosts);
+    return SB_FALSE;
+  }
+  epollFd = epoll_create1(0);
+  if (epollFd < 0)
+  {
+    free(devices);
+    free(hosts);
+    return SB_FALSE;
+  }
+  XcpEngineResolveHosts(targets, hosts, targetCnt);
+  firmwareInfo = parseResults;
+  firmwareImage = image;
+  tcpConnectTimeoutMs = connectTimeoutMs;
+
+  for (;;)
+  {
+    /* start the updates of the next devices in the free slots. an update that fails
+     * right away, such as for an unknown host, frees its slot again for the next one.
+     */
+    activeCnt = 0;
+    for (idx=0; idx<maxConcurrent; idx++)
+    {
+      while ( (devices[idx].active == SB_FALSE) && (nextTarget < targetCnt) )
+      {
+        XcpEngineStartDevice(&devices[idx], &targets[nextTarget], hosts[nextTarget],
+                             profile, programWindow);
+        nextTarget++;
+      }
+      if (devices[idx].active == SB_TRUE)
+      {
+        activeCnt++;
+      }
+    }
+    /* all done when no update is running anymore and all devices were started */
+    if ( (activeCnt == 0) && (nextTarget == targetCnt) )
+    {
+      break;
+    }
+    /* without a running update there is nothing to wait for */
+    if (activeCnt == 0)
+    {
+      continue;
+    }
+    /* sleep until an event occurs or the first deadline passes */
+    now = TimeUtilGetTimeNs();
+    waitMs = -1;
+    for (idx=0; idx<maxConcurrent; idx++)
+    {
+      if (devices[idx].active == SB_TRUE)
+      {
+        /* round up, such that epoll_wait() does not return just before the deadline */
+        remainingMs = 0;
+        if (devices[idx].deadlineNs > now)
+        {
+          remainingMs = (sb_int32)((devices[idx].deadlineNs - now + 999999ull) / 1000000ull);
+        }
+        if ( (waitMs < 0) || (remainingMs < waitMs) )
+        {
+          waitMs = remainingMs;
+        }
+      }
+    }
+    eventCnt = epoll_wait(epollFd, events, XCP_ENGINE_MAX_EVENTS, waitMs);
+    if ( (eventCnt < 0) && (errno != EINTR) )
+    {
+      break;
+    }
+    for (idx=0; (sb_int32)idx<eventCnt; idx++)
+    {
+      XcpEngineProcessEvent((tXcpEngineDevice *)events[idx].data.ptr);
+    }
+    /* handle the devices that did not respond in time */
+    now = TimeUtilGetTimeNs();
+    for (idx=0; idx<maxConcurrent; idx++)
+    {
+      if ( (devices[idx].active == SB_TRUE) && (devices[idx].deadlineNs <= now) )
+      {
+        XcpEngineProcessTimeout(&devices[idx]);
+      }
+    }
+  }
+
+  /* abort the updates that are still running in case the loop ended on an error */
+  for (idx=0; idx<maxConcurrent; idx++)
+  {
+    if (devices[idx].active == SB_TRUE)
+    {
+      XcpEngineFinishDevice(&devices[idx], SB_FALSE);
+    }
+  }
+  close(epollFd);
+  free(devices);
+  for (idx=0; idx<targetCnt; idx++)
+  {
+    XcpTransportFreeHost(hosts[idx]);
+  }
+  free(hosts);
+
+  /* determine the overall result */
+  for (idx=0; idx<targetCnt; idx++)
+  {
+    if (targets[idx].result == SB_FALSE)
+    {
+      result = SB_FALSE;
+    }
+  }
+  return result;
+} /*** end of XcpEngineRun ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains a descriptive name of a firmware update step.
+** \param     step Firmware update step.
+** \return    Name of the step.
+**
+****************************************************************************************/
+const sb_char *XcpEngineGetStepName(tXcpEngineStep step)
+{
+  switch (step)
+  {
+    case XCP_ENGINE_STEP_TCP_CONNECT:
+      return "tcp connect";
+    case XCP_ENGINE_STEP_CONNECT:
+      return "connect";
+    case XCP_ENGINE_STEP_PROGRAM_START:
+      return "program start";
+    case XCP_ENGINE_STEP_CLEAR:
+      return "erase";
+    case XCP_ENGINE_STEP_PROGRAM:
+      return "program";
+    case XCP_ENGINE_STEP_PROGRAM_STOP:
+      return "program stop";
+    case XCP_ENGINE_STEP_RESET:
+      return "reset";
+    default:
+      return "done";
+  }
+} /*** end of XcpEngineGetStepName ***/
+
+
+/************************************************************************************//**
+** \brief     Resolves the host names of all devices. The name lookups wait on the
+**            network rather than on the processor, so they are spread over the maximum
+**            number of threads instead of one per processor.
+** \param     targets Devices to update.
+** \param     hosts Array where the addresses of each device are stored. They are
+**            SB_NULL for a device whose host name could not be resolved.
+** \param     targetCnt Number of devices.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineResolveHosts(tXcpEngineTarget targets[], tXcpTransportHost *hosts[],
+                                  sb_uint32 targetCnt)
+{
+  tXcpEngineResolveJob jobs[PARALLEL_JOBS_MAX];
+  sb_uint32 jobCnt;
+  sb_uint32 idx;
+
+  jobCnt = (targetCnt < PARALLEL_JOBS_MAX) ? targetCnt : PARALLEL_JOBS_MAX;
+  for (idx=0; idx<jobCnt; idx++)
+  {
+    jobs[idx].targets = targets;
+    jobs[idx].hosts = hosts;
+    jobs[idx].firstTarget = (targetCnt * idx) / jobCnt;
+    jobs[idx].targetCnt = ((targetCnt * (idx + 1)) / jobCnt) - jobs[idx].firstTarget;
+  }
+  ParallelRun(XcpEngineResolveJob, jobs, sizeof(tXcpEngineResolveJob), jobCnt);
+} /*** end of XcpEngineResolveHosts ***/
+
+
+/************************************************************************************//**
+** \brief     Resolves the host names of some of the devices. Runs on a thread of its own.
+** \param     context The devices, of type tXcpEngineResolveJob.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineResolveJob(void *context)
+{
+  tXcpEngineResolveJob *job = (tXcpEngineResolveJob *)context;
+  sb_uint32 idx;
+
+  for (idx=job->firstTarget; idx<(job->firstTarget + job->targetCnt); idx++)
+  {
+    job->hosts[idx] = XcpTransportResolve(job->targets[idx].address,
+                                          job->targets[idx].port);
+  }
+} /*** end of XcpEngineResolveJob ***/
+
+
+/************************************************************************************//**
+** \brief     Starts the firmware update of a device in the specified slot. The update
+**            begins with establishing the TCP connection, whose completion is signalled
+**            by one of the racing connection attempts becoming writable.
+** \param     device Slot of the device.
+** \param     target Device to update.
+** \param     host Addresses of the device, or SB_NULL if its host name could not be
+**            resolved, which fails the update right away.
+** \param     profile Socket profile of the connection.
+** \param     programWindow Number of program commands in flight.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineStartDevice(tXcpEngineDevice *device, tXcpEngineTarget *target,
+                                 const tXcpTransportHost *host,
+                                 tXcpTransportProfile profile, sb_uint8 programWindow)
+{
+  struct epoll_event event;
+  sb_uint8 idx;
+
+  /* initialize the slot */
+  memset(device, 0, sizeof(*device));
+  device->target = target;
+  device->active = SB_TRUE;
+  device->startTimeNs = TimeUtilGetTimeNs();
+  device->deadlineNs = device->startTimeNs + (tcpConnectTimeoutMs * 1000000ull);
+  target->result = SB_FALSE;
+  target->step = XCP_ENGINE_STEP_TCP_CONNECT;
+  target->errorAddress = 0;
+  target->errorAddressValid = SB_FALSE;
+  target->bytesProgrammed = 0;
+  target->durationMs = 0;
+
+  /* start establishing the connection */
+  if ( (host == SB_NULL) ||
+       (XcpMasterInitNonBlocking(&device->session, host, profile) == SB_FALSE) )
+  {
+    device->active = SB_FALSE;
+    return;
+  }
+  XcpMasterSetProgramWindow(&device->session, programWindow);
+  /* monitor the sockets for the completion of the connection attempts */
+  event.events = EPOLLOUT;
+  event.data.ptr = device;
+  for (idx=0; idx<device->session.transport.connectSockCnt; idx++)
+  {
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, device->session.transport.connectSocks[idx],
+                  &event) < 0)
+    {
+      XcpEngineFinishDevice(device, SB_FALSE);
+      return;
+    }
+  }
+} /*** end of XcpEngineStartDevice ***/
+
+
+/************************************************************************************//**
+** \brief     Ends the firmware update of a device and frees its slot.
+** \param     device Slot of the device.
+** \param     result SB_TRUE if the update succeeded, SB_FALSE otherwise.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineFinishDevice(tXcpEngineDevice *device, sb_uint8 result)
+{
+  /* closing the sockets also removes them from the epoll instance */
+  XcpMasterDeinit(&device->session);
+  device->target->result = result;
+  device->target->durationMs = (sb_uint32)(TimeUtilGetElapsedUs(device->startTimeNs) / 1000ull);
+  device->active = SB_FALSE;
+} /*** end of XcpEngineFinishDevice ***/
+
+
+/************************************************************************************//**
+** \brief     Processes an event on the connection of a device. This is either the
+**            completion of the connection attempt or the arrival of response data.
+** \param     device Slot of the device.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineProcessEvent(tXcpEngineDevice *device)
+{
+  struct epoll_event event;
+  tXcpTransportStatus status;
+
+  /* the event could be for a device that already finished during this iteration */
+  if (device->active == SB_FALSE)
+  {
+    return;
+  }
+
+  /* ------------------- completion of the connection attempt ---------------------- */
+  if (device->target->step == XCP_ENGINE_STEP_TCP_CONNECT)
+  {
+    /* closing the abandoned attempts also removes them from the epoll instance */
+    status = XcpTransportConnectPoll(&device->session.transport, 0);
+    if (status != XCP_TRANSPORT_READY)
+    {
+      if (status == XCP_TRANSPORT_ERROR)
+      {
+        XcpEngineFinishDevice(device, SB_FALSE);
+      }
+      return;
+    }
+    /* from now on only the arrival of response data is of interest */
+    event.events = EPOLLIN;
+    event.data.ptr = device;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, device->session.transport.sock, &event);
+    device->target->step = XCP_ENGINE_STEP_CONNECT;
+    device->connectEndNs = TimeUtilGetTimeNs() + (XCP_ENGINE_CONNECT_TIMEOUT_MS * 1000000ull);
+    if (XcpMasterTransmitConnect(&device->session) == SB_FALSE)
+    {
+      XcpEngineFinishDevice(device, SB_FALSE);
+      return;
+    }
+    XcpEngineUpdateDeadline(device);
+    return;
+  }
+
+  /* ------------------- arrival of response data ---------------------------------- */
+  /* one receive operation can deliver several responses, so process them all */
+  while ((status = XcpTransportPollPacket(&device->session.transport)) == XCP_TRANSPORT_READY)
+  {
+    /* ignore the late response of a command that already timed out */
+    if (device->session.pendingCnt == 0)
+    {
+      continue;
+    }
+    if (XcpEngineProcessResponse(device) == SB_FALSE)
+    {
+      /* the device finished, either on an error or because the update is done */
+      return;
+    }
+  }
+  if (status == XCP_TRANSPORT_ERROR)
+  {
+    /* the slave does not necessarily respond to the reset command and could close the
+     * connection when it starts the new firmware.
+     */
+    XcpEngineFinishDevice(device, (device->target->step == XCP_ENGINE_STEP_RESET) ?
+                                  SB_TRUE : SB_FALSE);
+    if (device->target->step == XCP_ENGINE_STEP_RESET)
+    {
+      device->target->step = XCP_ENGINE_STEP_DONE;
+    }
+  }
+} /*** end of XcpEngineProcessEvent ***/
+
+
+/************************************************************************************//**
+** \brief     Processes the situation where a device did not respond in time.
+** \param     device Slot of the device.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineProcessTimeout(tXcpEngineDevice *device)
+{
+  XcpMasterHandleTimeout(&device->session);
+
+  switch (device->target->step)
+  {
+    case XCP_ENGINE_STEP_CONNECT:
+      /* the device might not be running the bootloader yet, so keep trying */
+      if (TimeUtilGetTimeNs() < device->connectEndNs)
+      {
+        if (XcpMasterTransmitConnect(&device->session) == SB_TRUE)
+        {
+          XcpEngineUpdateDeadline(device);
+          return;
+        }
+      }
+      XcpEngineFinishDevice(device, SB_FALSE);
+      break;
+
+    case XCP_ENGINE_STEP_PROGRAM:
+      /* report the address of the command that did not get its response */
+      device->target->errorAddress = device->inFlight[device->inFlightHead].address;
+      device->target->errorAddressValid = SB_TRUE;
+      XcpEngineFinishDevice(device, SB_FALSE);
+      break;
+
+    case XCP_ENGINE_STEP_RESET:
+      /* the slave does not necessarily respond to the reset command */
+      XcpEngineFinishDevice(device, SB_TRUE);
+      device->target->step = XCP_ENGINE_STEP_DONE;
+      break;
+
+    default:
+      XcpEngineFinishDevice(device, SB_FALSE);
+      break;
+  }
+} /*** end of XcpEngineProcessTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Processes the response of the oldest command in flight of a device and
+**            advances its firmware update to the next step when appropriate.
+** \param     device Slot of the device.
+** \return    SB_TRUE if the update continues, SB_FALSE if the device finished.
+**
+****************************************************************************************/
+static sb_uint8 XcpEngineProcessResponse(tXcpEngineDevice *device)
+{
+  tXcpMasterSession *session = &device->session;
+  tXcpEngineTarget *target = device->target;
+  tXcpEngineInFlight *inFlight = SB_NULL;
+  sb_uint8 result = SB_TRUE;
+
+  /* while programming, each response belongs to an entry in the in-flight list */
+  if (target->step == XCP_ENGINE_STEP_PROGRAM)
+  {
+    inFlight = &device->inFlight[device->inFlightHead];
+    device->inFlightHead = (device->inFlightHead + 1) % XCP_MASTER_PENDING_MAX;
+  }
+  if (XcpMasterHandleResponse(session) == SB_FALSE)
+  {
+    if (inFlight != SB_NULL)
+    {
+      target->errorAddress = inFlight->address;
+      target->errorAddressValid = SB_TRUE;
+    }
+    /* the reset command is allowed to fail, because it is not always responded to */
+    if (target->step == XCP_ENGINE_STEP_RESET)
+    {
+      target->step = XCP_ENGINE_STEP_DONE;
+      XcpEngineFinishDevice(device, SB_TRUE);
+    }
+    else
+    {
+      XcpEngineFinishDevice(device, SB_FALSE);
+    }
+    return SB_FALSE;
+  }
+  if (inFlight != SB_NULL)
+  {
+    target->bytesProgrammed += inFlight->len;
+  }
+
+  /* wait for the other commands in flight of the current step, except while programming
+   * where new commands are transmitted as soon as there is room in the window.
+   */
+  if ( (session->pendingCnt > 0) && (target->step != XCP_ENGINE_STEP_PROGRAM) )
+  {
+    XcpEngineUpdateDeadline(device);
+    return SB_TRUE;
+  }
+
+  switch (target->step)
+  {
+    case XCP_ENGINE_STEP_CONNECT:
+      target->step = XCP_ENGINE_STEP_PROGRAM_START;
+      result = XcpMasterTransmitProgramStart(session);
+      break;
+
+    case XCP_ENGINE_STEP_PROGRAM_START:
+      /* erase memory, which requires the MTA to point to the start of the firmware */
+      target->step = XCP_ENGINE_STEP_CLEAR;
+      result = XcpMasterTransmitSetMta(session, firmwareInfo->address_low);
+      if (result == SB_TRUE)
+      {
+        result = XcpMasterTransmitProgramClear(session, firmwareInfo->address_high -
+                                                        firmwareInfo->address_low);
+      }
+      break;
+
+    case XCP_ENGINE_STEP_CLEAR:
+      /* start programming. the MTA is set again before the first program command */
+      target->step = XCP_ENGINE_STEP_PROGRAM;
+      device->mtaValid = SB_FALSE;
+      result = XcpEngineFillProgramWindow(device);
+      break;
+
+    case XCP_ENGINE_STEP_PROGRAM:
+      result = XcpEngineFillProgramWindow(device);
+      if ( (result == SB_TRUE) && (session->pendingCnt == 0) && (device->endOfImage == SB_TRUE) )
+      {
+        /* all data programmed */
+        target->step = XCP_ENGINE_STEP_PROGRAM_STOP;
+        result = XcpMasterTransmitProgramStop(session);
+      }
+      break;
+
+    case XCP_ENGINE_STEP_PROGRAM_STOP:
+      target->step = XCP_ENGINE_STEP_RESET;
+      result = XcpMasterTransmitProgramReset(session);
+      break;
+
+    default:
+      /* the reset command was responded to */
+      target->step = XCP_ENGINE_STEP_DONE;
+      XcpEngineFinishDevice(device, SB_TRUE);
+      return SB_FALSE;
+  }
+
+  if (result == SB_FALSE)
+  {
+    XcpEngineFinishDevice(device, SB_FALSE);
+    return SB_FALSE;
+  }
+  XcpEngineUpdateDeadline(device);
+  return SB_TRUE;
+} /*** end of XcpEngineProcessResponse ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits program commands until the program window of a device is full
+**            or all data of the firmware image was transmitted. A SET MTA command is
+**            transmitted first at the start of each segment of the image.
+** \param     device Slot of the device.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpEngineFillProgramWindow(tXcpEngineDevice *device)
+{
+  tXcpMasterSession *session = &device->session;
+  tXcpEngineInFlight *inFlight;
+  const tSrecordSegment *segment;
+  sb_uint32 address;
+  sb_uint32 currentWriteCnt;
+
+  while ( (device->endOfImage == SB_FALSE) && (session->pendingCnt < session->programWindow) )
+  {
+    /* move on to the next segment once the current one was transmitted completely */
+    if (device->segmentIdx >= firmwareImage->segmentCnt)
+    {
+      device->endOfImage = SB_TRUE;
+      break;
+    }
+    segment = &firmwareImage->segments[device->segmentIdx];
+    if (device->segmentOffset >= segment->length)
+    {
+      device->segmentIdx++;
+      device->segmentOffset = 0;
+      continue;
+    }
+    address = segment->address + device->segmentOffset;
+    inFlight = &device->inFlight[(device->inFlightHead + session->pendingCnt) % XCP_MASTER_PENDING_MAX];
+    inFlight->address = address;
+    /* make sure the MTA points to the data */
+    if ( (device->mtaValid == SB_FALSE) || (address != device->mtaAddress) )
+    {
+      if (XcpMasterTransmitSetMta(session, address) == SB_FALSE)
+      {
+        device->target->errorAddress = address;
+        device->target->errorAddressValid = SB_TRUE;
+        return SB_FALSE;
+      }
+      inFlight->len = 0;
+      device->mtaAddress = address;
+      device->mtaValid = SB_TRUE;
+      continue;
+    }
+    /* transmit the next part of the segment */
+    currentWriteCnt = XcpMasterTransmitProgramData(session, segment->length - device->segmentOffset,
+                                                   &segment->data[device->segmentOffset]);
+    if (currentWriteCnt == 0)
+    {
+      device->target->errorAddress = address;
+      device->target->errorAddressValid = SB_TRUE;
+      return SB_FALSE;
+    }
+    inFlight->len = currentWriteCnt;
+    device->segmentOffset += currentWriteCnt;
+    /* the slave automatically increments the MTA */
+    device->mtaAddress += currentWriteCnt;
+  }
+  return SB_TRUE;
+} /*** end of XcpEngineFillProgramWindow ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the time that the response of the oldest command in flight of a
+**            device is due.
+** \param     device Slot of the device.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpEngineUpdateDeadline(tXcpEngineDevice *device)
+{
+  device->deadlineNs = TimeUtilGetTimeNs() +
+                       (XcpMasterGetResponseTimeout(&device->session) * 1000000ull);
+} /*** end of XcpEngineUpdateDeadline ***/
+
+
+/*********************************** end of xcpengine.c *********************************/
@@ -49,7 +49,11 @@
 #include "timeutil.h"                                 /* time utility module           */
 #include <sys/socket.h>
 #include <arpa/inet.h>
-#include <signal.h>
+#include <netdb.h>                                    /* network database operations   */
+#include <poll.h>                                     /* I/O multiplexing              */
+#include <sys/uio.h>                                  /* scatter/gather I/O            */
+#include <netinet/in.h>                               /* internet protocol family      */
+#include <netinet/tcp.h>                              /* TCP socket options            */
 
 
 
@@ -61,54 +65,276 @@
 #define XCP_MASTER_UART_MAX_DATA ((XCP_MASTER_TX_MAX_DATA>XCP_MASTER_RX_MAX_DATA) ? \
                                   (XCP_MASTER_TX_MAX_DATA+1) : (XCP_MASTER_RX_MAX_DATA+1))
 
-/** \brief The smallest time in millisecond that the UART is configured for. */
-#define UART_RX_TIMEOUT_MIN_MS   (200)
+/** \brief Socket buffer size of the low latency profile. Large enough to hold the
+ *         maximum number of program commands that can be in flight.
+ */
+#define XCP_TRANSPORT_SOCKET_BUFFER_SIZE (XCP_MASTER_PROGRAM_WINDOW_MAX * XCP_MASTER_UART_MAX_DATA)
+
+/** \brief Time after which an unresponsive peer is considered dead by the low latency
+ *         profile. The bootloader might not service its TCP/IP stack while erasing, so
+ *         this must be longer than the erase timeout.
+ */
+#define XCP_TRANSPORT_DEAD_PEER_TIMEOUT_MS (15000)
+
+/** \brief Idle time before the first keepalive probe of the low latency profile. */
+#define XCP_TRANSPORT_KEEPALIVE_IDLE_S   (5)
+
+/** \brief Interval between keepalive probes of the low latency profile. */
+#define XCP_TRANSPORT_KEEPALIVE_INTVL_S  (2)
+
+/** \brief Number of unanswered keepalive probes before the connection is dropped. */
+#define XCP_TRANSPORT_KEEPALIVE_CNT      (5)
 
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
+static sb_uint8 XcpTransportExtractPacket(tXcpTransport *transport);
+static sb_uint8 XcpTransportFillRxBuffer(tXcpTransport *transport, sb_uint64 timeoutTimeNs);
+static tXcpTransportStatus XcpTransportRecv(tXcpTransport *transport);
+static sb_int32 XcpTransportGetRemainingMs(sb_uint64 timeoutTimeNs);
+static void     XcpTransportApplyProfile(tXcpTransport *transport, sb_int32 sock);
+static void     XcpTransportRearmQuickAck(tXcpTransport *transport);
 
 
 /****************************************************************************************
 * Local data declarations
 ****************************************************************************************/
-static tXcpTransportResponsePacket responsePacket;
-
-static struct sockaddr_in server;
-static int sock;
-
-static void XcpTransportPipe(int signum)
-{
-  printf("remote closed connection\n");
-  abort();
-}
+/** \brief Empty response packet, handed out when no response packet was received. It is
+ *         never modified, so it can be shared by all transport instances.
+ */
+static tXcpTransportResponsePacket emptyPacket;
 
 
 /************************************************************************************//**
 ** \brief     Initializes the communication interface used by this transport layer.
-** \param     device Serial communication device name. For example "COM4".
+** \param     transport Transport layer instance.
+** \param     address Device host name or address. For example "192.168.1.100".
+** \param     port TCP port of the device.
+** \param     profile Socket profile to apply to the connection.
+** \param     connectTimeoutMs Time that establishing the connection is allowed to take.
 ** \return    SB_TRUE if successful, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpTransportInit(sb_char *address, sb_uint32 port)
+sb_uint8 XcpTransportInit(tXcpTransport *transport, sb_char *address, sb_uint32 port,
+                          tXcpTransportProfile profile, sb_uint32 connectTimeoutMs)
 {
-  sock = socket(AF_INET, SOCK_STREAM, 0);
-  if(sock == -1) {
+  tXcpTransportHost *host;
+  sb_uint64 timeoutTimeNs;
+  sb_int32 remainingMs;
+  tXcpTransportStatus status;
+  sb_uint8 started;
+
+  /* start connecting */
+  transport->sock = -1;
+  transport->connectSockCnt = 0;
+  host = XcpTransportResolve(address, port);
+  if (host == SB_NULL)
+  {
+    return SB_FALSE;
+  }
+  started = XcpTransportConnectStart(transport, host, profile);
+  XcpTransportFreeHost(host);
+  if (started == SB_FALSE)
+  {
     return SB_FALSE;
   }
+  /* wait for the connection attempt to complete */
+  timeoutTimeNs = TimeUtilGetTimeNs() + (connectTimeoutMs * 1000000ull);
+  do
+  {
+    remainingMs = XcpTransportGetRemainingMs(timeoutTimeNs);
+    if (remainingMs <= 0)
+    {
+      /* timeout occurred */
+      XcpTransportClose(transport);
+      return SB_FALSE;
+    }
+    status = XcpTransportConnectPoll(transport, remainingMs);
+  }
+  while (status == XCP_TRANSPORT_PENDING);
+
+  return (status == XCP_TRANSPORT_READY) ? SB_TRUE : SB_FALSE;
+} /*** end of XcpTransportInit ***/
 
-  server.sin_addr.s_addr = inet_addr(address);
-  server.sin_family = AF_INET;
-  server.sin_port = htons(port);
 
-  if(connect(sock, (struct sockaddr*) &server, sizeof(server)) < 0) {
+/************************************************************************************//**
+** \brief     Resolves the host name of a device into its addresses, IPv4 as well as
+**            IPv6. This blocks for as long as the name lookup takes.
+** \param     address Device host name or address. For example "192.168.1.100".
+** \param     port TCP port of the device.
+** \return    The addresses, to be released with XcpTransportFreeHost(), or SB_NULL if
+**            the host name could not be resolved.
+**
+****************************************************************************************/
+tXcpTransportHost *XcpTransportResolve(const sb_char *address, sb_uint32 port)
+{
+  struct addrinfo hints;
+  struct addrinfo *results;
+  sb_char service[8];
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  hints.ai_flags = AI_ADDRCONFIG;
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(address, service, &hints, &results) != 0)
+  {
+    return SB_NULL;
+  }
+  return results;
+} /*** end of XcpTransportResolve ***/
+
+
+/************************************************************************************//**
+** \brief     Releases the addresses that were obtained with XcpTransportResolve().
+** \param     host The addresses, or SB_NULL.
+** \return    none.
+**
+****************************************************************************************/
+void XcpTransportFreeHost(tXcpTransportHost *host)
+{
+  if (host != SB_NULL)
+  {
+    freeaddrinfo(host);
+  }
+} /*** end of XcpTransportFreeHost ***/
+
+
+/************************************************************************************//**
+** \brief     Starts connecting the communication interface used by this transport layer
+**            without waiting for the connection to be established. A connection attempt
+**            is started to each address of the host. These attempts race each other and
+**            the first one that completes is used. The sockets of the attempts become
+**            writable once they complete, after which XcpTransportConnectPoll() should
+**            be called. All sockets are in non-blocking mode.
+** \param     transport Transport layer instance.
+** \param     host Addresses of the device, from XcpTransportResolve().
+** \param     profile Socket profile to apply to the connection.
+** \return    SB_TRUE if the connection attempt was started, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpTransportConnectStart(tXcpTransport *transport, const tXcpTransportHost *host,
+                                  tXcpTransportProfile profile)
+{
+  const struct addrinfo *info;
+  sb_int32 sock;
+
+  transport->sock = -1;
+  transport->connectSockCnt = 0;
+  transport->profile = profile;
+
+  /* start a connection attempt to each address */
+  for (info = host; info != SB_NULL; info = info->ai_next)
+  {
+    if (transport->connectSockCnt >= XCP_TRANSPORT_MAX_CONNECT_SOCKS)
+    {
+      break;
+    }
+    sock = socket(info->ai_family, info->ai_socktype | SOCK_NONBLOCK, info->ai_protocol);
+    if (sock < 0)
+    {
+      continue;
+    }
+    /* socket buffer sizes must be configured before the connection is established */
+    XcpTransportApplyProfile(transport, sock);
+    if ( (connect(sock, info->ai_addr, info->ai_addrlen) < 0) && (errno != EINPROGRESS) )
+    {
+      close(sock);
+      continue;
+    }
+    transport->connectSocks[transport->connectSockCnt++] = sock;
+  }
+  if (transport->connectSockCnt == 0)
+  {
     return SB_FALSE;
   }
 
-  signal(SIGPIPE, XcpTransportPipe);
+  /* start with fresh statistics and an empty receive buffer for this connection */
+  memset(&transport->stats, 0, sizeof(transport->stats));
+  transport->rxPacketNumber = 0;
+  transport->rxHead = 0;
+  transport->rxTail = 0;
+  transport->responsePacketPtr = &emptyPacket;
+  transport->connectStartNs = TimeUtilGetTimeNs();
   return SB_TRUE;
-} /*** end of XcpTransportInit ***/
+} /*** end of XcpTransportConnectStart ***/
+
+
+/************************************************************************************//**
+** \brief     Checks the connection attempts that were started with
+**            XcpTransportConnectStart(). The first attempt that succeeded becomes the
+**            connection of this transport layer and the other attempts are abandoned.
+**            Attempts that failed are closed.
+** \param     transport Transport layer instance.
+** \param     timeOutMs Time to wait for an attempt to complete. 0 to not wait at all.
+** \return    XCP_TRANSPORT_READY if the connection was established,
+**            XCP_TRANSPORT_PENDING if attempts are still in progress,
+**            XCP_TRANSPORT_ERROR if all attempts failed.
+**
+****************************************************************************************/
+tXcpTransportStatus XcpTransportConnectPoll(tXcpTransport *transport, sb_int32 timeOutMs)
+{
+  struct pollfd pfds[XCP_TRANSPORT_MAX_CONNECT_SOCKS];
+  sb_uint8 idx;
+  sb_uint8 remainingCnt = 0;
+  int error;
+  socklen_t errorLen;
+
+  /* wait for one of the attempts to complete */
+  for (idx=0; idx<transport->connectSockCnt; idx++)
+  {
+    pfds[idx].fd = transport->connectSocks[idx];
+    pfds[idx].events = POLLOUT;
+    pfds[idx].revents = 0;
+  }
+  if (poll(pfds, transport->connectSockCnt, timeOutMs) < 0)
+  {
+    return (errno == EINTR) ? XCP_TRANSPORT_PENDING : XCP_TRANSPORT_ERROR;
+  }
+
+  /* obtain the result of the completed attempts */
+  for (idx=0; idx<transport->connectSockCnt; idx++)
+  {
+    if ( (pfds[idx].revents != 0) && (transport->sock < 0) )
+    {
+      error = 0;
+      errorLen = sizeof(error);
+      if ( (getsockopt(pfds[idx].fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) == 0) &&
+           (error == 0) )
+      {
+        /* the winner of the race */
+        transport->sock = pfds[idx].fd;
+        continue;
+      }
+    }
+    /* close the failed attempts, and all others once there is a winner */
+    if ( (pfds[idx].revents != 0) || (transport->sock >= 0) )
+    {
+      close(pfds[idx].fd);
+    }
+    else
+    {
+      transport->connectSocks[remainingCnt++] = pfds[idx].fd;
+    }
+  }
+  /* close the attempts that were still pending before the winner was found */
+  if (transport->sock >= 0)
+  {
+    for (idx=0; idx<remainingCnt; idx++)
+    {
+      close(transport->connectSocks[idx]);
+    }
+    transport->connectSockCnt = 0;
+    /* the handshake gives a first impression of the round trip time */
+    transport->stats.connectRttUs = (sb_uint32)TimeUtilGetElapsedUs(transport->connectStartNs);
+    XcpTransportRearmQuickAck(transport);
+    return XCP_TRANSPORT_READY;
+  }
+  transport->connectSockCnt = remainingCnt;
+  return (remainingCnt > 0) ? XCP_TRANSPORT_PENDING : XCP_TRANSPORT_ERROR;
+} /*** end of XcpTransportConnectPoll ***/
 
 
 /************************************************************************************//**
@@ -116,111 +342,494 @@ sb_uint8 XcpTransportInit(sb_char *address, sb_uint32 port)
 **            response within the given timeout. The data in the response packet is
 **            stored in an internal data buffer that can be obtained through function
 **            XcpTransportReadResponsePacket().
+** \param     transport Transport layer instance.
+** \param     segments Array with the segments that form the packet.
+** \param     segmentCnt Number of segments in the array.
+** \param     timeOutMs Maximum time to wait for the response.
 ** \return    SB_TRUE is the response packet was successfully received and stored,
 **            SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpTransportSendPacket(sb_uint8 *data, sb_uint8 len, sb_uint16 timeOutMs)
+sb_uint8 XcpTransportSendPacket(tXcpTransport *transport, tXcpTransportSegment segments[],
+                                sb_uint8 segmentCnt, sb_uint16 timeOutMs)
 {
-  sb_uint16 cnt;
-  static sb_uint8 xcpUartBuffer[XCP_MASTER_UART_MAX_DATA]; /* static to lower stack load */
-  sb_uint16 xcpUartLen;
-  sb_int32 bytesSent;
-  sb_int32 bytesToRead;
-  sb_int32 bytesRead;
-  sb_uint8 *uartReadDataPtr;
-  sb_uint32 timeoutTime;
-  sb_uint32 nowTime;
+  /* transmit the packet */
+  if (XcpTransportTransmitPacket(transport, segments, segmentCnt, timeOutMs) == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+  /* wait for its response */
+  return XcpTransportReceivePacket(transport, timeOutMs);
+} /*** end of XcpMasterTpSendPacket ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits an XCP packet on the transport layer without waiting for its
+**            response. This allows several packets to be in flight at the same time.
+**            Their responses are obtained in order with XcpTransportReceivePacket().
+**            The packet is made up of one or more segments, which are transmitted
+**            directly from the caller's buffers together with the length byte.
+** \param     transport Transport layer instance.
+** \param     segments Array with the segments that form the packet.
+** \param     segmentCnt Number of segments in the array.
+** \param     timeOutMs Maximum time to wait for room in the socket buffer, when the
+**            slave does not read the packets that were transmitted before.
+** \return    SB_TRUE if the packet was transmitted, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpTransportTransmitPacket(tXcpTransport *transport, tXcpTransportSegment segments[],
+                                    sb_uint8 segmentCnt, sb_uint16 timeOutMs)
+{
+  struct iovec iov[XCP_TRANSPORT_MAX_SEGMENTS + 1];
+  struct msghdr msg;
+  struct iovec *iovPtr;
+  struct pollfd pfd;
+  sb_uint8 lengthByte = 0;
+  sb_uint8 cnt;
   ssize_t result;
+  sb_uint64 timeoutTimeNs = 0;
+  sb_int32 remainingMs;
+
+  assert(segmentCnt <= XCP_TRANSPORT_MAX_SEGMENTS);
 
-  /* ------------------------ XCP packet transmission -------------------------------- */
-  /* prepare the XCP packet for transmission on UART. this is basically the same as the
-   * xcp packet data but just the length of the packet is added to the first byte.
+  /* the XCP packet on TCP is the same as the xcp packet data, but the length of the
+   * packet is added as the first byte.
    */
-  xcpUartLen = len+1;
-  xcpUartBuffer[0] = len;
-  for (cnt=0; cnt<len; cnt++)
+  for (cnt=0; cnt<segmentCnt; cnt++)
   {
-    xcpUartBuffer[cnt+1] = data[cnt];
+    iov[cnt+1].iov_base = (void *)segments[cnt].data;
+    iov[cnt+1].iov_len = segments[cnt].len;
+    lengthByte += segments[cnt].len;
   }
+  iov[0].iov_base = &lengthByte;
+  iov[0].iov_len = 1;
 
-  if(send(sock, xcpUartBuffer, xcpUartLen, 0) < 0) {
-    return SB_FALSE;
-  }
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = segmentCnt + 1;
 
-  /* ------------------------ XCP packet reception ----------------------------------- */
-  /* determine timeout time */
-  timeoutTime = TimeUtilGetSystemTimeMs() + timeOutMs + UART_RX_TIMEOUT_MIN_MS;
+  /* remember when this packet was transmitted for measuring the round trip time. this
+   * is done up front, because the response can arrive before sendmsg() returns.
+   */
+  transport->txTimestamps[transport->stats.packets % XCP_TRANSPORT_TX_TIMESTAMPS] = TimeUtilGetTimeNs();
 
-  /* read the first byte, which contains the length of the xcp packet that follows */
-  bytesToRead = 1;
-  uartReadDataPtr = &responsePacket.len;
-  while(bytesToRead > 0)
+  /* transmit the segments, continuing where the previous call left off in case only
+   * part of the packet was accepted by the socket.
+   */
+  for (;;)
   {
-    result = recv(sock, uartReadDataPtr, bytesToRead, MSG_DONTWAIT);
-    if (result >= 0)
+    transport->stats.sendCalls++;
+    /* a closed connection is reported through the return value instead of SIGPIPE,
+     * which would affect all connections in the process.
+     */
+    result = sendmsg(transport->sock, &msg, MSG_NOSIGNAL);
+    if (result < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+      {
+        /* the socket buffer is full. wait for room to become available, but not
+         * longer than the slave is allowed to take for the response, such that a
+         * slave that stopped reading cannot block the caller forever.
+         */
+        if (timeoutTimeNs == 0)
+        {
+          timeoutTimeNs = TimeUtilGetTimeNs() + (timeOutMs * 1000000ull);
+        }
+        remainingMs = XcpTransportGetRemainingMs(timeoutTimeNs);
+        if (remainingMs <= 0)
+        {
+          return SB_FALSE;
+        }
+        pfd.fd = transport->sock;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, remainingMs);
+        continue;
+      }
+      return SB_FALSE;
+    }
+    /* skip the segments that were sent completely */
+    iovPtr = msg.msg_iov;
+    while ( (msg.msg_iovlen > 0) && ((size_t)result >= iovPtr->iov_len) )
     {
-      bytesRead = result;
-      /* update the bytes that were already read */
-      uartReadDataPtr += bytesRead;
-      bytesToRead -= bytesRead;
+      result -= iovPtr->iov_len;
+      iovPtr++;
+      msg.msg_iovlen--;
     }
-    /* check for timeout if not yet done */
-    if ( (bytesToRead > 0) && (TimeUtilGetSystemTimeMs() >= timeoutTime) )
+    if (msg.msg_iovlen == 0)
     {
-      /* timeout occurred */
-      return SB_FALSE;
+      break;
     }
+    /* adjust the partially sent segment */
+    iovPtr->iov_base = (sb_uint8 *)iovPtr->iov_base + result;
+    iovPtr->iov_len -= result;
+    msg.msg_iov = iovPtr;
   }
+  transport->stats.packets++;
+  return SB_TRUE;
+} /*** end of XcpTransportTransmitPacket ***/
+
 
-  /* read the rest of the packet */
-  bytesToRead = responsePacket.len;
-  uartReadDataPtr = &responsePacket.data[0];
-  while(bytesToRead > 0)
+/************************************************************************************//**
+** \brief     Attempts to receive the response of the oldest transmitted packet within
+**            the given timeout. The data in the response packet is stored in an
+**            internal data buffer that can be obtained through function
+**            XcpTransportReadResponsePacket().
+** \param     transport Transport layer instance.
+** \param     timeOutMs Maximum time to wait for the response.
+** \return    SB_TRUE is the response packet was successfully received and stored,
+**            SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpTransportReceivePacket(tXcpTransport *transport, sb_uint16 timeOutMs)
+{
+  sb_uint64 timeoutTimeNs;
+
+  /* reset the wakeup counter for this command */
+  transport->stats.lastWakeups = 0;
+  transport->responsePacketPtr = &emptyPacket;
+
+  /* determine timeout time */
+  timeoutTimeNs = TimeUtilGetTimeNs() + (timeOutMs * 1000000ull);
+
+  /* wait until a complete packet is available in the receive buffer */
+  while (XcpTransportExtractPacket(transport) == SB_FALSE)
   {
-    result = recv(sock, uartReadDataPtr, bytesToRead, MSG_DONTWAIT);
-    if (result >= 0)
-    {
-      bytesRead = result;
-      /* update the bytes that were already read */
-      uartReadDataPtr += bytesRead;
-      bytesToRead -= bytesRead;
-    }
-    /* check for timeout if not yet done */
-    if ( (bytesToRead > 0) && (TimeUtilGetSystemTimeMs() >= timeoutTime) )
+    /* wait for more data to arrive */
+    if (XcpTransportFillRxBuffer(transport, timeoutTimeNs) == SB_FALSE)
     {
-      /* timeout occurred */
+      /* the responses of the packets in flight can no longer be matched to their
+       * transmit time.
+       */
+      transport->rxPacketNumber = transport->stats.packets;
       return SB_FALSE;
     }
   }
-  /* still here so the complete packet was received */
   return SB_TRUE;
-} /*** end of XcpMasterTpSendPacket ***/
+} /*** end of XcpTransportReceivePacket ***/
+
+
+/************************************************************************************//**
+** \brief     Checks if the response of the oldest transmitted packet is available,
+**            without waiting for it. Data that the socket has ready is read into the
+**            receive buffer first. If a response packet is available, it can be obtained
+**            through function XcpTransportReadResponsePacket(). Should be called again
+**            until it no longer reports a response packet, because one receive operation
+**            can deliver several response packets.
+** \param     transport Transport layer instance.
+** \return    XCP_TRANSPORT_READY if a response packet is available,
+**            XCP_TRANSPORT_PENDING if not yet, XCP_TRANSPORT_ERROR if the
+**            connection failed.
+**
+****************************************************************************************/
+tXcpTransportStatus XcpTransportPollPacket(tXcpTransport *transport)
+{
+  tXcpTransportStatus status;
+
+  /* try the data that was already received first */
+  transport->responsePacketPtr = &emptyPacket;
+  if (XcpTransportExtractPacket(transport) == SB_TRUE)
+  {
+    return XCP_TRANSPORT_READY;
+  }
+  /* read whatever the socket has ready */
+  status = XcpTransportRecv(transport);
+  if (status != XCP_TRANSPORT_READY)
+  {
+    return status;
+  }
+  return (XcpTransportExtractPacket(transport) == SB_TRUE) ? XCP_TRANSPORT_READY :
+                                                             XCP_TRANSPORT_PENDING;
+} /*** end of XcpTransportPollPacket ***/
 
 
 /************************************************************************************//**
 ** \brief     Reads the data from the response packet. Make sure to not call this
 **            function while XcpTransportSendPacket() is active, because the data won't be
-**            valid then.
+**            valid then. The packet remains valid until the next packet is received.
+** \param     transport Transport layer instance.
 ** \return    Pointer to the response packet data.
 **
 ****************************************************************************************/
-tXcpTransportResponsePacket *XcpTransportReadResponsePacket(void)
+tXcpTransportResponsePacket *XcpTransportReadResponsePacket(tXcpTransport *transport)
 {
-  return &responsePacket;
+  return transport->responsePacketPtr;
 } /*** end of XcpTransportReadResponsePacket ***/
 
 
+/************************************************************************************//**
+** \brief     Obtains the statistics of the transport layer. The wakeup counter of the
+**            last command is updated by each call to XcpTransportSendPacket().
+** \param     transport Transport layer instance.
+** \return    Pointer to the transport layer statistics.
+**
+****************************************************************************************/
+tXcpTransportStats *XcpTransportGetStats(tXcpTransport *transport)
+{
+  return &transport->stats;
+} /*** end of XcpTransportGetStats ***/
+
+
 /************************************************************************************//**
 ** \brief     Closes the communication channel.
+** \param     transport Transport layer instance.
 ** \return    none.
 **
 ****************************************************************************************/
-void XcpTransportClose(void)
+void XcpTransportClose(tXcpTransport *transport)
 {
-  signal(SIGPIPE, SIG_DFL);
-  close(sock);
+  sb_uint8 idx;
+
+  /* abandon the connection attempts that are still in progress */
+  for (idx=0; idx<transport->connectSockCnt; idx++)
+  {
+    close(transport->connectSocks[idx]);
+  }
+  transport->connectSockCnt = 0;
+  if (transport->sock >= 0)
+  {
+    close(transport->sock);
+    transport->sock = -1;
+  }
 } /*** end of XcpTransportClose ***/
 
 
+/************************************************************************************//**
+** \brief     Hands out the next response packet if it is completely available in the
+**            receive buffer. The packet is not copied.
+** \param     transport Transport layer instance.
+** \return    SB_TRUE if a response packet is available, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpTransportExtractPacket(tXcpTransport *transport)
+{
+  sb_uint32 available;
+  sb_uint32 rttUs;
+
+  /* is a complete packet available in the receive buffer? the first byte contains the
+   * length of the xcp packet that follows.
+   */
+  available = transport->rxTail - transport->rxHead;
+  if ( (available == 0) || (available < (sb_uint32)transport->rxBuffer[transport->rxHead] + 1) )
+  {
+    return SB_FALSE;
+  }
+  /* hand out the packet without copying it */
+  transport->responsePacketPtr = (tXcpTransportResponsePacket *)&transport->rxBuffer[transport->rxHead];
+  transport->rxHead += transport->responsePacketPtr->len + 1;
+  /* update the round trip time statistics */
+  rttUs = (sb_uint32)TimeUtilGetElapsedUs(transport->txTimestamps[transport->rxPacketNumber %
+                                                                 XCP_TRANSPORT_TX_TIMESTAMPS]);
+  transport->rxPacketNumber++;
+  transport->stats.lastRttUs = rttUs;
+  if ( (transport->stats.rttCount == 0) || (rttUs < transport->stats.rttMinUs) )
+  {
+    transport->stats.rttMinUs = rttUs;
+  }
+  if (rttUs > transport->stats.rttMaxUs)
+  {
+    transport->stats.rttMaxUs = rttUs;
+  }
+  transport->stats.rttTotalUs += rttUs;
+  transport->stats.rttCount++;
+  return SB_TRUE;
+} /*** end of XcpTransportExtractPacket ***/
+
+
+/************************************************************************************//**
+** \brief     Receives as many bytes as the socket has ready into the receive buffer.
+**            The calling thread sleeps in poll() until data is available or the deadline
+**            passes, so no CPU time is spent while waiting for a slow response.
+** \param     transport Transport layer instance.
+** \param     timeoutTimeNs Deadline in nanoseconds, as returned by TimeUtilGetTimeNs().
+** \return    SB_TRUE if at least one byte was received before the deadline, SB_FALSE
+**            otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpTransportFillRxBuffer(tXcpTransport *transport, sb_uint64 timeoutTimeNs)
+{
+  struct pollfd pfd;
+  sb_int32 remainingMs;
+  sb_int32 result;
+
+  pfd.fd = transport->sock;
+  pfd.events = POLLIN;
+
+  for (;;)
+  {
+    /* determine how long we are still allowed to wait */
+    remainingMs = XcpTransportGetRemainingMs(timeoutTimeNs);
+    if (remainingMs <= 0)
+    {
+      /* timeout occurred */
+      return SB_FALSE;
+    }
+    /* sleep until data is available or the deadline passes */
+    result = poll(&pfd, 1, remainingMs);
+    if (result < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return SB_FALSE;
+    }
+    transport->stats.lastWakeups++;
+    transport->stats.wakeups++;
+    if (result == 0)
+    {
+      /* timeout occurred */
+      return SB_FALSE;
+    }
+    /* read whatever is available */
+    switch (XcpTransportRecv(transport))
+    {
+      case XCP_TRANSPORT_READY:
+        return SB_TRUE;
+      case XCP_TRANSPORT_ERROR:
+        return SB_FALSE;
+      default:
+        break;
+    }
+  }
+} /*** end of XcpTransportFillRxBuffer ***/
+
+
+/************************************************************************************//**
+** \brief     Performs one non-blocking receive operation, which reads as many bytes as
+**            the socket has ready and fit into the receive buffer.
+** \param     transport Transport layer instance.
+** \return    XCP_TRANSPORT_READY if bytes were received, XCP_TRANSPORT_PENDING if
+**            no bytes were available, XCP_TRANSPORT_ERROR if the connection failed.
+**
+****************************************************************************************/
+static tXcpTransportStatus XcpTransportRecv(tXcpTransport *transport)
+{
+  ssize_t result;
+
+  /* make room in the receive buffer. all unprocessed bytes are moved to the start if
+   * there is not enough room left to complete the largest possible packet.
+   */
+  if (transport->rxHead == transport->rxTail)
+  {
+    transport->rxHead = 0;
+    transport->rxTail = 0;
+  }
+  else if ((XCP_TRANSPORT_RX_BUFFER_SIZE - transport->rxHead) < XCP_MASTER_UART_MAX_DATA)
+  {
+    memmove(&transport->rxBuffer[0], &transport->rxBuffer[transport->rxHead],
+            transport->rxTail - transport->rxHead);
+    transport->rxTail -= transport->rxHead;
+    transport->rxHead = 0;
+  }
+
+  /* read whatever is available and fits in the receive buffer */
+  result = recv(transport->sock, &transport->rxBuffer[transport->rxTail],
+                XCP_TRANSPORT_RX_BUFFER_SIZE - transport->rxTail, MSG_DONTWAIT);
+  transport->stats.recvCalls++;
+  if (result == 0)
+  {
+    /* remote closed the connection */
+    return XCP_TRANSPORT_ERROR;
+  }
+  if (result < 0)
+  {
+    if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) )
+    {
+      return XCP_TRANSPORT_PENDING;
+    }
+    return XCP_TRANSPORT_ERROR;
+  }
+  /* update the bytes that were already read */
+  transport->stats.recvBytes += result;
+  transport->rxTail += result;
+  /* the kernel falls back to delayed acknowledgements after a while */
+  XcpTransportRearmQuickAck(transport);
+  return XCP_TRANSPORT_READY;
+} /*** end of XcpTransportRecv ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the time that is left until a deadline, for passing it on to
+**            poll(). The time is rounded up, such that poll() does not return just
+**            before the deadline.
+** \param     timeoutTimeNs Deadline in nanoseconds, as returned by TimeUtilGetTimeNs().
+** \return    Remaining time in milliseconds, 0 if the deadline passed.
+**
+****************************************************************************************/
+static sb_int32 XcpTransportGetRemainingMs(sb_uint64 timeoutTimeNs)
+{
+  sb_uint64 now = TimeUtilGetTimeNs();
+
+  if (now >= timeoutTimeNs)
+  {
+    return 0;
+  }
+  return (sb_int32)((timeoutTimeNs - now + 999999ull) / 1000000ull);
+} /*** end of XcpTransportGetRemainingMs ***/
+
+
+/************************************************************************************//**
+** \brief     Applies the configured socket profile to the socket. The low latency
+**            profile disables Nagle's algorithm, sizes the socket buffers for the
+**            maximum number of packets in flight and detects a dead peer within
+**            XCP_TRANSPORT_DEAD_PEER_TIMEOUT_MS. Failures are ignored, because the
+**            connection still works without these options.
+** \param     transport Transport layer instance.
+** \param     sock Socket to apply the profile to.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpTransportApplyProfile(tXcpTransport *transport, sb_int32 sock)
+{
+  int value;
+
+  if (transport->profile != XCP_TRANSPORT_PROFILE_LOW_LATENCY)
+  {
+    return;
+  }
+  /* transmit the small XCP packets right away */
+  value = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+  /* size the socket buffers */
+  value = XCP_TRANSPORT_SOCKET_BUFFER_SIZE;
+  setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+  /* drop the connection if transmitted data is not acknowledged in time */
+  value = XCP_TRANSPORT_DEAD_PEER_TIMEOUT_MS;
+  setsockopt(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, &value, sizeof(value));
+  /* probe an idle connection to detect a peer that disappeared */
+  value = 1;
+  setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(value));
+  value = XCP_TRANSPORT_KEEPALIVE_IDLE_S;
+  setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof(value));
+  value = XCP_TRANSPORT_KEEPALIVE_INTVL_S;
+  setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof(value));
+  value = XCP_TRANSPORT_KEEPALIVE_CNT;
+  setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof(value));
+} /*** end of XcpTransportApplyProfile ***/
+
+
+/************************************************************************************//**
+** \brief     Makes sure received data is acknowledged right away when the low latency
+**            profile is used. The kernel clears this option by itself, so it needs to
+**            be set again after each receive operation.
+** \param     transport Transport layer instance.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpTransportRearmQuickAck(tXcpTransport *transport)
+{
+  int value = 1;
+
+  if (transport->profile == XCP_TRANSPORT_PROFILE_LOW_LATENCY)
+  {
+    setsockopt(transport->sock, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+  }
+} /*** end of XcpTransportRearmQuickAck ***/
+
+
 /*********************************** end of xcptransport.c *****************************/
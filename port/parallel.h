@@ -0,0 +1,59 @@
+/************************************************************************************//**
+* \file         port\parallel.h
+* \brief        Parallel execution of jobs header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work 
+* that includes OpenBLT without being obliged to provide the source code for any 
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+* 
+* \endinternal
+****************************************************************************************/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of jobs that run at the same time. */
+#define PARALLEL_JOBS_MAX              (32)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Function type of a job. It receives its own context. */
+typedef void (*tParallelJob)(void *context);
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint32 ParallelGetCpuCount(void);
+void      ParallelRun(tParallelJob job, void *contexts, sb_uint32 contextSize,
+                      sb_uint32 jobCnt);
+
+
+#endif /* PARALLEL_H */
+/*********************************** end of parallel.h *********************************/
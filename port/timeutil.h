@@ -37,7 +37,10 @@
 * Function prototypes
 ****************************************************************************************/
 sb_uint32 TimeUtilGetSystemTimeMs(void);
+sb_uint64 TimeUtilGetTimeNs(void);
+sb_uint64 TimeUtilGetElapsedUs(sb_uint64 startNs);
 void      TimeUtilDelayMs(sb_uint16 delay);
+void      TimeUtilDelayUs(sb_uint32 delay);
 
 
 #endif /* TIMEUTIL_H */
@@ -0,0 +1,93 @@
+/************************************************************************************//**
+* \file         port\xcpengine.h
+* \brief        Engine for concurrent firmware updates of several devices header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+#ifndef XCPENGINE_H
+#define XCPENGINE_H
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "xcpmaster.h"                                /* XCP master protocol module    */
+#include "srecord.h"                                  /* S-record file handling        */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of characters in the address of a device. */
+#define XCP_ENGINE_ADDRESS_MAX_LEN     (64)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enumeration for the steps of the firmware update of a device. */
+typedef enum
+{
+  XCP_ENGINE_STEP_TCP_CONNECT,                   /**< establishing the TCP connection  */
+  XCP_ENGINE_STEP_CONNECT,                       /**< connecting to the bootloader     */
+  XCP_ENGINE_STEP_PROGRAM_START,                 /**< starting the programming session */
+  XCP_ENGINE_STEP_CLEAR,                         /**< erasing memory                   */
+  XCP_ENGINE_STEP_PROGRAM,                       /**< programming data                 */
+  XCP_ENGINE_STEP_PROGRAM_STOP,                  /**< finishing the programming session*/
+  XCP_ENGINE_STEP_RESET,                         /**< performing the software reset    */
+  XCP_ENGINE_STEP_DONE                           /**< firmware update completed        */
+} tXcpEngineStep;
+
+/** \brief Structure type for a device whose firmware is updated, together with the
+ *         result of its firmware update.
+ */
+typedef struct
+{
+  sb_char address[XCP_ENGINE_ADDRESS_MAX_LEN];    /**< device address                  */
+  sb_uint32 port;                                 /**< TCP port of the device          */
+  sb_uint8 result;                                /**< SB_TRUE if update succeeded     */
+  tXcpEngineStep step;                            /**< step reached by the update      */
+  sb_uint32 errorAddress;                         /**< address of failed program cmd   */
+  sb_uint8 errorAddressValid;                     /**< SB_TRUE if errorAddress applies */
+  sb_uint32 bytesProgrammed;                      /**< number of bytes programmed      */
+  sb_uint32 durationMs;                           /**< duration of the update          */
+} tXcpEngineTarget;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint8 XcpEngineRun(tXcpEngineTarget targets[], sb_uint32 targetCnt,
+                      sb_uint32 maxConcurrent, const tSrecordImage *image,
+                      tSrecordParseResults *parseResults, tXcpTransportProfile profile,
+                      sb_uint8 programWindow, sb_uint32 connectTimeoutMs);
+const sb_char *XcpEngineGetStepName(tXcpEngineStep step);
+
+
+#endif /* XCPENGINE_H */
+/*********************************** end of xcpengine.h *********************************/
@@ -33,23 +33,140 @@
 #ifndef XCPTRANSPORT_H
 #define XCPTRANSPORT_H
 
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of segments that an XCP packet can be made up of. */
+#define XCP_TRANSPORT_MAX_SEGMENTS     (4)
+
+/** \brief Number of bytes that the framing adds to each packet. The packet is preceded
+ *         by its length.
+ */
+#define XCP_TRANSPORT_FRAMING_BYTES    (1)
+
+/** \brief Size of the receive buffer. A single recv() call can fill it with several
+ *         response packets.
+ */
+#define XCP_TRANSPORT_RX_BUFFER_SIZE   (4096)
+
+/** \brief Number of transmit timestamps that are kept for measuring the round trip time.
+ *         Should be larger than the number of packets that can be in flight.
+ */
+#define XCP_TRANSPORT_TX_TIMESTAMPS    (XCP_MASTER_PENDING_MAX)
+
+/** \brief Maximum number of addresses of a host name that are raced while connecting. */
+#define XCP_TRANSPORT_MAX_CONNECT_SOCKS (8)
+
+/** \brief Default time in milliseconds that establishing the connection may take. */
+#define XCP_TRANSPORT_CONNECT_TIMEOUT_MS (5000)
+
+
 /****************************************************************************************
 * Type definitions
 ****************************************************************************************/
+/** \brief Structure type for an XCP response packet. The layout matches the framing on
+ *         the wire, which is a length byte followed by the packet data.
+ */
 typedef struct
 {
-  sb_uint8 data[XCP_MASTER_RX_MAX_DATA];
   sb_uint8 len;
+  sb_uint8 data[XCP_MASTER_RX_MAX_DATA];
 } tXcpTransportResponsePacket;
 
+/** \brief Enumeration for the socket profiles of the TCP connection. */
+typedef enum
+{
+  XCP_TRANSPORT_PROFILE_DEFAULT,                 /**< operating system defaults        */
+  XCP_TRANSPORT_PROFILE_LOW_LATENCY              /**< tuned for small request/response */
+} tXcpTransportProfile;
+
+/** \brief Enumeration for the status of a non-blocking connect or receive operation. */
+typedef enum
+{
+  XCP_TRANSPORT_PENDING,                         /**< not completed yet                */
+  XCP_TRANSPORT_READY,                           /**< connected or response available  */
+  XCP_TRANSPORT_ERROR                            /**< connection failed                */
+} tXcpTransportStatus;
+
+/** \brief Structure type for the addresses that the host name of a device resolved to,
+ *         as obtained with XcpTransportResolve().
+ */
+typedef struct addrinfo tXcpTransportHost;
+
+/** \brief Structure type for a segment of an XCP packet that is to be transmitted. The
+ *         segments of a packet are transmitted back-to-back without being copied.
+ */
+typedef struct
+{
+  const sb_uint8 *data;                           /**< segment data                    */
+  sb_uint16 len;                                  /**< number of bytes in the segment  */
+} tXcpTransportSegment;
+
+/** \brief Structure type for grouping the statistics of the transport layer. */
+typedef struct
+{
+  sb_uint32 packets;                              /**< number of transmitted packets   */
+  sb_uint32 wakeups;                              /**< total receive wakeups           */
+  sb_uint32 lastWakeups;                          /**< receive wakeups of last command */
+  sb_uint32 sendCalls;                            /**< number of send syscalls         */
+  sb_uint32 recvCalls;                            /**< number of recv syscalls         */
+  sb_uint32 recvBytes;                            /**< bytes obtained through recv     */
+  sb_uint32 rttCount;                             /**< number of round trip samples    */
+  sb_uint64 rttTotalUs;                           /**< sum of the round trip times     */
+  sb_uint32 rttMinUs;                             /**< shortest round trip time        */
+  sb_uint32 rttMaxUs;                             /**< longest round trip time         */
+  sb_uint32 lastRttUs;                            /**< round trip time of last command */
+  sb_uint32 connectRttUs;                         /**< duration of the TCP handshake   */
+} tXcpTransportStats;
+
+/** \brief Structure type for the state of a transport layer instance. Each connection
+ *         has its own instance, so that several connections can coexist in one process.
+ */
+typedef struct
+{
+  sb_int32 sock;                                  /**< socket of the connection        */
+  sb_int32 connectSocks[XCP_TRANSPORT_MAX_CONNECT_SOCKS]; /**< racing connect attempts */
+  sb_uint8 connectSockCnt;                        /**< number of racing attempts       */
+  sb_uint64 connectStartNs;                       /**< start time of the attempts      */
+  tXcpTransportProfile profile;                   /**< socket profile                  */
+  /** \brief Receive buffer. Response packets are framed as a length byte followed by
+   *         the packet data, which matches the layout of tXcpTransportResponsePacket.
+   *         The response packets are therefore handed out as pointers into this buffer.
+   *         The extra space at the end makes sure such a pointer always references a
+   *         complete structure.
+   */
+  sb_uint8 rxBuffer[XCP_TRANSPORT_RX_BUFFER_SIZE + sizeof(tXcpTransportResponsePacket)];
+  sb_uint32 rxHead;                               /**< first unprocessed byte          */
+  sb_uint32 rxTail;                               /**< just past the last received byte*/
+  tXcpTransportResponsePacket *responsePacketPtr; /**< last received response packet   */
+  /** \brief Transmit timestamps in nanoseconds of the packets in flight, indexed by
+   *         packet number.
+   */
+  sb_uint64 txTimestamps[XCP_TRANSPORT_TX_TIMESTAMPS];
+  sb_uint32 rxPacketNumber;                       /**< packet of next expected response*/
+  tXcpTransportStats stats;                       /**< transport layer statistics      */
+} tXcpTransport;
+
 
 /****************************************************************************************
 * EFunction prototypes
 ****************************************************************************************/
-sb_uint8 XcpTransportInit(sb_char *address, sb_uint32 port);
-sb_uint8 XcpTransportSendPacket(sb_uint8 *data, sb_uint8 len, sb_uint16 timeOutMs);
-tXcpTransportResponsePacket *XcpTransportReadResponsePacket(void);
-void XcpTransportClose(void);
+sb_uint8 XcpTransportInit(tXcpTransport *transport, sb_char *address, sb_uint32 port,
+                          tXcpTransportProfile profile, sb_uint32 connectTimeoutMs);
+tXcpTransportHost *XcpTransportResolve(const sb_char *address, sb_uint32 port);
+void XcpTransportFreeHost(tXcpTransportHost *host);
+sb_uint8 XcpTransportConnectStart(tXcpTransport *transport, const tXcpTransportHost *host,
+                                  tXcpTransportProfile profile);
+tXcpTransportStatus XcpTransportConnectPoll(tXcpTransport *transport, sb_int32 timeOutMs);
+sb_uint8 XcpTransportSendPacket(tXcpTransport *transport, tXcpTransportSegment segments[],
+                                sb_uint8 segmentCnt, sb_uint16 timeOutMs);
+sb_uint8 XcpTransportTransmitPacket(tXcpTransport *transport, tXcpTransportSegment segments[],
+                                    sb_uint8 segmentCnt, sb_uint16 timeOutMs);
+sb_uint8 XcpTransportReceivePacket(tXcpTransport *transport, sb_uint16 timeOutMs);
+tXcpTransportStatus XcpTransportPollPacket(tXcpTransport *transport);
+tXcpTransportResponsePacket *XcpTransportReadResponsePacket(tXcpTransport *transport);
+tXcpTransportStats *XcpTransportGetStats(tXcpTransport *transport);
+void XcpTransportClose(tXcpTransport *transport);
 
 
 #endif /* XCPTRANSPORT_H */
@@ -0,0 +1,620 @@
+/************************************************************************************//**
+* \file         report.c
+* \brief        Progress and result reporting source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <stdio.h>                                    /* standard I/O library          */
+#include <stdarg.h>                                   /* variable arguments            */
+#include <string.h>                                   /* string library                */
+#include "report.h"                                   /* progress and result reporting */
+#include "xcptrace.h"                                 /* timeline export               */
+#include "timeutil.h"                                 /* time utility module           */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for the names of a phase. */
+typedef struct
+{
+  const sb_char *name;                            /**< name in the JSON events         */
+  const sb_char *traceName;                       /**< name in the trace               */
+  const sb_char *errorClass;                      /**< class of an error in the phase  */
+} tReportPhaseInfo;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void ReportWriteJsonString(const sb_char *text);
+static void ReportFlush(void);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Names of the phases, indexed by tReportPhase. An error is classified as a
+ *         problem with the firmware file, the network or the device.
+ */
+static const tReportPhaseInfo reportPhases[REPORT_PHASE_CNT] =
+{
+  { "open",           "open",               "file"    },
+  { "parse",          "parse",              "file"    },
+  { "tcp_connect",    "TCP connect",        "network" },
+  { "connect",        "bootloader connect", "device"  },
+  { "program_start",  "program start",      "device"  },
+  { "erase",          "erase",              "device"  },
+  { "program",        "program",            "device"  },
+  { "program_stop",   "program stop",       "device"  },
+  { "reset",          "reset",              "device"  },
+  { "update_devices", "update devices",     "device"  }
+};
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Buffer of the standard output. */
+static sb_char reportBuffer[REPORT_BUFFER_SIZE];
+
+/** \brief The way the events are rendered. */
+static tReportMode reportMode = REPORT_MODE_HUMAN;
+
+/** \brief Time that the firmware update started. */
+static sb_uint64 reportStartNs;
+
+/** \brief Phase that is in progress. */
+static tReportPhase currentPhase;
+
+/** \brief Time that the phase in progress started. */
+static sb_uint64 phaseStartNs;
+
+/** \brief Time of the last progress event. */
+static sb_uint64 lastProgressNs;
+
+/** \brief Phase that failed, REPORT_PHASE_CNT if none. */
+static tReportPhase failedPhase = REPORT_PHASE_CNT;
+
+/** \brief Address of the failed erase or program command of the failed phase. */
+static sb_uint32 failedAddress;
+
+/** \brief Whether the failed phase failed on a command at failedAddress. */
+static sb_uint8 failedAddressValid = SB_FALSE;
+
+
+/************************************************************************************//**
+** \brief     Initializes the reporting. Must be called before anything is output.
+**            The standard output is fully buffered and flushed once per event, instead
+**            of writing each fragment of text separately.
+** \param     mode The way the events are rendered.
+** \return    none.
+**
+****************************************************************************************/
+void ReportInit(tReportMode mode)
+{
+  reportMode = mode;
+  setvbuf(stdout, reportBuffer, _IOFBF, sizeof(reportBuffer));
+  reportStartNs = TimeUtilGetTimeNs();
+  failedPhase = REPORT_PHASE_CNT;
+  failedAddressValid = SB_FALSE;
+} /*** end of ReportInit ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the start of the firmware update.
+** \param     fileName Name of the firmware file.
+** \param     address Address of the device that was specified with -d.
+** \param     port TCP port of the device that was specified with -p.
+** \param     targetCnt Number of devices that were specified with -t, 0 if the device
+**            was specified with -d and -p instead.
+** \return    none.
+**
+****************************************************************************************/
+void ReportStart(const sb_char *fileName, const sb_char *address, sb_uint32 port,
+                 sb_uint32 targetCnt)
+{
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"start\", \"file\": ");
+    ReportWriteJsonString(fileName);
+    printf(", \"devices\": %u", (targetCnt > 0) ? targetCnt : 1);
+    if (targetCnt == 0)
+    {
+      printf(", \"address\": ");
+      ReportWriteJsonString(address);
+      printf(", \"port\": %u", port);
+    }
+    printf("}\n");
+  }
+  else if (targetCnt == 0)
+  {
+    printf("Starting firmware update for \"%s\" using %s:%u\n", fileName, address, port);
+  }
+  else
+  {
+    printf("Starting firmware update for \"%s\" on %u devices\n", fileName, targetCnt);
+  }
+  ReportFlush();
+} /*** end of ReportStart ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the start of a phase.
+** \param     phase The phase.
+** \param     format Format string of the text that describes the phase, followed by its
+**            arguments. Only used for the human readable output.
+** \return    none.
+**
+****************************************************************************************/
+void ReportPhaseStart(tReportPhase phase, const sb_char *format, ...)
+{
+  va_list args;
+
+  assert(phase < REPORT_PHASE_CNT);
+
+  currentPhase = phase;
+  phaseStartNs = TimeUtilGetTimeNs();
+  lastProgressNs = phaseStartNs;
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"phase_start\", \"phase\": \"%s\", \"timeMs\": %.3f}\n",
+           reportPhases[phase].name, (phaseStartNs - reportStartNs) / 1e6);
+  }
+  else
+  {
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+  }
+  ReportFlush();
+} /*** end of ReportPhaseStart ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the end of the phase that is in progress.
+** \param     result SB_TRUE if the phase succeeded, SB_FALSE otherwise.
+** \return    none.
+**
+****************************************************************************************/
+void ReportPhaseEnd(sb_uint8 result)
+{
+  XcpTracePhase(reportPhases[currentPhase].traceName, phaseStartNs);
+  if ( (result == SB_FALSE) && (failedPhase == REPORT_PHASE_CNT) )
+  {
+    failedPhase = currentPhase;
+  }
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"phase_end\", \"phase\": \"%s\", \"result\": \"%s\", "
+           "\"durationMs\": %.3f", reportPhases[currentPhase].name,
+           (result == SB_TRUE) ? "ok" : "error", (TimeUtilGetTimeNs() - phaseStartNs) / 1e6);
+    if ( (result == SB_FALSE) && (failedPhase == currentPhase) &&
+         (failedAddressValid == SB_TRUE) )
+    {
+      printf(", \"errorAddress\": %u", failedAddress);
+    }
+    printf("}\n");
+  }
+  else if (result == SB_TRUE)
+  {
+    printf("OK\n");
+  }
+  else if ( (failedPhase == currentPhase) && (failedAddressValid == SB_TRUE) )
+  {
+    printf("ERROR at 0x%08x\n", failedAddress);
+  }
+  else
+  {
+    printf("ERROR\n");
+  }
+  ReportFlush();
+} /*** end of ReportPhaseEnd ***/
+
+
+/************************************************************************************//**
+** \brief     Reports that the phase in progress failed on an erase or program command
+**            at the specified address. The address is shown with the failure of the
+**            phase and of the firmware update.
+** \param     address Address of the failed erase or program command.
+** \return    none.
+**
+****************************************************************************************/
+void ReportPhaseFailedAt(sb_uint32 address)
+{
+  /* only the first failure is reported */
+  if (failedPhase == REPORT_PHASE_CNT)
+  {
+    failedAddress = address;
+    failedAddressValid = SB_TRUE;
+  }
+  ReportPhaseEnd(SB_FALSE);
+} /*** end of ReportPhaseFailedAt ***/
+
+
+/************************************************************************************//**
+** \brief     Reports that the phase in progress failed, because the firmware file that
+**            is streamed turned out to be invalid. The error is attributed to parsing
+**            the file instead of to the phase in progress.
+** \param     line Line number of the error, 0 if the error concerns the whole file.
+** \param     reason Description of the error.
+** \return    none.
+**
+****************************************************************************************/
+void ReportPhaseFailedParsing(sb_uint32 line, const sb_char *reason)
+{
+  if (failedPhase == REPORT_PHASE_CNT)
+  {
+    failedPhase = REPORT_PHASE_PARSE;
+  }
+  ReportPhaseEnd(SB_FALSE);
+  ReportParseError(line, reason);
+} /*** end of ReportPhaseFailedParsing ***/
+
+
+/************************************************************************************//**
+** \brief     Reports why the firmware file was rejected.
+** \param     line Line number of the error, 0 if the error concerns the whole file.
+** \param     reason Description of the error.
+** \return    none.
+**
+****************************************************************************************/
+void ReportParseError(sb_uint32 line, const sb_char *reason)
+{
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"parse_error\", \"line\": %u, \"reason\": ", line);
+    ReportWriteJsonString(reason);
+    printf("}\n");
+  }
+  else if (line > 0)
+  {
+    printf("-> Line %u: %s\n", line, reason);
+  }
+  else
+  {
+    printf("-> %s\n", reason);
+  }
+  ReportFlush();
+} /*** end of ReportParseError ***/
+
+
+/************************************************************************************//**
+** \brief     Reports a message for the user.
+** \param     format Format string of the message, followed by its arguments.
+** \return    none.
+**
+****************************************************************************************/
+void ReportMessage(const sb_char *format, ...)
+{
+  sb_char text[256];
+  size_t len;
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    /* an event is a line by itself, so the line ending of the text is not needed */
+    len = strlen(text);
+    if ( (len > 0) && (text[len - 1] == '\n') )
+    {
+      text[len - 1] = '\0';
+    }
+    printf("{\"event\": \"message\", \"text\": ");
+    ReportWriteJsonString(text);
+    printf("}\n");
+  }
+  else
+  {
+    printf("%s", text);
+  }
+  ReportFlush();
+} /*** end of ReportMessage ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the contents of the firmware file.
+** \param     format Name of the format of the firmware file.
+** \param     parseResults Parsing results of the firmware file.
+** \return    none.
+**
+****************************************************************************************/
+void ReportImage(const sb_char *format, const tSrecordParseResults *parseResults)
+{
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"image\", \"format\": \"%s\", \"addressLow\": %u, "
+           "\"addressHigh\": %u, \"bytes\": %u, \"segments\": %u}\n", format,
+           parseResults->address_low, parseResults->address_high,
+           parseResults->data_bytes_total, parseResults->segment_count);
+  }
+  else
+  {
+    printf("-> File format: %s\n", format);
+    printf("-> Lowest memory address:  0x%08x\n", parseResults->address_low);
+    printf("-> Highest memory address: 0x%08x\n", parseResults->address_high);
+    printf("-> Total data bytes: %u\n", parseResults->data_bytes_total);
+    printf("-> Contiguous segments: %u\n", parseResults->segment_count);
+  }
+  ReportFlush();
+} /*** end of ReportImage ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the progress of the phase in progress. The events are rate
+**            limited, except for the one that reports completion. The human readable
+**            output does not show the progress.
+** \param     bytesDone Number of bytes done so far.
+** \param     bytesTotal Total number of bytes, 0 if it is not known yet.
+** \return    none.
+**
+****************************************************************************************/
+void ReportProgress(sb_uint32 bytesDone, sb_uint32 bytesTotal)
+{
+  sb_uint64 now;
+  double bytesPerSec;
+
+  if (reportMode != REPORT_MODE_JSON)
+  {
+    return;
+  }
+  now = TimeUtilGetTimeNs();
+  if ( ((bytesDone < bytesTotal) || (bytesTotal == 0)) &&
+       ((now - lastProgressNs) < (REPORT_PROGRESS_INTERVAL_MS * 1000000ull)) )
+  {
+    return;
+  }
+  lastProgressNs = now;
+  bytesPerSec = (now > phaseStartNs) ? (bytesDone * 1e9 / (now - phaseStartNs)) : 0.0;
+  printf("{\"event\": \"progress\", \"phase\": \"%s\", \"bytesDone\": %u, "
+         "\"bytesTotal\": %u, \"bytesPerSec\": %.0f, \"etaMs\": %.0f}\n",
+         reportPhases[currentPhase].name, bytesDone, bytesTotal, bytesPerSec,
+         ((bytesPerSec > 0.0) && (bytesTotal > bytesDone)) ?
+         ((bytesTotal - bytesDone) * 1000.0 / bytesPerSec) : 0.0);
+  ReportFlush();
+} /*** end of ReportProgress ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the statistics of a session with a device, after it was closed.
+** \param     session XCP master session.
+** \return    none.
+**
+****************************************************************************************/
+void ReportSessionStats(tXcpMasterSession *session)
+{
+  tXcpTransportStats *transportStats;
+  tXcpMasterRttEstimator *estimator;
+  tXcpMasterTimeoutClass timeoutClass;
+
+  transportStats = XcpTransportGetStats(&session->transport);
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"stats\", \"commands\": %u, \"wakeups\": %u, \"sendCalls\": %u, "
+           "\"recvCalls\": %u, \"recvBytes\": %u", transportStats->packets,
+           transportStats->wakeups, transportStats->sendCalls, transportStats->recvCalls,
+           transportStats->recvBytes);
+    if (transportStats->rttCount > 0)
+    {
+      printf(", \"rttAvgUs\": %.1f, \"rttMinUs\": %u, \"rttMaxUs\": %u",
+             transportStats->rttTotalUs / (double)transportStats->rttCount,
+             transportStats->rttMinUs, transportStats->rttMaxUs);
+    }
+    printf("}\n");
+  }
+  else
+  {
+    printf("-> Commands sent: %u\n", transportStats->packets);
+    printf("-> Receive wakeups: %u\n", transportStats->wakeups);
+    printf("-> Syscalls: %u send, %u recv (%u bytes per recv)\n", transportStats->sendCalls,
+           transportStats->recvCalls,
+           (transportStats->recvCalls > 0) ? (transportStats->recvBytes / transportStats->recvCalls) : 0);
+    if (transportStats->rttCount > 0)
+    {
+      printf("-> Round trip time: avg %.3f ms, min %.3f ms, max %.3f ms\n",
+             (transportStats->rttTotalUs / (double)transportStats->rttCount) / 1000.0,
+             transportStats->rttMinUs / 1000.0, transportStats->rttMaxUs / 1000.0);
+    }
+    for (timeoutClass=XCP_MASTER_TIMEOUT_CLASS_STD; timeoutClass<XCP_MASTER_TIMEOUT_CLASS_CNT; timeoutClass++)
+    {
+      estimator = XcpMasterGetRttEstimator(session, timeoutClass);
+      if ( (estimator->samples > 0) || (estimator->timeouts > 0) )
+      {
+        printf("-> Timeout of %s commands: %u ms (srtt %.3f ms, rttvar %.3f ms, %u samples, %u timeouts)\n",
+               XcpMasterGetTimeoutClassName(timeoutClass), XcpMasterGetTimeout(session, timeoutClass),
+               estimator->srttUs / 1000.0, estimator->rttvarUs / 1000.0, estimator->samples,
+               estimator->timeouts);
+      }
+    }
+  }
+  ReportFlush();
+} /*** end of ReportSessionStats ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the result of the firmware update of one of several devices.
+** \param     target The device and its result.
+** \param     first SB_TRUE for the first device, which also outputs the table header in
+**            the human readable output.
+** \return    none.
+**
+****************************************************************************************/
+void ReportTarget(const tXcpEngineTarget *target, sb_uint8 first)
+{
+  sb_char name[XCP_ENGINE_ADDRESS_MAX_LEN + 8];
+
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"device\", \"address\": ");
+    ReportWriteJsonString(target->address);
+    printf(", \"port\": %u, \"result\": \"%s\", \"step\": \"%s\", \"bytes\": %u, "
+           "\"durationMs\": %u", target->port, (target->result == SB_TRUE) ? "ok" : "error",
+           XcpEngineGetStepName(target->step), target->bytesProgrammed, target->durationMs);
+    if ( (target->result == SB_FALSE) && (target->errorAddressValid == SB_TRUE) )
+    {
+      printf(", \"errorAddress\": %u", target->errorAddress);
+    }
+    printf("}\n");
+    ReportFlush();
+    return;
+  }
+
+  if (first == SB_TRUE)
+  {
+    printf("%-28s %-7s %-14s %-10s %10s %10s\n", "Device", "Result", "Step", "Address",
+           "Bytes", "Time [ms]");
+  }
+  snprintf(name, sizeof(name), (strchr(target->address, ':') != SB_NULL) ?
+           "[%s]:%u" : "%s:%u", target->address, target->port);
+  if ( (target->result == SB_TRUE) || (target->errorAddressValid == SB_FALSE) )
+  {
+    printf("%-28s %-7s %-14s %-10s %10u %10u\n", name,
+           (target->result == SB_TRUE) ? "OK" : "ERROR",
+           XcpEngineGetStepName(target->step), "-", target->bytesProgrammed,
+           target->durationMs);
+  }
+  else
+  {
+    printf("%-28s %-7s %-14s 0x%08x %10u %10u\n", name, "ERROR",
+           XcpEngineGetStepName(target->step), target->errorAddress,
+           target->bytesProgrammed, target->durationMs);
+  }
+  ReportFlush();
+} /*** end of ReportTarget ***/
+
+
+/************************************************************************************//**
+** \brief     Reports how many of several devices were updated.
+** \param     updatedCnt Number of devices that were updated.
+** \param     targetCnt Number of devices.
+** \param     durationMs Time that updating the devices took.
+** \return    none.
+**
+****************************************************************************************/
+void ReportTargetsSummary(sb_uint32 updatedCnt, sb_uint32 targetCnt, sb_uint32 durationMs)
+{
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"devices\", \"updated\": %u, \"failed\": %u, \"durationMs\": %u}\n",
+           updatedCnt, targetCnt - updatedCnt, durationMs);
+  }
+  else
+  {
+    printf("-> %u of %u devices updated in %u ms\n", updatedCnt, targetCnt, durationMs);
+  }
+  ReportFlush();
+} /*** end of ReportTargetsSummary ***/
+
+
+/************************************************************************************//**
+** \brief     Reports the final result of the firmware update. A failure is classified
+**            by the phase that failed first.
+** \param     result SB_TRUE if the firmware update succeeded, SB_FALSE otherwise.
+** \return    none.
+**
+****************************************************************************************/
+void ReportResult(sb_uint8 result)
+{
+  if (reportMode == REPORT_MODE_JSON)
+  {
+    printf("{\"event\": \"result\", \"result\": \"%s\", \"durationMs\": %.3f",
+           (result == SB_TRUE) ? "ok" : "error", (TimeUtilGetTimeNs() - reportStartNs) / 1e6);
+    if ( (result == SB_FALSE) && (failedPhase < REPORT_PHASE_CNT) )
+    {
+      printf(", \"error\": \"%s\", \"errorPhase\": \"%s\"",
+             reportPhases[failedPhase].errorClass, reportPhases[failedPhase].name);
+      if (failedAddressValid == SB_TRUE)
+      {
+        printf(", \"errorAddress\": %u", failedAddress);
+      }
+    }
+    printf("}\n");
+  }
+  else if (result == SB_TRUE)
+  {
+    printf("Firmware successfully updated!\n");
+  }
+  ReportFlush();
+} /*** end of ReportResult ***/
+
+
+/************************************************************************************//**
+** \brief     Writes a string as a quoted JSON string.
+** \param     text The string.
+** \return    none.
+**
+****************************************************************************************/
+static void ReportWriteJsonString(const sb_char *text)
+{
+  putchar('"');
+  for ( ; *text != '\0'; text++)
+  {
+    if ( (*text == '"') || (*text == '\\') )
+    {
+      putchar('\\');
+      putchar(*text);
+    }
+    else if (*text == '\n')
+    {
+      printf("\\n");
+    }
+    else if ((sb_uint8)*text < 0x20)
+    {
+      printf("\\u%04x", (sb_uint8)*text);
+    }
+    else
+    {
+      putchar(*text);
+    }
+  }
+  putchar('"');
+} /*** end of ReportWriteJsonString ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the buffered output of an event.
+** \return    none.
+**
+****************************************************************************************/
+static void ReportFlush(void)
+{
+  fflush(stdout);
+} /*** end of ReportFlush ***/
+
+
+/*********************************** end of report.c ************************************/
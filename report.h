@@ -0,0 +1,102 @@
+/************************************************************************************//**
+* \file         report.h
+* \brief        Progress and result reporting header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+#ifndef REPORT_H
+#define REPORT_H
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "xcpmaster.h"                                /* XCP master protocol module    */
+#include "srecord.h"                                  /* S-record file handling        */
+#include "xcpengine.h"                                /* concurrent update engine      */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Size of the output buffer. Each event is written with a single write. */
+#define REPORT_BUFFER_SIZE             (8192)
+
+/** \brief Minimum time in milliseconds between two progress events. */
+#define REPORT_PROGRESS_INTERVAL_MS    (250)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enumeration for the ways the events are rendered. */
+typedef enum
+{
+  REPORT_MODE_HUMAN,                             /**< readable text for the console    */
+  REPORT_MODE_JSON                               /**< newline delimited JSON events    */
+} tReportMode;
+
+/** \brief Enumeration for the phases of the firmware update. */
+typedef enum
+{
+  REPORT_PHASE_OPEN,                             /**< opening the firmware file        */
+  REPORT_PHASE_PARSE,                            /**< parsing the firmware file        */
+  REPORT_PHASE_TCP_CONNECT,                      /**< establishing the TCP connection  */
+  REPORT_PHASE_CONNECT,                          /**< connecting to the bootloader     */
+  REPORT_PHASE_PROGRAM_START,                    /**< starting the programming session */
+  REPORT_PHASE_ERASE,                            /**< erasing memory                   */
+  REPORT_PHASE_PROGRAM,                          /**< programming data                 */
+  REPORT_PHASE_PROGRAM_STOP,                     /**< finishing the programming session*/
+  REPORT_PHASE_RESET,                            /**< performing the software reset    */
+  REPORT_PHASE_UPDATE_DEVICES,                   /**< updating several devices         */
+  REPORT_PHASE_CNT                               /**< number of phases                 */
+} tReportPhase;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void ReportInit(tReportMode mode);
+void ReportStart(const sb_char *fileName, const sb_char *address, sb_uint32 port,
+                 sb_uint32 targetCnt);
+void ReportPhaseStart(tReportPhase phase, const sb_char *format, ...);
+void ReportPhaseEnd(sb_uint8 result);
+void ReportPhaseFailedAt(sb_uint32 address);
+void ReportPhaseFailedParsing(sb_uint32 line, const sb_char *reason);
+void ReportParseError(sb_uint32 line, const sb_char *reason);
+void ReportMessage(const sb_char *format, ...);
+void ReportImage(const sb_char *format, const tSrecordParseResults *parseResults);
+void ReportProgress(sb_uint32 bytesDone, sb_uint32 bytesTotal);
+void ReportSessionStats(tXcpMasterSession *session);
+void ReportTarget(const tXcpEngineTarget *target, sb_uint8 first);
+void ReportTargetsSummary(sb_uint32 updatedCnt, sb_uint32 targetCnt, sb_uint32 durationMs);
+void ReportResult(sb_uint8 result);
+
+
+#endif /* REPORT_H */
+/*********************************** end of report.h ************************************/
@@ -62,6 +62,7 @@ typedef signed int        sb_int32;
 typedef unsigned char     sb_uint8;
 typedef unsigned short    sb_uint16;
 typedef unsigned int      sb_uint32;
+typedef unsigned long long sb_uint64;
 typedef FILE *            sb_file;
 
 
@@ -0,0 +1,795 @@
+/************************************************************************************//**
+* \file         sim\xcpslavesim.c
+* \brief        Simulated OpenBLT XCP slave, for testing without hardware.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#define _GNU_SOURCE                                   /* for ppoll                     */
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <stdio.h>                                    /* standard I/O library          */
+#include <stdlib.h>                                   /* standard library              */
+#include <string.h>                                   /* string library                */
+#include <unistd.h>                                   /* UNIX standard functions       */
+#include <errno.h>                                    /* error number definitions      */
+#include <signal.h>                                   /* signal handling               */
+#include <poll.h>                                     /* I/O multiplexing              */
+#include <sys/socket.h>                               /* sockets                       */
+#include <netinet/in.h>                               /* internet protocol family      */
+#include <netinet/tcp.h>                              /* TCP socket options            */
+#include "timeutil.h"                                 /* time utility module           */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Program return code if all went ok. */
+#define PROG_RESULT_OK    (0)
+
+/** \brief Program return code if an error occurred. */
+#define PROG_RESULT_ERROR (1)
+
+/* XCP command codes that are supported by the simulated slave */
+#define XCP_SIM_CMD_CONNECT            (0xFF)
+#define XCP_SIM_CMD_SET_MTA            (0xF6)
+#define XCP_SIM_CMD_UPLOAD             (0xF5)
+#define XCP_SIM_CMD_PROGRAM_START      (0xD2)
+#define XCP_SIM_CMD_PROGRAM_CLEAR      (0xD1)
+#define XCP_SIM_CMD_PROGRAM            (0xD0)
+#define XCP_SIM_CMD_PROGRAM_RESET      (0xCF)
+#define XCP_SIM_CMD_PROGRAM_MAX        (0xC9)
+
+/* XCP response packet IDs and error codes as defined by the protocol */
+#define XCP_SIM_PID_RES                (0xFF) /* positive response */
+#define XCP_SIM_PID_ERR                (0xFE) /* negative response */
+#define XCP_SIM_ERR_SEQUENCE           (0x29) /* command not allowed in this state */
+#define XCP_SIM_ERR_CMD_UNKNOWN        (0x20) /* unsupported command */
+#define XCP_SIM_ERR_CMD_SYNTAX         (0x21) /* malformed command */
+#define XCP_SIM_ERR_OUT_OF_RANGE       (0x22) /* memory outside of the flash */
+#define XCP_SIM_ERR_ACCESS_DENIED      (0x24) /* programming memory that is not erased */
+
+/** \brief Maximum number of bytes in an XCP packet. */
+#define XCP_SIM_MAX_PACKET             (255)
+
+/** \brief Size of the buffer for the received command packets. */
+#define XCP_SIM_RX_BUFFER_SIZE         (4096)
+
+/** \brief Maximum number of responses that wait for their due time. Larger than the
+ *         number of commands that the master can keep in flight.
+ */
+#define XCP_SIM_RESPONSE_QUEUE_SIZE    (256)
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for a response that is transmitted once it is due. */
+typedef struct
+{
+  sb_uint64 dueNs;                                /**< time to transmit the response   */
+  sb_uint8 len;                                   /**< number of bytes in the packet   */
+  sb_uint8 data[XCP_SIM_MAX_PACKET];              /**< response packet                 */
+} tXcpSimResponse;
+
+/** \brief Structure type for the state of the simulated slave on one connection. */
+typedef struct
+{
+  sb_int32 sock;                                  /**< socket of the connection        */
+  sb_uint8 *flash;                                /**< contents of the flash memory    */
+  sb_uint32 mta;                                  /**< memory transfer address         */
+  sb_uint8 connected;                             /**< CONNECT was received            */
+  sb_uint8 programming;                           /**< PROGRAM_START was received      */
+  sb_uint8 resetRequested;                        /**< PROGRAM_RESET was received      */
+  sb_uint64 busyUntilNs;                          /**< time the previous cmd completes */
+  sb_uint8 rxBuffer[XCP_SIM_RX_BUFFER_SIZE];      /**< received command packets        */
+  sb_uint32 rxLen;                                /**< bytes in the receive buffer     */
+  tXcpSimResponse responses[XCP_SIM_RESPONSE_QUEUE_SIZE]; /**< responses that are due */
+  sb_uint32 responseHead;                         /**< oldest queued response          */
+  sb_uint32 responseCnt;                          /**< number of queued responses      */
+} tXcpSimSession;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void     DisplayProgramInfo(void);
+static void     DisplayProgramUsage(void);
+static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[]);
+static void     XcpSimServe(sb_int32 sock);
+static sb_uint8 XcpSimProcessPacket(tXcpSimSession *session, const sb_uint8 *packet,
+                                    sb_uint8 len);
+static sb_uint8 XcpSimCheckRange(sb_uint32 address, sb_uint32 len);
+static void     XcpSimQueueResponse(tXcpSimSession *session, const sb_uint8 *data,
+                                    sb_uint8 len, sb_uint64 processingNs);
+static sb_uint8 XcpSimTransmitDueResponses(tXcpSimSession *session);
+static void     XcpSimDumpFlash(tXcpSimSession *session);
+static sb_uint32 XcpSimGetLong(const sb_uint8 *data);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief TCP port to listen on. */
+static sb_uint32 listenPort;
+
+/** \brief Start address of the simulated flash memory. */
+static sb_uint32 flashBase = 0x08000000;
+
+/** \brief Size of the simulated flash memory in bytes. */
+static sb_uint32 flashSize = 1024 * 1024;
+
+/** \brief Size of a flash sector in bytes, which is the smallest erasable unit. */
+static sb_uint32 sectorSize = 4096;
+
+/** \brief Time in microseconds to erase one sector. */
+static sb_uint32 eraseTimeUs = 0;
+
+/** \brief Time in nanoseconds to program one byte. */
+static sb_uint32 programTimeNs = 0;
+
+/** \brief One-way network delay in microseconds, applied to commands and responses. */
+static sb_uint32 networkDelayUs = 0;
+
+/** \brief Maximum number of bytes in a command packet. */
+static sb_uint32 maxCto = XCP_SIM_MAX_PACKET;
+
+/** \brief Name of the file to write the flash contents to on reset, empty if none. */
+static sb_char dumpFileName[128];
+
+
+/************************************************************************************//**
+** \brief     Program entry point. Accepts connections on the configured port and
+**            serves each one in its own process, such that each connection behaves as
+**            a separate device with its own flash memory.
+** \param     argc Number of program parameters.
+** \param     argv array to program parameter strings.
+** \return    0 on success, > 0 on error.
+**
+****************************************************************************************/
+sb_int32 main(sb_int32 argc, sb_char *argv[])
+{
+  struct sockaddr_in server;
+  sb_int32 listenSock;
+  sb_int32 sock;
+  sb_int32 value = 1;
+
+  setbuf(stdout, SB_NULL);
+  DisplayProgramInfo();
+
+  if (ParseCommandLine(argc, argv) == SB_FALSE)
+  {
+    DisplayProgramUsage();
+    return PROG_RESULT_ERROR;
+  }
+
+  /* -------------------- start listening -------------------------------------------- */
+  listenSock = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenSock < 0)
+  {
+    return PROG_RESULT_ERROR;
+  }
+  setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_addr.s_addr = htonl(INADDR_ANY);
+  server.sin_port = htons(listenPort);
+  if ( (bind(listenSock, (struct sockaddr *)&server, sizeof(server)) < 0) ||
+       (listen(listenSock, 64) < 0) )
+  {
+    printf("Could not listen on port %u\n", listenPort);
+    close(listenSock);
+    return PROG_RESULT_ERROR;
+  }
+  printf("Listening on port %u. Flash 0x%08x..0x%08x, %u byte sectors\n", listenPort,
+         flashBase, flashBase + flashSize - 1, sectorSize);
+  printf("-> Erase %u us/sector, program %u ns/byte, network delay %u us\n",
+         eraseTimeUs, programTimeNs, networkDelayUs);
+
+  /* the processes that serve the connections do not need to be waited for */
+  signal(SIGCHLD, SIG_IGN);
+
+  /* -------------------- serve the connections -------------------------------------- */
+  for (;;)
+  {
+    sock = accept(listenSock, SB_NULL, SB_NULL);
+    if (sock < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+    if (fork() == 0)
+    {
+      close(listenSock);
+      XcpSimServe(sock);
+      _exit(PROG_RESULT_OK);
+    }
+    close(sock);
+  }
+  close(listenSock);
+  return PROG_RESULT_ERROR;
+} /*** end of main ***/
+
+
+/************************************************************************************//**
+** \brief     Outputs information to the user about this program.
+** \return    none.
+**
+****************************************************************************************/
+static void DisplayProgramInfo(void)
+{
+  printf("-------------------------------------------------------------------------\n");
+  printf("openblt-xcp-sim version 1.00. Simulates a microcontroller that runs the\n");
+  printf("OpenBLT bootloader with XCP on TCP/IP, for testing openblt-tcp-boot.\n\n");
+  printf("Copyright (c) by Feaser  http://www.feaser.com\n");
+  printf("-------------------------------------------------------------------------\n");
+} /*** end of DisplayProgramInfo ***/
+
+
+/************************************************************************************//**
+** \brief     Outputs information to the user about how to use this program.
+** \return    none.
+**
+****************************************************************************************/
+static void DisplayProgramUsage(void)
+{
+  printf("Usage:    openblt-xcp-sim -p[port] [-a[address]] [-s[size]] [-k[sector size]]\n");
+  printf("                          [-e[erase time]] [-w[program time]] [-n[delay]]\n");
+  printf("                          [-c[max cto]] [-f[dump file]]\n\n");
+  printf("Example:  openblt-xcp-sim -p2101 -e20000 -w50 -n250\n");
+  printf("          -> Listens on port 2101. Erasing a sector takes 20 ms, programming\n");
+  printf("             a byte 50 ns and the network adds 250 us in each direction.\n");
+  printf("Options:  -a[address] start address of the flash (default 0x08000000).\n");
+  printf("          -s[size] size of the flash in bytes (default 1048576).\n");
+  printf("          -k[sector size] size of an erasable sector in bytes (default 4096).\n");
+  printf("          -e[erase time] time to erase one sector in microseconds.\n");
+  printf("          -w[program time] time to program one byte in nanoseconds.\n");
+  printf("          -n[delay] one-way network delay in microseconds.\n");
+  printf("          -c[max cto] maximum command packet size (8..%d).\n", XCP_SIM_MAX_PACKET);
+  printf("          -f[dump file] writes the flash contents to this file on reset.\n");
+  printf("Each connection is served as a separate device with erased flash.\n");
+  printf("-------------------------------------------------------------------------\n");
+} /*** end of DisplayProgramUsage ***/
+
+
+/************************************************************************************//**
+** \brief     Parses the command line arguments.
+** \param     argc Number of program parameters.
+** \param     argv array to program parameter strings.
+** \return    SB_TRUE on success, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 ParseCommandLine(sb_int32 argc, sb_char *argv[])
+{
+  sb_int32 paramIdx;
+  sb_uint8 paramPfound = SB_FALSE;
+  sb_char *value;
+
+  for (paramIdx=1; paramIdx<argc; paramIdx++)
+  {
+    if ( (argv[paramIdx][0] != '-') || (argv[paramIdx][1] == '\0') )
+    {
+      return SB_FALSE;
+    }
+    value = &argv[paramIdx][2];
+    switch (argv[paramIdx][1])
+    {
+      case 'p':
+        sscanf(value, "%u", &listenPort);
+        paramPfound = SB_TRUE;
+        break;
+      case 'a':
+        sscanf(value, "%i", (sb_int32 *)&flashBase);
+        break;
+      case 's':
+        sscanf(value, "%u", &flashSize);
+        break;
+      case 'k':
+        sscanf(value, "%u", &sectorSize);
+        break;
+      case 'e':
+        sscanf(value, "%u", &eraseTimeUs);
+        break;
+      case 'w':
+        sscanf(value, "%u", &programTimeNs);
+        break;
+      case 'n':
+        sscanf(value, "%u", &networkDelayUs);
+        break;
+      case 'c':
+        sscanf(value, "%u", &maxCto);
+        break;
+      case 'f':
+        if (strlen(value) >= sizeof(dumpFileName))
+        {
+          return SB_FALSE;
+        }
+        strcpy(dumpFileName, value);
+        break;
+      default:
+        return SB_FALSE;
+    }
+  }
+
+  /* verify the parameters */
+  if ( (paramPfound == SB_FALSE) || (flashSize == 0) || (sectorSize == 0) ||
+       (maxCto < 8) || (maxCto > XCP_SIM_MAX_PACKET) )
+  {
+    return SB_FALSE;
+  }
+  return SB_TRUE;
+} /*** end of ParseCommandLine ***/
+
+
+/************************************************************************************//**
+** \brief     Serves one connection until the master disconnects or requests a reset.
+**            Commands are processed as soon as they are received, but their responses
+**            are only transmitted once they are due. A command has to wait until the
+**            previous one completed, so the due time of a response is the later of the
+**            arrival of the command and the completion of the previous command, plus
+**            the processing time and the network delay. This way several commands in
+**            flight overlap their network delays, just like on a real network.
+** \param     sock Socket of the connection.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpSimServe(sb_int32 sock)
+{
+  tXcpSimSession *session;
+  struct pollfd pfd;
+  struct timespec timeout;
+  struct timespec *timeoutPtr;
+  sb_uint64 timeoutNs;
+  sb_uint64 now;
+  ssize_t result;
+  sb_uint32 offset;
+  sb_int32 value = 1;
+
+  session = calloc(1, sizeof(tXcpSimSession));
+  if (session == SB_NULL)
+  {
+    close(sock);
+    return;
+  }
+  session->flash = malloc(flashSize);
+  if (session->flash == SB_NULL)
+  {
+    free(session);
+    close(sock);
+    return;
+  }
+  /* the device starts out with erased flash */
+  memset(session->flash, 0xFF, flashSize);
+  session->sock = sock;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  for (;;)
+  {
+    /* transmit the responses that are due */
+    if (XcpSimTransmitDueResponses(session) == SB_FALSE)
+    {
+      break;
+    }
+    /* the connection is closed once the response to the reset command was transmitted */
+    if ( (session->resetRequested == SB_TRUE) && (session->responseCnt == 0) )
+    {
+      XcpSimDumpFlash(session);
+      break;
+    }
+    /* sleep until a command arrives or the next response is due. the due times are
+     * often less than a millisecond away, so a timeout in nanoseconds is needed.
+     */
+    timeoutPtr = SB_NULL;
+    if (session->responseCnt > 0)
+    {
+      now = TimeUtilGetTimeNs();
+      timeoutNs = 0;
+      if (session->responses[session->responseHead].dueNs > now)
+      {
+        timeoutNs = session->responses[session->responseHead].dueNs - now;
+      }
+      timeout.tv_sec = timeoutNs / 1000000000ull;
+      timeout.tv_nsec = timeoutNs % 1000000000ull;
+      timeoutPtr = &timeout;
+    }
+    /* no new commands are accepted once the response queue is full */
+    pfd.events = (session->responseCnt < XCP_SIM_RESPONSE_QUEUE_SIZE) ? POLLIN : 0;
+    if ( (ppoll(&pfd, 1, timeoutPtr, SB_NULL) < 0) && (errno != EINTR) )
+    {
+      break;
+    }
+    if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+    {
+      continue;
+    }
+    /* read the command packets */
+    result = recv(sock, &session->rxBuffer[session->rxLen],
+                  XCP_SIM_RX_BUFFER_SIZE - session->rxLen, MSG_DONTWAIT);
+    if (result == 0)
+    {
+      /* the master closed the connection */
+      break;
+    }
+    if (result < 0)
+    {
+      if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) )
+      {
+        continue;
+      }
+      break;
+    }
+    session->rxLen += result;
+    /* process all complete packets. the first byte of a packet is its length */
+    offset = 0;
+    while ( (session->resetRequested == SB_FALSE) &&
+            (session->responseCnt < XCP_SIM_RESPONSE_QUEUE_SIZE) &&
+            (session->rxLen - offset > 0) &&
+            (session->rxLen - offset >= (sb_uint32)session->rxBuffer[offset] + 1) )
+    {
+      if (XcpSimProcessPacket(session, &session->rxBuffer[offset + 1],
+                              session->rxBuffer[offset]) == SB_FALSE)
+      {
+        session->rxLen = 0;
+        break;
+      }
+      offset += session->rxBuffer[offset] + 1;
+    }
+    /* keep the incomplete packet */
+    if (offset > 0)
+    {
+      memmove(&session->rxBuffer[0], &session->rxBuffer[offset], session->rxLen - offset);
+      session->rxLen -= offset;
+    }
+  }
+
+  close(sock);
+  free(session->flash);
+  free(session);
+} /*** end of XcpSimServe ***/
+
+
+/************************************************************************************//**
+** \brief     Processes one command packet and queues its response.
+** \param     session Simulated slave session.
+** \param     packet Command packet, without the length byte.
+** \param     len Number of bytes in the command packet.
+** \return    SB_TRUE if successful, SB_FALSE if the packet is invalid.
+**
+****************************************************************************************/
+static sb_uint8 XcpSimProcessPacket(tXcpSimSession *session, const sb_uint8 *packet,
+                                    sb_uint8 len)
+{
+  sb_uint8 response[XCP_SIM_MAX_PACKET];
+  sb_uint8 responseLen = 1;
+  sb_uint64 processingNs = 0;
+  sb_uint32 count;
+  sb_uint32 idx;
+  sb_uint32 firstSector;
+  sb_uint32 lastSector;
+  const sb_uint8 *data = SB_NULL;
+
+  if (len == 0)
+  {
+    return SB_FALSE;
+  }
+  response[0] = XCP_SIM_PID_RES;
+
+  /* only CONNECT is accepted before the master connected */
+  if ( (session->connected == SB_FALSE) && (packet[0] != XCP_SIM_CMD_CONNECT) )
+  {
+    response[0] = XCP_SIM_PID_ERR;
+    response[1] = XCP_SIM_ERR_SEQUENCE;
+    XcpSimQueueResponse(session, response, 2, 0);
+    return SB_TRUE;
+  }
+
+  switch (packet[0])
+  {
+    case XCP_SIM_CMD_CONNECT:
+      session->connected = SB_TRUE;
+      session->programming = SB_FALSE;
+      response[1] = 0x10;                         /* resources: programming          */
+      response[2] = 0x00;                         /* Intel byte ordering             */
+      response[3] = (sb_uint8)maxCto;             /* max CTO                         */
+      response[4] = XCP_SIM_MAX_PACKET;           /* max DTO, LSB first              */
+      response[5] = 0x00;
+      response[6] = 0x01;                         /* protocol layer version          */
+      response[7] = 0x01;                         /* transport layer version         */
+      responseLen = 8;
+      break;
+
+    case XCP_SIM_CMD_SET_MTA:
+      if (len < 8)
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_CMD_SYNTAX;
+        responseLen = 2;
+        break;
+      }
+      session->mta = XcpSimGetLong(&packet[4]);
+      break;
+
+    case XCP_SIM_CMD_UPLOAD:
+      count = (len >= 2) ? packet[1] : 0;
+      if ( (count > XCP_SIM_MAX_PACKET - 1) || (XcpSimCheckRange(session->mta, count) == SB_FALSE) )
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_OUT_OF_RANGE;
+        responseLen = 2;
+        break;
+      }
+      memcpy(&response[1], &session->flash[session->mta - flashBase], count);
+      session->mta += count;
+      responseLen = 1 + count;
+      break;
+
+    case XCP_SIM_CMD_PROGRAM_START:
+      session->programming = SB_TRUE;
+      response[1] = 0x00;                         /* reserved                        */
+      response[2] = 0x00;                         /* communication mode programming  */
+      response[3] = (sb_uint8)maxCto;             /* max CTO during programming      */
+      response[4] = 0x00;                         /* max block size                  */
+      response[5] = 0x00;                         /* min separation time             */
+      response[6] = 0x00;                         /* queue size                      */
+      responseLen = 7;
+      break;
+
+    case XCP_SIM_CMD_PROGRAM_CLEAR:
+      count = (len >= 8) ? XcpSimGetLong(&packet[4]) : 0;
+      if (session->programming == SB_FALSE)
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_SEQUENCE;
+        responseLen = 2;
+        break;
+      }
+      if ( (count == 0) || (XcpSimCheckRange(session->mta, count) == SB_FALSE) )
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_OUT_OF_RANGE;
+        responseLen = 2;
+        break;
+      }
+      /* erase all sectors that overlap the range */
+      firstSector = (session->mta - flashBase) / sectorSize;
+      lastSector = (session->mta - flashBase + count - 1) / sectorSize;
+      for (idx=firstSector; idx<=lastSector; idx++)
+      {
+        count = ((idx + 1) * sectorSize <= flashSize) ? sectorSize : (flashSize - (idx * sectorSize));
+        memset(&session->flash[idx * sectorSize], 0xFF, count);
+      }
+      processingNs = (sb_uint64)(lastSector - firstSector + 1) * eraseTimeUs * 1000ull;
+      break;
+
+    case XCP_SIM_CMD_PROGRAM:
+    case XCP_SIM_CMD_PROGRAM_MAX:
+      if (packet[0] == XCP_SIM_CMD_PROGRAM)
+      {
+        count = (len >= 2) ? packet[1] : 0;
+        data = &packet[2];
+        if ( (len < 2) || (count > (sb_uint32)(len - 2)) )
+        {
+          response[0] = XCP_SIM_PID_ERR;
+          response[1] = XCP_SIM_ERR_CMD_SYNTAX;
+          responseLen = 2;
+          break;
+        }
+      }
+      else
+      {
+        count = len - 1;
+        data = &packet[1];
+      }
+      if (session->programming == SB_FALSE)
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_SEQUENCE;
+        responseLen = 2;
+        break;
+      }
+      /* a program command without data ends the programming session */
+      if (count == 0)
+      {
+        session->programming = SB_FALSE;
+        break;
+      }
+      if (XcpSimCheckRange(session->mta, count) == SB_FALSE)
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_OUT_OF_RANGE;
+        responseLen = 2;
+        break;
+      }
+      /* flash can only be programmed after it was erased */
+      for (idx=0; idx<count; idx++)
+      {
+        if (session->flash[session->mta - flashBase + idx] != 0xFF)
+        {
+          break;
+        }
+      }
+      if (idx < count)
+      {
+        response[0] = XCP_SIM_PID_ERR;
+        response[1] = XCP_SIM_ERR_ACCESS_DENIED;
+        responseLen = 2;
+        break;
+      }
+      memcpy(&session->flash[session->mta - flashBase], data, count);
+      session->mta += count;
+      processingNs = (sb_uint64)count * programTimeNs;
+      break;
+
+    case XCP_SIM_CMD_PROGRAM_RESET:
+      session->resetRequested = SB_TRUE;
+      break;
+
+    default:
+      response[0] = XCP_SIM_PID_ERR;
+      response[1] = XCP_SIM_ERR_CMD_UNKNOWN;
+      responseLen = 2;
+      break;
+  }
+
+  XcpSimQueueResponse(session, response, responseLen, processingNs);
+  return SB_TRUE;
+} /*** end of XcpSimProcessPacket ***/
+
+
+/************************************************************************************//**
+** \brief     Checks that a memory range lies within the simulated flash.
+** \param     address Start address of the range.
+** \param     len Number of bytes in the range.
+** \return    SB_TRUE if the range is valid, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpSimCheckRange(sb_uint32 address, sb_uint32 len)
+{
+  if ( (address < flashBase) || ((address - flashBase) > flashSize) ||
+       (len > flashSize - (address - flashBase)) )
+  {
+    return SB_FALSE;
+  }
+  return SB_TRUE;
+} /*** end of XcpSimCheckRange ***/
+
+
+/************************************************************************************//**
+** \brief     Queues a response for transmission once it is due.
+** \param     session Simulated slave session.
+** \param     data Response packet.
+** \param     len Number of bytes in the response packet.
+** \param     processingNs Time that the slave takes to process the command.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpSimQueueResponse(tXcpSimSession *session, const sb_uint8 *data,
+                                sb_uint8 len, sb_uint64 processingNs)
+{
+  tXcpSimResponse *response;
+  sb_uint64 arrivalNs;
+  sb_uint64 startNs;
+
+  assert(session->responseCnt < XCP_SIM_RESPONSE_QUEUE_SIZE);
+
+  /* the command can only be processed after it arrived and the previous one completed */
+  arrivalNs = TimeUtilGetTimeNs() + (networkDelayUs * 1000ull);
+  startNs = (session->busyUntilNs > arrivalNs) ? session->busyUntilNs : arrivalNs;
+  session->busyUntilNs = startNs + processingNs;
+
+  response = &session->responses[(session->responseHead + session->responseCnt) %
+                                 XCP_SIM_RESPONSE_QUEUE_SIZE];
+  response->dueNs = session->busyUntilNs + (networkDelayUs * 1000ull);
+  response->len = len;
+  memcpy(response->data, data, len);
+  session->responseCnt++;
+} /*** end of XcpSimQueueResponse ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the queued responses that are due.
+** \param     session Simulated slave session.
+** \return    SB_TRUE if successful, SB_FALSE if the connection failed.
+**
+****************************************************************************************/
+static sb_uint8 XcpSimTransmitDueResponses(tXcpSimSession *session)
+{
+  sb_uint8 frame[XCP_SIM_MAX_PACKET + 1];
+  tXcpSimResponse *response;
+  sb_uint64 now = TimeUtilGetTimeNs();
+
+  while (session->responseCnt > 0)
+  {
+    response = &session->responses[session->responseHead];
+    if (response->dueNs > now)
+    {
+      break;
+    }
+    /* frame the response with its length */
+    frame[0] = response->len;
+    memcpy(&frame[1], response->data, response->len);
+    if (send(session->sock, frame, response->len + 1, MSG_NOSIGNAL) != response->len + 1)
+    {
+      return SB_FALSE;
+    }
+    session->responseHead = (session->responseHead + 1) % XCP_SIM_RESPONSE_QUEUE_SIZE;
+    session->responseCnt--;
+  }
+  return SB_TRUE;
+} /*** end of XcpSimTransmitDueResponses ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the contents of the simulated flash to the dump file, if one was
+**            configured.
+** \param     session Simulated slave session.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpSimDumpFlash(tXcpSimSession *session)
+{
+  sb_file hDump;
+
+  if (dumpFileName[0] == '\0')
+  {
+    return;
+  }
+  hDump = fopen(dumpFileName, "wb");
+  if (hDump == SB_NULL)
+  {
+    return;
+  }
+  fwrite(session->flash, 1, flashSize, hDump);
+  fclose(hDump);
+} /*** end of XcpSimDumpFlash ***/
+
+
+/************************************************************************************//**
+** \brief     Reads a 32-bit value in Intel byte ordering from a byte buffer.
+** \param     data Byte buffer.
+** \return    The 32-bit value.
+**
+****************************************************************************************/
+static sb_uint32 XcpSimGetLong(const sb_uint8 *data)
+{
+  return (sb_uint32)data[0] | ((sb_uint32)data[1] << 8) | ((sb_uint32)data[2] << 16) |
+         ((sb_uint32)data[3] << 24);
+} /*** end of XcpSimGetLong ***/
+
+
+/*********************************** end of xcpslavesim.c ******************************/
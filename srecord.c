@@ -31,423 +31,918 @@
 * \endinternal
 ****************************************************************************************/
 
+
 /****************************************************************************************
 * Include files
 ****************************************************************************************/
 #include <assert.h>                                   /* assertion module              */
 #include <sb_types.h>                                 /* C types                       */
 #include <string.h>                                   /* for strcpy etc.               */
-#include <ctype.h>                                    /* for toupper() etc.            */
+#include <stdlib.h>                                   /* for malloc, qsort etc.        */
+#include <stdio.h>                                    /* for snprintf                  */
 #include "srecord.h"                                  /* S-record library              */
+#include "hexdecode.h"                                /* hexadecimal decoding          */
+#include "parallel.h"                                 /* parallel execution of jobs    */
+
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of bytes that follow the byte count of an S-record. */
+#define SRECORD_MAX_BYTES_PER_LINE        (255)
+
+/** \brief Minimum number of characters that a thread parses. Smaller files are parsed
+ *         by fewer threads, down to only the calling thread.
+ */
+#define SRECORD_PARSE_CHUNK_MIN           (1024*1024)
 
 
 /****************************************************************************************
 * Type definitions
 ****************************************************************************************/
-/** \brief Enumeration for the different S-record line types. */
-typedef enum
+/** \brief Structure type for grouping the parsing results of an S-record line. */
+typedef struct
 {
-  LINE_TYPE_S1,                                  /**< 16-bit address line              */
-  LINE_TYPE_S2,                                  /**< 24-bit address line              */
-  LINE_TYPE_S3,                                  /**< 32-bit address line              */
-  LINE_TYPE_UNSUPPORTED                          /**< unsupported line                 */
-} tSrecordLineType;
+  sb_uint8 bytes[SRECORD_MAX_BYTES_PER_LINE];     /**< address, data and checksum bytes */
+  sb_uint8 *data;                                 /**< data bytes within the bytes      */
+  sb_uint32 address;                              /**< address on S1,S2 or S3 line     */
+  sb_uint16 length;                               /**< number of data bytes, 0 if none */
+} tSrecordLineParseResults;
+
+/** \brief Structure type for a part of the file that is parsed by a thread of its own.
+ *         Each part starts at the beginning of a line.
+ */
+typedef struct
+{
+  const sb_char *start;                           /**< first character of the part      */
+  const sb_char *end;                             /**< character after the part         */
+  tSrecordImage image;                            /**< data of the part, in file order  */
+  sb_uint8 *arena;                                /**< where the data is merged to      */
+  sb_uint32 lineCnt;                              /**< number of lines parsed           */
+  sb_uint8 sorted;                                /**< SB_TRUE if in order of address   */
+  tSrecordError error;                            /**< line number within the part      */
+} tSrecordChunk;
 
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
-static tSrecordLineType SrecordGetLineType(const sb_char *line);
-static sb_uint8         SrecordVerifyChecksum(const sb_char *line);
-static sb_uint8         SrecordHexStringToByte(const sb_char *hexstring);
-static sb_uint8         SrecordReadLine(sb_file srecordHandle, sb_char *line);
+static void           SrecordParseChunk(void *context);
+static sb_uint8       SrecordMergeChunks(tSrecordImage *image, tSrecordChunk *chunks,
+                                         sb_uint32 chunkCnt, sb_uint8 *sorted);
+static void           SrecordCopyChunk(void *context);
+static const sb_char *SrecordParseLine(const sb_char *line, sb_uint32 lineLen,
+                                       tSrecordLineParseResults *parseResults);
+static sb_uint8       SrecordImageSort(tSrecordImage *image);
+static sb_uint8       SrecordImageGrowSegments(tSrecordImage *image);
+static int            SrecordCompareSegments(const void *first, const void *second);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Number of address bytes of each S-record type, indexed by the digit after the
+ *         'S'. A value of 0 marks the reserved S4 type.
+ */
+static const sb_uint8 srecordAddressBytes[10] = { 2, 2, 3, 4, 0, 2, 3, 4, 3, 2 };
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Number of threads that parse a file, 0 for one per processor. */
+static sb_uint32 srecordParseThreads = 0;
+
+/** \brief Description of an error that includes an address. */
+static sb_char srecordErrorText[96];
+
+
+/************************************************************************************//**
+** \brief     Sets the number of threads that parse a file, for comparing the
+**            throughput. By default there is one for each processor.
+** \param     threadCnt Number of threads, 0 for one per processor.
+** \return    none.
+**
+****************************************************************************************/
+void SrecordSetParseThreads(sb_uint32 threadCnt)
+{
+  srecordParseThreads = threadCnt;
+} /*** end of SrecordSetParseThreads ***/
 
 
 /************************************************************************************//**
-** \brief     Checks if the specified srecordFile exists and contains s-records.
-** \param     srecordFile The S-record file with full path if applicable.
-** \return    SB_TRUE on the S-record is valid, SB_FALSE otherwise.
+** \brief     Parses the S-record file contents into an in-memory firmware image, in a
+**            single pass. Each line is fully validated: the record type, the hex
+**            digits, the byte count and the checksum. The first invalid line stops the
+**            parsing and is reported with its line number. The data of the S1, S2 and
+**            S3 records is stored as segments of contiguous memory, sorted by address,
+**            such that each segment can be programmed with a single SET MTA command
+**            followed by back-to-back program commands. Data that overlaps other data
+**            is rejected. The parse results are determined as well.
+**            Large files are split into parts at line boundaries, which are parsed by
+**            a thread each, and the parts are merged afterwards.
+** \param     buffer Contents of the S-record file.
+** \param     size Number of bytes in the buffer.
+** \param     image Pointer to where the firmware image should be stored. Must be
+**            released with SrecordFreeImage(), also when this function fails.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored when the parsing fails.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 SrecordIsValid(const sb_char *srecordFile)
+sb_uint8 SrecordParseImage(const sb_char *buffer, sb_uint32 size, tSrecordImage *image,
+                           tSrecordParseResults *parseResults, tSrecordError *error)
 {
-  sb_file tempHandle;
-  sb_char line[SRECORD_MAX_CHARS_PER_LINE];
+  tSrecordChunk chunks[PARALLEL_JOBS_MAX];
+  const sb_char *chunkStart = buffer;
+  const sb_char *chunkEnd;
+  const sb_char *end = buffer + size;
+  sb_uint32 chunkCnt;
+  sb_uint32 lineBase = 0;
+  sb_uint8 sorted;
+  sb_uint32 idx;
+
+  /* init data structures */
+  memset(image, 0, sizeof(*image));
+  parseResults->address_high = 0;
+  parseResults->address_low = 0xffffffff;
+  parseResults->data_bytes_total = 0;
+  parseResults->segment_count = 0;
+  error->line = 0;
+  error->reason = SB_NULL;
+
+  /* determine the number of parts, one for each thread */
+  chunkCnt = (srecordParseThreads > 0) ? srecordParseThreads : ParallelGetCpuCount();
+  if (chunkCnt > (size / SRECORD_PARSE_CHUNK_MIN))
+  {
+    chunkCnt = size / SRECORD_PARSE_CHUNK_MIN;
+  }
+  if (chunkCnt > PARALLEL_JOBS_MAX)
+  {
+    chunkCnt = PARALLEL_JOBS_MAX;
+  }
+  if (chunkCnt == 0)
+  {
+    chunkCnt = 1;
+  }
+  /* split the file in parts of about the same size. each part ends after a line feed */
+  for (idx=0; idx<chunkCnt; idx++)
+  {
+    chunkEnd = buffer + (((sb_uint64)size * (idx + 1)) / chunkCnt);
+    if (chunkEnd <= chunkStart)
+    {
+      chunkEnd = chunkStart;
+    }
+    else if (chunkEnd < end)
+    {
+      chunkEnd = memchr(chunkEnd - 1, '\n', end - (chunkEnd - 1));
+      chunkEnd = (chunkEnd != SB_NULL) ? (chunkEnd + 1) : end;
+    }
+    memset(&chunks[idx], 0, sizeof(chunks[idx]));
+    chunks[idx].start = chunkStart;
+    chunks[idx].end = chunkEnd;
+    chunkStart = chunkEnd;
+  }
 
-  /* attempt to open the file */
-  tempHandle = SrecordOpen(srecordFile);
-  /* is the file available? */
-  if (tempHandle == SB_NULL)
+  /* select the hexadecimal decoder before the threads use it */
+  HexDecodeGetImpl();
+  ParallelRun(SrecordParseChunk, chunks, sizeof(tSrecordChunk), chunkCnt);
+
+  /* report the first error in the file. the line numbers of a part continue from the
+   * previous parts, which were all parsed completely in that case.
+   */
+  for (idx=0; idx<chunkCnt; idx++)
   {
-    /* cannot open the file */
+    if (chunks[idx].error.reason != SB_NULL)
+    {
+      error->line = (chunks[idx].error.line > 0) ? (lineBase + chunks[idx].error.line) : 0;
+      error->reason = chunks[idx].error.reason;
+      break;
+    }
+    lineBase += chunks[idx].lineCnt;
+  }
+  if (error->reason != SB_NULL)
+  {
+    for (idx=0; idx<chunkCnt; idx++)
+    {
+      SrecordFreeImage(&chunks[idx].image);
+    }
     return SB_FALSE;
   }
-  /* all lines should be formatted as S-records. read the first one to check this */
-  if (SrecordReadLine(tempHandle, line) == SB_FALSE)
+  if (SrecordMergeChunks(image, chunks, chunkCnt, &sorted) == SB_FALSE)
   {
-    /* could not read a line. file must be empty */
-    SrecordClose(tempHandle);
+    error->reason = "out of memory";
     return SB_FALSE;
   }
-  /* check if the line starts with the 'S' character, followed by a digit */
-  if ( (toupper(line[0]) != 'S') || (isdigit(line[1]) == 0) )
+
+  /* a file without data cannot be programmed */
+  if (image->segmentCnt == 0)
   {
-    SrecordClose(tempHandle);
+    error->reason = "no S1, S2 or S3 records with data";
     return SB_FALSE;
   }
+  return SrecordImageFinish(image, sorted, parseResults, error);
+} /*** end of SrecordParseImage ***/
 
-  /* still here so it is a valid s-record */
-  SrecordClose(tempHandle);
+
+/************************************************************************************//**
+** \brief     Completes a firmware image that was built with SrecordImageAppend(). The
+**            segments are sorted by address when they are not in order yet. Data that
+**            overlaps other data is rejected, naming the lines of both. Then the data
+**            pointers of the segments and the parse results are determined.
+** \param     image The firmware image.
+** \param     sorted SB_TRUE if the data was appended in order of address.
+** \param     parseResults Pointer to where the parse results should be stored.
+** \param     error Pointer to where the error is stored on failure.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 SrecordImageFinish(tSrecordImage *image, sb_uint8 sorted,
+                            tSrecordParseResults *parseResults, tSrecordError *error)
+{
+  tSrecordSegment *segment;
+  sb_uint32 idx;
+
+  parseResults->address_high = 0;
+  parseResults->address_low = 0xffffffff;
+  parseResults->data_bytes_total = 0;
+  /* the records of most files are in order, so that they were already merged */
+  if ( (sorted == SB_FALSE) && (SrecordImageSort(image) == SB_FALSE) )
+  {
+    error->reason = "out of memory";
+    return SB_FALSE;
+  }
+  parseResults->segment_count = image->segmentCnt;
+
+  /* now that the arena no longer moves, determine the data pointers and the results.
+   * the segments are sorted, so data overlaps when it starts before the end of the
+   * previous segment.
+   */
+  for (idx=0; idx<image->segmentCnt; idx++)
+  {
+    segment = &image->segments[idx];
+    if ( (idx > 0) && ((segment->address - segment[-1].address) < segment[-1].length) )
+    {
+      if (segment[-1].line > 0)
+      {
+        snprintf(srecordErrorText, sizeof(srecordErrorText),
+                 "data at 0x%08X overlaps the data that starts on line %u",
+                 segment->address, segment[-1].line);
+      }
+      else
+      {
+        snprintf(srecordErrorText, sizeof(srecordErrorText),
+                 "data at 0x%08X overlaps other data", segment->address);
+      }
+      error->line = segment->line;
+      error->reason = srecordErrorText;
+      return SB_FALSE;
+    }
+    segment->data = &image->arena[segment->offset];
+    parseResults->data_bytes_total += segment->length;
+    if (segment->address < parseResults->address_low)
+    {
+      parseResults->address_low = segment->address;
+    }
+    if ((segment->address + segment->length - 1) > parseResults->address_high)
+    {
+      parseResults->address_high = segment->address + segment->length - 1;
+    }
+  }
   return SB_TRUE;
-} /*** end of SrecordIsValid ***/
+} /*** end of SrecordImageFinish ***/
 
 
 /************************************************************************************//**
-** \brief     Opens the S-record file for reading.
-** \param     srecordFile The S-record file with full path if applicable.
-** \return    The filehandle if successful, SB_NULL otherwise.
+** \brief     Releases the memory of a firmware image, and unmaps the file that holds
+**            its data if there is one.
+** \param     image The firmware image.
+** \return    none.
 **
 ****************************************************************************************/
-sb_file SrecordOpen(const sb_char *srecordFile)
+void SrecordFreeImage(tSrecordImage *image)
 {
-  /* open the file for reading */
-  return fopen(srecordFile, "r");
-} /*** end of SrecordOpen ***/
+  free(image->segments);
+  if (image->arenaMap.data != SB_NULL)
+  {
+    FileMapClose(&image->arenaMap);
+  }
+  else
+  {
+    free(image->arena);
+  }
+  memset(image, 0, sizeof(*image));
+} /*** end of SrecordFreeImage ***/
 
 
 /************************************************************************************//**
-** \brief     Parse the S-record file to obtain information about its contents.
-** \param     srecordHandle The S-record file handle. It is returned by SrecordOpen.
-** \param     parseResults Pointer to where the parse results should be stored.
+** \brief     Parses the lines of a part of the file into the firmware image of the
+**            part. Runs on a thread of its own.
+** \param     context The part, of type tSrecordChunk.
 ** \return    none.
 **
 ****************************************************************************************/
-void SrecordParse(sb_file srecordHandle, tSrecordParseResults *parseResults)
+static void SrecordParseChunk(void *context)
 {
+  tSrecordChunk *chunk = context;
   tSrecordLineParseResults lineResults;
+  tSrecordSegment *segment;
+  const sb_char *line = chunk->start;
+  const sb_char *lineEnd;
+  sb_uint32 lineLen;
+
+  chunk->sorted = SB_TRUE;
+  /* loop through all lines of the part */
+  while (line < chunk->end)
+  {
+    chunk->lineCnt++;
+    lineEnd = memchr(line, '\n', chunk->end - line);
+    if (lineEnd == SB_NULL)
+    {
+      lineEnd = chunk->end;
+    }
+    /* strip the line termination and trailing white space */
+    lineLen = lineEnd - line;
+    while ( (lineLen > 0) && ((line[lineLen - 1] == '\r') || (line[lineLen - 1] == ' ') ||
+                              (line[lineLen - 1] == '\t')) )
+    {
+      lineLen--;
+    }
+    /* empty lines are allowed */
+    if (lineLen > 0)
+    {
+      chunk->error.reason = SrecordParseLine(line, lineLen, &lineResults);
+      if (chunk->error.reason != SB_NULL)
+      {
+        chunk->error.line = chunk->lineCnt;
+        return;
+      }
+      if (lineResults.length > 0)
+      {
+        /* keep track of whether the records are in order of their addresses */
+        if (chunk->image.segmentCnt > 0)
+        {
+          segment = &chunk->image.segments[chunk->image.segmentCnt - 1];
+          if (lineResults.address < (segment->address + segment->length))
+          {
+            chunk->sorted = SB_FALSE;
+          }
+        }
+        if (SrecordImageAppend(&chunk->image, lineResults.address, lineResults.data,
+                               lineResults.length, chunk->lineCnt) == SB_FALSE)
+        {
+          chunk->error.reason = "out of memory";
+          return;
+        }
+      }
+    }
+    line = lineEnd + 1;
+  }
+} /*** end of SrecordParseChunk ***/
 
-  /* start at the beginning of the file */
-  rewind(srecordHandle);
-  
-  /* init data structure */
-  parseResults->address_high = 0;
-  parseResults->address_low = 0xffffffff;
-  parseResults->data_bytes_total = 0;
 
-  /* loop through all S-records with program data */
-  while (SrecordParseNextDataLine(srecordHandle, &lineResults) == SB_TRUE)
+/************************************************************************************//**
+** \brief     Merges the firmware images of the parts of the file into one, in the
+**            order of the file. The result is the same as when the file was parsed as
+**            a whole, except that it still needs to be sorted when the parts were not
+**            in order. The data of the parts is copied in parallel and the images of
+**            the parts are released. The line numbers of the segments of a part, which
+**            count from the start of the part, become line numbers in the file.
+** \param     image Pointer to where the merged firmware image is stored.
+** \param     chunks The parts of the file.
+** \param     chunkCnt Number of parts.
+** \param     sorted Pointer to where SB_TRUE is stored when the merged image is sorted.
+** \return    SB_TRUE if successful, SB_FALSE if memory could not be allocated.
+**
+****************************************************************************************/
+static sb_uint8 SrecordMergeChunks(tSrecordImage *image, tSrecordChunk *chunks,
+                                   sb_uint32 chunkCnt, sb_uint8 *sorted)
+{
+  tSrecordSegment *segment;
+  tSrecordSegment *last;
+  sb_uint32 arenaSize = 0;
+  sb_uint32 segmentCnt = 0;
+  sb_uint32 lineBase = 0;
+  sb_uint32 idx;
+  sb_uint32 segIdx;
+
+  /* a single part already is the image */
+  if (chunkCnt == 1)
+  {
+    *image = chunks[0].image;
+    *sorted = chunks[0].sorted;
+    return SB_TRUE;
+  }
+  for (idx=0; idx<chunkCnt; idx++)
+  {
+    arenaSize += chunks[idx].image.arenaSize;
+    segmentCnt += chunks[idx].image.segmentCnt;
+  }
+  if (segmentCnt > 0)
+  {
+    image->arena = malloc(arenaSize);
+    image->segments = malloc(segmentCnt * sizeof(tSrecordSegment));
+    if ( (image->arena == SB_NULL) || (image->segments == SB_NULL) )
+    {
+      for (idx=0; idx<chunkCnt; idx++)
+      {
+        SrecordFreeImage(&chunks[idx].image);
+      }
+      return SB_FALSE;
+    }
+    image->arenaAlloc = arenaSize;
+    image->segmentAlloc = segmentCnt;
+  }
+
+  /* append the segments of each part. the data of the parts is placed back to back in
+   * the arena, so a segment that continues at the start of the next part is merged.
+   */
+  *sorted = SB_TRUE;
+  for (idx=0; idx<chunkCnt; idx++)
   {
-    /* update byte total */
-    parseResults->data_bytes_total += lineResults.length;
-    /* is this a new lowest address? */
-    if (lineResults.address < parseResults->address_low)
+    chunks[idx].arena = &image->arena[image->arenaSize];
+    if (chunks[idx].sorted == SB_FALSE)
     {
-      parseResults->address_low = lineResults.address;
+      *sorted = SB_FALSE;
     }
-    /* is this a new highest address? */
-    if ((lineResults.address + lineResults.length - 1) > parseResults->address_high)
+    for (segIdx=0; segIdx<chunks[idx].image.segmentCnt; segIdx++)
     {
-      parseResults->address_high = (lineResults.address + lineResults.length - 1);
+      segment = &chunks[idx].image.segments[segIdx];
+      last = (image->segmentCnt > 0) ? &image->segments[image->segmentCnt - 1] : SB_NULL;
+      if ( (segIdx == 0) && (last != SB_NULL) )
+      {
+        if (segment->address < (last->address + last->length))
+        {
+          *sorted = SB_FALSE;
+        }
+        if (segment->address == (last->address + last->length))
+        {
+          last->length += segment->length;
+          continue;
+        }
+      }
+      image->segments[image->segmentCnt] = *segment;
+      image->segments[image->segmentCnt].offset += image->arenaSize;
+      image->segments[image->segmentCnt].line += lineBase;
+      image->segmentCnt++;
     }
+    image->arenaSize += chunks[idx].image.arenaSize;
+    lineBase += chunks[idx].lineCnt;
   }
-  /* reset to the beginning of the file again */
-  rewind(srecordHandle);
-} /*** end of SrecordParse ***/
+  ParallelRun(SrecordCopyChunk, chunks, sizeof(tSrecordChunk), chunkCnt);
+  return SB_TRUE;
+} /*** end of SrecordMergeChunks ***/
 
 
 /************************************************************************************//**
-** \brief     Closes the S-record file.
-** \param     srecordHandle The S-record file handle. It is returned by SrecordOpen.
+** \brief     Copies the data of a part of the file to the merged firmware image and
+**            releases the image of the part. Runs on a thread of its own.
+** \param     context The part, of type tSrecordChunk.
 ** \return    none.
 **
 ****************************************************************************************/
-void SrecordClose(sb_file srecordHandle)
+static void SrecordCopyChunk(void *context)
 {
-  /* close the file handle if valid */
-  if (srecordHandle != SB_NULL)
+  tSrecordChunk *chunk = context;
+
+  if (chunk->image.arenaSize > 0)
   {
-    fclose(srecordHandle);
+    memcpy(chunk->arena, chunk->image.arena, chunk->image.arenaSize);
   }
-} /*** end of SrecordClose ***/
+  SrecordFreeImage(&chunk->image);
+} /*** end of SrecordCopyChunk ***/
 
 
 /************************************************************************************//**
-** \brief     Reads the next S-record with program data, parses it and returns the 
-**            results.
-** \param     srecordHandle The S-record file handle. It is returned by SrecordOpen.
+** \brief     Validates and parses a line from a Motorola S-record file. All record
+**            types are validated, but only S1, S2 and S3 records contain data.
+** \param     line The line, without its line termination.
+** \param     lineLen Number of characters on the line.
 ** \param     parseResults Pointer to where the parse results should be stored.
-** \return    SB_TRUE is valid parse results were stored. SB_FALSE in case of end-of-
-**            file.
+** \return    SB_NULL if the line is valid, otherwise a description of the error.
 **
 ****************************************************************************************/
-sb_uint8 SrecordParseNextDataLine(sb_file srecordHandle, tSrecordLineParseResults *parseResults)
+static const sb_char *SrecordParseLine(const sb_char *line, sb_uint32 lineLen,
+                                       tSrecordLineParseResults *parseResults)
 {
-  sb_char line[SRECORD_MAX_CHARS_PER_LINE];
-  sb_uint8 data_line_found = SB_FALSE;
-  tSrecordLineType lineType;
-  sb_uint16 bytes_on_line;
+  sb_uint8 bytes_on_line;
+  sb_uint8 address_bytes;
+  sb_uint8 checksum;
+  sb_uint8 type;
   sb_uint16 i;
-  sb_char *linePtr;
 
   /* first set the length paramter to 0 */
   parseResults->length = 0;
 
-  while (data_line_found == SB_FALSE)
+  /* check if the line starts with the 'S' character, followed by a digit */
+  if ( (lineLen < 4) || ((line[0] != 'S') && (line[0] != 's')) )
+  {
+    return "not an S-record";
+  }
+  if ( (line[1] < '0') || (line[1] > '9') || (srecordAddressBytes[line[1] - '0'] == 0) )
+  {
+    return "unsupported record type";
+  }
+  type = line[1] - '0';
+  address_bytes = srecordAddressBytes[type];
+  /* read out the number of byte values that follow on the line. the checksum is
+   * calculated by summing up the values of the byte count, address and databytes and
+   * then taking the 1-complement of the sum's least signigicant byte
+   */
+  checksum = 0;
+  if (HexDecode(&line[2], &bytes_on_line, 1, &checksum) == SB_FALSE)
+  {
+    return "invalid hex digit";
+  }
+  if (lineLen != (4 + (2 * (sb_uint32)bytes_on_line)))
+  {
+    return "byte count does not match the length of the record";
+  }
+  if (bytes_on_line < (address_bytes + 1))
+  {
+    return "byte count too small for the record type";
+  }
+  /* decode the address, data and checksum bytes and add them to the checksum, in one
+   * pass over the characters
+   */
+  if (HexDecode(&line[4], parseResults->bytes, bytes_on_line, &checksum) == SB_FALSE)
+  {
+    return "invalid hex digit";
+  }
+  /* the sum includes the checksum itself, which makes it 0xff when correct */
+  if (checksum != 0xff)
+  {
+    return "checksum mismatch";
+  }
+  /* only S1, S2 and S3 records contain program data */
+  if ( (type < 1) || (type > 3) )
+  {
+    return SB_NULL;
+  }
+  parseResults->address = 0;
+  for (i=0; i<address_bytes; i++)
+  {
+    parseResults->address = (parseResults->address << 8) + parseResults->bytes[i];
+  }
+  parseResults->data = &parseResults->bytes[address_bytes];
+  parseResults->length = bytes_on_line - address_bytes - 1;
+  if ( (parseResults->length > 0) &&
+       ((parseResults->address + parseResults->length - 1) < parseResults->address) )
+  {
+    return "data exceeds the 32-bit address range";
+  }
+  return SB_NULL;
+} /*** end of SrecordParseLine ***/
+
+
+/************************************************************************************//**
+** \brief     Validates and parses a line from a Motorola S-record file and appends its
+**            data to the firmware image. This allows building the image one line at a
+**            time, as the lines become available.
+** \param     line The line, without its line termination.
+** \param     lineLen Number of characters on the line, at least 1.
+** \param     lineNumber Number of the line in the file.
+** \param     image The firmware image.
+** \return    SB_NULL if the line is valid, otherwise a description of the error.
+**
+****************************************************************************************/
+const sb_char *SrecordParseRecord(const sb_char *line, sb_uint32 lineLen,
+                                  sb_uint32 lineNumber, tSrecordImage *image)
+{
+  tSrecordLineParseResults lineResults;
+  const sb_char *reason;
+
+  reason = SrecordParseLine(line, lineLen, &lineResults);
+  if ( (reason == SB_NULL) && (lineResults.length > 0) &&
+       (SrecordImageAppend(image, lineResults.address, lineResults.data,
+                           lineResults.length, lineNumber) == SB_FALSE) )
   {
-    /* read the next line from the file */
-    if (SrecordReadLine(srecordHandle, line) == SB_FALSE)
+    reason = "out of memory";
+  }
+  return reason;
+} /*** end of SrecordParseRecord ***/
+
+
+/************************************************************************************//**
+** \brief     Appends data to the firmware image. The data is merged into the last
+**            segment when it directly follows it, otherwise a new segment is started.
+** \param     image The firmware image.
+** \param     address Memory address of the data.
+** \param     data The data bytes.
+** \param     length Number of data bytes.
+** \param     line Number of the line in the file that the data is on, 0 if the format
+**            of the file has no lines.
+** \return    SB_TRUE if successful, SB_FALSE if memory could not be allocated.
+**
+****************************************************************************************/
+sb_uint8 SrecordImageAppend(tSrecordImage *image, sb_uint32 address,
+                            const sb_uint8 *data, sb_uint32 length, sb_uint32 line)
+{
+  tSrecordSegment *segment;
+  sb_uint8 *newArena;
+  sb_uint32 newAlloc;
+
+  /* grow the arena when the data does not fit anymore */
+  if ((image->arenaSize + length) > image->arenaAlloc)
+  {
+    newAlloc = (image->arenaAlloc > 0) ? image->arenaAlloc : SRECORD_IMAGE_ARENA_SIZE;
+    while (newAlloc < (image->arenaSize + length))
     {
-      /* end-of-file encountered */
-      return SB_FALSE;
+      newAlloc *= 2;
     }
-    /* we now have a line. check if it is a S-record data line */
-    lineType = SrecordGetLineType(line);
-    if (lineType != LINE_TYPE_UNSUPPORTED)
+    newArena = realloc(image->arena, newAlloc);
+    if (newArena == SB_NULL)
     {
-      /* check if the checksum on the line is correct */
-      if (SrecordVerifyChecksum(line) == SB_TRUE)
-      {
-        /* found a valid line that can be parsed. loop will stop */
-        data_line_found = SB_TRUE;
-        break;
-      }
+      return SB_FALSE;
     }
+    image->arena = newArena;
+    image->arenaAlloc = newAlloc;
   }
-
-  /* still here so we have a valid S-record data line. start parsing */
-  linePtr = &line[0];
-  /* all good so far, now read out the address and databytes for the line */
-  switch (lineType)
-  {
-    /* ---------------------------- S1 line type ------------------------------------- */
-    case LINE_TYPE_S1:
-      /* adjust pointer to point to byte count value */
-      linePtr += 2;
-      /* read out the number of byte values that follow on the line */
-      bytes_on_line = SrecordHexStringToByte(linePtr);
-      /* read out the 16-bit address */
-      linePtr += 2;
-      parseResults->address = SrecordHexStringToByte(linePtr) << 8;
-      linePtr += 2;
-      parseResults->address += SrecordHexStringToByte(linePtr);
-      /* adjust pointer to point to the first data byte after the address */
-      linePtr += 2;
-      /* determine how many data bytes are on the line */
-      parseResults->length = bytes_on_line - 3; /* -2 bytes address, -1 byte checksum */
-      /* read and store data bytes if requested */
-      for (i=0; i<parseResults->length; i++)
-      {
-        parseResults->data[i] = SrecordHexStringToByte(linePtr);
-        linePtr += 2;
-      }
-      break;
-      
-    /* ---------------------------- S2 line type ------------------------------------- */
-    case LINE_TYPE_S2:
-      /* adjust pointer to point to byte count value */
-      linePtr += 2;
-      /* read out the number of byte values that follow on the line */
-      bytes_on_line = SrecordHexStringToByte(linePtr);
-      /* read out the 32-bit address */
-      linePtr += 2;
-      parseResults->address = SrecordHexStringToByte(linePtr) << 16;
-      linePtr += 2;
-      parseResults->address += SrecordHexStringToByte(linePtr) << 8;
-      linePtr += 2;
-      parseResults->address += SrecordHexStringToByte(linePtr);
-      /* adjust pointer to point to the first data byte after the address */
-      linePtr += 2;
-      /* determine how many data bytes are on the line */
-      parseResults->length = bytes_on_line - 4; /* -3 bytes address, -1 byte checksum */
-      /* read and store data bytes if requested */
-      for (i=0; i<parseResults->length; i++)
-      {
-        parseResults->data[i] = SrecordHexStringToByte(linePtr);
-        linePtr += 2;
-      }
-      break;
-      
-    /* ---------------------------- S3 line type ------------------------------------- */
-    case LINE_TYPE_S3:
-      /* adjust pointer to point to byte count value */
-      linePtr += 2;
-      /* read out the number of byte values that follow on the line */
-      bytes_on_line = SrecordHexStringToByte(linePtr);
-      /* read out the 32-bit address */
-      linePtr += 2;
-      parseResults->address = SrecordHexStringToByte(linePtr) << 24;
-      linePtr += 2;
-      parseResults->address += SrecordHexStringToByte(linePtr) << 16;
-      linePtr += 2;
-      parseResults->address += SrecordHexStringToByte(linePtr) << 8;
-      linePtr += 2;
-      parseResults->address += SrecordHexStringToByte(linePtr);
-      /* adjust pointer to point to the first data byte after the address */
-      linePtr += 2;
-      /* determine how many data bytes are on the line */
-      parseResults->length = bytes_on_line - 5; /* -4 bytes address, -1 byte checksum */
-      /* read and store data bytes if requested */
-      for (i=0; i<parseResults->length; i++)
-      {
-        parseResults->data[i] = SrecordHexStringToByte(linePtr);
-        linePtr += 2;
-      }
-      break;
-
-    default:
-      /* will not happen */
-      break;
+  /* the data of the last segment is always at the end of the arena, so the data can
+   * simply be appended to it when the addresses are contiguous.
+   */
+  segment = (image->segmentCnt > 0) ? &image->segments[image->segmentCnt - 1] : SB_NULL;
+  if ( (segment == SB_NULL) || ((segment->address + segment->length) != address) )
+  {
+    if (SrecordImageGrowSegments(image) == SB_FALSE)
+    {
+      return SB_FALSE;
+    }
+    segment = &image->segments[image->segmentCnt];
+    segment->address = address;
+    segment->length = 0;
+    segment->offset = image->arenaSize;
+    segment->line = line;
+    segment->data = SB_NULL;
+    image->segmentCnt++;
   }
-
-  /* parsing all done */
+  memcpy(&image->arena[image->arenaSize], data, length);
+  image->arenaSize += length;
+  segment->length += length;
   return SB_TRUE;
-} /*** end of SrecordParseNextDataLine ***/
+} /*** end of SrecordImageAppend ***/
 
 
 /************************************************************************************//**
-** \brief     Inspects a line from a Motorola S-Record file to determine its type.
-** \param     line A line from the S-Record.
-** \return    the S-Record line type.
+** \brief     Finds the segments of a firmware image that intersect a range of memory,
+**            such as a sector, with a binary search. The segments must be sorted and
+**            may not overlap, as is the case after SrecordImageFinish() and for an
+**            index that is built with SrecordImageInsertRange().
+** \param     image The firmware image.
+** \param     address Start address of the range.
+** \param     length Number of bytes in the range, at least 1.
+** \param     segmentIdx Pointer to where the index of the first segment that intersects
+**            the range is stored. When none does, it is the index where a segment
+**            for the range would be inserted.
+** \return    Number of segments that intersect the range.
 **
 ****************************************************************************************/
-static tSrecordLineType SrecordGetLineType(const sb_char *line)
+sb_uint32 SrecordImageFindSegments(const tSrecordImage *image, sb_uint32 address,
+                                   sb_uint32 length, sb_uint32 *segmentIdx)
 {
-  /* check if the line starts with the 'S' character, followed by a digit */
-  if ( (toupper(line[0]) != 'S') || (isdigit(line[1]) == 0) )
+  const tSrecordSegment *segment;
+  sb_uint32 low = 0;
+  sb_uint32 high = image->segmentCnt;
+  sb_uint32 mid;
+  sb_uint32 lastAddress = address + length - 1;
+  sb_uint32 segmentCnt = 0;
+
+  assert(length > 0);
+
+  /* find the first segment that ends at or after the start of the range */
+  while (low < high)
   {
-    /* not a valid S-Record line type */
-    return LINE_TYPE_UNSUPPORTED;
+    mid = low + ((high - low) / 2);
+    segment = &image->segments[mid];
+    if ((segment->address + segment->length - 1) < address)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
   }
-  /* determine the line type */
-  if (line[1] == '1')
+  *segmentIdx = low;
+  /* the segments from there on intersect the range as long as they start in it */
+  while ( ((low + segmentCnt) < image->segmentCnt) &&
+          (image->segments[low + segmentCnt].address <= lastAddress) )
   {
-    return LINE_TYPE_S1;
+    segmentCnt++;
   }
-  if (line[1] == '2')
+  return segmentCnt;
+} /*** end of SrecordImageFindSegments ***/
+
+
+/************************************************************************************//**
+** \brief     Determines the next range of memory to erase before programming a firmware
+**            image. A range covers adjacent sectors that the image has data in, so
+**            each range takes a single erase command, and the sectors without data
+**            in between the segments of a sparse image are left alone.
+** \param     image The firmware image, after SrecordImageFinish().
+** \param     sectorSize Size of a sector of the device.
+** \param     segmentIdx Index of the first segment that is not erased yet, 0 for the
+**            first range. It is advanced past the segments in the range.
+** \param     range Pointer to where the range is stored.
+** \return    SB_TRUE if a range was stored, SB_FALSE when all segments were covered.
+**
+****************************************************************************************/
+sb_uint8 SrecordImageNextEraseRange(const tSrecordImage *image, sb_uint32 sectorSize,
+                                    sb_uint32 *segmentIdx, tSrecordRange *range)
+{
+  const tSrecordSegment *segment;
+  sb_uint32 firstSector;
+  sb_uint32 lastSector;
+  sb_uint64 length;
+
+  assert(sectorSize > 0);
+
+  if (*segmentIdx >= image->segmentCnt)
   {
-    return LINE_TYPE_S2;
+    return SB_FALSE;
   }
-  if (line[1] == '3')
+  segment = &image->segments[*segmentIdx];
+  firstSector = segment->address / sectorSize;
+  lastSector = (segment->address + segment->length - 1) / sectorSize;
+  /* add the segments that have data in the same sector or in the one after it */
+  for ((*segmentIdx)++; *segmentIdx < image->segmentCnt; (*segmentIdx)++)
   {
-    return LINE_TYPE_S3;
+    segment = &image->segments[*segmentIdx];
+    if ((segment->address / sectorSize) > (lastSector + 1))
+    {
+      break;
+    }
+    lastSector = (segment->address + segment->length - 1) / sectorSize;
   }
-  /* still here so not a supported line type found */
-  return LINE_TYPE_UNSUPPORTED;
-} /*** end of SrecordGetLineType ***/
+  range->address = firstSector * sectorSize;
+  /* the range is limited to the 32-bit address space */
+  length = ((sb_uint64)lastSector - firstSector + 1) * sectorSize;
+  range->length = (length > 0xffffffffull) ? 0xffffffff : (sb_uint32)length;
+  return SB_TRUE;
+} /*** end of SrecordImageNextEraseRange ***/
 
 
 /************************************************************************************//**
-** \brief     Inspects an S1, S2 or S3 line from a Motorola S-Record file to
-**            determine if the checksum at the end is corrrect.
-** \param     line An S1, S2 or S3 line from the S-Record.
-** \return    SB_TRUE if the checksum is correct, SB_FALSE otherwise.
+** \brief     Inserts a range of memory into an index, which is an image with segments
+**            but without data. The segments are kept sorted and a range that is
+**            adjacent to a segment is merged into it. This allows checking data for
+**            overlaps as it comes in, without keeping the data itself.
+** \param     index The index. Must be released with SrecordFreeImage().
+** \param     address Start address of the range.
+** \param     length Number of bytes in the range, at least 1.
+** \param     line Number of the line in the file of the first byte of the range, 0 if
+**            the format of the file has no lines.
+** \param     error Pointer to where the error is stored when the range overlaps a
+**            range that was inserted before, naming the lines of both.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 SrecordVerifyChecksum(const sb_char *line)
+sb_uint8 SrecordImageInsertRange(tSrecordImage *index, sb_uint32 address,
+                                 sb_uint32 length, sb_uint32 line, tSrecordError *error)
 {
-  sb_uint16 bytes_on_line;
-  sb_uint8  checksum = 0;
-  
-  /* adjust pointer to point to byte count value */
-  line += 2;
-  /* read out the number of byte values that follow on the line */
-  bytes_on_line = SrecordHexStringToByte(line);
-  /* byte count is part of checksum */
-  checksum += bytes_on_line;
-  /* adjust pointer to the first byte of the address */
-  line += 2;
-  /* add byte values of address and data, but not the final checksum */
-  do 
-  {
-    /* add the next byte value to the checksum */
-    checksum += SrecordHexStringToByte(line);
-    /* update counter */
-    bytes_on_line--;
-    /* point to next hex string in the line */
-    line += 2;
-  } 
-  while (bytes_on_line > 1);
-  /* the checksum is calculated by summing up the values of the byte count, address and
-   * databytes and then taking the 1-complement of the sum's least signigicant byte */
-  checksum = ~checksum;
-  /* finally verify the calculated checksum with the one at the end of the line */
-  if (checksum != SrecordHexStringToByte(line))
-  {
-    /* checksum incorrect */
+  tSrecordSegment *segment;
+  sb_uint32 idx;
+  sb_uint8 mergePrevious;
+  sb_uint8 mergeNext;
+
+  if (SrecordImageFindSegments(index, address, length, &idx) > 0)
+  {
+    segment = &index->segments[idx];
+    snprintf(srecordErrorText, sizeof(srecordErrorText),
+             "data at 0x%08X overlaps the data that starts on line %u",
+             (segment->address > address) ? segment->address : address, segment->line);
+    error->line = line;
+    error->reason = srecordErrorText;
     return SB_FALSE;
   }
-  /* still here so the checksum was correct */
+  mergePrevious = ( (idx > 0) &&
+                    ((index->segments[idx - 1].address + index->segments[idx - 1].length) ==
+                     address) ) ? SB_TRUE : SB_FALSE;
+  mergeNext = ( (idx < index->segmentCnt) &&
+                ((address + length) == index->segments[idx].address) ) ? SB_TRUE : SB_FALSE;
+  if ( (mergePrevious == SB_TRUE) && (mergeNext == SB_TRUE) )
+  {
+    /* the range fills the gap between two segments */
+    index->segments[idx - 1].length += length + index->segments[idx].length;
+    memmove(&index->segments[idx], &index->segments[idx + 1],
+            (index->segmentCnt - idx - 1) * sizeof(tSrecordSegment));
+    index->segmentCnt--;
+  }
+  else if (mergePrevious == SB_TRUE)
+  {
+    index->segments[idx - 1].length += length;
+  }
+  else if (mergeNext == SB_TRUE)
+  {
+    index->segments[idx].address = address;
+    index->segments[idx].length += length;
+    index->segments[idx].line = line;
+  }
+  else
+  {
+    if (SrecordImageGrowSegments(index) == SB_FALSE)
+    {
+      error->line = 0;
+      error->reason = "out of memory";
+      return SB_FALSE;
+    }
+    memmove(&index->segments[idx + 1], &index->segments[idx],
+            (index->segmentCnt - idx) * sizeof(tSrecordSegment));
+    segment = &index->segments[idx];
+    segment->address = address;
+    segment->length = length;
+    segment->offset = 0;
+    segment->line = line;
+    segment->data = SB_NULL;
+    index->segmentCnt++;
+  }
   return SB_TRUE;
-} /*** end of SrecordVerifyChecksum ***/
+} /*** end of SrecordImageInsertRange ***/
 
 
 /************************************************************************************//**
-** \brief     Helper function to convert a sequence of 2 characters that represent
-**            a hexadecimal value to the actual byte value.
-**              Example: SrecordHexStringToByte("2f")  --> returns 47.
-** \param     hexstring String beginning with 2 characters that represent a hexa-
-**                      decimal value.
-** \return    The resulting byte value.
+** \brief     Sorts the segments of a firmware image by address and merges the ones that
+**            are adjacent. The data is copied into a new arena in the sorted order.
+**            Overlapping segments are kept separate, in the order of the file.
+** \param     image The firmware image.
+** \return    SB_TRUE if successful, SB_FALSE if memory could not be allocated.
 **
 ****************************************************************************************/
-static sb_uint8 SrecordHexStringToByte(const sb_char *hexstring)
+static sb_uint8 SrecordImageSort(tSrecordImage *image)
 {
-  sb_uint8 result = 0;
-  sb_char  c;
-  sb_uint8 counter;
-  
-  /* a hexadecimal character is 2 characters long (i.e 0x4F minus the 0x part) */
-  for (counter=0; counter < 2; counter++)
-  {
-    /* read out the character */
-    c = toupper(hexstring[counter]);
-    /* check that the character is 0..9 or A..F */
-    if ( (c < '0') || (c > 'F') || ( (c > '9') && (c < 'A') ) )
-    {
-      /* character not valid */
-      return 0;
-    }
-    /* convert character to 4-bit value (check ASCII table for more info) */
-    c -= '0';
-    if (c > 9) 
+  tSrecordImage sortedImage;
+  tSrecordSegment *segment;
+  sb_uint32 idx;
+
+  qsort(image->segments, image->segmentCnt, sizeof(tSrecordSegment),
+        SrecordCompareSegments);
+  memset(&sortedImage, 0, sizeof(sortedImage));
+  for (idx=0; idx<image->segmentCnt; idx++)
+  {
+    segment = &image->segments[idx];
+    if (SrecordImageAppend(&sortedImage, segment->address, &image->arena[segment->offset],
+                           segment->length, segment->line) == SB_FALSE)
     {
-      c -= 7;
+      SrecordFreeImage(&sortedImage);
+      return SB_FALSE;
     }
-    /* add it to the result */
-    result = (result << 4) + c;
   }
-  /* return the results */
-  return result;
-} /*** end of SrecordHexStringToByte ***/
+  SrecordFreeImage(image);
+  *image = sortedImage;
+  return SB_TRUE;
+} /*** end of SrecordImageSort ***/
 
 
 /************************************************************************************//**
-** \brief     Reads the next line from the S-record file handle.
-** \param     srecordHandle The S-record file handle. It is returned by SrecordOpen.
-** \param     line Destination buffer for the line characters. Should be of size
-**            SRECORD_MAX_CHARS_PER_LINE.
-** \return    SB_TRUE if successful, SB_FALSE otherwise.
+** \brief     Makes sure that there is room for one more segment in a firmware image.
+** \param     image The firmware image.
+** \return    SB_TRUE if successful, SB_FALSE if memory could not be allocated.
 **
 ****************************************************************************************/
-static sb_uint8 SrecordReadLine(sb_file srecordHandle, sb_char *line)
+static sb_uint8 SrecordImageGrowSegments(tSrecordImage *image)
 {
-  /* init the line as an empty line */
-  line[0] = '\0';
+  tSrecordSegment *newSegments;
+  sb_uint32 newAlloc;
 
-  /* loop as long as we find a non-empty line or end-of-file */
-  while (line[0] == '\0') 
+  if (image->segmentCnt >= image->segmentAlloc)
   {
-    if (fgets(line, SRECORD_MAX_CHARS_PER_LINE, srecordHandle) == SB_NULL)
+    newAlloc = (image->segmentAlloc > 0) ? (image->segmentAlloc * 2) : SRECORD_IMAGE_SEGMENTS;
+    newSegments = realloc(image->segments, newAlloc * sizeof(tSrecordSegment));
+    if (newSegments == SB_NULL)
     {
-      /* no more lines available */
       return SB_FALSE;
     }
-    /* replace the line termination with a string termination */
-    line[strcspn(line, "\n")] = '\0';
+    image->segments = newSegments;
+    image->segmentAlloc = newAlloc;
   }
-  /* still here so not EOF and not and empty line, so success */
   return SB_TRUE;
-} /*** end of SrecordReadLine ***/
+} /*** end of SrecordImageGrowSegments ***/
+
+
+/************************************************************************************//**
+** \brief     Compares two segments for sorting them by address. Segments with the same
+**            address keep the order in which they appear in the file.
+** \param     first The first segment.
+** \param     second The second segment.
+** \return    < 0, 0 or > 0 if the first segment comes before, at or after the second.
+**
+****************************************************************************************/
+static int SrecordCompareSegments(const void *first, const void *second)
+{
+  const tSrecordSegment *firstSegment = first;
+  const tSrecordSegment *secondSegment = second;
+
+  if (firstSegment->address != secondSegment->address)
+  {
+    return (firstSegment->address < secondSegment->address) ? -1 : 1;
+  }
+  /* the arena holds the data in the order of the file */
+  if (firstSegment->offset != secondSegment->offset)
+  {
+    return (firstSegment->offset < secondSegment->offset) ? -1 : 1;
+  }
+  return 0;
+} /*** end of SrecordCompareSegments ***/
 
 
 /*********************************** end of srecord.c **********************************/
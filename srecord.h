@@ -33,17 +33,24 @@
 #ifndef SRECORD_H
 #define SRECORD_H
 
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include "filemap.h"                                  /* read-only file mapping        */
+
 
 /****************************************************************************************
 * Macro definitions
 ****************************************************************************************/
-/** \brief Maximum number of characters that can be on a line in the firmware file. */
-#define SRECORD_MAX_CHARS_PER_LINE        (512)
+/** \brief Initial size of the arena that holds the data of a firmware image. It doubles
+ *         whenever it is full.
+ */
+#define SRECORD_IMAGE_ARENA_SIZE          (64*1024)
 
-/** \brief Maximum number of data bytes that can be on a line in the firmware file
- *         (S-record).
+/** \brief Initial number of segments of a firmware image. It doubles whenever more are
+ *         needed.
  */
-#define SRECORD_MAX_DATA_BYTES_PER_LINE   (SRECORD_MAX_CHARS_PER_LINE/2)
+#define SRECORD_IMAGE_SEGMENTS            (64)
 
 
 /****************************************************************************************
@@ -55,25 +62,73 @@ typedef struct
   sb_uint32 address_low;                          /**< lowest memory address           */
   sb_uint32 address_high;                         /**< lowest memory address           */
   sb_uint32 data_bytes_total;                     /**< total number of data bytes      */
+  sb_uint32 segment_count;                        /**< number of contiguous segments   */
 } tSrecordParseResults;
 
-/** \brief Structure type for grouping the parsing results of an S-record line. */
+/** \brief Structure type for a contiguous range of memory in a firmware image. */
+typedef struct
+{
+  sb_uint32 address;                              /**< start address of the segment    */
+  sb_uint32 length;                               /**< number of data bytes            */
+  sb_uint32 offset;                               /**< offset of the data in the arena */
+  sb_uint32 line;                                 /**< line of its first record, or 0  */
+  sb_uint8 *data;                                 /**< data bytes in the arena         */
+} tSrecordSegment;
+
+/** \brief Structure type for the firmware image in an S-record file. The data of all
+ *         segments is held in one arena. The segments are sorted by address, and
+ *         adjacent S-records are merged into one segment. This makes the segments an
+ *         index of the memory that the image has data in, which is searched with
+ *         SrecordImageFindSegments(). An index without data is built with
+ *         SrecordImageInsertRange(). The arena can also lie in a mapped file, such as
+ *         a cache file, in which case the image holds the mapping and its data is
+ *         read-only.
+ */
+typedef struct
+{
+  tSrecordSegment *segments;                      /**< segments sorted by address      */
+  sb_uint32 segmentCnt;                           /**< number of segments              */
+  sb_uint32 segmentAlloc;                         /**< number of allocated segments    */
+  sb_uint8 *arena;                                /**< data bytes of all segments      */
+  sb_uint32 arenaSize;                            /**< number of used arena bytes      */
+  sb_uint32 arenaAlloc;                           /**< number of allocated arena bytes */
+  tFileMap arenaMap;                              /**< file that holds the arena       */
+} tSrecordImage;
+
+/** \brief Structure type for a range of memory. */
+typedef struct
+{
+  sb_uint32 address;                              /**< start address of the range      */
+  sb_uint32 length;                               /**< number of bytes                 */
+} tSrecordRange;
+
+/** \brief Structure type for the reason that an S-record file was rejected. */
 typedef struct
 {
-  sb_uint8 data[SRECORD_MAX_DATA_BYTES_PER_LINE]; /**< array for S1,S2 or S3 data bytes*/
-  sb_uint32 address;                              /**< address on S1,S2 or S3 line     */
-  sb_uint16 length;                               /**< number of bytes written to array */
-} tSrecordLineParseResults;
+  sb_uint32 line;                                 /**< line number, 0 for the file     */
+  const sb_char *reason;                          /**< description of the error        */
+} tSrecordError;
 
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
-sb_uint8 SrecordIsValid(const sb_char *srecordFile);
-sb_file  SrecordOpen(const sb_char *srecordFile);
-void     SrecordParse(sb_file srecordHandle, tSrecordParseResults *parseResults);
-void     SrecordClose(sb_file srecordHandle);
-sb_uint8 SrecordParseNextDataLine(sb_file srecordHandle, tSrecordLineParseResults *parseResults);
+sb_uint8 SrecordParseImage(const sb_char *buffer, sb_uint32 size, tSrecordImage *image,
+                           tSrecordParseResults *parseResults, tSrecordError *error);
+void     SrecordFreeImage(tSrecordImage *image);
+void     SrecordSetParseThreads(sb_uint32 threadCnt);
+const sb_char *SrecordParseRecord(const sb_char *line, sb_uint32 lineLen,
+                                  sb_uint32 lineNumber, tSrecordImage *image);
+sb_uint8 SrecordImageAppend(tSrecordImage *image, sb_uint32 address,
+                            const sb_uint8 *data, sb_uint32 length, sb_uint32 line);
+sb_uint8 SrecordImageFinish(tSrecordImage *image, sb_uint8 sorted,
+                            tSrecordParseResults *parseResults, tSrecordError *error);
+sb_uint32 SrecordImageFindSegments(const tSrecordImage *image, sb_uint32 address,
+                                   sb_uint32 length, sb_uint32 *segmentIdx);
+sb_uint8 SrecordImageNextEraseRange(const tSrecordImage *image, sb_uint32 sectorSize,
+                                    sb_uint32 *segmentIdx, tSrecordRange *range);
+sb_uint8 SrecordImageInsertRange(tSrecordImage *index, sb_uint32 address,
+                                 sb_uint32 length, sb_uint32 line, tSrecordError *error);
 
 
 #endif /* SRECORD_H */
@@ -36,28 +36,20 @@
 ****************************************************************************************/
 #include <assert.h>                                   /* assertion module              */
 #include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* string library                */
 #include "xcpmaster.h"                                /* XCP master protocol module    */
+#include "xcptrace.h"                                 /* timeline export               */
 
 
 /****************************************************************************************
 * Macro definitions
 ****************************************************************************************/
-/* XCP command codes as defined by the protocol currently supported by this module */
-#define XCP_MASTER_CMD_CONNECT         (0xFF)
-#define XCP_MASTER_CMD_DISCONNECT      (0xFE)
-#define XCP_MASTER_CMD_SET_MTA         (0xF6)
-#define XCP_MASTER_CMD_UPLOAD          (0xF5)
-#define XCP_MASTER_CMD_PROGRAM_START   (0xD2)
-#define XCP_MASTER_CMD_PROGRAM_CLEAR   (0xD1)
-#define XCP_MASTER_CMD_PROGRAM         (0xD0)
-#define XCP_MASTER_CMD_PROGRAM_RESET   (0xCF)
-#define XCP_MASTER_CMD_PROGRAM_MAX     (0xC9)
-
 /* XCP response packet IDs as defined by the protocol */
 #define XCP_MASTER_CMD_PID_RES         (0xFF) /* positive response */
 
-/* timeout values */
-#define XCP_MASTER_CONNECT_TIMEOUT_MS  (20)
+/* timeout values. these are the ceilings of the timeouts that are derived from the
+ * measured round trip times.
+ */
 #define XCP_MASTER_TIMEOUT_T1_MS       (1000)  /* standard command timeout */
 #define XCP_MASTER_TIMEOUT_T2_MS       (2000)  /* build checksum timeout */
 #define XCP_MASTER_TIMEOUT_T3_MS       (2000)  /* program start timeout */
@@ -66,6 +58,16 @@
 #define XCP_MASTER_TIMEOUT_T6_MS       (1000)  /* user specific connect connect timeout */
 #define XCP_MASTER_TIMEOUT_T7_MS       (2000)  /* wait timer timeout */
 
+/** \brief Lower bound of a timeout that is derived from the measured round trip times.
+ *         A response can be held back by the Nagle algorithm of the slave until the
+ *         master's delayed acknowledgement of the previous response, which takes up to
+ *         200 ms. This must not cause a timeout.
+ */
+#define XCP_MASTER_TIMEOUT_MIN_MS      (250)
+
+/** \brief Maximum number of times that a timeout is doubled after consecutive timeouts. */
+#define XCP_MASTER_TIMEOUT_BACKOFF_MAX (4)
+
 /** \brief Number of retries to connect to the XCP slave. */
 #define XCP_MASTER_CONNECT_RETRIES     (5)
 
@@ -73,68 +75,91 @@
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdConnect(void);
-static sb_uint8 XcpMasterSendCmdSetMta(sb_uint32 address);
-static sb_uint8 XcpMasterSendCmdUpload(sb_uint8 data[], sb_uint8 length);
-static sb_uint8 XcpMasterSendCmdProgramStart(void);
-static sb_uint8 XcpMasterSendCmdProgramReset(void);
-static sb_uint8 XcpMasterSendCmdProgram(sb_uint8 length, sb_uint8 data[]);
-static sb_uint8 XcpMasterSendCmdProgramMax(sb_uint8 data[]);
-static sb_uint8 XcpMasterSendCmdProgramClear(sb_uint32 length);
-static void     XcpMasterSetOrderedLong(sb_uint32 value, sb_uint8 data[]);
+static void     XcpMasterResetSession(tXcpMasterSession *session);
+static sb_uint8 XcpMasterSendCmdConnect(tXcpMasterSession *session);
+static sb_uint8 XcpMasterSendCmdSetMta(tXcpMasterSession *session, sb_uint32 address);
+static sb_uint8 XcpMasterSendCmdUpload(tXcpMasterSession *session, sb_uint8 data[],
+                                       sb_uint8 length);
+static sb_uint8 XcpMasterSendCmdProgramStart(tXcpMasterSession *session);
+static sb_uint8 XcpMasterSendCmdProgramReset(tXcpMasterSession *session);
+static sb_uint8 XcpMasterSendCmdProgram(tXcpMasterSession *session, sb_uint8 length,
+                                        sb_uint8 data[]);
+static sb_uint8 XcpMasterSendCmdProgramClear(tXcpMasterSession *session, sb_uint32 length);
+static sb_uint8 XcpMasterTransmitCmd(tXcpMasterSession *session,
+                                     tXcpTransportSegment segments[], sb_uint8 segmentCnt);
+static sb_uint8 XcpMasterTransmitCmdProgram(tXcpMasterSession *session, sb_uint8 length,
+                                            sb_uint8 data[]);
+static sb_uint8 XcpMasterTransmitCmdProgramMax(tXcpMasterSession *session, sb_uint8 data[]);
+static sb_uint8 XcpMasterReceiveResponse(tXcpMasterSession *session);
+static tXcpMasterTimeoutClass XcpMasterGetCmdTimeoutClass(sb_uint8 cmd);
+static void     XcpMasterUpdateRttEstimator(tXcpMasterSession *session, sb_uint8 cmd);
+static void     XcpMasterSetOrderedLong(tXcpMasterSession *session, sb_uint32 value,
+                                        sb_uint8 data[]);
 
 
-/****************************************************************************************
-* Local data declarations
+/************************************************************************************//**
+** \brief     Initializes the XCP master protocol layer.
+** \param     session XCP master session.
+** \param     address Device host name or address. For example "192.168.1.100".
+** \param     port TCP port of the device.
+** \param     profile Socket profile of the connection.
+** \param     connectTimeoutMs Time that establishing the connection is allowed to take.
+** \return    SB_TRUE is successful, SB_FALSE otherwise.
+**
 ****************************************************************************************/
-/** \brief Store the byte ordering of the XCP slave. */
-static sb_uint8 xcpSlaveIsIntel = SB_FALSE;
-
-/** \brief The max number of bytes in the command transmit object (master->slave). */
-static sb_uint8 xcpMaxCto;
-
-/** \brief The max number of bytes in the command transmit object (master->slave) during
- *         a programming session.
- */
-static sb_uint8 xcpMaxProgCto = 0;
-
-/** \brief The max number of bytes in the data transmit object (slave->master). */
-static sb_uint8 xcpMaxDto;
+sb_uint8 XcpMasterInit(tXcpMasterSession *session, sb_char *address, sb_uint32 port,
+                       tXcpTransportProfile profile, sb_uint32 connectTimeoutMs)
+{
+  /* start out with the default session settings */
+  XcpMasterResetSession(session);
 
-/** \brief Internal data buffer for storing the data of the XCP response packet. */
-static tXcpTransportResponsePacket responsePacket;
+  /* initialize the underlying transport layer that is used for the communication */
+  return XcpTransportInit(&session->transport, address, port, profile, connectTimeoutMs);
+} /*** end of XcpMasterInit ***/
 
 
 /************************************************************************************//**
-** \brief     Initializes the XCP master protocol layer.
-** \param     address Device address. For example "192.168.1.100".
+** \brief     Initializes the XCP master protocol layer without waiting for the
+**            connection to be established. Completion of the connection is signalled
+**            by one of the connection attempts becoming writable, after which
+**            XcpTransportConnectPoll() should be called.
+** \param     session XCP master session.
+** \param     host Addresses of the device, from XcpTransportResolve().
+** \param     profile Socket profile of the connection.
 ** \return    SB_TRUE is successful, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterInit(sb_char *address, sb_uint32 port)
+sb_uint8 XcpMasterInitNonBlocking(tXcpMasterSession *session, const tXcpTransportHost *host,
+                                  tXcpTransportProfile profile)
 {
-  /* initialize the underlying transport layer that is used for the communication */
-  return XcpTransportInit(address, port);
-} /*** end of XcpMasterInit ***/
+  /* start out with the default session settings */
+  XcpMasterResetSession(session);
+
+  /* start connecting the underlying transport layer */
+  return XcpTransportConnectStart(&session->transport, host, profile);
+} /*** end of XcpMasterInitNonBlocking ***/
 
 
 /************************************************************************************//**
 ** \brief     Uninitializes the XCP master protocol layer.
+** \param     session XCP master session.
 ** \return    none.
 **
 ****************************************************************************************/
-void XcpMasterDeinit(void)
+void XcpMasterDeinit(tXcpMasterSession *session)
 {
-  XcpTransportClose();
+  XcpTransportClose(&session->transport);
+  XCP_STATS_SESSION_END(&session->stats, &session->transport.stats);
 } /*** end of XcpMasterDeinit ***/
 
 
 /************************************************************************************//**
 ** \brief     Connect to the XCP slave.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterConnect(void)
+sb_uint8 XcpMasterConnect(tXcpMasterSession *session)
 {
   sb_uint8 cnt;
   
@@ -142,7 +167,7 @@ sb_uint8 XcpMasterConnect(void)
   for (cnt=0; cnt<XCP_MASTER_CONNECT_RETRIES; cnt++)
   {
     /* send the connect command */
-    if (XcpMasterSendCmdConnect() == SB_TRUE)
+    if (XcpMasterSendCmdConnect(session) == SB_TRUE)
     {
       /* connected so no need to retry */
       return SB_TRUE;
@@ -155,81 +180,87 @@ sb_uint8 XcpMasterConnect(void)
 
 /************************************************************************************//**
 ** \brief     Disconnect the slave.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterDisconnect(void)
+sb_uint8 XcpMasterDisconnect(tXcpMasterSession *session)
 {
   /* send reset command instead of the disconnect. this causes the user program on the
    * slave to automatically start again if present.
    */
-  return XcpMasterSendCmdProgramReset();
+  return XcpMasterSendCmdProgramReset(session);
 } /*** end of XcpMasterDisconnect ***/
 
 /************************************************************************************//**
 ** \brief     Puts a connected slave in programming session.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterStartProgrammingSession(void)
+sb_uint8 XcpMasterStartProgrammingSession(tXcpMasterSession *session)
 {
   /* place the slave in programming mode */
-  return XcpMasterSendCmdProgramStart();
+  return XcpMasterSendCmdProgramStart(session);
 } /*** end of XcpMasterStartProgrammingSession ***/
 
 
 /************************************************************************************//**
 ** \brief     Stops the programming session by sending a program command with size 0 and
 **            then resetting the slave.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterStopProgrammingSession(void)
+sb_uint8 XcpMasterStopProgrammingSession(tXcpMasterSession *session)
 {
   /* stop programming by sending the program command with size 0 */
-  if (XcpMasterSendCmdProgram(0, SB_NULL) == SB_FALSE)
+  if (XcpMasterSendCmdProgram(session, 0, SB_NULL) == SB_FALSE)
   {
     return SB_FALSE;
   }
   /* request a reset of the slave */
-  return XcpMasterSendCmdProgramReset();
+  return XcpMasterSendCmdProgramReset(session);
 } /*** end of XcpMasterStopProgrammingSession ***/
 
 
 /************************************************************************************//**
 ** \brief     Erases non volatile memory on the slave.
+** \param     session XCP master session.
 ** \param     addr Base memory address for the erase operation.
 ** \param     len Number of bytes to erase.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterClearMemory(sb_uint32 addr, sb_uint32 len)
+sb_uint8 XcpMasterClearMemory(tXcpMasterSession *session, sb_uint32 addr, sb_uint32 len)
 {
   /* first set the MTA pointer */
-  if (XcpMasterSendCmdSetMta(addr) == SB_FALSE)
+  if (XcpMasterSendCmdSetMta(session, addr) == SB_FALSE)
   {
     return SB_FALSE;
   }
   /* now perform the erase operation */
-  return XcpMasterSendCmdProgramClear(len);
+  return XcpMasterSendCmdProgramClear(session, len);
 } /*** end of XcpMasterClearMemory ***/
 
 
 /************************************************************************************//**
 ** \brief     Reads data from the slave's memory.
+** \param     session XCP master session.
 ** \param     addr Base memory address for the read operation
 ** \param     len Number of bytes to read.
 ** \param     data Destination buffer for storing the read data bytes.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterReadData(sb_uint32 addr, sb_uint32 len, sb_uint8 data[])
+sb_uint8 XcpMasterReadData(tXcpMasterSession *session, sb_uint32 addr, sb_uint32 len,
+                           sb_uint8 data[])
 {
   sb_uint8 currentReadCnt;
   sb_uint32 bufferOffset = 0;
 
   /* first set the MTA pointer */
-  if (XcpMasterSendCmdSetMta(addr) == SB_FALSE)
+  if (XcpMasterSendCmdSetMta(session, addr) == SB_FALSE)
   {
     return SB_FALSE;
   }
@@ -237,13 +268,13 @@ sb_uint8 XcpMasterReadData(sb_uint32 addr, sb_uint32 len, sb_uint8 data[])
   while (len > 0)
   {
     /* set the current read length to make optimal use of the available packet data. */
-    currentReadCnt = len % (xcpMaxDto - 1);
+    currentReadCnt = len % (session->maxDto - 1);
     if (currentReadCnt == 0)
     {
-      currentReadCnt = (xcpMaxDto - 1);
+      currentReadCnt = (session->maxDto - 1);
     }
     /* upload some data */
-    if (XcpMasterSendCmdUpload(&data[bufferOffset], currentReadCnt) == SB_FALSE)
+    if (XcpMasterSendCmdUpload(session, &data[bufferOffset], currentReadCnt) == SB_FALSE)
     {
       return SB_FALSE;
     }
@@ -258,126 +289,166 @@ sb_uint8 XcpMasterReadData(sb_uint32 addr, sb_uint32 len, sb_uint8 data[])
 
 /************************************************************************************//**
 ** \brief     Programs data to the slave's non volatile memory. Note that it must be
-**            erased first.
+**            erased first. Up to the configured program window of commands are kept in
+**            flight and their responses are matched in order. On the first failing command no
+**            new commands are sent and the address of that command is stored, such that
+**            it can be obtained with XcpMasterGetErrorAddress().
+** \param     session XCP master session.
 ** \param     addr Base memory address for the program operation
 ** \param     len Number of bytes to program.
 ** \param     data Source buffer with the to be programmed bytes.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-sb_uint8 XcpMasterProgramData(sb_uint32 addr, sb_uint32 len, sb_uint8 data[])
+sb_uint8 XcpMasterProgramData(tXcpMasterSession *session, sb_uint32 addr, sb_uint32 len,
+                              sb_uint8 data[])
 {
   sb_uint8 currentWriteCnt;
   sb_uint32 bufferOffset = 0;
+  sb_uint32 inFlightAddr[XCP_MASTER_PROGRAM_WINDOW_MAX];
+  sb_uint8 inFlightHead = 0;
+  sb_uint8 inFlightCnt = 0;
+  sb_uint8 result = SB_TRUE;
+  sb_uint8 errorAddressSet = SB_FALSE;
+  sb_uint32 transmitErrorAddr = 0;
 
   /* first set the MTA pointer */
-  if (XcpMasterSendCmdSetMta(addr) == SB_FALSE)
+  if (XcpMasterSendCmdSetMta(session, addr) == SB_FALSE)
   {
+    session->errorAddress = addr;
     return SB_FALSE;
   }
   /* perform segmented programming of the data */
-  while (len > 0)
+  while ( (len > 0) || (inFlightCnt > 0) )
   {
-    /* set the current read length to make optimal use of the available packet data. */
-    currentWriteCnt = len % (xcpMaxProgCto - 1);
-    if (currentWriteCnt == 0)
-    {
-      currentWriteCnt = (xcpMaxProgCto - 1);
-    }
-    /* prepare the packed data for the program command */
-    if (currentWriteCnt < (xcpMaxProgCto - 1))
+    /* fill up the window with program commands, unless an error was detected */
+    while ( (result == SB_TRUE) && (len > 0) && (inFlightCnt < session->programWindow) )
     {
-      /* program data */
-      if (XcpMasterSendCmdProgram(currentWriteCnt, &data[bufferOffset]) == SB_FALSE)
+      /* transmit the next part of the data */
+      currentWriteCnt = XcpMasterTransmitProgramData(session, len, &data[bufferOffset]);
+      if (currentWriteCnt == 0)
       {
-        return SB_FALSE;
+        /* the commands in flight precede this one, so it is only reported when none
+         * of them fails
+         */
+        result = SB_FALSE;
+        transmitErrorAddr = addr + bufferOffset;
+        break;
       }
+      /* remember the address of this command for error reporting */
+      inFlightAddr[(inFlightHead + inFlightCnt) % XCP_MASTER_PROGRAM_WINDOW_MAX] = addr + bufferOffset;
+      inFlightCnt++;
+      /* update loop variables */
+      len -= currentWriteCnt;
+      bufferOffset += currentWriteCnt;
     }
-    else
+    /* stop if nothing is in flight anymore. can only happen after an error */
+    if (inFlightCnt == 0)
     {
-      /* program max data */
-      if (XcpMasterSendCmdProgramMax(&data[bufferOffset]) == SB_FALSE)
+      break;
+    }
+    /* collect the response of the oldest command in flight */
+    if (XcpMasterReceiveResponse(session) == SB_FALSE)
+    {
+      if (errorAddressSet == SB_FALSE)
+      {
+        session->errorAddress = inFlightAddr[inFlightHead];
+        errorAddressSet = SB_TRUE;
+      }
+      result = SB_FALSE;
+      /* a lost response means the in-flight responses are no longer in sync */
+      if (XcpTransportReadResponsePacket(&session->transport)->len == 0)
       {
-        return SB_FALSE;
+        break;
       }
     }
-    /* update loop variables */
-    len -= currentWriteCnt;
-    bufferOffset += currentWriteCnt;
+    inFlightHead = (inFlightHead + 1) % XCP_MASTER_PROGRAM_WINDOW_MAX;
+    inFlightCnt--;
+    /* stop sending after an error, but still drain the commands that are in flight */
+    if (result == SB_FALSE)
+    {
+      len = 0;
+    }
   }
-  /* still here so all data successfully programmed */
-  return SB_TRUE;
+  /* report the failed transmission if all commands before it succeeded */
+  if ( (result == SB_FALSE) && (errorAddressSet == SB_FALSE) )
+  {
+    session->errorAddress = transmitErrorAddr;
+  }
+  /* all data successfully programmed if no error was detected */
+  return result;
 } /*** end of XcpMasterProgramData ***/
 
 
 /************************************************************************************//**
-** \brief     Sends the XCP Connect command.
+** \brief     Configures the number of program commands that XcpMasterProgramData() keeps
+**            in flight. A window of 1 results in stop-and-wait operation.
+** \param     session XCP master session.
+** \param     window Number of program commands in flight.
+** \return    none.
+**
+****************************************************************************************/
+void XcpMasterSetProgramWindow(tXcpMasterSession *session, sb_uint8 window)
+{
+  /* make sure the window is within the supported range */
+  if (window < 1)
+  {
+    window = 1;
+  }
+  else if (window > XCP_MASTER_PROGRAM_WINDOW_MAX)
+  {
+    window = XCP_MASTER_PROGRAM_WINDOW_MAX;
+  }
+  session->programWindow = window;
+} /*** end of XcpMasterSetProgramWindow ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the memory address of the first command that failed during
+**            XcpMasterProgramData().
+** \param     session XCP master session.
+** \return    The memory address.
+**
+****************************************************************************************/
+sb_uint32 XcpMasterGetErrorAddress(tXcpMasterSession *session)
+{
+  return session->errorAddress;
+} /*** end of XcpMasterGetErrorAddress ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the XCP CONNECT command without waiting for its response.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdConnect(void)
+sb_uint8 XcpMasterTransmitConnect(tXcpMasterSession *session)
 {
   sb_uint8 packetData[2];
-  tXcpTransportResponsePacket *responsePacketPtr;
+  tXcpTransportSegment segment;
   
   /* prepare the command packet */
   packetData[0] = XCP_MASTER_CMD_CONNECT;
   packetData[1] = 0; /* normal mode */
   
   /* send the packet */
-  if (XcpTransportSendPacket(packetData, 2, XCP_MASTER_CONNECT_TIMEOUT_MS) == SB_FALSE)
-  {
-    /* cound not set packet or receive response within the specified timeout */
-    return SB_FALSE;
-  }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
-  {
-    /* not a valid or positive response */
-    return SB_FALSE;
-  }
-  
-  /* process response data */
-  if ((responsePacketPtr->data[2] & 0x01) == 0)
-  {
-    /* store slave's byte ordering information */
-    xcpSlaveIsIntel = SB_TRUE;
-  }
-  /* store max number of bytes the slave allows for master->slave packets. */
-  xcpMaxCto = responsePacketPtr->data[3];
-  xcpMaxProgCto = xcpMaxCto;
-  /* store max number of bytes the slave allows for slave->master packets. */
-  if (xcpSlaveIsIntel == SB_TRUE)
-  {
-    xcpMaxDto = responsePacketPtr->data[4] + (responsePacketPtr->data[5] << 8);
-  }
-  else
-  {
-    xcpMaxDto = responsePacketPtr->data[5] + (responsePacketPtr->data[4] << 8);
-  }
-  
-  /* double check size configuration of the master */
-  assert(XCP_MASTER_TX_MAX_DATA >= xcpMaxCto);
-  assert(XCP_MASTER_RX_MAX_DATA >= xcpMaxDto);
-  
-  /* still here so all went well */  
-  return SB_TRUE;
-} /*** end of XcpMasterSendCmdConnect ***/
+  segment.data = packetData;
+  segment.len = 2;
+  return XcpMasterTransmitCmd(session, &segment, 1);
+} /*** end of XcpMasterTransmitConnect ***/
 
 
 /************************************************************************************//**
-** \brief     Sends the XCP Set MTA command.
+** \brief     Transmits the XCP SET MTA command without waiting for its response.
+** \param     session XCP master session.
 ** \param     address New MTA address for the slave.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdSetMta(sb_uint32 address)
+sb_uint8 XcpMasterTransmitSetMta(tXcpMasterSession *session, sb_uint32 address)
 {
   sb_uint8 packetData[8];
-  tXcpTransportResponsePacket *responsePacketPtr;
+  tXcpTransportSegment segment;
   
   /* prepare the command packet */
   packetData[0] = XCP_MASTER_CMD_SET_MTA;
@@ -386,16 +457,171 @@ static sb_uint8 XcpMasterSendCmdSetMta(sb_uint32 address)
   packetData[3] = 0; /* address extension not supported */
   
   /* set the address taking into account byte ordering */
-  XcpMasterSetOrderedLong(address, &packetData[4]);
+  XcpMasterSetOrderedLong(session, address, &packetData[4]);
   
   /* send the packet */
-  if (XcpTransportSendPacket(packetData, 8, XCP_MASTER_TIMEOUT_T1_MS) == SB_FALSE)
+  segment.data = packetData;
+  segment.len = 8;
+  return XcpMasterTransmitCmd(session, &segment, 1);
+} /*** end of XcpMasterTransmitSetMta ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the XCP PROGRAM START command without waiting for its response.
+** \param     session XCP master session.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpMasterTransmitProgramStart(tXcpMasterSession *session)
+{
+  sb_uint8 packetData[1];
+  tXcpTransportSegment segment;
+
+  /* prepare the command packet */
+  packetData[0] = XCP_MASTER_CMD_PROGRAM_START;
+
+  /* send the packet */
+  segment.data = packetData;
+  segment.len = 1;
+  return XcpMasterTransmitCmd(session, &segment, 1);
+} /*** end of XcpMasterTransmitProgramStart ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the XCP PROGRAM CLEAR command without waiting for its response.
+** \param     session XCP master session.
+** \param     length Number of bytes to erase, starting at the MTA.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpMasterTransmitProgramClear(tXcpMasterSession *session, sb_uint32 length)
+{
+  sb_uint8 packetData[8];
+  tXcpTransportSegment segment;
+
+  /* prepare the command packet */
+  packetData[0] = XCP_MASTER_CMD_PROGRAM_CLEAR;
+  packetData[1] = 0; /* use absolute mode */
+  packetData[2] = 0; /* reserved */
+  packetData[3] = 0; /* reserved */
+
+  /* set the erase length taking into account byte ordering */
+  XcpMasterSetOrderedLong(session, length, &packetData[4]);
+
+  /* send the packet */
+  segment.data = packetData;
+  segment.len = 8;
+  return XcpMasterTransmitCmd(session, &segment, 1);
+} /*** end of XcpMasterTransmitProgramClear ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits a PROGRAM or PROGRAM MAX command with the next part of the data
+**            to program, without waiting for its response. The part is sized such
+**            that all following parts make optimal use of the available packet data.
+** \param     session XCP master session.
+** \param     len Number of bytes that still need to be programmed.
+** \param     data Source buffer with the to be programmed bytes.
+** \return    Number of bytes that were transmitted, 0 in case of an error.
+**
+****************************************************************************************/
+sb_uint8 XcpMasterTransmitProgramData(tXcpMasterSession *session, sb_uint32 len,
+                                      sb_uint8 data[])
+{
+  sb_uint8 currentWriteCnt;
+  sb_uint8 result;
+
+  /* set the current write length to make optimal use of the available packet data. */
+  currentWriteCnt = len % (session->maxProgCto - 1);
+  if (currentWriteCnt == 0)
   {
-    /* cound not set packet or receive response within the specified timeout */
-    return SB_FALSE;
+    currentWriteCnt = (session->maxProgCto - 1);
   }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
+  /* prepare the packed data for the program command */
+  if (currentWriteCnt < (session->maxProgCto - 1))
+  {
+    /* program data */
+    result = XcpMasterTransmitCmdProgram(session, currentWriteCnt, data);
+  }
+  else
+  {
+    /* program max data */
+    result = XcpMasterTransmitCmdProgramMax(session, data);
+  }
+  return (result == SB_TRUE) ? currentWriteCnt : 0;
+} /*** end of XcpMasterTransmitProgramData ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the XCP PROGRAM command with size 0, which ends the programming
+**            session, without waiting for its response.
+** \param     session XCP master session.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpMasterTransmitProgramStop(tXcpMasterSession *session)
+{
+  return XcpMasterTransmitCmdProgram(session, 0, SB_NULL);
+} /*** end of XcpMasterTransmitProgramStop ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the XCP PROGRAM RESET command without waiting for its response.
+**            Note that the slave does not necessarily respond to this command.
+** \param     session XCP master session.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpMasterTransmitProgramReset(tXcpMasterSession *session)
+{
+  sb_uint8 packetData[1];
+  tXcpTransportSegment segment;
+
+  /* prepare the command packet */
+  packetData[0] = XCP_MASTER_CMD_PROGRAM_RESET;
+
+  /* send the packet */
+  segment.data = packetData;
+  segment.len = 1;
+  return XcpMasterTransmitCmd(session, &segment, 1);
+} /*** end of XcpMasterTransmitProgramReset ***/
+
+
+/************************************************************************************//**
+** \brief     Processes the response packet of the oldest command in flight, after it
+**            was received by the transport layer. Checks that it is a positive
+**            response and stores the information that the slave reports in it.
+** \param     session XCP master session.
+** \return    SB_TRUE if a positive response was received, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpMasterHandleResponse(tXcpMasterSession *session)
+{
+  tXcpTransportResponsePacket *responsePacketPtr;
+  sb_uint8 cmd;
+
+  /* the response belongs to the oldest command in flight */
+  assert(session->pendingCnt > 0);
+  cmd = session->pendingCmd[session->pendingHead];
+  session->pendingHead = (session->pendingHead + 1) % XCP_MASTER_PENDING_MAX;
+  session->pendingCnt--;
+
+  /* any response tells how long the slave took to process this type of command, except
+   * for the reset command that the slave does not necessarily respond to
+   */
+  if (cmd != XCP_MASTER_CMD_PROGRAM_RESET)
+  {
+    XcpMasterUpdateRttEstimator(session, cmd);
+  }
+
+  responsePacketPtr = XcpTransportReadResponsePacket(&session->transport);
+  XCP_STATS_RESPONSE_RECEIVED(&session->stats, cmd, responsePacketPtr->len,
+                              (responsePacketPtr->len > 0) &&
+                              (responsePacketPtr->data[0] == XCP_MASTER_CMD_PID_RES),
+                              session->transport.stats.lastRttUs);
+  XcpTraceCommand(cmd, session->transport.stats.lastRttUs,
+                  (responsePacketPtr->len > 0) &&
+                  (responsePacketPtr->data[0] == XCP_MASTER_CMD_PID_RES));
   
   /* check if the reponse was valid */
   if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
@@ -403,23 +629,302 @@ static sb_uint8 XcpMasterSendCmdSetMta(sb_uint32 address)
     /* not a valid or positive response */
     return SB_FALSE;
   }
+
+  /* process response data of the connect command */
+  if (cmd == XCP_MASTER_CMD_CONNECT)
+  {
+    if ((responsePacketPtr->data[2] & 0x01) == 0)
+    {
+      /* store slave's byte ordering information */
+      session->slaveIsIntel = SB_TRUE;
+    }
+    /* store max number of bytes the slave allows for master->slave packets. */
+    session->maxCto = responsePacketPtr->data[3];
+    session->maxProgCto = session->maxCto;
+    /* store max number of bytes the slave allows for slave->master packets. */
+    if (session->slaveIsIntel == SB_TRUE)
+    {
+      session->maxDto = responsePacketPtr->data[4] + (responsePacketPtr->data[5] << 8);
+    }
+    else
+    {
+      session->maxDto = responsePacketPtr->data[5] + (responsePacketPtr->data[4] << 8);
+    }
+    
+    /* double check size configuration of the master */
+    assert(XCP_MASTER_TX_MAX_DATA >= session->maxCto);
+    assert(XCP_MASTER_RX_MAX_DATA >= session->maxDto);
+  }
+  /* process response data of the program start command */
+  else if (cmd == XCP_MASTER_CMD_PROGRAM_START)
+  {
+    /* store max number of bytes the slave allows for master->slave packets during the
+     * programming session
+     */
+    session->maxProgCto = responsePacketPtr->data[3];
+  }
   
   /* still here so all went well */  
   return SB_TRUE;
+} /*** end of XcpMasterHandleResponse ***/
+
+
+/************************************************************************************//**
+** \brief     Processes the situation where the response of the oldest command in flight
+**            did not arrive in time. The responses of the commands in flight can no
+**            longer be matched to their commands, so they are all discarded.
+** \param     session XCP master session.
+** \return    none.
+**
+****************************************************************************************/
+void XcpMasterHandleTimeout(tXcpMasterSession *session)
+{
+  tXcpMasterRttEstimator *estimator;
+
+  /* back off the timeout of this type of command, in case the slave got slower. the
+   * slave does not necessarily respond to the reset command, so that is no timeout.
+   */
+  if ( (session->pendingCnt > 0) &&
+       (session->pendingCmd[session->pendingHead] != XCP_MASTER_CMD_PROGRAM_RESET) )
+  {
+    estimator = &session->rttEstimators[XcpMasterGetCmdTimeoutClass(session->pendingCmd[session->pendingHead])];
+    estimator->timeouts++;
+    XCP_STATS_TIMEOUT(&session->stats, session->pendingCmd[session->pendingHead]);
+    XcpTraceTimeout(session->pendingCmd[session->pendingHead]);
+    if (estimator->backoff < XCP_MASTER_TIMEOUT_BACKOFF_MAX)
+    {
+      estimator->backoff++;
+    }
+  }
+  session->pendingHead = 0;
+  session->pendingCnt = 0;
+} /*** end of XcpMasterHandleTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the time that the slave is allowed to take for responding to the
+**            oldest command in flight.
+** \param     session XCP master session.
+** \return    Timeout in milliseconds.
+**
+****************************************************************************************/
+sb_uint16 XcpMasterGetResponseTimeout(tXcpMasterSession *session)
+{
+  if (session->pendingCnt == 0)
+  {
+    return XcpMasterGetTimeout(session, XCP_MASTER_TIMEOUT_CLASS_STD);
+  }
+  return XcpMasterGetTimeout(session, XcpMasterGetCmdTimeoutClass(session->pendingCmd[session->pendingHead]));
+} /*** end of XcpMasterGetResponseTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the time that the slave is allowed to take for responding to a
+**            type of command. It is derived from the measured round trip times the same
+**            way TCP derives its retransmission timeout (RFC 6298): the smoothed round
+**            trip time plus four times its variation. The timeout is doubled for each
+**            consecutive timeout. It never exceeds the timeout that the XCP
+**            specification defines for the type of command, which is also used as long
+**            as no round trip time was measured. Erase commands always get the
+**            specified timeout, because the time to erase grows with the length that
+**            is erased and the previous erase says nothing about the next one.
+** \param     session XCP master session.
+** \param     timeoutClass Type of command.
+** \return    Timeout in milliseconds.
+**
+****************************************************************************************/
+sb_uint16 XcpMasterGetTimeout(tXcpMasterSession *session, tXcpMasterTimeoutClass timeoutClass)
+{
+  static const sb_uint16 ceilingsMs[XCP_MASTER_TIMEOUT_CLASS_CNT] =
+  {
+    XCP_MASTER_TIMEOUT_T1_MS,
+    XCP_MASTER_TIMEOUT_T6_MS,
+    XCP_MASTER_TIMEOUT_T3_MS,
+    XCP_MASTER_TIMEOUT_T4_MS,
+    XCP_MASTER_TIMEOUT_T5_MS
+  };
+  tXcpMasterRttEstimator *estimator = &session->rttEstimators[timeoutClass];
+  sb_uint32 srttUs = estimator->srttUs;
+  sb_uint32 rttvarUs = estimator->rttvarUs;
+  sb_uint32 timeoutMs;
+
+  if (timeoutClass == XCP_MASTER_TIMEOUT_CLASS_CLEAR)
+  {
+    return ceilingsMs[timeoutClass];
+  }
+  if (estimator->samples == 0)
+  {
+    /* commands that the slave processes right away take about as long as the TCP
+     * handshake. the other commands start out with the specified timeout.
+     */
+    if ( ((timeoutClass != XCP_MASTER_TIMEOUT_CLASS_STD) &&
+          (timeoutClass != XCP_MASTER_TIMEOUT_CLASS_CONNECT)) ||
+         (session->transport.stats.connectRttUs == 0) )
+    {
+      return ceilingsMs[timeoutClass];
+    }
+    srttUs = session->transport.stats.connectRttUs;
+    rttvarUs = srttUs / 2;
+  }
+  /* RTO = SRTT + max(G, 4 * RTTVAR), with a clock granularity G of 1 ms */
+  timeoutMs = (srttUs + ((4 * rttvarUs > 1000) ? (4 * rttvarUs) : 1000) + 999) / 1000;
+  if (timeoutMs < XCP_MASTER_TIMEOUT_MIN_MS)
+  {
+    timeoutMs = XCP_MASTER_TIMEOUT_MIN_MS;
+  }
+  timeoutMs <<= estimator->backoff;
+  if (timeoutMs > ceilingsMs[timeoutClass])
+  {
+    timeoutMs = ceilingsMs[timeoutClass];
+  }
+  return (sb_uint16)timeoutMs;
+} /*** end of XcpMasterGetTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the round trip time estimator of a type of command.
+** \param     session XCP master session.
+** \param     timeoutClass Type of command.
+** \return    Round trip time estimator.
+**
+****************************************************************************************/
+tXcpMasterRttEstimator *XcpMasterGetRttEstimator(tXcpMasterSession *session,
+                                                 tXcpMasterTimeoutClass timeoutClass)
+{
+  return &session->rttEstimators[timeoutClass];
+} /*** end of XcpMasterGetRttEstimator ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains a descriptive name of a type of command.
+** \param     timeoutClass Type of command.
+** \return    Name of the type of command.
+**
+****************************************************************************************/
+const sb_char *XcpMasterGetTimeoutClassName(tXcpMasterTimeoutClass timeoutClass)
+{
+  switch (timeoutClass)
+  {
+    case XCP_MASTER_TIMEOUT_CLASS_CONNECT:
+      return "connect";
+    case XCP_MASTER_TIMEOUT_CLASS_PROGRAM_START:
+      return "program start";
+    case XCP_MASTER_TIMEOUT_CLASS_CLEAR:
+      return "erase";
+    case XCP_MASTER_TIMEOUT_CLASS_PROGRAM:
+      return "program";
+    default:
+      return "standard";
+  }
+} /*** end of XcpMasterGetTimeoutClassName ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the name of an XCP command, as used in the XCP specification.
+** \param     cmd XCP command code.
+** \return    Name of the command.
+**
+****************************************************************************************/
+const sb_char *XcpMasterGetCmdName(sb_uint8 cmd)
+{
+  switch (cmd)
+  {
+    case XCP_MASTER_CMD_CONNECT:
+      return "CONNECT";
+    case XCP_MASTER_CMD_DISCONNECT:
+      return "DISCONNECT";
+    case XCP_MASTER_CMD_SET_MTA:
+      return "SET_MTA";
+    case XCP_MASTER_CMD_UPLOAD:
+      return "UPLOAD";
+    case XCP_MASTER_CMD_PROGRAM_START:
+      return "PROGRAM_START";
+    case XCP_MASTER_CMD_PROGRAM_CLEAR:
+      return "PROGRAM_CLEAR";
+    case XCP_MASTER_CMD_PROGRAM:
+      return "PROGRAM";
+    case XCP_MASTER_CMD_PROGRAM_RESET:
+      return "PROGRAM_RESET";
+    case XCP_MASTER_CMD_PROGRAM_MAX:
+      return "PROGRAM_MAX";
+    default:
+      return "UNKNOWN";
+  }
+} /*** end of XcpMasterGetCmdName ***/
+
+
+/************************************************************************************//**
+** \brief     Resets the session to its default settings.
+** \param     session XCP master session.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpMasterResetSession(tXcpMasterSession *session)
+{
+  session->slaveIsIntel = SB_FALSE;
+  session->maxCto = 0;
+  session->maxProgCto = 0;
+  session->maxDto = 0;
+  session->programWindow = 1;
+  session->errorAddress = 0;
+  session->pendingHead = 0;
+  session->pendingCnt = 0;
+  memset(session->rttEstimators, 0, sizeof(session->rttEstimators));
+  XCP_STATS_INIT(&session->stats);
+} /*** end of XcpMasterResetSession ***/
+
+
+/************************************************************************************//**
+** \brief     Sends the XCP Connect command.
+** \param     session XCP master session.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpMasterSendCmdConnect(tXcpMasterSession *session)
+{
+  /* send the packet */
+  if (XcpMasterTransmitConnect(session) == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+  /* wait for the response */
+  return XcpMasterReceiveResponse(session);
+} /*** end of XcpMasterSendCmdConnect ***/
+
+
+/************************************************************************************//**
+** \brief     Sends the XCP Set MTA command.
+** \param     session XCP master session.
+** \param     address New MTA address for the slave.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpMasterSendCmdSetMta(tXcpMasterSession *session, sb_uint32 address)
+{
+  /* send the packet */
+  if (XcpMasterTransmitSetMta(session, address) == SB_FALSE)
+  {
+    return SB_FALSE;
+  }
+  /* wait for the response */
+  return XcpMasterReceiveResponse(session);
 } /*** end of XcpMasterSendCmdSetMta ***/
 
 
 /************************************************************************************//**
 ** \brief     Sends the XCP UPLOAD command.
+** \param     session XCP master session.
 ** \param     data Destination data buffer.
 ** \param     length Number of bytes to upload.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdUpload(sb_uint8 data[], sb_uint8 length)
+static sb_uint8 XcpMasterSendCmdUpload(tXcpMasterSession *session, sb_uint8 data[],
+                                       sb_uint8 length)
 {
   sb_uint8 packetData[2];
   tXcpTransportResponsePacket *responsePacketPtr;
+  tXcpTransportSegment segment;
   sb_uint8 data_index;
   
   /* cannot request more data then the max rx data - 1 */
@@ -430,20 +935,19 @@ static sb_uint8 XcpMasterSendCmdUpload(sb_uint8 data[], sb_uint8 length)
   packetData[1] = length;
 
   /* send the packet */
-  if (XcpTransportSendPacket(packetData, 2, XCP_MASTER_TIMEOUT_T1_MS) == SB_FALSE)
+  segment.data = packetData;
+  segment.len = 2;
+  if (XcpMasterTransmitCmd(session, &segment, 1) == SB_FALSE)
   {
-    /* cound not set packet or receive response within the specified timeout */
     return SB_FALSE;
   }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
+  /* wait for the response */
+  if (XcpMasterReceiveResponse(session) == SB_FALSE)
   {
-    /* not a valid or positive response */
     return SB_FALSE;
   }
+  /* still here so a response was received */
+  responsePacketPtr = XcpTransportReadResponsePacket(&session->transport);
   
   /* now store the uploaded data */
   for (data_index=0; data_index<length; data_index++)
@@ -458,75 +962,44 @@ static sb_uint8 XcpMasterSendCmdUpload(sb_uint8 data[], sb_uint8 length)
 
 /************************************************************************************//**
 ** \brief     Sends the XCP PROGRAM START command.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdProgramStart(void)
+static sb_uint8 XcpMasterSendCmdProgramStart(tXcpMasterSession *session)
 {
-  sb_uint8 packetData[1];
-  tXcpTransportResponsePacket *responsePacketPtr;
-
-  /* prepare the command packet */
-  packetData[0] = XCP_MASTER_CMD_PROGRAM_START;
-
   /* send the packet */
-  if (XcpTransportSendPacket(packetData, 1, XCP_MASTER_TIMEOUT_T3_MS) == SB_FALSE)
-  {
-    /* cound not set packet or receive response within the specified timeout */
-    return SB_FALSE;
-  }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
+  if (XcpMasterTransmitProgramStart(session) == SB_FALSE)
   {
-    /* not a valid or positive response */
     return SB_FALSE;
   }
-  
-  /* store max number of bytes the slave allows for master->slave packets during the
-   * programming session
-   */
-  xcpMaxProgCto = responsePacketPtr->data[3];
-  
-  /* still here so all went well */  
-  return SB_TRUE;
+  /* wait for the response */
+  return XcpMasterReceiveResponse(session);
 } /*** end of XcpMasterSendCmdProgramStart ***/
 
 
 /************************************************************************************//**
 ** \brief     Sends the XCP PROGRAM RESET command. Note that this command is a bit 
 **            different as in it does not require a response.
+** \param     session XCP master session.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdProgramReset(void)
+static sb_uint8 XcpMasterSendCmdProgramReset(tXcpMasterSession *session)
 {
-  sb_uint8 packetData[1];
-  tXcpTransportResponsePacket *responsePacketPtr;
-
-  /* prepare the command packet */
-  packetData[0] = XCP_MASTER_CMD_PROGRAM_RESET;
-
   /* send the packet, assume the sending itself is ok and check if a response was
    * received.
    */
-  if (XcpTransportSendPacket(packetData, 1, XCP_MASTER_TIMEOUT_T5_MS) == SB_FALSE)
+  if (XcpMasterTransmitProgramReset(session) == SB_FALSE)
   {
-    /* probably no response received within the specified timeout, but that is allowed
-     * for the reset command.
-     */
     return SB_TRUE;
   }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
+  if (XcpMasterReceiveResponse(session) == SB_FALSE)
   {
-    /* not a valid or positive response */
-    return SB_FALSE;
+    /* probably no response received within the specified timeout, but that is allowed
+     * for the reset command. only a negative response is an error.
+     */
+    return (XcpTransportReadResponsePacket(&session->transport)->len == 0) ? SB_TRUE : SB_FALSE;
   }
   
   /* still here so all went well */  
@@ -536,144 +1009,233 @@ static sb_uint8 XcpMasterSendCmdProgramReset(void)
 
 /************************************************************************************//**
 ** \brief     Sends the XCP PROGRAM command.
+** \param     session XCP master session.
 ** \param     length Number of bytes in the data array to program.
 ** \param     data Array with data bytes to program.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdProgram(sb_uint8 length, sb_uint8 data[])
+static sb_uint8 XcpMasterSendCmdProgram(tXcpMasterSession *session, sb_uint8 length,
+                                        sb_uint8 data[])
 {
-  sb_uint8 packetData[XCP_MASTER_TX_MAX_DATA];
-  tXcpTransportResponsePacket *responsePacketPtr;
-  sb_uint8 cnt;
-  
-  /* verify that this number of bytes actually first in this command */
-  assert(length <= (xcpMaxProgCto-2) && (xcpMaxProgCto <= XCP_MASTER_TX_MAX_DATA));
-  
-  /* prepare the command packet */
-  packetData[0] = XCP_MASTER_CMD_PROGRAM;
-  packetData[1] = length;
-  for (cnt=0; cnt<length; cnt++)
+  /* send the packet */
+  if (XcpMasterTransmitCmdProgram(session, length, data) == SB_FALSE)
   {
-    packetData[cnt+2] = data[cnt];
+    return SB_FALSE;
   }
+  /* wait for the response */
+  return XcpMasterReceiveResponse(session);
+} /*** end of XcpMasterSendCmdProgram ***/
 
+
+/************************************************************************************//**
+** \brief     Sends the XCP PROGRAM CLEAR command.
+** \param     session XCP master session.
+** \param     length Number of bytes to erase, starting at the MTA.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpMasterSendCmdProgramClear(tXcpMasterSession *session, sb_uint32 length)
+{
   /* send the packet */
-  if (XcpTransportSendPacket(packetData, length+2, XCP_MASTER_TIMEOUT_T5_MS) == SB_FALSE)
+  if (XcpMasterTransmitProgramClear(session, length) == SB_FALSE)
   {
-    /* cound not set packet or receive response within the specified timeout */
     return SB_FALSE;
   }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
+  /* wait for the response */
+  return XcpMasterReceiveResponse(session);
+} /*** end of XcpMasterSendCmdProgramClear ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits an XCP command packet without waiting for its response. The
+**            command is remembered, such that its response can be processed once it
+**            arrives.
+** \param     session XCP master session.
+** \param     segments Array with the segments that form the packet. The first byte of
+**            the first segment holds the command code.
+** \param     segmentCnt Number of segments in the array.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpMasterTransmitCmd(tXcpMasterSession *session,
+                                     tXcpTransportSegment segments[], sb_uint8 segmentCnt)
+{
+  sb_uint16 timeoutMs;
+
+  assert(session->pendingCnt < XCP_MASTER_PENDING_MAX);
+
+  /* a slave that does not read the packet in time would not respond in time either */
+  timeoutMs = XcpMasterGetTimeout(session, XcpMasterGetCmdTimeoutClass(segments[0].data[0]));
+  if (XcpTransportTransmitPacket(&session->transport, segments, segmentCnt, timeoutMs) == SB_FALSE)
   {
-    /* not a valid or positive response */
     return SB_FALSE;
   }
-  
-  /* still here so all went well */  
+  XCP_STATS_COMMAND_SENT(&session->stats, segments, segmentCnt);
+  /* remember the command until its response arrives */
+  session->pendingCmd[(session->pendingHead + session->pendingCnt) % XCP_MASTER_PENDING_MAX] =
+    segments[0].data[0];
+  session->pendingCnt++;
   return SB_TRUE;
-} /*** end of XcpMasterSendCmdProgram ***/
+} /*** end of XcpMasterTransmitCmd ***/
 
 
 /************************************************************************************//**
-** \brief     Sends the XCP PROGRAM MAX command.
+** \brief     Transmits the XCP PROGRAM command without waiting for its response.
+** \param     session XCP master session.
+** \param     length Number of bytes in the data array to program.
 ** \param     data Array with data bytes to program.
 ** \return    SB_TRUE is successfull, SB_FALSE otherwise.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdProgramMax(sb_uint8 data[])
+static sb_uint8 XcpMasterTransmitCmdProgram(tXcpMasterSession *session, sb_uint8 length,
+                                            sb_uint8 data[])
 {
-  sb_uint8 packetData[XCP_MASTER_TX_MAX_DATA];
-  tXcpTransportResponsePacket *responsePacketPtr;
-  sb_uint8 cnt;
+  sb_uint8 packetData[2];
+  tXcpTransportSegment segments[2];
   
   /* verify that this number of bytes actually first in this command */
-  assert(xcpMaxProgCto <= XCP_MASTER_TX_MAX_DATA);
+  assert(length <= (session->maxProgCto-2) && (session->maxProgCto <= XCP_MASTER_TX_MAX_DATA));
   
-  /* prepare the command packet */
+  /* prepare the command packet. the data is transmitted directly from the caller's
+   * buffer, so only the command header needs to be prepared here.
+   */
+  packetData[0] = XCP_MASTER_CMD_PROGRAM;
+  packetData[1] = length;
+  segments[0].data = packetData;
+  segments[0].len = 2;
+  segments[1].data = data;
+  segments[1].len = length;
+
+  /* send the packet */
+  return XcpMasterTransmitCmd(session, segments, 2);
+} /*** end of XcpMasterTransmitCmdProgram ***/
+
+
+/************************************************************************************//**
+** \brief     Transmits the XCP PROGRAM MAX command without waiting for its response.
+** \param     session XCP master session.
+** \param     data Array with data bytes to program.
+** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+**
+****************************************************************************************/
+static sb_uint8 XcpMasterTransmitCmdProgramMax(tXcpMasterSession *session, sb_uint8 data[])
+{
+  sb_uint8 packetData[1];
+  tXcpTransportSegment segments[2];
+  
+  /* verify that this number of bytes actually first in this command */
+  assert(session->maxProgCto <= XCP_MASTER_TX_MAX_DATA);
+  
+  /* prepare the command packet. the data is transmitted directly from the caller's
+   * buffer, so only the command header needs to be prepared here.
+   */
   packetData[0] = XCP_MASTER_CMD_PROGRAM_MAX;
-  for (cnt=0; cnt<(xcpMaxProgCto-1); cnt++)
-  {
-    packetData[cnt+1] = data[cnt];
-  }
+  segments[0].data = packetData;
+  segments[0].len = 1;
+  segments[1].data = data;
+  segments[1].len = session->maxProgCto - 1;
 
   /* send the packet */
-  if (XcpTransportSendPacket(packetData, xcpMaxProgCto, XCP_MASTER_TIMEOUT_T5_MS) == SB_FALSE)
+  return XcpMasterTransmitCmd(session, segments, 2);
+} /*** end of XcpMasterTransmitCmdProgramMax ***/
+
+
+/************************************************************************************//**
+** \brief     Receives the response of the oldest command in flight and checks that it
+**            is a positive response.
+** \param     session XCP master session.
+** \return    SB_TRUE if a positive response was received, SB_FALSE otherwise. The
+**            length of the response packet is 0 in case no response was received.
+**
+****************************************************************************************/
+static sb_uint8 XcpMasterReceiveResponse(tXcpMasterSession *session)
+{
+  if (XcpTransportReceivePacket(&session->transport, XcpMasterGetResponseTimeout(session)) == SB_FALSE)
   {
-    /* cound not set packet or receive response within the specified timeout */
+    /* could not receive response within the specified timeout */
+    XcpMasterHandleTimeout(session);
     return SB_FALSE;
   }
   /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
-  {
-    /* not a valid or positive response */
-    return SB_FALSE;
-  }
-  
-  /* still here so all went well */  
-  return SB_TRUE;
-} /*** end of XcpMasterSendCmdProgramMax ***/
+  return XcpMasterHandleResponse(session);
+} /*** end of XcpMasterReceiveResponse ***/
 
 
 /************************************************************************************//**
-** \brief     Sends the XCP PROGRAM CLEAR command.
-** \return    SB_TRUE is successfull, SB_FALSE otherwise.
+** \brief     Obtains the type of a command, which determines its timeout.
+** \param     cmd XCP command code.
+** \return    Type of command.
 **
 ****************************************************************************************/
-static sb_uint8 XcpMasterSendCmdProgramClear(sb_uint32 length)
+static tXcpMasterTimeoutClass XcpMasterGetCmdTimeoutClass(sb_uint8 cmd)
 {
-  sb_uint8 packetData[8];
-  tXcpTransportResponsePacket *responsePacketPtr;
-
-  /* prepare the command packet */
-  packetData[0] = XCP_MASTER_CMD_PROGRAM_CLEAR;
-  packetData[1] = 0; /* use absolute mode */
-  packetData[2] = 0; /* reserved */
-  packetData[3] = 0; /* reserved */
+  switch (cmd)
+  {
+    case XCP_MASTER_CMD_CONNECT:
+      return XCP_MASTER_TIMEOUT_CLASS_CONNECT;
+    case XCP_MASTER_CMD_PROGRAM_START:
+      return XCP_MASTER_TIMEOUT_CLASS_PROGRAM_START;
+    case XCP_MASTER_CMD_PROGRAM_CLEAR:
+      return XCP_MASTER_TIMEOUT_CLASS_CLEAR;
+    case XCP_MASTER_CMD_PROGRAM:
+    case XCP_MASTER_CMD_PROGRAM_MAX:
+    case XCP_MASTER_CMD_PROGRAM_RESET:
+      /* the reset command gets the timeout of T5, but does not update its estimator */
+      return XCP_MASTER_TIMEOUT_CLASS_PROGRAM;
+    default:
+      return XCP_MASTER_TIMEOUT_CLASS_STD;
+  }
+} /*** end of XcpMasterGetCmdTimeoutClass ***/
 
-  /* set the erase length taking into account byte ordering */
-  XcpMasterSetOrderedLong(length, &packetData[4]);
 
+/************************************************************************************//**
+** \brief     Updates the round trip time estimator of a type of command with the round
+**            trip time of the response that was just received (RFC 6298).
+** \param     session XCP master session.
+** \param     cmd XCP command code of the command that was responded to.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpMasterUpdateRttEstimator(tXcpMasterSession *session, sb_uint8 cmd)
+{
+  tXcpMasterRttEstimator *estimator;
+  sb_uint32 rttUs;
+  sb_uint32 deltaUs;
 
-  /* send the packet */
-  if (XcpTransportSendPacket(packetData, 8, XCP_MASTER_TIMEOUT_T4_MS) == SB_FALSE)
+  estimator = &session->rttEstimators[XcpMasterGetCmdTimeoutClass(cmd)];
+  rttUs = session->transport.stats.lastRttUs;
+  if (estimator->samples == 0)
   {
-    /* cound not set packet or receive response within the specified timeout */
-    return SB_FALSE;
+    estimator->srttUs = rttUs;
+    estimator->rttvarUs = rttUs / 2;
   }
-  /* still here so a response was received */
-  responsePacketPtr = XcpTransportReadResponsePacket();
-  
-  /* check if the reponse was valid */
-  if ( (responsePacketPtr->len == 0) || (responsePacketPtr->data[0] != XCP_MASTER_CMD_PID_RES) )
+  else
   {
-    /* not a valid or positive response */
-    return SB_FALSE;
+    /* RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R| and SRTT = 7/8 SRTT + 1/8 R */
+    deltaUs = (estimator->srttUs > rttUs) ? (estimator->srttUs - rttUs) : (rttUs - estimator->srttUs);
+    estimator->rttvarUs = ((3 * estimator->rttvarUs) + deltaUs) / 4;
+    estimator->srttUs = ((7 * estimator->srttUs) + rttUs) / 8;
   }
-  
-  /* still here so all went well */  
-  return SB_TRUE;
-} /*** end of XcpMasterSendCmdProgramClear ***/
+  estimator->samples++;
+  /* the slave responds again, so the timeout no longer needs to be backed off */
+  estimator->backoff = 0;
+} /*** end of XcpMasterUpdateRttEstimator ***/
 
 
 /************************************************************************************//**
 ** \brief     Stores a 32-bit value into a byte buffer taking into account Intel
 **            or Motorola byte ordering.
+** \param     session XCP master session.
 ** \param     value The 32-bit value to store in the buffer.
 ** \param     data Array to the buffer for storage.
 ** \return    none.
 **
 ****************************************************************************************/
-static void XcpMasterSetOrderedLong(sb_uint32 value, sb_uint8 data[])
+static void XcpMasterSetOrderedLong(tXcpMasterSession *session, sb_uint32 value,
+                                    sb_uint8 data[])
 {
-  if (xcpSlaveIsIntel == SB_TRUE)
+  if (session->slaveIsIntel == SB_TRUE)
   {
     data[3] = (sb_uint8)(value >> 24);
     data[2] = (sb_uint8)(value >> 16);
@@ -46,25 +46,121 @@
  */
 #define XCP_MASTER_RX_MAX_DATA         (255)
 
+/** \brief Maximum number of program commands that can be kept in flight while
+ *         programming data.
+ */
+#define XCP_MASTER_PROGRAM_WINDOW_MAX  (64)
+
+/** \brief Maximum number of commands that can be in flight. One more than the program
+ *         window, because a SET MTA command can precede the program commands.
+ */
+#define XCP_MASTER_PENDING_MAX         (XCP_MASTER_PROGRAM_WINDOW_MAX + 1)
+
+/* XCP command codes as defined by the protocol currently supported by this module */
+#define XCP_MASTER_CMD_CONNECT         (0xFF)
+#define XCP_MASTER_CMD_DISCONNECT      (0xFE)
+#define XCP_MASTER_CMD_SET_MTA         (0xF6)
+#define XCP_MASTER_CMD_UPLOAD          (0xF5)
+#define XCP_MASTER_CMD_PROGRAM_START   (0xD2)
+#define XCP_MASTER_CMD_PROGRAM_CLEAR   (0xD1)
+#define XCP_MASTER_CMD_PROGRAM         (0xD0)
+#define XCP_MASTER_CMD_PROGRAM_RESET   (0xCF)
+#define XCP_MASTER_CMD_PROGRAM_MAX     (0xC9)
+
 
 /****************************************************************************************
 * Include files
 ****************************************************************************************/
 #include "xcptransport.h"                             /* XCP transport layer           */
+#include "xcpstats.h"                                 /* XCP command statistics        */
+
+
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Enumeration for the types of commands that each have their own timeout. */
+typedef enum
+{
+  XCP_MASTER_TIMEOUT_CLASS_STD,                  /**< standard commands (T1)           */
+  XCP_MASTER_TIMEOUT_CLASS_CONNECT,              /**< connect command (T6)             */
+  XCP_MASTER_TIMEOUT_CLASS_PROGRAM_START,        /**< program start command (T3)       */
+  XCP_MASTER_TIMEOUT_CLASS_CLEAR,                /**< program clear command (T4)       */
+  XCP_MASTER_TIMEOUT_CLASS_PROGRAM,              /**< program and reset commands (T5)  */
+  XCP_MASTER_TIMEOUT_CLASS_CNT                   /**< number of types of commands      */
+} tXcpMasterTimeoutClass;
+
+/** \brief Structure type for the round trip time estimator of a type of command, from
+ *         which its timeout is derived.
+ */
+typedef struct
+{
+  sb_uint32 srttUs;                               /**< smoothed round trip time        */
+  sb_uint32 rttvarUs;                             /**< round trip time variation       */
+  sb_uint32 samples;                              /**< number of measured round trips  */
+  sb_uint32 timeouts;                             /**< number of timeouts              */
+  sb_uint8 backoff;                               /**< times the timeout is doubled    */
+} tXcpMasterRttEstimator;
+
+/** \brief Structure type for the state of an XCP master session. Each session has its
+ *         own connection with an XCP slave, so that several sessions can coexist in one
+ *         process and be used from different threads.
+ */
+typedef struct
+{
+  tXcpTransport transport;                        /**< transport layer of the session  */
+  sb_uint8 slaveIsIntel;                          /**< byte ordering of the XCP slave  */
+  sb_uint8 maxCto;                                /**< max bytes master->slave packet  */
+  sb_uint8 maxProgCto;                            /**< idem, during programming        */
+  sb_uint8 maxDto;                                /**< max bytes slave->master packet  */
+  sb_uint8 programWindow;                         /**< program commands in flight      */
+  sb_uint32 errorAddress;                         /**< address of failed program cmd   */
+  sb_uint8 pendingCmd[XCP_MASTER_PENDING_MAX];    /**< codes of commands in flight     */
+  sb_uint8 pendingHead;                           /**< oldest command in flight        */
+  sb_uint8 pendingCnt;                            /**< number of commands in flight    */
+  /** \brief Round trip time estimators, indexed by tXcpMasterTimeoutClass. */
+  tXcpMasterRttEstimator rttEstimators[XCP_MASTER_TIMEOUT_CLASS_CNT];
+#if (XCP_STATS_ENABLE > 0)
+  tXcpStats stats;                                /**< statistics per type of command  */
+#endif
+} tXcpMasterSession;
 
 
 /****************************************************************************************
 * Function prototypes
 ****************************************************************************************/
-sb_uint8 XcpMasterInit(sb_char *address, sb_uint32 port);
-void     XcpMasterDeinit(void);
-sb_uint8 XcpMasterConnect(void);
-sb_uint8 XcpMasterDisconnect(void);
-sb_uint8 XcpMasterStartProgrammingSession(void);
-sb_uint8 XcpMasterStopProgrammingSession(void);
-sb_uint8 XcpMasterClearMemory(sb_uint32 addr, sb_uint32 len);
-sb_uint8 XcpMasterReadData(sb_uint32 addr, sb_uint32 len, sb_uint8 data[]);
-sb_uint8 XcpMasterProgramData(sb_uint32 addr, sb_uint32 len, sb_uint8 data[]);
+sb_uint8 XcpMasterInit(tXcpMasterSession *session, sb_char *address, sb_uint32 port,
+                       tXcpTransportProfile profile, sb_uint32 connectTimeoutMs);
+void     XcpMasterDeinit(tXcpMasterSession *session);
+sb_uint8 XcpMasterConnect(tXcpMasterSession *session);
+sb_uint8 XcpMasterDisconnect(tXcpMasterSession *session);
+sb_uint8 XcpMasterStartProgrammingSession(tXcpMasterSession *session);
+sb_uint8 XcpMasterStopProgrammingSession(tXcpMasterSession *session);
+sb_uint8 XcpMasterClearMemory(tXcpMasterSession *session, sb_uint32 addr, sb_uint32 len);
+sb_uint8 XcpMasterReadData(tXcpMasterSession *session, sb_uint32 addr, sb_uint32 len,
+                           sb_uint8 data[]);
+sb_uint8 XcpMasterProgramData(tXcpMasterSession *session, sb_uint32 addr, sb_uint32 len,
+                              sb_uint8 data[]);
+void     XcpMasterSetProgramWindow(tXcpMasterSession *session, sb_uint8 window);
+sb_uint32 XcpMasterGetErrorAddress(tXcpMasterSession *session);
+/* non-blocking interface, which leaves waiting for the responses to the caller */
+sb_uint8 XcpMasterInitNonBlocking(tXcpMasterSession *session, const tXcpTransportHost *host,
+                                  tXcpTransportProfile profile);
+sb_uint8 XcpMasterTransmitConnect(tXcpMasterSession *session);
+sb_uint8 XcpMasterTransmitSetMta(tXcpMasterSession *session, sb_uint32 address);
+sb_uint8 XcpMasterTransmitProgramStart(tXcpMasterSession *session);
+sb_uint8 XcpMasterTransmitProgramClear(tXcpMasterSession *session, sb_uint32 length);
+sb_uint8 XcpMasterTransmitProgramData(tXcpMasterSession *session, sb_uint32 len,
+                                      sb_uint8 data[]);
+sb_uint8 XcpMasterTransmitProgramStop(tXcpMasterSession *session);
+sb_uint8 XcpMasterTransmitProgramReset(tXcpMasterSession *session);
+sb_uint8 XcpMasterHandleResponse(tXcpMasterSession *session);
+void     XcpMasterHandleTimeout(tXcpMasterSession *session);
+sb_uint16 XcpMasterGetResponseTimeout(tXcpMasterSession *session);
+sb_uint16 XcpMasterGetTimeout(tXcpMasterSession *session, tXcpMasterTimeoutClass timeoutClass);
+tXcpMasterRttEstimator *XcpMasterGetRttEstimator(tXcpMasterSession *session,
+                                                 tXcpMasterTimeoutClass timeoutClass);
+const sb_char *XcpMasterGetTimeoutClassName(tXcpMasterTimeoutClass timeoutClass);
+const sb_char *XcpMasterGetCmdName(sb_uint8 cmd);
 
 
 #endif /* XCPMASTER_H */
@@ -0,0 +1,371 @@
+/************************************************************************************//**
+* \file         xcpstats.c
+* \brief        XCP command statistics source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* string library                */
+#include "xcpmaster.h"                                /* XCP master protocol module    */
+
+#if (XCP_STATS_ENABLE > 0)
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for the name of an XCP command that is counted separately. */
+typedef struct
+{
+  sb_uint8 code;                                  /**< XCP command code                */
+  const sb_char *name;                            /**< name in the JSON output         */
+} tXcpStatsCommandName;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static tXcpStatsCommand *XcpStatsGetCommand(tXcpStats *stats, sb_uint8 cmd);
+
+
+/****************************************************************************************
+* Local constant declarations
+****************************************************************************************/
+/** \brief Commands that are counted separately. All others are counted as the last
+ *         entry.
+ */
+static const tXcpStatsCommandName xcpStatsCommandNames[XCP_STATS_CMD_CNT] =
+{
+  { XCP_MASTER_CMD_CONNECT,       "CONNECT" },
+  { XCP_MASTER_CMD_SET_MTA,       "SET_MTA" },
+  { XCP_MASTER_CMD_UPLOAD,        "UPLOAD" },
+  { XCP_MASTER_CMD_PROGRAM_START, "PROGRAM_START" },
+  { XCP_MASTER_CMD_PROGRAM_CLEAR, "PROGRAM_CLEAR" },
+  { XCP_MASTER_CMD_PROGRAM,       "PROGRAM" },
+  { XCP_MASTER_CMD_PROGRAM_MAX,   "PROGRAM_MAX" },
+  { XCP_MASTER_CMD_PROGRAM_RESET, "PROGRAM_RESET" },
+  { 0x00,                         "OTHER" }
+};
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Totals of all sessions that ended. */
+static tXcpStats xcpStatsTotals;
+
+
+/************************************************************************************//**
+** \brief     Initializes the statistics.
+** \param     stats Statistics to initialize.
+** \return    none.
+**
+****************************************************************************************/
+void XcpStatsInit(tXcpStats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+} /*** end of XcpStatsInit ***/
+
+
+/************************************************************************************//**
+** \brief     Counts a transmitted command. A command that is transmitted again after
+**            the previous one of its type timed out is counted as a retry.
+** \param     stats Statistics of the session.
+** \param     segments Segments of the command packet. The first byte of the first
+**            segment is the command code.
+** \param     segmentCnt Number of segments.
+** \return    none.
+**
+****************************************************************************************/
+void XcpStatsCommandSent(tXcpStats *stats, const tXcpTransportSegment segments[],
+                         sb_uint8 segmentCnt)
+{
+  sb_uint8 cmd = segments[0].data[0];
+  tXcpStatsCommand *command = XcpStatsGetCommand(stats, cmd);
+  sb_uint32 len = 0;
+  sb_uint8 segmentIdx;
+
+  for (segmentIdx=0; segmentIdx<segmentCnt; segmentIdx++)
+  {
+    len += segments[segmentIdx].len;
+  }
+  command->sent++;
+  command->payloadBytes += len;
+  command->framingBytes += XCP_TRANSPORT_FRAMING_BYTES;
+  if ( (stats->lastTimeoutCmd == cmd) && (cmd != 0) )
+  {
+    command->retries++;
+    stats->lastTimeoutCmd = 0;
+  }
+} /*** end of XcpStatsCommandSent ***/
+
+
+/************************************************************************************//**
+** \brief     Counts a received response and adds its round trip time to the histogram
+**            of its command.
+** \param     stats Statistics of the session.
+** \param     cmd XCP command code of the command that the response belongs to.
+** \param     len Number of bytes in the response packet.
+** \param     positive SB_TRUE for a positive response, SB_FALSE otherwise.
+** \param     rttUs Round trip time of the command in microseconds.
+** \return    none.
+**
+****************************************************************************************/
+void XcpStatsResponseReceived(tXcpStats *stats, sb_uint8 cmd, sb_uint32 len,
+                              sb_uint8 positive, sb_uint32 rttUs)
+{
+  tXcpStatsCommand *command = XcpStatsGetCommand(stats, cmd);
+  sb_uint8 bucket = 0;
+
+  if (positive == SB_TRUE)
+  {
+    command->positive++;
+  }
+  else
+  {
+    command->negative++;
+  }
+  command->payloadBytes += len;
+  command->framingBytes += XCP_TRANSPORT_FRAMING_BYTES;
+  /* update the latency distribution */
+  if ( (command->positive + command->negative == 1) || (rttUs < command->latencyMinUs) )
+  {
+    command->latencyMinUs = rttUs;
+  }
+  if (rttUs > command->latencyMaxUs)
+  {
+    command->latencyMaxUs = rttUs;
+  }
+  command->latencyTotalUs += rttUs;
+  while ( (bucket < (XCP_STATS_HISTOGRAM_BUCKETS - 1)) && ((rttUs >> (bucket + 1)) != 0) )
+  {
+    bucket++;
+  }
+  command->histogram[bucket]++;
+} /*** end of XcpStatsResponseReceived ***/
+
+
+/************************************************************************************//**
+** \brief     Counts a command whose response did not arrive in time.
+** \param     stats Statistics of the session.
+** \param     cmd XCP command code.
+** \return    none.
+**
+****************************************************************************************/
+void XcpStatsTimeout(tXcpStats *stats, sb_uint8 cmd)
+{
+  XcpStatsGetCommand(stats, cmd)->timeouts++;
+  stats->lastTimeoutCmd = cmd;
+} /*** end of XcpStatsTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Adds the statistics of a session that ends to the totals, together with
+**            the syscall counters of its transport layer. The statistics of the session
+**            are cleared afterwards, so that they are only added once.
+** \param     stats Statistics of the session.
+** \param     transportStats Statistics of the transport layer of the session.
+** \return    none.
+**
+****************************************************************************************/
+void XcpStatsSessionEnd(tXcpStats *stats, const tXcpTransportStats *transportStats)
+{
+  tXcpStatsCommand *total;
+  tXcpStatsCommand *command;
+  sb_uint8 cmdIdx;
+  sb_uint8 bucket;
+  sb_uint32 sent = 0;
+
+  /* nothing to add if the session never transmitted a command, or already ended */
+  for (cmdIdx=0; cmdIdx<XCP_STATS_CMD_CNT; cmdIdx++)
+  {
+    sent += stats->commands[cmdIdx].sent;
+  }
+  if (sent == 0)
+  {
+    return;
+  }
+  for (cmdIdx=0; cmdIdx<XCP_STATS_CMD_CNT; cmdIdx++)
+  {
+    total = &xcpStatsTotals.commands[cmdIdx];
+    command = &stats->commands[cmdIdx];
+    if ( (command->positive + command->negative > 0) &&
+         ((total->positive + total->negative == 0) ||
+          (command->latencyMinUs < total->latencyMinUs)) )
+    {
+      total->latencyMinUs = command->latencyMinUs;
+    }
+    if (command->latencyMaxUs > total->latencyMaxUs)
+    {
+      total->latencyMaxUs = command->latencyMaxUs;
+    }
+    total->sent += command->sent;
+    total->positive += command->positive;
+    total->negative += command->negative;
+    total->timeouts += command->timeouts;
+    total->retries += command->retries;
+    total->payloadBytes += command->payloadBytes;
+    total->framingBytes += command->framingBytes;
+    total->latencyTotalUs += command->latencyTotalUs;
+    for (bucket=0; bucket<XCP_STATS_HISTOGRAM_BUCKETS; bucket++)
+    {
+      total->histogram[bucket] += command->histogram[bucket];
+    }
+  }
+  xcpStatsTotals.sessions++;
+  xcpStatsTotals.sendCalls += transportStats->sendCalls;
+  xcpStatsTotals.recvCalls += transportStats->recvCalls;
+  xcpStatsTotals.wakeups += transportStats->wakeups;
+  XcpStatsInit(stats);
+} /*** end of XcpStatsSessionEnd ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the totals of all sessions that ended.
+** \return    Pointer to the totals.
+**
+****************************************************************************************/
+tXcpStats *XcpStatsGetTotals(void)
+{
+  return &xcpStatsTotals;
+} /*** end of XcpStatsGetTotals ***/
+
+
+/************************************************************************************//**
+** \brief     Writes the statistics to a file in JSON format.
+** \param     stats Statistics to write.
+** \param     fileName Name of the file.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpStatsWriteJson(const tXcpStats *stats, const sb_char *fileName)
+{
+  sb_file hFile;
+  const tXcpStatsCommand *command;
+  sb_uint64 payloadBytes = 0;
+  sb_uint64 framingBytes = 0;
+  sb_uint32 timeouts = 0;
+  sb_uint32 retries = 0;
+  sb_uint8 cmdIdx;
+  sb_uint8 bucket;
+  sb_uint8 first = SB_TRUE;
+  sb_uint8 firstBucket;
+
+  hFile = fopen(fileName, "w");
+  if (hFile == SB_NULL)
+  {
+    return SB_FALSE;
+  }
+
+  fprintf(hFile, "{\n  \"commands\": {");
+  for (cmdIdx=0; cmdIdx<XCP_STATS_CMD_CNT; cmdIdx++)
+  {
+    command = &stats->commands[cmdIdx];
+    payloadBytes += command->payloadBytes;
+    framingBytes += command->framingBytes;
+    timeouts += command->timeouts;
+    retries += command->retries;
+    /* only output the commands that were used */
+    if (command->sent == 0)
+    {
+      continue;
+    }
+    fprintf(hFile, "%s\n    \"%s\": {\"sent\": %u, \"positive\": %u, \"negative\": %u, "
+            "\"timeouts\": %u, \"retries\": %u,\n", (first == SB_TRUE) ? "" : ",",
+            xcpStatsCommandNames[cmdIdx].name, command->sent, command->positive,
+            command->negative, command->timeouts, command->retries);
+    fprintf(hFile, "      \"payloadBytes\": %llu, \"framingBytes\": %llu,\n",
+            (unsigned long long)command->payloadBytes,
+            (unsigned long long)command->framingBytes);
+    fprintf(hFile, "      \"latencyUs\": {\"min\": %u, \"avg\": %.1f, \"max\": %u},\n",
+            command->latencyMinUs,
+            (command->positive + command->negative > 0) ?
+            ((double)command->latencyTotalUs / (command->positive + command->negative)) : 0.0,
+            command->latencyMaxUs);
+    /* the histogram lists the non-empty buckets as pairs of the upper bound and the
+     * count. the upper bound of the last bucket is unlimited, which is written as 0.
+     */
+    fprintf(hFile, "      \"histogramUs\": [");
+    firstBucket = SB_TRUE;
+    for (bucket=0; bucket<XCP_STATS_HISTOGRAM_BUCKETS; bucket++)
+    {
+      if (command->histogram[bucket] > 0)
+      {
+        fprintf(hFile, "%s[%u, %u]", (firstBucket == SB_TRUE) ? "" : ", ",
+                (bucket < (XCP_STATS_HISTOGRAM_BUCKETS - 1)) ? (2u << bucket) : 0,
+                command->histogram[bucket]);
+        firstBucket = SB_FALSE;
+      }
+    }
+    fprintf(hFile, "]}");
+    first = SB_FALSE;
+  }
+  fprintf(hFile, "\n  },\n");
+  fprintf(hFile, "  \"sessions\": %u,\n  \"payloadBytes\": %llu,\n  \"framingBytes\": %llu,\n",
+          stats->sessions, (unsigned long long)payloadBytes,
+          (unsigned long long)framingBytes);
+  fprintf(hFile, "  \"wireEfficiency\": %.4f,\n",
+          (payloadBytes + framingBytes > 0) ?
+          ((double)payloadBytes / (payloadBytes + framingBytes)) : 0.0);
+  fprintf(hFile, "  \"timeouts\": %u,\n  \"retries\": %u,\n", timeouts, retries);
+  fprintf(hFile, "  \"syscalls\": {\"send\": %u, \"recv\": %u},\n  \"wakeups\": %u\n}\n",
+          stats->sendCalls, stats->recvCalls, stats->wakeups);
+  fclose(hFile);
+  return SB_TRUE;
+} /*** end of XcpStatsWriteJson ***/
+
+
+/************************************************************************************//**
+** \brief     Obtains the statistics of a type of command.
+** \param     stats Statistics of the session.
+** \param     cmd XCP command code.
+** \return    Pointer to the statistics of the command.
+**
+****************************************************************************************/
+static tXcpStatsCommand *XcpStatsGetCommand(tXcpStats *stats, sb_uint8 cmd)
+{
+  sb_uint8 cmdIdx;
+
+  for (cmdIdx=0; cmdIdx<(XCP_STATS_CMD_CNT - 1); cmdIdx++)
+  {
+    if (xcpStatsCommandNames[cmdIdx].code == cmd)
+    {
+      break;
+    }
+  }
+  return &stats->commands[cmdIdx];
+} /*** end of XcpStatsGetCommand ***/
+#endif /* XCP_STATS_ENABLE > 0 */
+
+
+/*********************************** end of xcpstats.c **********************************/
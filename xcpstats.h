@@ -0,0 +1,126 @@
+/************************************************************************************//**
+* \file         xcpstats.h
+* \brief        XCP command statistics header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+#ifndef XCPSTATS_H
+#define XCPSTATS_H
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Enables the collection of statistics for each type of XCP command. When
+ *         disabled, the hooks in the XCP master compile to nothing. Enable it with
+ *         "cmake -DXCP_STATS=ON".
+ */
+#ifndef XCP_STATS_ENABLE
+#define XCP_STATS_ENABLE               (0)
+#endif
+
+/** \brief Number of buckets in a latency histogram. Bucket n counts the round trips
+ *         that took less than 2^(n+1) microseconds, the last one counts all others.
+ */
+#define XCP_STATS_HISTOGRAM_BUCKETS    (24)
+
+/** \brief Number of types of commands that are counted separately. */
+#define XCP_STATS_CMD_CNT              (9)
+
+#if (XCP_STATS_ENABLE > 0)
+/* hooks for the XCP master */
+#define XCP_STATS_INIT(stats) \
+  XcpStatsInit((stats))
+#define XCP_STATS_COMMAND_SENT(stats, segments, segmentCnt) \
+  XcpStatsCommandSent((stats), (segments), (segmentCnt))
+#define XCP_STATS_RESPONSE_RECEIVED(stats, cmd, len, positive, rttUs) \
+  XcpStatsResponseReceived((stats), (cmd), (len), (positive), (rttUs))
+#define XCP_STATS_TIMEOUT(stats, cmd) \
+  XcpStatsTimeout((stats), (cmd))
+#define XCP_STATS_SESSION_END(stats, transportStats) \
+  XcpStatsSessionEnd((stats), (transportStats))
+#else
+#define XCP_STATS_INIT(stats)                                          ((void)0)
+#define XCP_STATS_COMMAND_SENT(stats, segments, segmentCnt)            ((void)0)
+#define XCP_STATS_RESPONSE_RECEIVED(stats, cmd, len, positive, rttUs)  ((void)0)
+#define XCP_STATS_TIMEOUT(stats, cmd)                                  ((void)0)
+#define XCP_STATS_SESSION_END(stats, transportStats)                   ((void)0)
+#endif
+
+
+#if (XCP_STATS_ENABLE > 0)
+/****************************************************************************************
+* Type definitions
+****************************************************************************************/
+/** \brief Structure type for the statistics of one type of XCP command. */
+typedef struct
+{
+  sb_uint32 sent;                                 /**< number of transmitted commands  */
+  sb_uint32 positive;                             /**< number of positive responses    */
+  sb_uint32 negative;                             /**< number of negative responses    */
+  sb_uint32 timeouts;                             /**< number of missing responses     */
+  sb_uint32 retries;                              /**< commands sent again after timeout*/
+  sb_uint64 payloadBytes;                         /**< command and response bytes      */
+  sb_uint64 framingBytes;                         /**< bytes added by the framing      */
+  sb_uint64 latencyTotalUs;                       /**< sum of the round trip times     */
+  sb_uint32 latencyMinUs;                         /**< shortest round trip time        */
+  sb_uint32 latencyMaxUs;                         /**< longest round trip time         */
+  sb_uint32 histogram[XCP_STATS_HISTOGRAM_BUCKETS]; /**< round trip time distribution  */
+} tXcpStatsCommand;
+
+/** \brief Structure type for the statistics of an XCP master session, or the totals of
+ *         all sessions.
+ */
+typedef struct
+{
+  tXcpStatsCommand commands[XCP_STATS_CMD_CNT];   /**< statistics per type of command  */
+  sb_uint8 lastTimeoutCmd;                        /**< command that last timed out     */
+  sb_uint32 sessions;                             /**< number of ended sessions        */
+  sb_uint32 sendCalls;                            /**< number of send syscalls         */
+  sb_uint32 recvCalls;                            /**< number of recv syscalls         */
+  sb_uint32 wakeups;                              /**< total receive wakeups           */
+} tXcpStats;
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+void       XcpStatsInit(tXcpStats *stats);
+void       XcpStatsCommandSent(tXcpStats *stats, const tXcpTransportSegment segments[],
+                               sb_uint8 segmentCnt);
+void       XcpStatsResponseReceived(tXcpStats *stats, sb_uint8 cmd, sb_uint32 len,
+                                    sb_uint8 positive, sb_uint32 rttUs);
+void       XcpStatsTimeout(tXcpStats *stats, sb_uint8 cmd);
+void       XcpStatsSessionEnd(tXcpStats *stats, const tXcpTransportStats *transportStats);
+tXcpStats *XcpStatsGetTotals(void);
+sb_uint8   XcpStatsWriteJson(const tXcpStats *stats, const sb_char *fileName);
+#endif /* XCP_STATS_ENABLE > 0 */
+
+
+#endif /* XCPSTATS_H */
+/*********************************** end of xcpstats.h **********************************/
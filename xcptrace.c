@@ -0,0 +1,230 @@
+/************************************************************************************//**
+* \file         xcptrace.c
+* \brief        Timeline export in Chrome trace event format source file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+
+
+/****************************************************************************************
+* Include files
+****************************************************************************************/
+#include <assert.h>                                   /* assertion module              */
+#include <sb_types.h>                                 /* C types                       */
+#include <string.h>                                   /* string library                */
+#include "xcpmaster.h"                                /* XCP master protocol module    */
+#include "xcptrace.h"                                 /* timeline export               */
+#include "timeutil.h"                                 /* time utility module           */
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+static void XcpTraceWriteSpan(const sb_char *name, const sb_char *category,
+                              sb_uint32 track, sb_uint64 startNs, sb_uint64 endNs,
+                              const sb_char *result);
+
+
+/****************************************************************************************
+* Local data declarations
+****************************************************************************************/
+/** \brief Trace file, SB_NULL when no trace is recorded. */
+static sb_file hTraceFile = SB_NULL;
+
+/** \brief Time that the trace started. The timestamps are relative to it. */
+static sb_uint64 traceStartNs;
+
+/** \brief End time of the last span on each track, for spreading overlapping commands
+ *         over several tracks.
+ */
+static sb_uint64 trackEndNs[XCP_TRACE_MAX_TRACKS];
+
+/** \brief Number of tracks that were given a name so far. */
+static sb_uint32 trackCnt;
+
+
+/************************************************************************************//**
+** \brief     Starts recording a trace. The spans are written to the file as they end.
+** \param     fileName Name of the trace file.
+** \return    SB_TRUE if successful, SB_FALSE otherwise.
+**
+****************************************************************************************/
+sb_uint8 XcpTraceOpen(const sb_char *fileName)
+{
+  hTraceFile = fopen(fileName, "w");
+  if (hTraceFile == SB_NULL)
+  {
+    return SB_FALSE;
+  }
+  traceStartNs = TimeUtilGetTimeNs();
+  memset(trackEndNs, 0, sizeof(trackEndNs));
+  trackCnt = 0;
+  fprintf(hTraceFile, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(hTraceFile, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+          "\"args\": {\"name\": \"openblt-tcp-boot\"}}");
+  return SB_TRUE;
+} /*** end of XcpTraceOpen ***/
+
+
+/************************************************************************************//**
+** \brief     Stops recording the trace and closes the trace file.
+** \return    none.
+**
+****************************************************************************************/
+void XcpTraceClose(void)
+{
+  if (hTraceFile == SB_NULL)
+  {
+    return;
+  }
+  fprintf(hTraceFile, "\n]}\n");
+  fclose(hTraceFile);
+  hTraceFile = SB_NULL;
+} /*** end of XcpTraceClose ***/
+
+
+/************************************************************************************//**
+** \brief     Records a phase that ends now.
+** \param     name Name of the phase.
+** \param     startNs Time that the phase started, from TimeUtilGetTimeNs().
+** \return    none.
+**
+****************************************************************************************/
+void XcpTracePhase(const sb_char *name, sb_uint64 startNs)
+{
+  if (hTraceFile == SB_NULL)
+  {
+    return;
+  }
+  XcpTraceWriteSpan(name, "phase", 0, startNs, TimeUtilGetTimeNs(), SB_NULL);
+} /*** end of XcpTracePhase ***/
+
+
+/************************************************************************************//**
+** \brief     Records an XCP command whose response arrived just now. Commands are put
+**            on the track of the phases, where they show up nested in their phase. When
+**            commands are pipelined, an overlapping command is put on the first track
+**            that is free at the time it was transmitted.
+** \param     cmd XCP command code.
+** \param     rttUs Round trip time of the command in microseconds.
+** \param     positive SB_TRUE for a positive response, SB_FALSE otherwise.
+** \return    none.
+**
+****************************************************************************************/
+void XcpTraceCommand(sb_uint8 cmd, sb_uint32 rttUs, sb_uint8 positive)
+{
+  sb_uint64 endNs;
+  sb_uint64 startNs;
+  sb_uint32 track;
+
+  if (hTraceFile == SB_NULL)
+  {
+    return;
+  }
+  endNs = TimeUtilGetTimeNs();
+  startNs = endNs - (rttUs * 1000ull);
+  for (track=0; track<(XCP_TRACE_MAX_TRACKS - 1); track++)
+  {
+    if (trackEndNs[track] <= startNs)
+    {
+      break;
+    }
+  }
+  trackEndNs[track] = endNs;
+  XcpTraceWriteSpan(XcpMasterGetCmdName(cmd), "xcp", track, startNs, endNs,
+                    (positive == SB_TRUE) ? "ok" : "error");
+} /*** end of XcpTraceCommand ***/
+
+
+/************************************************************************************//**
+** \brief     Records that the response of an XCP command did not arrive in time.
+** \param     cmd XCP command code.
+** \return    none.
+**
+****************************************************************************************/
+void XcpTraceTimeout(sb_uint8 cmd)
+{
+  if (hTraceFile == SB_NULL)
+  {
+    return;
+  }
+  fprintf(hTraceFile, ",\n{\"name\": \"%s timeout\", \"cat\": \"xcp\", \"ph\": \"i\", "
+          "\"s\": \"t\", \"ts\": %.3f, \"pid\": 1, \"tid\": 1}", XcpMasterGetCmdName(cmd),
+          (TimeUtilGetTimeNs() - traceStartNs) / 1000.0);
+} /*** end of XcpTraceTimeout ***/
+
+
+/************************************************************************************//**
+** \brief     Writes a span as a complete event. Tracks are numbered from 0, which
+**            becomes thread 1 in the trace.
+** \param     name Name of the span.
+** \param     category Category of the span.
+** \param     track Track of the span.
+** \param     startNs Start time of the span.
+** \param     endNs End time of the span.
+** \param     result Result that is added as an argument, or SB_NULL for none.
+** \return    none.
+**
+****************************************************************************************/
+static void XcpTraceWriteSpan(const sb_char *name, const sb_char *category,
+                              sb_uint32 track, sb_uint64 startNs, sb_uint64 endNs,
+                              const sb_char *result)
+{
+  /* name the tracks the first time they are used */
+  while (trackCnt <= track)
+  {
+    if (trackCnt == 0)
+    {
+      fprintf(hTraceFile, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+              "\"tid\": 1, \"args\": {\"name\": \"phases\"}}");
+    }
+    else
+    {
+      fprintf(hTraceFile, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+              "\"tid\": %u, \"args\": {\"name\": \"pipelined commands %u\"}}",
+              trackCnt + 1, trackCnt);
+    }
+    trackCnt++;
+  }
+  if (startNs < traceStartNs)
+  {
+    startNs = traceStartNs;
+  }
+  fprintf(hTraceFile, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+          "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u", name, category,
+          (startNs - traceStartNs) / 1000.0, (endNs - startNs) / 1000.0, track + 1);
+  if (result != SB_NULL)
+  {
+    fprintf(hTraceFile, ", \"args\": {\"result\": \"%s\"}", result);
+  }
+  fprintf(hTraceFile, "}");
+} /*** end of XcpTraceWriteSpan ***/
+
+
+/*********************************** end of xcptrace.c **********************************/
@@ -0,0 +1,57 @@
+/************************************************************************************//**
+* \file         xcptrace.h
+* \brief        Timeline export in Chrome trace event format header file.
+* \ingroup      openblt-tcp-boot
+* \internal
+*----------------------------------------------------------------------------------------
+*                          C O P Y R I G H T
+*----------------------------------------------------------------------------------------
+*   Copyright (c) 2014  by Feaser    http://www.feaser.com    All rights reserved
+*
+*----------------------------------------------------------------------------------------
+*                            L I C E N S E
+*----------------------------------------------------------------------------------------
+* This file is part of OpenBLT. OpenBLT is free software: you can redistribute it and/or
+* modify it under the terms of the GNU General Public License as published by the Free
+* Software Foundation, either version 3 of the License, or (at your option) any later
+* version.
+*
+* OpenBLT is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+* PURPOSE. See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with OpenBLT.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+* A special exception to the GPL is included to allow you to distribute a combined work
+* that includes OpenBLT without being obliged to provide the source code for any
+* proprietary components. The exception text is included at the bottom of the license
+* file <license.html>.
+*
+* \endinternal
+****************************************************************************************/
+#ifndef XCPTRACE_H
+#define XCPTRACE_H
+
+/****************************************************************************************
+* Macro definitions
+****************************************************************************************/
+/** \brief Maximum number of tracks that the spans of overlapping commands are spread
+ *         over. The first track is the one of the phases, so that commands that do not
+ *         overlap are shown nested in their phase.
+ */
+#define XCP_TRACE_MAX_TRACKS           (XCP_MASTER_PENDING_MAX)
+
+
+/****************************************************************************************
+* Function prototypes
+****************************************************************************************/
+sb_uint8 XcpTraceOpen(const sb_char *fileName);
+void     XcpTraceClose(void);
+void     XcpTracePhase(const sb_char *name, sb_uint64 startNs);
+void     XcpTraceCommand(sb_uint8 cmd, sb_uint32 rttUs, sb_uint8 positive);
+void     XcpTraceTimeout(sb_uint8 cmd);
+
+
+#endif /* XCPTRACE_H */
+/*********************************** end of xcptrace.h **********************************/